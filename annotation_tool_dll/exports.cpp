@@ -1,6 +1,21 @@
 #include "exports.h"
 
+#include <cmath>
+#include <cstring>
+#include <thread>
+
+#include <base/native_event_looper.h>
+
+#include <async_decoder.h>
+#include <batch_decoder.h>
+#include <box_propagator.h>
 #include <decoder.h>
+#include <file_decoder.h>
+#include <header_scanner.h>
+#include <preview_refiner.h>
+#include <sequence_archive.h>
+#include <thumbnail_store.h>
+#include <transformer.h>
 
 void* jpegDecompressorInit(const unsigned char *src, unsigned long size)
 {
@@ -31,6 +46,37 @@ unsigned jpegDecompressorGetSize(void* handle)
 	return jpeg_decompressor->getSize();
 }
 
+void jpegDecompressorSetQuality(void* handle, int quality)
+{
+	JPEGDecompressor *jpeg_decompressor = (JPEGDecompressor*)handle;
+	jpeg_decompressor->setQuality(quality ? DecodeQuality::preview : DecodeQuality::full);
+}
+
+int jpegDecompressorSetScalingFactor(void* handle, unsigned numerator, unsigned denominator)
+{
+	JPEGDecompressor *jpeg_decompressor = (JPEGDecompressor*)handle;
+	try {
+		jpeg_decompressor->setScalingFactor(numerator, denominator);
+		return 0;
+	}
+	catch (...)
+	{
+		return 1;
+	}
+}
+
+unsigned jpegDecompressorGetScaledWidth(void* handle)
+{
+	JPEGDecompressor *jpeg_decompressor = (JPEGDecompressor*)handle;
+	return jpeg_decompressor->getScaledWidth();
+}
+
+unsigned jpegDecompressorGetScaledHeight(void* handle)
+{
+	JPEGDecompressor *jpeg_decompressor = (JPEGDecompressor*)handle;
+	return jpeg_decompressor->getScaledHeight();
+}
+
 int jpegDecompress(void* handle, unsigned char* buf)
 {
 	JPEGDecompressor *jpeg_decompressor = (JPEGDecompressor*)handle;
@@ -44,7 +90,509 @@ int jpegDecompress(void* handle, unsigned char* buf)
 	}
 }
 
+int jpegDecompressLuma(void* handle, unsigned char* buf)
+{
+	JPEGDecompressor *jpeg_decompressor = (JPEGDecompressor*)handle;
+	try {
+		jpeg_decompressor->processLuma(buf);
+		return 0;
+	}
+	catch (...)
+	{
+		return 1;
+	}
+}
+
 void jpegDecompressDestroy(void* handle)
 {
 	delete static_cast<JPEGDecompressor*>(handle);
 }
+
+int jpegBatchDecompress(const unsigned char* const* srcs, const unsigned long* sizes, unsigned n,
+	unsigned width, unsigned height, int format, unsigned char* dst, int* statuses)
+{
+	static_assert(sizeof(BatchSlotStatus) == sizeof(int), "BatchSlotStatus must be ABI compatible with int");
+	try {
+		BatchDecoder decoder(width, height, PixelFormat(format));
+		return (int)decoder.decode(srcs, sizes, n, dst, (BatchSlotStatus*)statuses);
+	}
+	catch (...)
+	{
+		return -1;
+	}
+}
+
+int jpegBatchDecompressFiles(const wchar_t* const* paths, unsigned n,
+	unsigned width, unsigned height, int format, unsigned char* dst, int* statuses)
+{
+	try {
+		BatchDecoder decoder(width, height, PixelFormat(format));
+		return (int)decoder.decode(paths, n, dst, (BatchSlotStatus*)statuses);
+	}
+	catch (...)
+	{
+		return -1;
+	}
+}
+
+int jpegReadHeader(const wchar_t* path, unsigned* width, unsigned* height, int* subsampling)
+{
+	try {
+		JPEGImageInfo info;
+		if (!readJPEGHeader(path, &info))
+			return 1;
+		*width = info.width;
+		*height = info.height;
+		*subsampling = (int)info.subsampling;
+		return 0;
+	}
+	catch (...)
+	{
+		return 1;
+	}
+}
+
+void* jpegScanDirectoryHeaders(const wchar_t* directory)
+{
+	try {
+		return new std::vector<JPEGHeaderScanResult>(scanJPEGHeaders(directory));
+	}
+	catch (...)
+	{
+		return nullptr;
+	}
+}
+
+unsigned jpegScanDirectoryHeadersGetCount(void* handle)
+{
+	std::vector<JPEGHeaderScanResult> *results = (std::vector<JPEGHeaderScanResult>*)handle;
+	return (unsigned)results->size();
+}
+
+int jpegScanDirectoryHeadersGet(void* handle, unsigned index, const wchar_t** fileName, unsigned* width, unsigned* height, int* subsampling)
+{
+	std::vector<JPEGHeaderScanResult> *results = (std::vector<JPEGHeaderScanResult>*)handle;
+	if (index >= results->size())
+		return 1;
+	const JPEGHeaderScanResult &result = (*results)[index];
+	*fileName = result.fileName.c_str();
+	if (!result.valid)
+		return 1;
+	*width = result.info.width;
+	*height = result.info.height;
+	*subsampling = (int)result.info.subsampling;
+	return 0;
+}
+
+void jpegScanDirectoryHeadersDestroy(void* handle)
+{
+	delete static_cast<std::vector<JPEGHeaderScanResult>*>(handle);
+}
+
+void* sequenceArchiveOpen(const wchar_t* path)
+{
+	try {
+		return new SequenceArchiveReader(path);
+	}
+	catch (...)
+	{
+		return nullptr;
+	}
+}
+
+unsigned sequenceArchiveGetNumberOfFrames(void* handle)
+{
+	SequenceArchiveReader *reader = (SequenceArchiveReader*)handle;
+	return reader->getNumberOfFrames();
+}
+
+int sequenceArchiveGetFrame(void* handle, unsigned index, const unsigned char** data, unsigned long* size)
+{
+	SequenceArchiveReader *reader = (SequenceArchiveReader*)handle;
+	if (index >= reader->getNumberOfFrames())
+		return 1;
+	uint32_t frameSize;
+	*data = reader->getFrame(index, &frameSize);
+	*size = frameSize;
+	return 0;
+}
+
+int sequenceArchiveGetRecord(void* handle, unsigned index, int* id, int* labeled, int* x, int* y, int* w, int* h, int* occlusion, int* outOfView)
+{
+	SequenceArchiveReader *reader = (SequenceArchiveReader*)handle;
+	if (!reader->hasRecords() || index >= reader->getNumberOfFrames())
+		return 1;
+	const SequenceArchiveRecord &record = reader->getRecord(index);
+	*id = record.id;
+	*labeled = record.labeled;
+	*x = record.x;
+	*y = record.y;
+	*w = record.w;
+	*h = record.h;
+	*occlusion = record.occlusion;
+	*outOfView = record.outOfView;
+	return 0;
+}
+
+void sequenceArchiveClose(void* handle)
+{
+	delete static_cast<SequenceArchiveReader*>(handle);
+}
+
+void* thumbnailStoreOpen(const wchar_t* sequenceDirectory, const wchar_t* storePath)
+{
+	try {
+		return new ThumbnailStore(sequenceDirectory, storePath);
+	}
+	catch (...)
+	{
+		return nullptr;
+	}
+}
+
+int thumbnailStoreUpdate(void* handle)
+{
+	ThumbnailStore *store = (ThumbnailStore*)handle;
+	try {
+		store->update();
+	}
+	catch (...)
+	{
+		return 1;
+	}
+	return 0;
+}
+
+int thumbnailStoreIsUpdating(void* handle)
+{
+	ThumbnailStore *store = (ThumbnailStore*)handle;
+	return store->isUpdating();
+}
+
+unsigned thumbnailStoreGetNumberOfFrames(void* handle)
+{
+	ThumbnailStore *store = (ThumbnailStore*)handle;
+	return store->getNumberOfFrames();
+}
+
+int thumbnailStoreGetThumbnail(void* handle, unsigned frame, unsigned level, unsigned char* jpeg, unsigned long* size, unsigned* width, unsigned* height)
+{
+	ThumbnailStore *store = (ThumbnailStore*)handle;
+	try {
+		std::vector<unsigned char> data;
+		if (!store->getThumbnail(frame, level, &data, width, height))
+			return 1;
+		const unsigned long capacity = *size;
+		*size = (unsigned long)data.size();
+		if (data.size() > capacity)
+			return 1;
+		memcpy(jpeg, data.data(), data.size());
+	}
+	catch (...)
+	{
+		return 1;
+	}
+	return 0;
+}
+
+void thumbnailStoreClose(void* handle)
+{
+	delete static_cast<ThumbnailStore*>(handle);
+}
+
+void* boxPropagatorCreate()
+{
+	try {
+		return new BoxPropagator;
+	}
+	catch (...)
+	{
+		return nullptr;
+	}
+}
+
+int boxPropagatorPropagate(void* handle, const unsigned char* frame, unsigned long frameSize, const unsigned char* nextFrame, unsigned long nextFrameSize,
+	int x, int y, int w, int h, int* nextX, int* nextY, int* nextW, int* nextH, double* confidence)
+{
+	BoxPropagator *propagator = (BoxPropagator*)handle;
+	try {
+		const PropagatedBox box = propagator->propagate(frame, frameSize, nextFrame, nextFrameSize, x, y, w, h);
+		*nextX = (int)std::lround(box.x);
+		*nextY = (int)std::lround(box.y);
+		*nextW = (int)std::lround(box.w);
+		*nextH = (int)std::lround(box.h);
+		*confidence = box.confidence;
+	}
+	catch (...)
+	{
+		return 1;
+	}
+	return 0;
+}
+
+void boxPropagatorDestroy(void* handle)
+{
+	delete static_cast<BoxPropagator*>(handle);
+}
+
+void* jpegAsyncDecoderCreate(unsigned numberOfThreads, unsigned maximumQueueDepth)
+{
+	try {
+		return new AsyncDecoder(numberOfThreads, maximumQueueDepth);
+	}
+	catch (...)
+	{
+		return nullptr;
+	}
+}
+
+static uint64_t submitAsyncDecode(AsyncDecoder *decoder, AsyncDecodeRequest &request, unsigned char* dst, unsigned long dstCapacity,
+	int format, int quality, unsigned scalingFactorDenominator, JPEGAsyncDecodeCallback callback, void* context, int nonBlocking)
+{
+	request.dst = dst;
+	request.dstCapacity = dstCapacity;
+	request.format = (PixelFormat)format;
+	request.quality = quality ? DecodeQuality::preview : DecodeQuality::full;
+	request.scalingFactorDenominator = scalingFactorDenominator;
+	if (callback)
+	{
+		request.callback = [callback, context](uint64_t ticket, AsyncDecodeStatus status, unsigned width, unsigned height)
+		{
+			callback(ticket, (int)status, width, height, context);
+		};
+	}
+	try {
+		return nonBlocking ? decoder->trySubmit(request) : decoder->submit(request);
+	}
+	catch (...)
+	{
+		return 0;
+	}
+}
+
+uint64_t jpegAsyncDecodeSubmit(void* handle, const unsigned char* src, unsigned long size, unsigned char* dst, unsigned long dstCapacity,
+	int format, int quality, unsigned scalingFactorDenominator, JPEGAsyncDecodeCallback callback, void* context, int nonBlocking)
+{
+	AsyncDecodeRequest request = {};
+	request.src = src;
+	request.srcSize = size;
+	return submitAsyncDecode((AsyncDecoder*)handle, request, dst, dstCapacity, format, quality, scalingFactorDenominator, callback, context, nonBlocking);
+}
+
+uint64_t jpegAsyncDecodeSubmitFile(void* handle, const wchar_t* path, unsigned char* dst, unsigned long dstCapacity,
+	int format, int quality, unsigned scalingFactorDenominator, JPEGAsyncDecodeCallback callback, void* context, int nonBlocking)
+{
+	AsyncDecodeRequest request = {};
+	request.path = path;
+	return submitAsyncDecode((AsyncDecoder*)handle, request, dst, dstCapacity, format, quality, scalingFactorDenominator, callback, context, nonBlocking);
+}
+
+int jpegAsyncDecodePoll(void* handle, uint64_t ticket, unsigned* width, unsigned* height)
+{
+	AsyncDecoder *decoder = (AsyncDecoder*)handle;
+	try {
+		return (int)decoder->poll(ticket, width, height);
+	}
+	catch (...)
+	{
+		return -1;
+	}
+}
+
+int jpegAsyncDecodeWait(void* handle, uint64_t ticket, unsigned timeout_ms, unsigned* width, unsigned* height)
+{
+	AsyncDecoder *decoder = (AsyncDecoder*)handle;
+	try {
+		return (int)decoder->wait(ticket, timeout_ms, width, height);
+	}
+	catch (...)
+	{
+		return -1;
+	}
+}
+
+int jpegAsyncDecodeCancel(void* handle, uint64_t ticket)
+{
+	AsyncDecoder *decoder = (AsyncDecoder*)handle;
+	return decoder->cancel(ticket) ? 0 : 1;
+}
+
+void jpegAsyncDecoderDestroy(void* handle)
+{
+	delete static_cast<AsyncDecoder*>(handle);
+}
+
+void* jpegFileDecoderCreate(unsigned maximumPrefetchedFrames)
+{
+	try {
+		return new JPEGFileDecoder(maximumPrefetchedFrames);
+	}
+	catch (...)
+	{
+		return nullptr;
+	}
+}
+
+void* jpegFileDecoderOpen(void* handle, const wchar_t* path)
+{
+	JPEGFileDecoder *decoder = static_cast<JPEGFileDecoder*>(handle);
+	try {
+		return &decoder->open(path);
+	}
+	catch (...)
+	{
+		return nullptr;
+	}
+}
+
+int jpegFileDecoderPrefetch(void* handle, const wchar_t* path)
+{
+	JPEGFileDecoder *decoder = static_cast<JPEGFileDecoder*>(handle);
+	try {
+		decoder->prefetch(path);
+		return 0;
+	}
+	catch (...)
+	{
+		return 1;
+	}
+}
+
+void jpegFileDecoderClearPrefetched(void* handle)
+{
+	static_cast<JPEGFileDecoder*>(handle)->clearPrefetched();
+}
+
+void jpegFileDecoderDestroy(void* handle)
+{
+	delete static_cast<JPEGFileDecoder*>(handle);
+}
+
+void* jpegTransformerCreate(int operation, int trim)
+{
+	try {
+		JPEGTransformer *transformer = new JPEGTransformer((JPEGTransformOperation)operation);
+		transformer->setTrim(trim != 0);
+		return transformer;
+	}
+	catch (...)
+	{
+		return nullptr;
+	}
+}
+
+void jpegTransformerSetCrop(void* handle, unsigned x, unsigned y, unsigned w, unsigned h)
+{
+	static_cast<JPEGTransformer*>(handle)->setCrop(x, y, w, h);
+}
+
+int jpegTransform(void* handle, const unsigned char* src, unsigned long srcSize, unsigned char* dst, unsigned long* size, unsigned* width, unsigned* height)
+{
+	JPEGTransformer *transformer = static_cast<JPEGTransformer*>(handle);
+	try {
+		std::vector<unsigned char> data;
+		const JPEGTransformGeometry geometry = transformer->transform(src, srcSize, data);
+		*width = geometry.width;
+		*height = geometry.height;
+		const unsigned long capacity = *size;
+		*size = (unsigned long)data.size();
+		if (data.size() > capacity)
+			return 1;
+		memcpy(dst, data.data(), data.size());
+	}
+	catch (...)
+	{
+		return 1;
+	}
+	return 0;
+}
+
+int jpegTransformBox(void* handle, const unsigned char* src, unsigned long srcSize, int* x, int* y, int* w, int* h)
+{
+	JPEGTransformer *transformer = static_cast<JPEGTransformer*>(handle);
+	try {
+		return JPEGTransformer::transformBox(transformer->getGeometry(src, srcSize), x, y, w, h) ? 0 : 1;
+	}
+	catch (...)
+	{
+		return 1;
+	}
+}
+
+void jpegTransformerDestroy(void* handle)
+{
+	delete static_cast<JPEGTransformer*>(handle);
+}
+
+// The refiner and the looper thread its full quality decodes run on
+class PreviewRefinerHandle
+{
+public:
+	PreviewRefinerHandle(PixelFormat format, uint32_t settleTime_ms, unsigned previewScalingFactorDenominator, JPEGPreviewCallback callback, void *context)
+		: _refiner(format, [callback, context](const unsigned char *image, unsigned width, unsigned height, DecodeQuality quality)
+		{
+			callback(image, width, height, (int)quality, context);
+		}, settleTime_ms, previewScalingFactorDenominator)
+	{
+		_looper.registerWaitableObject(&_refiner);
+		_looperThread = std::thread([this]()
+		{
+			while (true)
+			{
+				try {
+					_looper.runLooper();
+					return;
+				}
+				catch (std::exception &)
+				{
+					// Already logged, a frame that fails to decode does not end scrubbing
+				}
+			}
+		});
+	}
+	PreviewRefinerHandle(const PreviewRefinerHandle &) = delete;
+	~PreviewRefinerHandle()
+	{
+		_looper.cancel();
+		_looperThread.join();
+		_looper.eraseWaitableObject(&_refiner);
+	}
+	void seek(const unsigned char *src, unsigned long size)
+	{
+		_refiner.seek(src, size);
+	}
+private:
+	Base::NativeEventLooper _looper;
+	PreviewRefiner _refiner;
+	std::thread _looperThread;
+};
+
+void* jpegPreviewRefinerCreate(int format, unsigned settleTime_ms, unsigned previewScalingFactorDenominator, JPEGPreviewCallback callback, void* context)
+{
+	if (!callback)
+		return nullptr;
+	try {
+		return new PreviewRefinerHandle((PixelFormat)format, settleTime_ms, previewScalingFactorDenominator, callback, context);
+	}
+	catch (...)
+	{
+		return nullptr;
+	}
+}
+
+int jpegPreviewRefinerSeek(void* handle, const unsigned char* src, unsigned long size)
+{
+	try {
+		static_cast<PreviewRefinerHandle*>(handle)->seek(src, size);
+	}
+	catch (...)
+	{
+		return 1;
+	}
+	return 0;
+}
+
+void jpegPreviewRefinerDestroy(void* handle)
+{
+	delete static_cast<PreviewRefinerHandle*>(handle);
+}
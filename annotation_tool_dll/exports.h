@@ -6,11 +6,123 @@
 #define DLLEXPORT __declspec(dllimport)
 #endif
 
+#include <cstdint>
+
 
 
 DLLEXPORT void * jpegDecompressorInit(const unsigned char *src, unsigned long size);
 DLLEXPORT unsigned jpegDecompressorGetWidth(void *handle);
 DLLEXPORT unsigned jpegDecompressorGetHeight(void *handle);
 DLLEXPORT unsigned jpegDecompressorGetSize(void *handle);
+// quality: 0 full, 1 preview (fast IDCT and upsampling)
+DLLEXPORT void jpegDecompressorSetQuality(void *handle, int quality);
+// Returns 1 if the scaling factor is not supported by libjpeg-turbo
+DLLEXPORT int jpegDecompressorSetScalingFactor(void *handle, unsigned numerator, unsigned denominator);
+DLLEXPORT unsigned jpegDecompressorGetScaledWidth(void *handle);
+DLLEXPORT unsigned jpegDecompressorGetScaledHeight(void *handle);
 DLLEXPORT int jpegDecompress(void *handle, unsigned char *buf);
+// Writes scaled width * scaled height bytes of luma, skipping chroma decoding and color conversion
+DLLEXPORT int jpegDecompressLuma(void *handle, unsigned char *buf);
 DLLEXPORT void jpegDecompressDestroy(void *handle);
+
+// Decodes n JPEGs in parallel into dst, a contiguous n x height x width x channels buffer.
+// format is a PixelFormat value, statuses (may be null) receives a BatchSlotStatus per frame.
+// Returns the number of frames that failed, their slots are zero filled, or -1 on invalid arguments.
+DLLEXPORT int jpegBatchDecompress(const unsigned char * const *srcs, const unsigned long *sizes, unsigned n,
+	unsigned width, unsigned height, int format, unsigned char *dst, int *statuses);
+DLLEXPORT int jpegBatchDecompressFiles(const wchar_t * const *paths, unsigned n,
+	unsigned width, unsigned height, int format, unsigned char *dst, int *statuses);
+
+// Reads width, height and subsampling (TJSAMP value) from the SOF marker only. Returns 0 on success
+DLLEXPORT int jpegReadHeader(const wchar_t *path, unsigned *width, unsigned *height, int *subsampling);
+// Probes all .jpg/.jpeg files of a directory in parallel, in natural file name order
+DLLEXPORT void * jpegScanDirectoryHeaders(const wchar_t *directory);
+DLLEXPORT unsigned jpegScanDirectoryHeadersGetCount(void *handle);
+// fileName stays valid until jpegScanDirectoryHeadersDestroy(). Returns 0 if the file is a decodable JPEG
+DLLEXPORT int jpegScanDirectoryHeadersGet(void *handle, unsigned index, const wchar_t **fileName, unsigned *width, unsigned *height, int *subsampling);
+DLLEXPORT void jpegScanDirectoryHeadersDestroy(void *handle);
+
+// Maps a packed sequence archive, frames are pointers into the mapping and can be passed to jpegDecompressorInit
+// directly. They stay valid until sequenceArchiveClose().
+DLLEXPORT void * sequenceArchiveOpen(const wchar_t *path);
+DLLEXPORT unsigned sequenceArchiveGetNumberOfFrames(void *handle);
+DLLEXPORT int sequenceArchiveGetFrame(void *handle, unsigned index, const unsigned char **data, unsigned long *size);
+// Returns 1 if the index is out of range or the archive has no records
+DLLEXPORT int sequenceArchiveGetRecord(void *handle, unsigned index, int *id, int *labeled, int *x, int *y, int *w, int *h, int *occlusion, int *outOfView);
+DLLEXPORT void sequenceArchiveClose(void *handle);
+
+// Thumbnails at 1/8 and 1/4 scale (levels 0 and 1), the store file is loaded right away,
+// thumbnailStoreUpdate() rebuilds missing and outdated ones in the background
+DLLEXPORT void * thumbnailStoreOpen(const wchar_t *sequenceDirectory, const wchar_t *storePath);
+DLLEXPORT int thumbnailStoreUpdate(void *handle);
+DLLEXPORT int thumbnailStoreIsUpdating(void *handle);
+DLLEXPORT unsigned thumbnailStoreGetNumberOfFrames(void *handle);
+// size is the capacity of jpeg on input and the JPEG size on output. Returns 1 if the thumbnail is not built yet,
+// or if jpeg is too small, in which case size is set to the required capacity
+DLLEXPORT int thumbnailStoreGetThumbnail(void *handle, unsigned frame, unsigned level, unsigned char *jpeg, unsigned long *size, unsigned *width, unsigned *height);
+DLLEXPORT void thumbnailStoreClose(void *handle);
+
+// Proposes the box of the next frame from the box of the current one by template matching on luma,
+// one handle per thread. Returns 1 if a frame can not be decoded or the box lies outside of the frame.
+// confidence is the normalized cross-correlation of the match, 0 if the box has no texture to match on.
+DLLEXPORT void * boxPropagatorCreate();
+DLLEXPORT int boxPropagatorPropagate(void *handle, const unsigned char *frame, unsigned long frameSize, const unsigned char *nextFrame, unsigned long nextFrameSize,
+	int x, int y, int w, int h, int *nextX, int *nextY, int *nextW, int *nextH, double *confidence);
+DLLEXPORT void boxPropagatorDestroy(void *handle);
+
+// Asynchronous decoding on a pool of numberOfThreads workers (0: one per core) with at most maximumQueueDepth
+// requests waiting. status values: 0 pending, 1 ok, 2 decode failed, 3 file open failed, 4 dst too small, 5 canceled.
+// The callback runs on a worker thread, or on the thread that cancels the request.
+typedef void(*JPEGAsyncDecodeCallback)(uint64_t ticket, int status, unsigned width, unsigned height, void *context);
+DLLEXPORT void * jpegAsyncDecoderCreate(unsigned numberOfThreads, unsigned maximumQueueDepth);
+// Returns the ticket, or 0 on invalid arguments and, with nonBlocking set, if the queue is full.
+// Without nonBlocking the call waits for room in the queue. callback may be null, the result is then
+// collected with jpegAsyncDecodePoll() or jpegAsyncDecodeWait(). src and dst must stay valid until completion.
+DLLEXPORT uint64_t jpegAsyncDecodeSubmit(void *handle, const unsigned char *src, unsigned long size, unsigned char *dst, unsigned long dstCapacity,
+	int format, int quality, unsigned scalingFactorDenominator, JPEGAsyncDecodeCallback callback, void *context, int nonBlocking);
+DLLEXPORT uint64_t jpegAsyncDecodeSubmitFile(void *handle, const wchar_t *path, unsigned char *dst, unsigned long dstCapacity,
+	int format, int quality, unsigned scalingFactorDenominator, JPEGAsyncDecodeCallback callback, void *context, int nonBlocking);
+// Return the status, -1 for unknown tickets. A ticket is forgotten once a result other than pending was returned.
+DLLEXPORT int jpegAsyncDecodePoll(void *handle, uint64_t ticket, unsigned *width, unsigned *height);
+DLLEXPORT int jpegAsyncDecodeWait(void *handle, uint64_t ticket, unsigned timeout_ms, unsigned *width, unsigned *height);
+// Returns 0 if the request was still queued and is canceled now
+DLLEXPORT int jpegAsyncDecodeCancel(void *handle, uint64_t ticket);
+// Cancels the queued requests and waits for the running ones
+DLLEXPORT void jpegAsyncDecoderDestroy(void *handle);
+
+// Decodes files by path through a reused read buffer, with up to maximumPrefetchedFrames upcoming frames read
+// in the background. jpegFileDecoderOpen() returns a decompressor handle for the jpegDecompressor* functions,
+// valid until the next open or jpegFileDecoderDestroy() and not to be passed to jpegDecompressDestroy(), or null on failure.
+DLLEXPORT void * jpegFileDecoderCreate(unsigned maximumPrefetchedFrames);
+DLLEXPORT void * jpegFileDecoderOpen(void *handle, const wchar_t *path);
+DLLEXPORT int jpegFileDecoderPrefetch(void *handle, const wchar_t *path);
+DLLEXPORT void jpegFileDecoderClearPrefetched(void *handle);
+DLLEXPORT void jpegFileDecoderDestroy(void *handle);
+
+// Lossless rotation/flip/crop on the compressed data. operation: 0 none, 1 horizontal flip, 2 vertical flip,
+// 3 transpose, 4 transverse, 5 rotate 90 clockwise, 6 rotate 180, 7 rotate 270. Without trim, images whose size
+// is not a multiple of the iMCU fail instead of losing their partial edge iMCUs.
+DLLEXPORT void * jpegTransformerCreate(int operation, int trim);
+// The region refers to the transformed image, its corner is aligned down to the iMCU grid. w or h of 0 extend to the edge.
+DLLEXPORT void jpegTransformerSetCrop(void *handle, unsigned x, unsigned y, unsigned w, unsigned h);
+// size is the capacity of dst on input and the JPEG size on output, returns 1 on failure or if dst is too small
+DLLEXPORT int jpegTransform(void *handle, const unsigned char *src, unsigned long srcSize, unsigned char *dst, unsigned long *size, unsigned *width, unsigned *height);
+// Maps a box of the source image into the transformed one, returns 1 if nothing of it is left
+DLLEXPORT int jpegTransformBox(void *handle, const unsigned char *src, unsigned long srcSize, int *x, int *y, int *w, int *h);
+DLLEXPORT void jpegTransformerDestroy(void *handle);
+
+// Scrubbing: each seek decodes the frame as a fast preview, scaled by 1/previewScalingFactorDenominator, and
+// once no further seek came for settleTime_ms the last frame is decoded again in full quality and resolution.
+// A seek cancels the pending full quality decode of the frame before. The callback receives quality 1 for
+// previews, on the seeking thread, and 0 for the full quality frame, on a background thread. image is only
+// valid during the call and the callback must not seek.
+typedef void(*JPEGPreviewCallback)(const unsigned char *image, unsigned width, unsigned height, int quality, void *context);
+DLLEXPORT void * jpegPreviewRefinerCreate(int format, unsigned settleTime_ms, unsigned previewScalingFactorDenominator, JPEGPreviewCallback callback, void *context);
+// src must stay valid until the next seek or until the full quality frame has been delivered. Returns 1 on failure
+DLLEXPORT int jpegPreviewRefinerSeek(void *handle, const unsigned char *src, unsigned long size);
+// Waits for a full quality decode in progress
+DLLEXPORT void jpegPreviewRefinerDestroy(void *handle);
+
+// Logging of the DLL is written by a background thread. Returns once everything logged before is written,
+// call it before unloading the DLL.
+DLLEXPORT void loggingFlush();
@@ -0,0 +1,18 @@
+#define SPDLOG_WCHAR_FILENAMES
+#include <spdlog/spdlog.h>
+
+#include <base/async_logging.h>
+#include <base/debugoutput_logger_sink.h>
+
+#include "exports.h"
+
+std::shared_ptr<spdlog::logger> logger = std::make_shared<spdlog::logger>("annotation_tool_dll logger", std::make_shared<Base::debugoutput_sink>());
+
+// Started with the DLL and never destroyed: its writer thread can not exit while the loader lock is held during
+// unload, joining it there would hang. Hosts call loggingFlush() before unloading to keep the last records.
+static Base::AsyncLogging *asyncLogging = new Base::AsyncLogging();
+
+void loggingFlush()
+{
+	asyncLogging->flush();
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "file.h"
+
+namespace Base
+{
+	struct AsyncIORequest
+	{
+		// Opened with File::Mode::overlapped
+		File *file;
+		uint64_t offset;
+		// Must stay valid until the completion is collected
+		unsigned char *buffer;
+		uint32_t size;
+		bool write;
+		// Handed back with the completion
+		uint64_t userData;
+	};
+
+	struct AsyncIOCompletion
+	{
+		uint64_t userData;
+		uint32_t bytesTransferred;
+		// Win32 error code, 0 on success. Reads starting at or past the end of the file fail with ERROR_HANDLE_EOF,
+		// canceled requests with ERROR_OPERATION_ABORTED.
+		uint32_t error;
+	};
+
+	// Batched asynchronous file I/O on an I/O completion port. submit() issues a batch of requests without
+	// waiting for any of them, getCompletions() collects finished ones in batches, so a single thread keeps
+	// as many transfers in flight as the device queue takes.
+	// submit() is thread safe, completions are collected by one thread at a time.
+	class AsyncIOEngine
+	{
+	public:
+		AsyncIOEngine(unsigned maximumInFlight = 64);
+		AsyncIOEngine(const AsyncIOEngine &) = delete;
+		// Cancels the requests in flight and waits for them, their completions are dropped
+		~AsyncIOEngine();
+		// Associates the file with the completion port, once per file before its first request.
+		// A file can only ever be associated with one engine. Synchronous read()/write() calls on it stay allowed,
+		// their completions are not queued to the engine.
+		void registerFile(File &file);
+		// Issues requests in order until maximumInFlight are in flight, returns how many were taken.
+		// A request that can not be issued completes right away with its error.
+		size_t submit(const AsyncIORequest *requests, size_t numberOfRequests);
+		// Waits up to timeout_ms for the first completion, then takes what else is ready without waiting.
+		// Returns the number of completions written, 0 on timeout.
+		size_t getCompletions(AsyncIOCompletion *completions, size_t maximumCompletions, uint32_t timeout_ms);
+		size_t getNumberOfInFlight() const;
+		unsigned getMaximumInFlight() const noexcept;
+	private:
+		struct Operation;
+		// nullptr once maximumInFlight are in flight
+		Operation *acquireOperation();
+		void releaseOperation(Operation *operation);
+
+		HANDLE _completionPort;
+		unsigned _maximumInFlight;
+		mutable std::mutex _lock;
+		std::vector<std::unique_ptr<Operation>> _operations;
+		std::vector<Operation*> _freeOperations;
+		// Requests that failed to issue, handed out ahead of the port
+		std::vector<AsyncIOCompletion> _failedRequests;
+		// Used by the collecting thread only
+		std::vector<OVERLAPPED_ENTRY> _entries;
+	};
+}
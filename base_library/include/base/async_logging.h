@@ -0,0 +1,40 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <thread>
+
+#include "log_record.h"
+#include "message_notifier.h"
+
+namespace Base
+{
+	// While an instance exists, the records of the logging macros go into a preallocated lock free ring and a
+	// background thread formats them and writes them to ::logger, so logging costs the caller little more than
+	// rendering its text. Stack traces of fatal errors are symbolized by the writer too, the exception text no longer
+	// carries them. Without an instance everything is written synchronously as before.
+	// One instance at a time, usually next to the logger initialization for the lifetime of the process.
+	// When the ring is full, records below error are dropped and counted, errors wait for room, fatal errors wait
+	// until they are written since the process may not survive them.
+	class AsyncLogging
+	{
+	public:
+		AsyncLogging(size_t capacity = 2048);
+		AsyncLogging(const AsyncLogging &) = delete;
+		// Writes the records still queued
+		~AsyncLogging();
+		// Returns once the records queued before are written and the logger is flushed
+		void flush();
+		uint64_t getNumberOfDropped() const noexcept;
+		static bool isRunning() noexcept;
+		// false if no instance is running or on the writer thread, then the caller writes the record itself
+		static bool write(LogRecord &&record);
+	private:
+		void queue(LogRecord &&record);
+		void writerEntry();
+
+		MessageNotifier<LogRecord> _records;
+		std::atomic<uint64_t> _numberOfDropped;
+		std::thread _writer;
+	};
+}
@@ -0,0 +1,147 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace Base
+{
+	// Fixed capacity multi producer multi consumer ring (D. Vyukov's bounded queue): each cell carries a sequence
+	// number telling producers and consumers whose turn it is, so a push or pop is one compare exchange on the
+	// position plus the copy, without locks or allocations. Payloads are moved in and out.
+	template <typename Type>
+	class BoundedQueue
+	{
+	public:
+		// Rounded up to a power of two
+		explicit BoundedQueue(size_t capacity);
+		BoundedQueue(const BoundedQueue &) = delete;
+		~BoundedQueue();
+		// false if full, value is only moved from on success
+		bool tryPush(Type &&value);
+		// false if empty
+		bool tryPop(Type &value);
+		// Move in values from the front until full, returns how many were taken
+		size_t tryPush(Type *values, size_t numberOfValues);
+		size_t tryPop(Type *values, size_t maximumNumberOfValues);
+		size_t getCapacity() const noexcept;
+	private:
+		struct Cell
+		{
+			std::atomic<size_t> sequence;
+			typename std::aligned_storage<sizeof(Type), alignof(Type)>::type storage;
+		};
+		std::unique_ptr<Cell[]> _cells;
+		size_t _mask;
+		// Producers and consumers update their position on separate cache lines
+		char _padding0[64];
+		std::atomic<size_t> _enqueuePosition;
+		char _padding1[64];
+		std::atomic<size_t> _dequeuePosition;
+		char _padding2[64];
+	};
+
+	template <typename Type>
+	BoundedQueue<Type>::BoundedQueue(size_t capacity)
+		: _enqueuePosition(0), _dequeuePosition(0)
+	{
+		size_t roundedCapacity = 2;
+		while (roundedCapacity < capacity)
+			roundedCapacity *= 2;
+		_cells = std::make_unique<Cell[]>(roundedCapacity);
+		_mask = roundedCapacity - 1;
+		for (size_t i = 0; i < roundedCapacity; ++i)
+			_cells[i].sequence.store(i, std::memory_order_relaxed);
+	}
+
+	template <typename Type>
+	BoundedQueue<Type>::~BoundedQueue()
+	{
+		for (size_t position = _dequeuePosition.load(); position != _enqueuePosition.load(); ++position)
+		{
+			Cell &cell = _cells[position & _mask];
+			if (cell.sequence.load() == position + 1)
+				reinterpret_cast<Type*>(&cell.storage)->~Type();
+		}
+	}
+
+	template <typename Type>
+	bool BoundedQueue<Type>::tryPush(Type&& value)
+	{
+		size_t position = _enqueuePosition.load(std::memory_order_relaxed);
+		while (true)
+		{
+			Cell &cell = _cells[position & _mask];
+			const size_t sequence = cell.sequence.load(std::memory_order_acquire);
+			const ptrdiff_t difference = ptrdiff_t(sequence) - ptrdiff_t(position);
+			if (difference == 0)
+			{
+				if (_enqueuePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+				{
+					new (&cell.storage) Type(std::move(value));
+					cell.sequence.store(position + 1, std::memory_order_release);
+					return true;
+				}
+			}
+			else if (difference < 0)
+				// The consumer of the previous round has not taken the cell yet
+				return false;
+			else
+				position = _enqueuePosition.load(std::memory_order_relaxed);
+		}
+	}
+
+	template <typename Type>
+	bool BoundedQueue<Type>::tryPop(Type& value)
+	{
+		size_t position = _dequeuePosition.load(std::memory_order_relaxed);
+		while (true)
+		{
+			Cell &cell = _cells[position & _mask];
+			const size_t sequence = cell.sequence.load(std::memory_order_acquire);
+			const ptrdiff_t difference = ptrdiff_t(sequence) - ptrdiff_t(position + 1);
+			if (difference == 0)
+			{
+				if (_dequeuePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+				{
+					Type *stored = reinterpret_cast<Type*>(&cell.storage);
+					value = std::move(*stored);
+					stored->~Type();
+					cell.sequence.store(position + _mask + 1, std::memory_order_release);
+					return true;
+				}
+			}
+			else if (difference < 0)
+				return false;
+			else
+				position = _dequeuePosition.load(std::memory_order_relaxed);
+		}
+	}
+
+	template <typename Type>
+	size_t BoundedQueue<Type>::tryPush(Type* values, size_t numberOfValues)
+	{
+		size_t numberOfPushed = 0;
+		while (numberOfPushed < numberOfValues && tryPush(std::move(values[numberOfPushed])))
+			++numberOfPushed;
+		return numberOfPushed;
+	}
+
+	template <typename Type>
+	size_t BoundedQueue<Type>::tryPop(Type* values, size_t maximumNumberOfValues)
+	{
+		size_t numberOfPopped = 0;
+		while (numberOfPopped < maximumNumberOfValues && tryPop(values[numberOfPopped]))
+			++numberOfPopped;
+		return numberOfPopped;
+	}
+
+	template <typename Type>
+	size_t BoundedQueue<Type>::getCapacity() const noexcept
+	{
+		return _mask + 1;
+	}
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace Base
+{
+	class BufferPool;
+
+	// Owns a pooled buffer and hands it back to its pool on destruction. Contents are not initialized.
+	class BufferLease
+	{
+	public:
+		BufferLease() noexcept;
+		BufferLease(const BufferLease &) = delete;
+		BufferLease(BufferLease &&other) noexcept;
+		BufferLease &operator=(BufferLease &&other) noexcept;
+		~BufferLease();
+		unsigned char *get() const noexcept;
+		// The requested size, the underlying buffer may be larger (getCapacity())
+		size_t getSize() const noexcept;
+		size_t getCapacity() const noexcept;
+		void release() noexcept;
+		explicit operator bool() const noexcept;
+	private:
+		friend class BufferPool;
+		BufferLease(BufferPool *pool, unsigned char *buffer, size_t size, unsigned sizeClass) noexcept;
+		BufferPool *_pool;
+		unsigned char *_buffer;
+		size_t _size;
+		unsigned _sizeClass;
+	};
+
+	// Size-classed pool of page aligned (so at least 64 byte aligned) buffers for decoded frames.
+	// Sizes are rounded up to a quarter of their power of two (at most 25% slack), at least 64 KB.
+	// Released buffers are cached per class up to maxCachedBuffersPerClass and reused without
+	// touching the allocator or faulting fresh pages in.
+	class BufferPool
+	{
+	public:
+		// Large pages need SeLockMemoryPrivilege, the pool falls back to normal pages if it is not granted
+		BufferPool(bool useLargePages = false, unsigned maxCachedBuffersPerClass = 4);
+		BufferPool(const BufferPool &) = delete;
+		~BufferPool();
+		BufferLease acquire(size_t size);
+		// Frees all cached buffers, leased buffers are not affected
+		void trim();
+		bool isUsingLargePages() const noexcept;
+		static size_t getCapacityOfSizeClass(unsigned sizeClass) noexcept;
+		// Process wide pool backed by normal pages. Never destroyed, so leases may outlive static destruction.
+		static BufferPool &getDefault();
+	private:
+		friend class BufferLease;
+		void release(unsigned char *buffer, unsigned sizeClass) noexcept;
+		unsigned char *allocate(size_t capacity);
+		void free(unsigned char *buffer) noexcept;
+		struct SizeClass
+		{
+			std::mutex lock;
+			std::vector<unsigned char*> buffers;
+		};
+		std::unique_ptr<SizeClass[]> _sizeClasses;
+		unsigned _maxCachedBuffersPerClass;
+		size_t _largePageSize;
+	};
+}
@@ -19,6 +19,8 @@
 #include <d2d1helper.h>
 #include <dwrite.h>
 
+#include "buffer_pool.h"
+
 /******************************************************************
 *                                                                 *
 *  D2DWindow                                                        *
@@ -62,7 +64,7 @@ namespace Base {
 		CComPtr<ID2D1Factory> m_pD2DFactory;
 		CComPtr<ID2D1HwndRenderTarget> m_pRenderTarget;
 		CComPtr<ID2D1Bitmap> _bitmap;
-		std::vector<unsigned char> _imageBuffer;
+		BufferLease _imageBuffer;
 		uint32_t _width, _height;
 		double _dpix, _dpiy;
 		std::mutex _lock;
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace Base
+{
+	// Digit runs compare by value ("frame2" < "frame10"), other characters case insensitive,
+	// path separators before anything else so parents come before their children
+	int compareNatural(const wchar_t *left, size_t leftLength, const wchar_t *right, size_t rightLength);
+	bool naturalLess(const std::wstring &left, const std::wstring &right);
+
+	// Recursive listing of a dataset tree. Directories are listed in parallel and their files are kept in one
+	// name arena per directory. A rescan only re-lists the directories whose last write time changed, which
+	// happens when entries are added, removed or renamed in them; files rewritten in place are not noticed.
+	// Not thread safe, indices are valid until the next scan().
+	class DatasetScanner
+	{
+	public:
+		DatasetScanner(const std::wstring &path);
+		DatasetScanner(const DatasetScanner &) = delete;
+		~DatasetScanner();
+		// Returns the number of directories listed, the whole tree on the first call, 0 if nothing changed
+		size_t scan();
+		// Lists again the nearest directories containing the given paths, relative to the root as reported by a
+		// Base::DirectoryWatcher, without checking the rest of the tree. Picks up files rewritten in place too.
+		size_t scan(const std::vector<std::wstring> &changedPaths);
+		const std::wstring &getPath() const noexcept;
+		// Directories in natural path order, the root first
+		size_t getNumberOfDirectories() const noexcept;
+		// Relative to the root, empty for the root itself
+		const std::wstring &getDirectoryPath(size_t directory) const;
+		uint64_t getDirectoryLastWriteTime(size_t directory) const;
+		// -1 if the relative path is not a scanned directory
+		size_t findDirectory(const std::wstring &path) const;
+		// Files of a directory in natural name order
+		size_t getNumberOfFiles(size_t directory) const;
+		std::wstring getFileName(size_t directory, size_t file) const;
+		uint64_t getFileLastWriteTime(size_t directory, size_t file) const;
+		uint64_t getFileSize(size_t directory, size_t file) const;
+	private:
+		struct Directory;
+		struct Listing;
+		// Lists the directories, then the subdirectories discovered in them, returns the number listed
+		size_t listDirectories(const std::vector<std::wstring> &paths, bool changed);
+		void list(const Directory &directory, Listing &listing) const;
+		void removeDirectory(const std::wstring &path);
+
+		std::wstring _path;
+		std::unordered_map<std::wstring, std::unique_ptr<Directory>> _directories;
+		std::vector<Directory*> _sortedDirectories;
+	};
+}
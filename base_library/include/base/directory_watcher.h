@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "event.h"
+#include "native_event_looper.h"
+#include "timer.h"
+
+struct _OVERLAPPED;
+
+namespace Base
+{
+	// Watches a directory tree for files and directories being added, removed, renamed or written.
+	// Register it to a Base::NativeEventLooper: changes are collected on the looper thread, a burst of them
+	// is coalesced for coalesceTime_ms after its first change, then handed to the listeners at once.
+	// Erase it from the looper before destroying it.
+	class DirectoryWatcher : public NativeWaitableObject
+	{
+	public:
+		// paths are relative to the watched directory, sorted and unique. overflowed is set when changes were
+		// dropped by the system, then everything under the watched directory has to be treated as changed.
+		typedef std::function<void(const std::vector<std::wstring> &paths, bool overflowed)> Listener;
+		DirectoryWatcher(const std::wstring &path, uint32_t coalesceTime_ms = 200);
+		DirectoryWatcher(const DirectoryWatcher &) = delete;
+		~DirectoryWatcher();
+		const std::wstring &getPath() const noexcept;
+		// Returns an id for removeListener(), listeners are called on the looper thread
+		uint64_t addListener(Listener listener);
+		void removeListener(uint64_t id);
+		void getNumberOfWaitableObjects(uint32_t *numberOfWaitableObject) override;
+		void getWaitableObjects(HANDLE *nativeWaitableObjects) override;
+		void callback(uint32_t index) override;
+	private:
+		void issueRead();
+		void collectChanges();
+		void notify();
+		std::wstring _path;
+		uint32_t _coalesceTime_ms;
+		HANDLE _directory;
+		Event _readCompleted;
+		std::unique_ptr<_OVERLAPPED> _overlapped;
+		// FILE_NOTIFY_INFORMATION records are DWORD aligned
+		std::vector<uint32_t> _buffer;
+		Timer _coalesceTimer;
+		std::set<std::wstring> _changedPaths;
+		bool _overflowed;
+		std::mutex _lock;
+		std::vector<std::pair<uint64_t, Listener>> _listeners;
+		uint64_t _nextListenerId;
+	};
+}
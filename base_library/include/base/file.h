@@ -65,6 +65,14 @@ namespace Base {
 
 	extern unsigned char UTF16LE_BOM[2];
 
+	// One range of File::readRanges()
+	struct FileRange
+	{
+		uint64_t offset;
+		uint64_t size;
+		unsigned char *buffer;
+	};
+
 	class File
 	{
 	public:
@@ -85,19 +93,33 @@ namespace Base {
 			create_new = 0x00000010UL,
 			open_existing = 0, // default
 			open_always = 0x00000100UL,
-			truncate_existing = 0x00001000UL
+			truncate_existing = 0x00001000UL,
+			// FILE_FLAG_SEQUENTIAL_SCAN, the cache manager reads ahead further and drops pages behind sooner
+			sequential_scan = 0x01000000UL,
+			// FILE_FLAG_OVERLAPPED, concurrent calls on the File proceed in parallel instead of being serialized
+			// on the file object. read() and write() still return once their own transfer completed.
+			overlapped = 0x02000000UL
 		};
 		File(const std::wstring &path, Mode mode = Mode::read);
 		File(const File &path) = delete;
 		File(File &&path) noexcept;
 		~File();
 		uint64_t getSize() const;
+		// Positional, the offset goes with each call instead of through the file pointer,
+		// so threads can read and write through the same File concurrently.
+		// read() returns less than size at the end of the file.
 		uint64_t read(unsigned char *buffer, uint64_t offset, uint64_t size) const;
 		uint64_t write(const unsigned char *buffer, uint64_t offset, uint64_t size);
+		// Scatter read. Ranges at most maximumGap bytes apart are read with one ReadFile into a pooled
+		// buffer and copied out, so many small payloads cost few calls. Returns the bytes copied into the
+		// buffers, ranges past the end of the file are cut short.
+		uint64_t readRanges(const FileRange *ranges, size_t numberOfRanges, uint64_t maximumGap = 64 * 1024) const;
 		uint64_t getLastWriteTime() const;
 		HANDLE getHANDLE();
+		bool isOverlapped() const noexcept;
 	private:
 		HANDLE _fileHandle;
+		bool _overlapped;
 	};
 
 	File::Mode operator&(File::Mode left, File::Mode right);
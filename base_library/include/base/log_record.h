@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+
+#define SPDLOG_WCHAR_FILENAMES
+#include <spdlog/common.h>
+
+namespace Base
+{
+	class Event;
+
+	// A log entry as queued by Base::AsyncLogging. The text is rendered by the caller, the rest (the location
+	// prefix, symbolizing the stack trace, the sinks) is left to whoever writes it.
+	struct LogRecord
+	{
+		enum class Type : uint8_t { MESSAGE, FLUSH, STOP };
+		static const size_t inlineMessageSize = 416;
+		static const unsigned short maximumNumberOfFrames = 128;
+		LogRecord() noexcept;
+		LogRecord(LogRecord &&) = default;
+		LogRecord &operator=(LogRecord &&) = default;
+		void setMessage(const char *text, size_t length);
+		const char *getMessage() const noexcept;
+
+		Type type;
+		spdlog::level::level_enum level;
+		// Static strings of the call site, nullptr if the text has the prefix already
+		const char *file;
+		const char *function;
+		int line;
+		uint16_t numberOfFrames;
+		uint32_t messageLength;
+		char message[inlineMessageSize];
+		// Texts not fitting in message
+		std::unique_ptr<char[]> longMessage;
+		std::unique_ptr<void*[]> frames;
+		// Of a FLUSH record, set once the records before it are written
+		Event *flushed;
+	};
+
+	// Queues the record if a Base::AsyncLogging is running, otherwise writes it right away
+	void writeLog(LogRecord &&record);
+	// Formats the record and writes it to the logger on the calling thread
+	void writeLogRecord(const LogRecord &record);
+}
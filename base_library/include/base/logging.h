@@ -1,13 +1,16 @@
 #pragma once
 
 #include "exception.h"
+#include "log_record.h"
 #include "utils.h"
 
 #include <locale>
 #include <functional>
 #include <codecvt>
+#include <cstdint>
 #include <memory>
 #include <sstream>
+#include <string>
 
 #define SPDLOG_WCHAR_FILENAMES
 #include <spdlog/spdlog.h>
@@ -15,8 +18,11 @@
 extern std::shared_ptr<spdlog::logger> logger;
 namespace Base
 {
-
 	std::string getStackTrace();
+	// Return addresses from the calling function up, the first framesToSkip left out
+	unsigned short captureStackTrace(void **frames, unsigned short maximumNumberOfFrames, unsigned long framesToSkip = 0);
+	std::string symbolizeStackTrace(void *const *frames, unsigned short numberOfFrames);
+
 	class Win32ErrorCodeToString
 	{
 	public:
@@ -77,6 +83,37 @@ namespace Base
 		std::ostringstream str_stream;
 	};
 
+	// Renders the text straight into a LogRecord, no stream or allocation involved; texts longer than
+	// LogRecord::inlineMessageSize are cut. Nothing is rendered for levels the logger filters out.
+	class LogMessage
+	{
+	public:
+		LogMessage(spdlog::level::level_enum level, const char* file, int line, const char* function);
+		LogMessage(const LogMessage &) = delete;
+		~LogMessage();
+		LogMessage& stream() noexcept;
+		LogMessage& operator<<(const char *text);
+		LogMessage& operator<<(const std::string &text);
+		LogMessage& operator<<(const wchar_t *text);
+		LogMessage& operator<<(const std::wstring &text);
+		LogMessage& operator<<(char value);
+		LogMessage& operator<<(bool value);
+		LogMessage& operator<<(int value);
+		LogMessage& operator<<(unsigned value);
+		LogMessage& operator<<(long value);
+		LogMessage& operator<<(unsigned long value);
+		LogMessage& operator<<(long long value);
+		LogMessage& operator<<(unsigned long long value);
+		LogMessage& operator<<(double value);
+		LogMessage& operator<<(const void *pointer);
+	private:
+		void append(const char *text, size_t length);
+		void appendWide(const wchar_t *text, size_t length);
+		void appendInteger(unsigned long long value, bool negative);
+		bool _enabled;
+		LogRecord _record;
+	};
+
 	template <typename T1, typename T2, typename Op>
 	std::unique_ptr<std::pair<T1, T2>> check_impl(const T1 &a, const T2 &b, Op op) {
 		if (op(a, b))
@@ -404,3 +441,47 @@ Base::EventLogging(__FILE__, __LINE__, __func__, #exp1, #op, #exp2).stream() \
 	LOG_IF_OP_CRTAPI(exp1, exp2, >=, std::greater_equal<>())
 #define LOG_IF_NOT_GT_CRTAPI(exp1, exp2) \
 	LOG_IF_OP_CRTAPI(exp1, exp2, >, std::greater<>())
+
+// Leveled logging for hot paths, see Base::LogMessage. Levels below BASE_LOGGING_LEVEL (spdlog level numbers)
+// are compiled out; by default debug in release builds.
+#ifndef BASE_LOGGING_LEVEL
+#ifdef NDEBUG
+#define BASE_LOGGING_LEVEL 2
+#else
+#define BASE_LOGGING_LEVEL 1
+#endif
+#endif
+
+#define LOG_AT_LEVEL(level) \
+	Base::LogMessage(level, __FILE__, __LINE__, __func__).stream()
+
+// The operands of a compiled out level are still type checked, but never evaluated
+#define LOG_ELIDED(level) \
+	while (false) LOG_AT_LEVEL(level)
+
+#if BASE_LOGGING_LEVEL <= 1
+#define LOG_DEBUG \
+	LOG_AT_LEVEL(spdlog::level::debug)
+#else
+#define LOG_DEBUG \
+	LOG_ELIDED(spdlog::level::debug)
+#endif
+
+#if BASE_LOGGING_LEVEL <= 2
+#define LOG_INFO \
+	LOG_AT_LEVEL(spdlog::level::info)
+#else
+#define LOG_INFO \
+	LOG_ELIDED(spdlog::level::info)
+#endif
+
+#if BASE_LOGGING_LEVEL <= 3
+#define LOG_WARN \
+	LOG_AT_LEVEL(spdlog::level::warn)
+#else
+#define LOG_WARN \
+	LOG_ELIDED(spdlog::level::warn)
+#endif
+
+#define LOG_ERROR \
+	LOG_AT_LEVEL(spdlog::level::err)
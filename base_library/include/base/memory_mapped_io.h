@@ -5,17 +5,48 @@ typedef void * HANDLE;
 
 namespace Base
 {
+	// Maps the whole file, or a window of it that can be slid over files too large to map at once
 	class MemoryMappedIO
 	{
 	public:
-		MemoryMappedIO(const wchar_t *filename);
+		// Passed to the cache manager when the file is opened
+		enum class AccessHint : uint32_t
+		{
+			normal = 0, sequential, random
+		};
+		MemoryMappedIO(const wchar_t *filename, AccessHint hint = AccessHint::normal);
+		// Maps size bytes from offset, size 0 or beyond the end of the file maps up to the end
+		MemoryMappedIO(const wchar_t *filename, uint64_t offset, uint64_t size, AccessHint hint = AccessHint::normal);
 		MemoryMappedIO(const MemoryMappedIO&) = delete;
 		~MemoryMappedIO() noexcept(false);
+		// Moves the window, pointers into the previous one become invalid and a lock is released
+		void remap(uint64_t offset, uint64_t size = 0);
+		// Start of the window
 		const unsigned char *getPtr() const;
+		// Size of the window
 		uint64_t getSize() const;
+		// Of the window in the file
+		uint64_t getOffset() const;
+		// Queried once when the file is opened
+		uint64_t getFileSize() const;
+		// Starts reading a range of the window in (offset relative to the window, size 0 up to its end), without waiting for it
+		void prefetch(uint64_t offset = 0, uint64_t size = 0);
+		// Returns once every page of the window is resident
+		void populate();
+		// Keeps the window resident until unlock(), remap() or destruction, limited by the working set quota
+		void lock();
+		void unlock();
 	private:
+		void map(uint64_t offset, uint64_t size);
+		void unmap();
 		HANDLE hFile;
 		HANDLE hFileMapping;
-		void *ptr;
+		// Returned by MapViewOfFile, aligned to the allocation granularity at or before the window
+		void *view;
+		const unsigned char *ptr;
+		uint64_t offset;
+		uint64_t size;
+		uint64_t fileSize;
+		bool locked;
 	};
-}
\ No newline at end of file
+}
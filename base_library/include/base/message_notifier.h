@@ -1,55 +1,128 @@
 #pragma once
 
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+
+#include "bounded_queue.h"
 #include "event.h"
-#include <concurrent_queue.h>
 
 namespace Base
 {
+	// Bounded message queue with an event for the consumer. The event is only set when the consumer may be
+	// about to wait on it, that is initially and once it found the queue empty, so a busy consumer costs producers
+	// no system call. Producers finding the queue full block until the consumer took messages, the consumer only
+	// wakes them while one of them waits.
+	// Any number of producers, one consumer waiting at a time (through get() or on getEventHandle()).
 	template <typename Type>
 	class MessageNotifier
 	{
 	public:
+		MessageNotifier(size_t capacity = 1024);
 		MessageNotifier(const MessageNotifier<Type> &) = delete;
-		MessageNotifier(const MessageNotifier<Type> &&) noexcept;
+		// Blocks while the queue is full
 		void send(Type message);
+		// Moves all messages in, setting the event at most once; blocks while the queue is full
+		void send(Type *messages, size_t numberOfMessages);
+		// false if the queue is full, message is only moved from on success
+		bool try_send(Type &&message);
+		// A consumer waiting on getEventHandle() calls this until it returns false
 		bool try_get(Type *message);
+		size_t try_get(Type *messages, size_t maximumNumberOfMessages);
 		void get(Type *message);
 		HANDLE getEventHandle();
 	private:
-		void accept(Type message);
-		Concurrency::concurrent_queue<Type> _message;
+		void notify();
+		void prepareToWait();
+		void notifyProducers();
+		BoundedQueue<Type> _messages;
 		Event _event;
+		std::atomic<bool> _consumerWaiting;
+		std::mutex _spaceLock;
+		std::condition_variable _spaceAvailable;
+		std::atomic<unsigned> _numberOfWaitingProducers;
 	};
 
 	template <typename Type>
-	MessageNotifier<Type>::MessageNotifier(const MessageNotifier<Type>&& other) noexcept
+	MessageNotifier<Type>::MessageNotifier(size_t capacity)
+		// A consumer may wait on getEventHandle() before its first try_get()
+		: _messages(capacity), _consumerWaiting(true), _numberOfWaitingProducers(0)
 	{
-		_event = std::move(other._event);
-		_message = other._message;
-		other._message.clear();
 	}
 
 	template <typename Type>
 	void MessageNotifier<Type>::send(Type message)
 	{
-		accept(message);
-		_event.set();
+		send(&message, 1);
+	}
+
+	template <typename Type>
+	void MessageNotifier<Type>::send(Type* messages, size_t numberOfMessages)
+	{
+		size_t numberOfSent = 0;
+		while (true)
+		{
+			numberOfSent += _messages.tryPush(messages + numberOfSent, numberOfMessages - numberOfSent);
+			if (numberOfSent == numberOfMessages)
+				break;
+			// Full, the consumer has to catch up
+			notify();
+			std::unique_lock<std::mutex> lock(_spaceLock);
+			++_numberOfWaitingProducers;
+			// Pairs with the fence in notifyProducers(): either this finds the room on its second look, or the
+			// consumer sees the count and has to take the lock, which it only gets once this waits
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			const size_t numberOfPushed = _messages.tryPush(messages + numberOfSent, numberOfMessages - numberOfSent);
+			if (!numberOfPushed)
+				_spaceAvailable.wait(lock);
+			--_numberOfWaitingProducers;
+			numberOfSent += numberOfPushed;
+		}
+		notify();
+	}
+
+	template <typename Type>
+	bool MessageNotifier<Type>::try_send(Type&& message)
+	{
+		if (!_messages.tryPush(std::move(message)))
+			return false;
+		notify();
+		return true;
 	}
 
 	template <typename Type>
 	bool MessageNotifier<Type>::try_get(Type* message)
 	{
-		return _message.try_pop(*message);
+		if (!_messages.tryPop(*message))
+		{
+			prepareToWait();
+			if (!_messages.tryPop(*message))
+				return false;
+		}
+		notifyProducers();
+		return true;
+	}
+
+	template <typename Type>
+	size_t MessageNotifier<Type>::try_get(Type* messages, size_t maximumNumberOfMessages)
+	{
+		size_t numberOfMessages = _messages.tryPop(messages, maximumNumberOfMessages);
+		if (!numberOfMessages && maximumNumberOfMessages)
+		{
+			prepareToWait();
+			numberOfMessages = _messages.tryPop(messages, maximumNumberOfMessages);
+		}
+		if (numberOfMessages)
+			notifyProducers();
+		return numberOfMessages;
 	}
 
 	template <typename Type>
 	void MessageNotifier<Type>::get(Type* message)
 	{
-		while (true) {
+		// The event may be left set by a message taken without waiting, then this goes round once more
+		while (!try_get(message))
 			_event.join();
-			if (_message.try_pop(*message))
-				break;
-		}
 	}
 
 	template <typename Type>
@@ -59,8 +132,29 @@ namespace Base
 	}
 
 	template <typename Type>
-	void MessageNotifier<Type>::accept(Type message)
+	void MessageNotifier<Type>::notify()
+	{
+		// Pairs with the fence in prepareToWait(): either the consumer sees the message on its second look,
+		// or this sees the flag
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if (_consumerWaiting.load(std::memory_order_relaxed) && _consumerWaiting.exchange(false))
+			_event.set();
+	}
+
+	template <typename Type>
+	void MessageNotifier<Type>::prepareToWait()
+	{
+		_consumerWaiting.store(true, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+	}
+
+	template <typename Type>
+	void MessageNotifier<Type>::notifyProducers()
 	{
-		_message.push(message);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if (!_numberOfWaitingProducers.load(std::memory_order_relaxed))
+			return;
+		std::lock_guard<std::mutex> lock_guard(_spaceLock);
+		_spaceAvailable.notify_all();
 	}
-}
\ No newline at end of file
+}
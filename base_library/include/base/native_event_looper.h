@@ -1,11 +1,15 @@
 #pragma once
 
 #include <cstdint>
+#include <memory>
+#include <unordered_map>
 #include <vector>
-#include <map>
 
 #include "event.h"
 
+struct _TP_WAIT;
+struct _OVERLAPPED_ENTRY;
+
 namespace Base
 {
 	typedef void *HANDLE;
@@ -19,19 +23,37 @@ namespace Base
 		virtual void callback(uint32_t index) = 0;
 	};
 
+	// Each handle is waited for by a thread pool wait that queues a packet to a completion port once signaled, the
+	// looper thread takes the packets in batches. So the number of handles is not limited by MAXIMUM_WAIT_OBJECTS,
+	// and registering, dispatching and erasing do not depend on how many objects are registered.
+	// A handle is waited for again once its callback returned. Objects are registered, updated and erased on the
+	// looper thread or while it is not running; cancel() can be called from any thread.
 	class NativeEventLooper
 	{
 	public:
 		NativeEventLooper();
+		NativeEventLooper(const NativeEventLooper &) = delete;
+		~NativeEventLooper();
 		void registerWaitableObject(NativeWaitableObject *waitable_object);
 		void updateWaitableObject(NativeWaitableObject *waitable_object);
+		// Callbacks of the object already queued are dropped
 		void eraseWaitableObject(NativeWaitableObject *waitable_object);
+		// Returns after cancel()
 		void runLooper();
 		void cancel();
 	private:
-		Event _event;
-		std::vector<HANDLE> _nativeWaitableHandles;
-		std::vector<NativeWaitableObject *> _objects;
-		std::map<NativeWaitableObject*, uint32_t> _objectNativeHandleCountMapper;
+		struct Slot;
+		void addSlots(NativeWaitableObject *waitable_object, std::vector<uint32_t> &slots);
+		void removeSlots(const std::vector<uint32_t> &slots);
+		void dispatch(uintptr_t key, uint32_t generation);
+
+		HANDLE _completionPort;
+		std::vector<std::unique_ptr<Slot>> _slots;
+		std::vector<uint32_t> _freeSlots;
+		std::unordered_map<NativeWaitableObject*, std::vector<uint32_t>> _objectSlots;
+		// A batch taken from the port, the rest of it is dispatched by the next runLooper() if a callback threw
+		std::unique_ptr<_OVERLAPPED_ENTRY[]> _entries;
+		size_t _numberOfEntries;
+		size_t _nextEntry;
 	};
-}
\ No newline at end of file
+}
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Base
+{
+	// Shared by its copies, tasks check it to stop early
+	class CancellationToken
+	{
+	public:
+		CancellationToken();
+		void cancel() const noexcept;
+		bool isCanceled() const noexcept;
+	private:
+		std::shared_ptr<std::atomic<bool>> _canceled;
+	};
+
+	// Fixed pool of workers with one task deque each. A worker runs its own tasks newest first and, once out of
+	// them, takes the oldest task of the submission queue or of another worker, so tasks spawned by tasks stay
+	// on the worker that spawned them while idle workers spread the load.
+	class TaskScheduler
+	{
+	public:
+		typedef std::function<void()> Task;
+		// 0 workers uses one per logical processor. With a non zero affinityMask the workers are pinned round
+		// robin to the processors of the mask.
+		TaskScheduler(unsigned numberOfWorkers = 0, uint64_t affinityMask = 0);
+		TaskScheduler(const TaskScheduler &) = delete;
+		// Runs the tasks still queued, then stops the workers
+		~TaskScheduler();
+		// Exceptions escaping the task are logged and dropped, use a TaskGroup to get them back
+		void submit(Task task);
+		// Runs one queued task on the calling thread, false if there was none
+		bool runPendingTask();
+		unsigned getNumberOfWorkers() const noexcept;
+	private:
+		struct Worker
+		{
+			std::mutex lock;
+			std::deque<Task> tasks;
+			std::thread thread;
+		};
+		bool tryTakeTask(Task &task);
+		void runTask(Task &task);
+		void workerEntry(unsigned index);
+
+		std::vector<std::unique_ptr<Worker>> _workers;
+		std::mutex _lock;
+		std::deque<Task> _submittedTasks;
+		std::condition_variable _wakeup;
+		std::atomic<size_t> _numberOfQueued;
+		std::atomic<unsigned> _numberOfSleeping;
+		bool _stopping;
+	};
+
+	// Tasks that are waited for together. wait() runs queued tasks while it waits, so it can be called from
+	// inside a task without tying up the worker. It sleeps once nothing is queued, until the group finishes
+	// or gets another task it could help with.
+	class TaskGroup
+	{
+	public:
+		TaskGroup(TaskScheduler &scheduler, CancellationToken token = CancellationToken());
+		TaskGroup(const TaskGroup &) = delete;
+		// Waits, exceptions are dropped
+		~TaskGroup();
+		// Skipped if the group is canceled before the task starts
+		void run(TaskScheduler::Task task);
+		// Returns once every task run so far finished, rethrows the first exception a task threw.
+		// A task throwing cancels the group.
+		void wait();
+		void cancel() noexcept;
+		bool isCanceled() const noexcept;
+		const CancellationToken &getCancellationToken() const noexcept;
+	private:
+		struct State
+		{
+			std::atomic<size_t> numberOfUnfinished;
+			// Tasks run so far and threads blocked in wait(), a waiter is only woken for a new task while it sleeps
+			std::atomic<size_t> numberOfRuns;
+			std::atomic<unsigned> numberOfWaiting;
+			std::mutex lock;
+			std::condition_variable finished;
+			std::exception_ptr exception;
+		};
+		TaskScheduler &_scheduler;
+		CancellationToken _token;
+		std::shared_ptr<State> _state;
+	};
+
+	// body(index) for each index in [begin, end), the range is split in halves down to grainSize so idle workers
+	// steal large pieces. Returns once all ran, rethrows the first exception.
+	void parallelFor(TaskScheduler &scheduler, size_t begin, size_t end, const std::function<void(size_t index)> &body, size_t grainSize = 1);
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+#include "native_event_looper.h"
+#include "timer.h"
+
+namespace Base
+{
+	// Many logical timers on one waitable timer. Expiry times are kept in a hierarchical wheel of four levels
+	// of 64 slots, the first one tick apart, each further level 64 times coarser; timers move down a level when
+	// their slot comes up. Scheduling and canceling are O(1), the waitable timer only ticks while timers are
+	// scheduled. Register it to a Base::NativeEventLooper, the callbacks run on the looper thread.
+	// schedule() and cancel() can be called from any thread, also from inside the callbacks.
+	class TimerWheel : public NativeWaitableObject
+	{
+	public:
+		typedef std::function<void()> Callback;
+		typedef uint64_t TimerId;
+		// Timers fire on the first tick at or after their time, up to resolution_ms late
+		TimerWheel(uint32_t resolution_ms = 10);
+		TimerWheel(const TimerWheel &) = delete;
+		// period_ms 0 fires once, otherwise every period_ms after the first delay_ms
+		TimerId schedule(uint32_t delay_ms, Callback callback, uint32_t period_ms = 0);
+		// false if the timer already fired (one shot) or was canceled
+		bool cancel(TimerId id);
+		size_t getNumberOfTimers() const;
+		uint32_t getResolution() const noexcept;
+		// Fires the timers due by now, called by callback()
+		void advance();
+		void getNumberOfWaitableObjects(uint32_t *numberOfWaitableObject) override;
+		void getWaitableObjects(HANDLE *nativeWaitableObjects) override;
+		void callback(uint32_t index) override;
+	private:
+		static const unsigned numberOfLevels = 4;
+		static const unsigned levelBits = 6;
+		static const unsigned slotsPerLevel = 1U << levelBits;
+		static const uint32_t none = UINT32_MAX;
+		struct Entry
+		{
+			Callback callback;
+			uint64_t expiry;
+			uint64_t periodTicks;
+			// Level * slotsPerLevel + slot of the list the entry is linked in, none while not in a slot
+			uint32_t slot;
+			uint32_t previous;
+			uint32_t next;
+			// Bumped when the entry is released, stale ids no longer match
+			uint32_t generation;
+			bool due;
+			bool used;
+		};
+		uint64_t toTicks(uint32_t time_ms) const;
+		uint64_t getCurrentTick() const;
+		void insert(uint32_t index);
+		void link(uint32_t slot, uint32_t index);
+		void unlink(uint32_t index);
+		void release(uint32_t index);
+		void cascade(unsigned level);
+		void tick();
+
+		uint32_t _resolution_ms;
+		std::chrono::steady_clock::time_point _startTime;
+		Timer _timer;
+		mutable std::mutex _lock;
+		uint64_t _currentTick;
+		std::vector<Entry> _entries;
+		std::vector<uint32_t> _freeEntries;
+		size_t _numberOfTimers;
+		// Heads of the slot lists
+		uint32_t _slots[numberOfLevels][slotsPerLevel];
+		// Expired, waiting for their callback to be run
+		std::vector<TimerId> _due;
+	};
+}
@@ -0,0 +1,153 @@
+#include <base/async_io.h>
+
+#include <algorithm>
+#include <cstring>
+
+#include <base/logging.h>
+
+namespace Base
+{
+	struct AsyncIOEngine::Operation
+	{
+		// First member, the OVERLAPPED pointer of a completion is the operation
+		OVERLAPPED overlapped;
+		HANDLE file;
+		uint64_t userData;
+	};
+
+	AsyncIOEngine::AsyncIOEngine(unsigned maximumInFlight)
+		: _completionPort(nullptr), _maximumInFlight(maximumInFlight)
+	{
+		CHECK_GT(maximumInFlight, 0U);
+		_completionPort = CreateIoCompletionPort(INVALID_HANDLE_VALUE, nullptr, 0, 1);
+		CHECK_WIN32API(_completionPort);
+		for (unsigned i = 0; i < maximumInFlight; ++i)
+		{
+			_operations.push_back(std::make_unique<Operation>());
+			_freeOperations.push_back(_operations.back().get());
+		}
+	}
+
+	AsyncIOEngine::~AsyncIOEngine()
+	{
+		{
+			std::lock_guard<std::mutex> lock_guard(_lock);
+			for (const std::unique_ptr<Operation> &operation : _operations)
+			{
+				if (std::find(_freeOperations.begin(), _freeOperations.end(), operation.get()) == _freeOperations.end())
+					CancelIoEx(operation->file, &operation->overlapped);
+			}
+		}
+		// The kernel writes to the OVERLAPPEDs until the completions are dequeued, canceled or not
+		OVERLAPPED_ENTRY entries[16];
+		while (getNumberOfInFlight())
+		{
+			ULONG numberOfEntries;
+			if (!GetQueuedCompletionStatusEx(_completionPort, entries, 16, &numberOfEntries, INFINITE, FALSE))
+			{
+				LOG_IF_FAILED_WIN32API(FALSE);
+				break;
+			}
+			for (ULONG i = 0; i < numberOfEntries; ++i)
+				releaseOperation(reinterpret_cast<Operation*>(entries[i].lpOverlapped));
+		}
+		LOG_IF_FAILED_WIN32API(CloseHandle(_completionPort));
+	}
+
+	void AsyncIOEngine::registerFile(File& file)
+	{
+		CHECK(file.isOverlapped()) << "Files need File::Mode::overlapped";
+		CHECK_EQ_WIN32API(CreateIoCompletionPort(file.getHANDLE(), _completionPort, 0, 0), _completionPort);
+	}
+
+	size_t AsyncIOEngine::submit(const AsyncIORequest* requests, size_t numberOfRequests)
+	{
+		size_t numberOfSubmitted = 0;
+		for (; numberOfSubmitted < numberOfRequests; ++numberOfSubmitted)
+		{
+			const AsyncIORequest &request = requests[numberOfSubmitted];
+			CHECK(request.file && request.file->isOverlapped());
+			Operation *operation = acquireOperation();
+			if (!operation)
+				break;
+			memset(&operation->overlapped, 0, sizeof(operation->overlapped));
+			operation->overlapped.Offset = DWORD(request.offset);
+			operation->overlapped.OffsetHigh = DWORD(request.offset >> 32);
+			operation->file = request.file->getHANDLE();
+			operation->userData = request.userData;
+			// Requests completing right away are queued to the port as well
+			const BOOL issued = request.write ?
+				WriteFile(operation->file, request.buffer, request.size, nullptr, &operation->overlapped) :
+				ReadFile(operation->file, request.buffer, request.size, nullptr, &operation->overlapped);
+			if (issued)
+				continue;
+			const DWORD error = GetLastError();
+			if (error == ERROR_IO_PENDING)
+				continue;
+			releaseOperation(operation);
+			std::lock_guard<std::mutex> lock_guard(_lock);
+			_failedRequests.push_back(AsyncIOCompletion{ request.userData, 0, error });
+		}
+		return numberOfSubmitted;
+	}
+
+	size_t AsyncIOEngine::getCompletions(AsyncIOCompletion* completions, size_t maximumCompletions, uint32_t timeout_ms)
+	{
+		size_t numberOfCompletions = 0;
+		{
+			std::lock_guard<std::mutex> lock_guard(_lock);
+			numberOfCompletions = std::min(maximumCompletions, _failedRequests.size());
+			std::copy(_failedRequests.begin(), _failedRequests.begin() + numberOfCompletions, completions);
+			_failedRequests.erase(_failedRequests.begin(), _failedRequests.begin() + numberOfCompletions);
+		}
+		if (numberOfCompletions == maximumCompletions)
+			return numberOfCompletions;
+
+		_entries.resize(std::min(maximumCompletions - numberOfCompletions, (size_t)_maximumInFlight));
+		ULONG numberOfEntries;
+		if (!GetQueuedCompletionStatusEx(_completionPort, _entries.data(), (ULONG)_entries.size(), &numberOfEntries,
+			numberOfCompletions ? 0 : timeout_ms, FALSE))
+		{
+			CHECK_WIN32API(GetLastError() == WAIT_TIMEOUT);
+			return numberOfCompletions;
+		}
+		for (ULONG i = 0; i < numberOfEntries; ++i)
+		{
+			Operation *operation = reinterpret_cast<Operation*>(_entries[i].lpOverlapped);
+			AsyncIOCompletion &completion = completions[numberOfCompletions++];
+			completion.userData = operation->userData;
+			DWORD bytesTransferred = 0;
+			completion.error = GetOverlappedResult(operation->file, &operation->overlapped, &bytesTransferred, FALSE) ? 0 : GetLastError();
+			completion.bytesTransferred = bytesTransferred;
+			releaseOperation(operation);
+		}
+		return numberOfCompletions;
+	}
+
+	size_t AsyncIOEngine::getNumberOfInFlight() const
+	{
+		std::lock_guard<std::mutex> lock_guard(_lock);
+		return _operations.size() - _freeOperations.size();
+	}
+
+	unsigned AsyncIOEngine::getMaximumInFlight() const noexcept
+	{
+		return _maximumInFlight;
+	}
+
+	AsyncIOEngine::Operation* AsyncIOEngine::acquireOperation()
+	{
+		std::lock_guard<std::mutex> lock_guard(_lock);
+		if (_freeOperations.empty())
+			return nullptr;
+		Operation *operation = _freeOperations.back();
+		_freeOperations.pop_back();
+		return operation;
+	}
+
+	void AsyncIOEngine::releaseOperation(Operation* operation)
+	{
+		std::lock_guard<std::mutex> lock_guard(_lock);
+		_freeOperations.push_back(operation);
+	}
+}
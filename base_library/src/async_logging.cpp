@@ -0,0 +1,138 @@
+#include <base/async_logging.h>
+
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+
+#include <base/event.h>
+#include <base/logging.h>
+
+#include <vector>
+
+namespace Base
+{
+	// Records taken from the ring at once
+	static const size_t batchSize = 64;
+
+	static std::atomic<AsyncLogging*> currentInstance(nullptr);
+	// Threads in write(), the instance is not torn down under them
+	static std::atomic<unsigned> numberOfWriters(0);
+	// Records logged while writing one are written synchronously, the writer would wait for itself otherwise
+	static thread_local bool onWriterThread = false;
+
+	AsyncLogging::AsyncLogging(size_t capacity)
+		: _records(capacity), _numberOfDropped(0)
+	{
+		AsyncLogging *expected = nullptr;
+		CHECK(currentInstance.compare_exchange_strong(expected, this)) << "Another AsyncLogging is running";
+		try
+		{
+			_writer = std::thread(&AsyncLogging::writerEntry, this);
+		}
+		catch (...)
+		{
+			currentInstance.store(nullptr);
+			throw;
+		}
+	}
+
+	AsyncLogging::~AsyncLogging()
+	{
+		currentInstance.store(nullptr);
+		while (numberOfWriters.load())
+			std::this_thread::yield();
+		LogRecord record;
+		record.type = LogRecord::Type::STOP;
+		_records.send(std::move(record));
+		_writer.join();
+	}
+
+	void AsyncLogging::flush()
+	{
+		Event flushed;
+		LogRecord record;
+		record.type = LogRecord::Type::FLUSH;
+		record.flushed = &flushed;
+		_records.send(std::move(record));
+		flushed.join();
+	}
+
+	uint64_t AsyncLogging::getNumberOfDropped() const noexcept
+	{
+		return _numberOfDropped.load();
+	}
+
+	bool AsyncLogging::isRunning() noexcept
+	{
+		return currentInstance.load() != nullptr;
+	}
+
+	bool AsyncLogging::write(LogRecord&& record)
+	{
+		if (onWriterThread)
+			return false;
+		struct WriterCount
+		{
+			WriterCount() { ++numberOfWriters; }
+			~WriterCount() { --numberOfWriters; }
+		} writerCount;
+		AsyncLogging *instance = currentInstance.load();
+		if (!instance)
+			return false;
+		instance->queue(std::move(record));
+		return true;
+	}
+
+	void AsyncLogging::queue(LogRecord&& record)
+	{
+		const spdlog::level::level_enum level = record.level;
+		if (level < spdlog::level::err)
+		{
+			if (!_records.try_send(std::move(record)))
+				++_numberOfDropped;
+			return;
+		}
+		_records.send(std::move(record));
+		if (level >= spdlog::level::critical)
+			flush();
+	}
+
+	void AsyncLogging::writerEntry()
+	{
+		onWriterThread = true;
+		std::vector<LogRecord> records(batchSize);
+		bool stopping = false;
+		while (!stopping)
+		{
+			size_t numberOfRecords = _records.try_get(records.data(), records.size());
+			if (!numberOfRecords)
+			{
+				_records.get(records.data());
+				numberOfRecords = 1;
+			}
+			for (size_t index = 0; index < numberOfRecords; ++index)
+			{
+				LogRecord &record = records[index];
+				try
+				{
+					if (record.type == LogRecord::Type::MESSAGE)
+						writeLogRecord(record);
+					else
+						logger->flush();
+				}
+				catch (...)
+				{
+					// Nowhere left to report it
+				}
+				if (record.type == LogRecord::Type::FLUSH)
+				{
+					LOG_IF_FAILED_WIN32API(SetEvent(record.flushed->getHandle()));
+				}
+				else if (record.type == LogRecord::Type::STOP)
+					stopping = true;
+				record.longMessage.reset();
+				record.frames.reset();
+			}
+		}
+	}
+}
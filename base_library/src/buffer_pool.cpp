@@ -0,0 +1,223 @@
+#include <base/buffer_pool.h>
+
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#include <intrin.h>
+
+#include <base/logging.h>
+
+namespace Base
+{
+	// 4 classes per power of two, from 64 KB up to 1 TB
+	static const unsigned MIN_SIZE_CLASS_SHIFT = 16;
+	static const unsigned MAX_SIZE_CLASS_SHIFT = 40;
+	static const unsigned NUMBER_OF_SIZE_CLASSES = (MAX_SIZE_CLASS_SHIFT - MIN_SIZE_CLASS_SHIFT) * 4 + 1;
+
+	static unsigned getSizeClass(size_t size)
+	{
+		const size_t minSize = size_t(1) << MIN_SIZE_CLASS_SHIFT;
+		if (size <= minSize)
+			return 0;
+		unsigned long msb;
+		_BitScanReverse64(&msb, size - 1);
+		// size - 1 in [2^msb, 2^(msb+1)), split the range in 4 steps of 2^(msb-2)
+		const unsigned quarter = unsigned(((size - 1) >> (msb - 2)) & 3);
+		return (msb - MIN_SIZE_CLASS_SHIFT) * 4 + quarter + 1;
+	}
+
+	size_t BufferPool::getCapacityOfSizeClass(unsigned sizeClass) noexcept
+	{
+		if (sizeClass == 0)
+			return size_t(1) << MIN_SIZE_CLASS_SHIFT;
+		const unsigned shift = (sizeClass - 1) / 4 + MIN_SIZE_CLASS_SHIFT;
+		const unsigned quarter = (sizeClass - 1) % 4;
+		return (size_t(1) << shift) + (size_t(quarter + 1) << (shift - 2));
+	}
+
+	static bool enableLockMemoryPrivilege()
+	{
+		HANDLE token;
+		if (!OpenProcessToken(GetCurrentProcess(), TOKEN_ADJUST_PRIVILEGES | TOKEN_QUERY, &token))
+			return false;
+		TOKEN_PRIVILEGES privileges;
+		privileges.PrivilegeCount = 1;
+		privileges.Privileges[0].Attributes = SE_PRIVILEGE_ENABLED;
+		bool succeeded = LookupPrivilegeValue(nullptr, SE_LOCK_MEMORY_NAME, &privileges.Privileges[0].Luid)
+			&& AdjustTokenPrivileges(token, FALSE, &privileges, 0, nullptr, nullptr)
+			// AdjustTokenPrivileges succeeds even if the privilege is not held
+			&& GetLastError() == ERROR_SUCCESS;
+		LOG_IF_FAILED_WIN32API(CloseHandle(token));
+		return succeeded;
+	}
+
+	BufferPool::BufferPool(bool useLargePages, unsigned maxCachedBuffersPerClass)
+		: _sizeClasses(new SizeClass[NUMBER_OF_SIZE_CLASSES]), _maxCachedBuffersPerClass(maxCachedBuffersPerClass), _largePageSize(0)
+	{
+		if (useLargePages)
+		{
+			if (enableLockMemoryPrivilege())
+				_largePageSize = GetLargePageMinimum();
+			LOG_IF_FAILED(_largePageSize) << "Large pages are not available, falling back to normal pages";
+		}
+	}
+
+	BufferPool::~BufferPool()
+	{
+		trim();
+	}
+
+	BufferLease BufferPool::acquire(size_t size)
+	{
+		const unsigned sizeClass = getSizeClass(size);
+		CHECK_LT(sizeClass, NUMBER_OF_SIZE_CLASSES);
+		SizeClass &cache = _sizeClasses[sizeClass];
+		{
+			std::lock_guard<std::mutex> lock_guard(cache.lock);
+			if (!cache.buffers.empty())
+			{
+				unsigned char *buffer = cache.buffers.back();
+				cache.buffers.pop_back();
+				return BufferLease(this, buffer, size, sizeClass);
+			}
+		}
+		return BufferLease(this, allocate(getCapacityOfSizeClass(sizeClass)), size, sizeClass);
+	}
+
+	void BufferPool::trim()
+	{
+		for (unsigned i = 0; i < NUMBER_OF_SIZE_CLASSES; ++i)
+		{
+			std::vector<unsigned char*> buffers;
+			{
+				std::lock_guard<std::mutex> lock_guard(_sizeClasses[i].lock);
+				buffers.swap(_sizeClasses[i].buffers);
+			}
+			for (unsigned char *buffer : buffers)
+				free(buffer);
+		}
+	}
+
+	bool BufferPool::isUsingLargePages() const noexcept
+	{
+		return _largePageSize != 0;
+	}
+
+	BufferPool& BufferPool::getDefault()
+	{
+		// Leaked on purpose, leases held by other statics are released after a function local pool would be gone.
+		// The cached buffers go away with the process.
+		static BufferPool *pool = new BufferPool();
+		return *pool;
+	}
+
+	void BufferPool::release(unsigned char* buffer, unsigned sizeClass) noexcept
+	{
+		SizeClass &cache = _sizeClasses[sizeClass];
+		{
+			std::lock_guard<std::mutex> lock_guard(cache.lock);
+			if (cache.buffers.size() < _maxCachedBuffersPerClass)
+			{
+				try {
+					cache.buffers.push_back(buffer);
+					return;
+				}
+				catch (std::bad_alloc &)
+				{
+				}
+			}
+		}
+		free(buffer);
+	}
+
+	unsigned char* BufferPool::allocate(size_t capacity)
+	{
+		if (_largePageSize && capacity >= _largePageSize)
+		{
+			const size_t largePageCapacity = (capacity + _largePageSize - 1) / _largePageSize * _largePageSize;
+			void *buffer = VirtualAlloc(nullptr, largePageCapacity, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+			// Physically contiguous memory may be exhausted, normal pages are still fine
+			if (buffer)
+				return (unsigned char*)buffer;
+		}
+		void *buffer = VirtualAlloc(nullptr, capacity, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+		if (!buffer)
+			throw std::bad_alloc();
+		return (unsigned char*)buffer;
+	}
+
+	void BufferPool::free(unsigned char* buffer) noexcept
+	{
+		LOG_IF_FAILED_WIN32API(VirtualFree(buffer, 0, MEM_RELEASE));
+	}
+
+	BufferLease::BufferLease() noexcept
+		: _pool(nullptr), _buffer(nullptr), _size(0), _sizeClass(0)
+	{
+	}
+
+	BufferLease::BufferLease(BufferPool* pool, unsigned char* buffer, size_t size, unsigned sizeClass) noexcept
+		: _pool(pool), _buffer(buffer), _size(size), _sizeClass(sizeClass)
+	{
+	}
+
+	BufferLease::BufferLease(BufferLease&& other) noexcept
+		: _pool(other._pool), _buffer(other._buffer), _size(other._size), _sizeClass(other._sizeClass)
+	{
+		other._pool = nullptr;
+		other._buffer = nullptr;
+		other._size = 0;
+	}
+
+	BufferLease& BufferLease::operator=(BufferLease&& other) noexcept
+	{
+		if (this != &other)
+		{
+			release();
+			_pool = other._pool;
+			_buffer = other._buffer;
+			_size = other._size;
+			_sizeClass = other._sizeClass;
+			other._pool = nullptr;
+			other._buffer = nullptr;
+			other._size = 0;
+		}
+		return *this;
+	}
+
+	BufferLease::~BufferLease()
+	{
+		release();
+	}
+
+	unsigned char* BufferLease::get() const noexcept
+	{
+		return _buffer;
+	}
+
+	size_t BufferLease::getSize() const noexcept
+	{
+		return _size;
+	}
+
+	size_t BufferLease::getCapacity() const noexcept
+	{
+		return _buffer ? BufferPool::getCapacityOfSizeClass(_sizeClass) : 0;
+	}
+
+	void BufferLease::release() noexcept
+	{
+		if (_buffer)
+		{
+			_pool->release(_buffer, _sizeClass);
+			_pool = nullptr;
+			_buffer = nullptr;
+			_size = 0;
+		}
+	}
+
+	BufferLease::operator bool() const noexcept
+	{
+		return _buffer != nullptr;
+	}
+}
@@ -97,7 +97,8 @@ namespace Base
 			_height = size.height;
 			_dpix = 96;
 			_dpiy = 96;
-			_imageBuffer.resize(_width * _height * 4);
+			_imageBuffer = BufferPool::getDefault().acquire(_width * _height * 4);
+			memset(_imageBuffer.get(), 0, _imageBuffer.getSize());
 
 			// Create a Direct2D render target.
 			hr = m_pD2DFactory->CreateHwndRenderTarget(
@@ -138,12 +139,13 @@ namespace Base
 	{
 		{
 			std::lock_guard<std::mutex> lock_guard(_lock);
-			_imageBuffer.resize(width * height * 4);
+			if (_imageBuffer.getCapacity() < width * height * 4)
+				_imageBuffer = BufferPool::getDefault().acquire(width * height * 4);
 			_width = width;
 			_height = height;
 			_dpix = dpix;
 			_dpiy = dpiy;
-			memcpy(_imageBuffer.data(), buffer, width * height * 4);
+			memcpy(_imageBuffer.get(), buffer, width * height * 4);
 		}
 		PostMessage(m_hwnd, WM_PAINT, 0, 0);
 	}
@@ -191,7 +193,7 @@ namespace Base
 			bitmap_properties.pixelFormat = { DXGI_FORMAT_B8G8R8A8_UNORM,D2D1_ALPHA_MODE_IGNORE };
 			{
 				std::lock_guard<std::mutex> lock_guard(_lock);
-				hr = m_pRenderTarget->CreateBitmap(D2D1_SIZE_U{ _width, _height }, _imageBuffer.data(), _width * 4, bitmap_properties, &bitmap);
+				hr = m_pRenderTarget->CreateBitmap(D2D1_SIZE_U{ _width, _height }, _imageBuffer.get(), _width * 4, bitmap_properties, &bitmap);
 			}
 
 			if (SUCCEEDED(hr))
@@ -0,0 +1,386 @@
+#include <base/dataset_scanner.h>
+
+#include <base/file.h>
+#include <base/logging.h>
+#include <base/utils.h>
+
+#include <algorithm>
+#include <cwctype>
+#include <ppl.h>
+
+namespace Base
+{
+	static bool isDigit(wchar_t character)
+	{
+		return character >= L'0' && character <= L'9';
+	}
+
+	int compareNatural(const wchar_t* left, size_t leftLength, const wchar_t* right, size_t rightLength)
+	{
+		size_t i = 0, j = 0;
+		while (i < leftLength && j < rightLength)
+		{
+			if (isDigit(left[i]) && isDigit(right[j]))
+			{
+				while (i < leftLength && left[i] == L'0')
+					++i;
+				while (j < rightLength && right[j] == L'0')
+					++j;
+				size_t leftEnd = i, rightEnd = j;
+				while (leftEnd < leftLength && isDigit(left[leftEnd]))
+					++leftEnd;
+				while (rightEnd < rightLength && isDigit(right[rightEnd]))
+					++rightEnd;
+				// Without leading zeros the longer run is the larger number
+				if (leftEnd - i != rightEnd - j)
+					return leftEnd - i < rightEnd - j ? -1 : 1;
+				for (; i < leftEnd; ++i, ++j)
+				{
+					if (left[i] != right[j])
+						return left[i] < right[j] ? -1 : 1;
+				}
+				continue;
+			}
+			const wchar_t leftCharacter = towlower(left[i]), rightCharacter = towlower(right[j]);
+			if (leftCharacter != rightCharacter)
+			{
+				if (leftCharacter == L'\\')
+					return -1;
+				if (rightCharacter == L'\\')
+					return 1;
+				return leftCharacter < rightCharacter ? -1 : 1;
+			}
+			++i;
+			++j;
+		}
+		if (i < leftLength)
+			return 1;
+		if (j < rightLength)
+			return -1;
+		// Equal apart from case or leading zeros, ordinal order keeps the order strict
+		const int result = std::wstring::traits_type::compare(left, right, std::min(leftLength, rightLength));
+		if (result)
+			return result < 0 ? -1 : 1;
+		if (leftLength != rightLength)
+			return leftLength < rightLength ? -1 : 1;
+		return 0;
+	}
+
+	bool naturalLess(const std::wstring& left, const std::wstring& right)
+	{
+		return compareNatural(left.data(), left.size(), right.data(), right.size()) < 0;
+	}
+
+	static uint64_t toUInt64(const FILETIME &fileTime)
+	{
+		return (uint64_t(fileTime.dwHighDateTime) << 32) | fileTime.dwLowDateTime;
+	}
+
+	static std::wstring appendRelativePath(const std::wstring &path, const std::wstring &name)
+	{
+		return path.empty() ? name : path + L'\\' + name;
+	}
+
+	struct DatasetScannerFile
+	{
+		// Into the name arena of the directory
+		uint32_t nameOffset;
+		uint32_t nameLength;
+		uint64_t lastWriteTime;
+		uint64_t size;
+	};
+
+	struct DatasetScanner::Directory
+	{
+		std::wstring path;
+		uint64_t lastWriteTime;
+		std::vector<wchar_t> names;
+		std::vector<DatasetScannerFile> files;
+		// Names, to drop the subtrees of the ones that disappear
+		std::vector<std::wstring> subdirectories;
+	};
+
+	struct DatasetScanner::Listing
+	{
+		bool succeeded;
+		std::vector<wchar_t> names;
+		std::vector<DatasetScannerFile> files;
+		std::vector<std::pair<std::wstring, uint64_t>> subdirectories;
+	};
+
+	DatasetScanner::DatasetScanner(const std::wstring& path)
+		: _path(path)
+	{
+	}
+
+	DatasetScanner::~DatasetScanner() = default;
+
+	size_t DatasetScanner::scan()
+	{
+		bool changed = false;
+		std::vector<std::wstring> pendingPaths;
+		if (_directories.empty())
+		{
+			WIN32_FILE_ATTRIBUTE_DATA attributes;
+			CHECK_WIN32API(GetFileAttributesEx(_path.c_str(), GetFileExInfoStandard, &attributes));
+			CHECK(attributes.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) << UTF16ToUTF8(_path) << " is not a directory";
+			std::unique_ptr<Directory> root = std::make_unique<Directory>();
+			root->lastWriteTime = toUInt64(attributes.ftLastWriteTime);
+			_directories.emplace(std::wstring(), std::move(root));
+			pendingPaths.emplace_back();
+		}
+		else
+		{
+			// The last write times are taken before listing, a change during the scan is picked up by the next one
+			const size_t numberOfDirectories = _sortedDirectories.size();
+			std::vector<uint64_t> lastWriteTimes(numberOfDirectories);
+			std::vector<char> exists(numberOfDirectories);
+			Concurrency::parallel_for(size_t(0), numberOfDirectories, [&](size_t index)
+			{
+				const Directory &directory = *_sortedDirectories[index];
+				WIN32_FILE_ATTRIBUTE_DATA attributes;
+				if (!GetFileAttributesEx(directory.path.empty() ? _path.c_str() : appendPath(_path, directory.path).c_str(),
+					GetFileExInfoStandard, &attributes) || !(attributes.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY))
+					return;
+				exists[index] = true;
+				lastWriteTimes[index] = toUInt64(attributes.ftLastWriteTime);
+			});
+			CHECK(exists[0]) << UTF16ToUTF8(_path) << " is gone";
+			std::vector<std::wstring> missingPaths;
+			for (size_t index = 0; index < numberOfDirectories; ++index)
+			{
+				Directory &directory = *_sortedDirectories[index];
+				if (!exists[index])
+					missingPaths.push_back(directory.path);
+				else if (directory.lastWriteTime != lastWriteTimes[index])
+				{
+					directory.lastWriteTime = lastWriteTimes[index];
+					pendingPaths.push_back(directory.path);
+				}
+			}
+			for (const std::wstring &path : missingPaths)
+				removeDirectory(path);
+			changed = !missingPaths.empty();
+		}
+
+		return listDirectories(pendingPaths, changed);
+	}
+
+	size_t DatasetScanner::scan(const std::vector<std::wstring>& changedPaths)
+	{
+		if (_directories.empty())
+			return scan();
+		std::vector<std::wstring> pendingPaths;
+		for (const std::wstring &path : changedPaths)
+		{
+			// The path itself if it is a directory, and the nearest directory containing it. The root is always there.
+			if (_directories.find(path) != _directories.end())
+				pendingPaths.push_back(path);
+			std::wstring parent = path;
+			do
+			{
+				const size_t separator = parent.find_last_of(L'\\');
+				parent = separator == std::wstring::npos ? std::wstring() : parent.substr(0, separator);
+			} while (_directories.find(parent) == _directories.end());
+			pendingPaths.push_back(parent);
+		}
+		std::sort(pendingPaths.begin(), pendingPaths.end());
+		pendingPaths.erase(std::unique(pendingPaths.begin(), pendingPaths.end()), pendingPaths.end());
+		// Keeps a later scan() from listing them again
+		for (const std::wstring &path : pendingPaths)
+		{
+			WIN32_FILE_ATTRIBUTE_DATA attributes;
+			if (GetFileAttributesEx(path.empty() ? _path.c_str() : appendPath(_path, path).c_str(), GetFileExInfoStandard, &attributes))
+				_directories.at(path)->lastWriteTime = toUInt64(attributes.ftLastWriteTime);
+		}
+		return listDirectories(pendingPaths, false);
+	}
+
+	size_t DatasetScanner::listDirectories(const std::vector<std::wstring>& pendingPaths, bool changed)
+	{
+		std::vector<Directory*> pending;
+		for (const std::wstring &path : pendingPaths)
+		{
+			const auto iterator = _directories.find(path);
+			if (iterator != _directories.end())
+				pending.push_back(iterator->second.get());
+		}
+
+		size_t numberOfListed = 0;
+		while (!pending.empty())
+		{
+			std::vector<Listing> listings(pending.size());
+			Concurrency::parallel_for(size_t(0), pending.size(), [&](size_t index)
+			{
+				list(*pending[index], listings[index]);
+			});
+			numberOfListed += pending.size();
+
+			std::vector<std::wstring> discoveredPaths, removedPaths;
+			for (size_t index = 0; index < pending.size(); ++index)
+			{
+				Directory &directory = *pending[index];
+				Listing &listing = listings[index];
+				if (!listing.succeeded)
+				{
+					CHECK(!directory.path.empty()) << "Can not list " << UTF16ToUTF8(_path);
+					removedPaths.push_back(directory.path);
+					continue;
+				}
+				directory.names.swap(listing.names);
+				directory.files.swap(listing.files);
+				std::vector<std::wstring> subdirectories;
+				for (std::pair<std::wstring, uint64_t> &subdirectory : listing.subdirectories)
+				{
+					const std::wstring path = appendRelativePath(directory.path, subdirectory.first);
+					if (_directories.find(path) == _directories.end())
+					{
+						std::unique_ptr<Directory> child = std::make_unique<Directory>();
+						child->path = path;
+						child->lastWriteTime = subdirectory.second;
+						_directories.emplace(path, std::move(child));
+						discoveredPaths.push_back(path);
+					}
+					subdirectories.push_back(std::move(subdirectory.first));
+				}
+				for (const std::wstring &name : directory.subdirectories)
+				{
+					if (!std::binary_search(subdirectories.begin(), subdirectories.end(), name, naturalLess))
+						removedPaths.push_back(appendRelativePath(directory.path, name));
+				}
+				directory.subdirectories.swap(subdirectories);
+			}
+			// After the batch, the directories removed may be pending in it or have discovered children
+			for (const std::wstring &path : removedPaths)
+				removeDirectory(path);
+			pending.clear();
+			for (const std::wstring &path : discoveredPaths)
+			{
+				const auto iterator = _directories.find(path);
+				if (iterator != _directories.end())
+					pending.push_back(iterator->second.get());
+			}
+		}
+
+		if (numberOfListed || changed)
+		{
+			_sortedDirectories.clear();
+			_sortedDirectories.reserve(_directories.size());
+			for (const auto &directory : _directories)
+				_sortedDirectories.push_back(directory.second.get());
+			std::sort(_sortedDirectories.begin(), _sortedDirectories.end(), [](const Directory *left, const Directory *right)
+			{
+				return naturalLess(left->path, right->path);
+			});
+		}
+		return numberOfListed;
+	}
+
+	void DatasetScanner::list(const Directory& directory, Listing& listing) const
+	{
+		WIN32_FIND_DATA fileData;
+		const HANDLE handle = FindFirstFileEx(((directory.path.empty() ? _path : appendPath(_path, directory.path)) + L"\\*").c_str(),
+			FindExInfoBasic, &fileData, FindExSearchNameMatch, nullptr, FIND_FIRST_EX_LARGE_FETCH);
+		listing.succeeded = handle != INVALID_HANDLE_VALUE;
+		if (!listing.succeeded)
+			return;
+		do
+		{
+			const size_t nameLength = wcslen(fileData.cFileName);
+			if (fileData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+			{
+				if (wcscmp(fileData.cFileName, L".") && wcscmp(fileData.cFileName, L".."))
+					listing.subdirectories.emplace_back(fileData.cFileName, toUInt64(fileData.ftLastWriteTime));
+				continue;
+			}
+			listing.files.push_back(DatasetScannerFile{ uint32_t(listing.names.size()), uint32_t(nameLength),
+				toUInt64(fileData.ftLastWriteTime), (uint64_t(fileData.nFileSizeHigh) << 32) | fileData.nFileSizeLow });
+			listing.names.insert(listing.names.end(), fileData.cFileName, fileData.cFileName + nameLength);
+		} while (FindNextFile(handle, &fileData));
+		LOG_IF_FAILED_WIN32API(FindClose(handle));
+
+		const wchar_t *names = listing.names.data();
+		std::sort(listing.files.begin(), listing.files.end(), [names](const DatasetScannerFile &left, const DatasetScannerFile &right)
+		{
+			return compareNatural(names + left.nameOffset, left.nameLength, names + right.nameOffset, right.nameLength) < 0;
+		});
+		std::sort(listing.subdirectories.begin(), listing.subdirectories.end(),
+			[](const std::pair<std::wstring, uint64_t> &left, const std::pair<std::wstring, uint64_t> &right)
+		{
+			return naturalLess(left.first, right.first);
+		});
+	}
+
+	void DatasetScanner::removeDirectory(const std::wstring& path)
+	{
+		const auto iterator = _directories.find(path);
+		if (iterator == _directories.end())
+			return;
+		const std::unique_ptr<Directory> directory = std::move(iterator->second);
+		_directories.erase(iterator);
+		for (const std::wstring &name : directory->subdirectories)
+			removeDirectory(appendRelativePath(path, name));
+	}
+
+	const std::wstring& DatasetScanner::getPath() const noexcept
+	{
+		return _path;
+	}
+
+	size_t DatasetScanner::getNumberOfDirectories() const noexcept
+	{
+		return _sortedDirectories.size();
+	}
+
+	const std::wstring& DatasetScanner::getDirectoryPath(size_t directory) const
+	{
+		CHECK_LT(directory, _sortedDirectories.size());
+		return _sortedDirectories[directory]->path;
+	}
+
+	uint64_t DatasetScanner::getDirectoryLastWriteTime(size_t directory) const
+	{
+		CHECK_LT(directory, _sortedDirectories.size());
+		return _sortedDirectories[directory]->lastWriteTime;
+	}
+
+	size_t DatasetScanner::findDirectory(const std::wstring& path) const
+	{
+		const auto iterator = std::lower_bound(_sortedDirectories.begin(), _sortedDirectories.end(), path,
+			[](const Directory *directory, const std::wstring &value)
+		{
+			return naturalLess(directory->path, value);
+		});
+		if (iterator == _sortedDirectories.end() || (*iterator)->path != path)
+			return size_t(-1);
+		return size_t(iterator - _sortedDirectories.begin());
+	}
+
+	size_t DatasetScanner::getNumberOfFiles(size_t directory) const
+	{
+		CHECK_LT(directory, _sortedDirectories.size());
+		return _sortedDirectories[directory]->files.size();
+	}
+
+	std::wstring DatasetScanner::getFileName(size_t directory, size_t file) const
+	{
+		CHECK_LT(directory, _sortedDirectories.size());
+		const Directory &entry = *_sortedDirectories[directory];
+		CHECK_LT(file, entry.files.size());
+		return std::wstring(entry.names.data() + entry.files[file].nameOffset, entry.files[file].nameLength);
+	}
+
+	uint64_t DatasetScanner::getFileLastWriteTime(size_t directory, size_t file) const
+	{
+		CHECK_LT(directory, _sortedDirectories.size());
+		CHECK_LT(file, _sortedDirectories[directory]->files.size());
+		return _sortedDirectories[directory]->files[file].lastWriteTime;
+	}
+
+	uint64_t DatasetScanner::getFileSize(size_t directory, size_t file) const
+	{
+		CHECK_LT(directory, _sortedDirectories.size());
+		CHECK_LT(file, _sortedDirectories[directory]->files.size());
+		return _sortedDirectories[directory]->files[file].size;
+	}
+}
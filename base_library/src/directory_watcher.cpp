@@ -0,0 +1,146 @@
+#include <base/directory_watcher.h>
+
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+
+#include <base/logging.h>
+
+#include <cstring>
+
+namespace Base
+{
+	// Change records larger than this are dropped and reported as an overflow, 64 KB is also the limit for
+	// directories on network shares
+	static const size_t changeBufferSize = 65536;
+
+	DirectoryWatcher::DirectoryWatcher(const std::wstring& path, uint32_t coalesceTime_ms)
+		: _path(path), _coalesceTime_ms(coalesceTime_ms), _directory(nullptr), _overlapped(std::make_unique<OVERLAPPED>()),
+		_buffer(changeBufferSize / sizeof(uint32_t)), _overflowed(false), _nextListenerId(0)
+	{
+		_directory = CreateFile(path.c_str(), FILE_LIST_DIRECTORY, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+			nullptr, OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OVERLAPPED, nullptr);
+		CHECK_NE_WIN32API(_directory, INVALID_HANDLE_VALUE);
+		try
+		{
+			issueRead();
+		}
+		catch (...)
+		{
+			CloseHandle(_directory);
+			throw;
+		}
+	}
+
+	DirectoryWatcher::~DirectoryWatcher()
+	{
+		// The pending read writes into _buffer until it is canceled
+		if (CancelIoEx(_directory, _overlapped.get()))
+		{
+			DWORD numberOfBytes;
+			GetOverlappedResult(_directory, _overlapped.get(), &numberOfBytes, TRUE);
+		}
+		LOG_IF_FAILED_WIN32API(CloseHandle(_directory));
+	}
+
+	const std::wstring& DirectoryWatcher::getPath() const noexcept
+	{
+		return _path;
+	}
+
+	uint64_t DirectoryWatcher::addListener(Listener listener)
+	{
+		std::lock_guard<std::mutex> lock_guard(_lock);
+		const uint64_t id = _nextListenerId++;
+		_listeners.emplace_back(id, std::move(listener));
+		return id;
+	}
+
+	void DirectoryWatcher::removeListener(uint64_t id)
+	{
+		std::lock_guard<std::mutex> lock_guard(_lock);
+		for (auto iterator = _listeners.begin(); iterator != _listeners.end(); ++iterator)
+		{
+			if (iterator->first == id)
+			{
+				_listeners.erase(iterator);
+				return;
+			}
+		}
+	}
+
+	void DirectoryWatcher::getNumberOfWaitableObjects(uint32_t* numberOfWaitableObject)
+	{
+		*numberOfWaitableObject = 2;
+	}
+
+	void DirectoryWatcher::getWaitableObjects(HANDLE* nativeWaitableObjects)
+	{
+		nativeWaitableObjects[0] = _readCompleted.getHandle();
+		nativeWaitableObjects[1] = _coalesceTimer.getHandle();
+	}
+
+	void DirectoryWatcher::callback(uint32_t index)
+	{
+		if (index == 0)
+			collectChanges();
+		else
+			notify();
+	}
+
+	void DirectoryWatcher::issueRead()
+	{
+		memset(_overlapped.get(), 0, sizeof(OVERLAPPED));
+		_overlapped->hEvent = _readCompleted.getHandle();
+		CHECK_WIN32API(ReadDirectoryChangesW(_directory, _buffer.data(), DWORD(changeBufferSize), TRUE,
+			FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_DIR_NAME | FILE_NOTIFY_CHANGE_SIZE | FILE_NOTIFY_CHANGE_LAST_WRITE,
+			nullptr, _overlapped.get(), nullptr));
+	}
+
+	void DirectoryWatcher::collectChanges()
+	{
+		const bool idle = _changedPaths.empty() && !_overflowed;
+		DWORD numberOfBytes;
+		if (!GetOverlappedResult(_directory, _overlapped.get(), &numberOfBytes, FALSE))
+		{
+			if (GetLastError() == ERROR_OPERATION_ABORTED)
+				return;
+			CHECK_WIN32API(GetLastError() == ERROR_NOTIFY_ENUM_DIR);
+			_overflowed = true;
+		}
+		else if (numberOfBytes == 0)
+			// The changes did not fit into the buffer
+			_overflowed = true;
+		else
+		{
+			const unsigned char *record = reinterpret_cast<const unsigned char*>(_buffer.data());
+			while (true)
+			{
+				const FILE_NOTIFY_INFORMATION *information = reinterpret_cast<const FILE_NOTIFY_INFORMATION*>(record);
+				_changedPaths.emplace(information->FileName, information->FileNameLength / sizeof(wchar_t));
+				if (!information->NextEntryOffset)
+					break;
+				record += information->NextEntryOffset;
+			}
+		}
+		// Records arriving in between are queued by the system until the next read
+		issueRead();
+		if (idle && (!_changedPaths.empty() || _overflowed))
+			_coalesceTimer.activate(0, uint64_t(_coalesceTime_ms) * 10000ULL);
+	}
+
+	void DirectoryWatcher::notify()
+	{
+		const std::vector<std::wstring> paths(_changedPaths.begin(), _changedPaths.end());
+		const bool overflowed = _overflowed;
+		_changedPaths.clear();
+		_overflowed = false;
+		std::vector<std::pair<uint64_t, Listener>> listeners;
+		{
+			std::lock_guard<std::mutex> lock_guard(_lock);
+			listeners = _listeners;
+		}
+		for (const std::pair<uint64_t, Listener> &listener : listeners)
+			listener.second(paths, overflowed);
+	}
+}
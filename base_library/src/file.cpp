@@ -1,6 +1,12 @@
 #include <base/file.h>
 
+#include <base/buffer_pool.h>
+#include <base/event.h>
 #include <base/logging.h>
+
+#include <algorithm>
+#include <cstring>
+#include <memory>
 #include <random>
 
 namespace Base
@@ -383,12 +389,18 @@ namespace Base
 			creationDisposition = OPEN_ALWAYS;
 		else if (uint32_t(mode & Mode::truncate_existing))
 			creationDisposition = TRUNCATE_EXISTING;
-		_fileHandle = CreateFile(path.c_str(), desiredAccess, FILE_SHARE_READ, NULL, creationDisposition, FILE_ATTRIBUTE_NORMAL, NULL);
+		uint32_t flagsAndAttributes = FILE_ATTRIBUTE_NORMAL;
+		if (uint32_t(mode & Mode::sequential_scan))
+			flagsAndAttributes |= FILE_FLAG_SEQUENTIAL_SCAN;
+		_overlapped = uint32_t(mode & Mode::overlapped) != 0;
+		if (_overlapped)
+			flagsAndAttributes |= FILE_FLAG_OVERLAPPED;
+		_fileHandle = CreateFile(path.c_str(), desiredAccess, FILE_SHARE_READ, NULL, creationDisposition, flagsAndAttributes, NULL);
 		CHECK_NE_WIN32API(_fileHandle, INVALID_HANDLE_VALUE);
 	}
 
 	File::File(File&& other) noexcept
-		: _fileHandle(other._fileHandle)
+		: _fileHandle(other._fileHandle), _overlapped(other._overlapped)
 	{
 		other._fileHandle = nullptr;
 	}
@@ -406,58 +418,117 @@ namespace Base
 		return large_integer.QuadPart;
 	}
 
+	static OVERLAPPED getOverlappedAtOffset(uint64_t offset)
+	{
+		OVERLAPPED overlapped = {};
+		overlapped.Offset = DWORD(offset);
+		overlapped.OffsetHigh = DWORD(offset >> 32);
+		return overlapped;
+	}
+
+	// Waited for by the synchronous calls on an overlapped handle, one per thread rather than one per call.
+	// ReadFile/WriteFile reset it when they start. The low bit keeps the completion off a port the file may be
+	// registered with (AsyncIOEngine), whose collector would take the OVERLAPPED on our stack for one of its own.
+	static HANDLE getCompletionEvent()
+	{
+		thread_local Event completed;
+		return (HANDLE)((uintptr_t)completed.getHandle() | 1);
+	}
+
 	uint64_t File::read(unsigned char* buffer, uint64_t offset, uint64_t size) const
 	{
-		LARGE_INTEGER large_integer;
-		large_integer.QuadPart = offset;
-		CHECK_WIN32API(SetFilePointerEx(_fileHandle, large_integer, nullptr, FILE_BEGIN));
 		uint64_t totalReadFileSize = 0;
 		while (size)
 		{
-			DWORD this_read_size;
-			if (size > std::numeric_limits<DWORD>::max()) {
-				this_read_size = std::numeric_limits<DWORD>::max();
-				size -= this_read_size;
-			}
-			else
+			const DWORD this_read_size = (DWORD)std::min(size, (uint64_t)std::numeric_limits<DWORD>::max());
+			OVERLAPPED overlapped = getOverlappedAtOffset(offset);
+			if (_overlapped)
+				overlapped.hEvent = getCompletionEvent();
+			DWORD sizeRead = 0;
+			BOOL succeeded = ReadFile(_fileHandle, buffer, this_read_size, &sizeRead, &overlapped);
+			if (!succeeded && GetLastError() == ERROR_IO_PENDING)
+				succeeded = GetOverlappedResult(_fileHandle, &overlapped, &sizeRead, TRUE);
+			if (!succeeded)
 			{
-				this_read_size = (DWORD)size;
-				size = 0;
+				// Reads with an offset report the end of the file as a failure
+				CHECK_WIN32API(GetLastError() == ERROR_HANDLE_EOF);
+				break;
 			}
-
-			DWORD sizeRead;
-			CHECK_WIN32API(ReadFile(_fileHandle, buffer, this_read_size, &sizeRead, nullptr));
 			totalReadFileSize += sizeRead;
-			buffer += this_read_size;
+			if (sizeRead < this_read_size)
+				break;
+			buffer += sizeRead;
+			offset += sizeRead;
+			size -= sizeRead;
 		}
 		return totalReadFileSize;
 	}
 
 	uint64_t File::write(const unsigned char* buffer, uint64_t offset, uint64_t size)
 	{
-		LARGE_INTEGER large_integer;
-		large_integer.QuadPart = offset;
-		CHECK_WIN32API(SetFilePointerEx(_fileHandle, large_integer, nullptr, FILE_BEGIN));
 		uint64_t totalWriteFileSize = 0;
 		while (size)
 		{
-			DWORD currentWriteSize;
-			if (size > std::numeric_limits<DWORD>::max()) {
-				currentWriteSize = std::numeric_limits<DWORD>::max();
-				size -= currentWriteSize;
+			const DWORD currentWriteSize = (DWORD)std::min(size, (uint64_t)std::numeric_limits<DWORD>::max());
+			OVERLAPPED overlapped = getOverlappedAtOffset(offset);
+			if (_overlapped)
+				overlapped.hEvent = getCompletionEvent();
+			DWORD sizeWritten = 0;
+			BOOL succeeded = WriteFile(_fileHandle, buffer, currentWriteSize, &sizeWritten, &overlapped);
+			if (!succeeded && GetLastError() == ERROR_IO_PENDING)
+				succeeded = GetOverlappedResult(_fileHandle, &overlapped, &sizeWritten, TRUE);
+			CHECK_WIN32API(succeeded);
+			totalWriteFileSize += sizeWritten;
+			buffer += sizeWritten;
+			offset += sizeWritten;
+			size -= sizeWritten;
+		}
+		return totalWriteFileSize;
+	}
+
+	uint64_t File::readRanges(const FileRange* ranges, size_t numberOfRanges, uint64_t maximumGap) const
+	{
+		// Bounds the pooled buffer of a merged read
+		const uint64_t maximumMergedSize = 8 * 1024 * 1024;
+		std::vector<const FileRange*> sortedRanges(numberOfRanges);
+		for (size_t i = 0; i < numberOfRanges; ++i)
+			sortedRanges[i] = ranges + i;
+		std::sort(sortedRanges.begin(), sortedRanges.end(), [](const FileRange *range1, const FileRange *range2) { return range1->offset < range2->offset; });
+
+		uint64_t totalReadFileSize = 0;
+		for (size_t first = 0; first < numberOfRanges; )
+		{
+			const uint64_t begin = sortedRanges[first]->offset;
+			uint64_t end = begin + sortedRanges[first]->size;
+			size_t last = first + 1;
+			for (; last < numberOfRanges; ++last)
+			{
+				const FileRange *range = sortedRanges[last];
+				if (range->offset > end + maximumGap || range->offset + range->size - begin > maximumMergedSize)
+					break;
+				end = std::max(end, range->offset + range->size);
 			}
+
+			if (last - first == 1)
+				totalReadFileSize += read(sortedRanges[first]->buffer, begin, end - begin);
 			else
 			{
-				currentWriteSize = (DWORD)size;
-				size = 0;
+				BufferLease merged = BufferPool::getDefault().acquire(size_t(end - begin));
+				const uint64_t mergedSize = read(merged.get(), begin, end - begin);
+				for (size_t i = first; i < last; ++i)
+				{
+					const FileRange *range = sortedRanges[i];
+					const uint64_t rangeOffset = range->offset - begin;
+					if (rangeOffset >= mergedSize)
+						continue;
+					const uint64_t rangeSize = std::min(range->size, mergedSize - rangeOffset);
+					memcpy(range->buffer, merged.get() + rangeOffset, size_t(rangeSize));
+					totalReadFileSize += rangeSize;
+				}
 			}
-
-			DWORD sizeWritten;
-			CHECK_WIN32API(WriteFile(_fileHandle, buffer, currentWriteSize, &sizeWritten, nullptr));
-			totalWriteFileSize += sizeWritten;
-			buffer += currentWriteSize;
+			first = last;
 		}
-		return totalWriteFileSize;
+		return totalReadFileSize;
 	}
 
 	uint64_t File::getLastWriteTime() const
@@ -473,6 +544,11 @@ namespace Base
 		return _fileHandle;
 	}
 
+	bool File::isOverlapped() const noexcept
+	{
+		return _overlapped;
+	}
+
 	std::wstring getParentPath(const std::wstring& path)
 	{
 		size_t end_pos = path.size();
@@ -2,9 +2,13 @@
 #define NOMINMAX
 #include <winsock2.h>
 #include <stdarg.h>
+#include <stdio.h>
 #include <string.h>
 
 #include <base/logging.h>
+#include <base/async_logging.h>
+
+#include <algorithm>
 
 namespace Base
 {
@@ -20,6 +24,21 @@ namespace Base
 		return base_file_name;
 	}
 
+	// Records of the stream based classes, their text carries the location prefix already
+	static void writeMessage(spdlog::level::level_enum level, const std::string &message, bool withStackTrace)
+	{
+		LogRecord record;
+		record.level = level;
+		record.setMessage(message.data(), message.size());
+		if (withStackTrace)
+		{
+			record.frames = std::make_unique<void*[]>(LogRecord::maximumNumberOfFrames);
+			// From the logging destructor up
+			record.numberOfFrames = captureStackTrace(record.frames.get(), LogRecord::maximumNumberOfFrames, 1);
+		}
+		writeLog(std::move(record));
+	}
+
 	FatalErrorLogging::FatalErrorLogging(ErrorCodeType errorCodeType, int64_t errorcode, const char* file, int line, const char* function)
 		: errorcode(errorcode), errorCodeType(errorCodeType)
 	{
@@ -40,6 +59,17 @@ namespace Base
 
 	FatalErrorLogging::~FatalErrorLogging() noexcept(false)
 	{
+		if (AsyncLogging::isRunning())
+		{
+			// Only the return addresses are taken here, the writer symbolizes them; returns once written
+			if (std::uncaught_exception())
+				writeMessage(spdlog::level::critical, "Fatal error occured during exception handling. Message: " + str_stream.str(), true);
+			else {
+				writeMessage(spdlog::level::critical, str_stream.str(), true);
+				throw FatalError(str_stream.str(), errorcode, errorCodeType);
+			}
+			return;
+		}
 		str_stream << std::endl
 			<< "*** Check failure stack trace: ***" << std::endl
 			<< getStackTrace();
@@ -77,9 +107,9 @@ namespace Base
 	RuntimeExceptionLogging::~RuntimeExceptionLogging() noexcept(false)
 	{
 		if (std::uncaught_exception())
-			logger->error("runtime exception occured during exception handling. Message: {}", str_stream.str());
+			writeMessage(spdlog::level::err, "runtime exception occured during exception handling. Message: " + str_stream.str(), false);
 		else {
-			logger->warn(str_stream.str());
+			writeMessage(spdlog::level::warn, str_stream.str(), false);
 			throw RuntimeException(str_stream.str(), errorcode, errorCodeType);
 		}
 	}
@@ -108,7 +138,7 @@ namespace Base
 
 	EventLogging::~EventLogging() noexcept(false)
 	{
-		logger->info(str_stream.str());
+		writeMessage(spdlog::level::info, str_stream.str(), false);
 	}
 
 	std::ostringstream& EventLogging::stream()
@@ -116,6 +146,235 @@ namespace Base
 		return str_stream;
 	}
 
+	LogRecord::LogRecord() noexcept
+		: type(Type::MESSAGE), level(spdlog::level::info), file(nullptr), function(nullptr), line(0), numberOfFrames(0), messageLength(0), flushed(nullptr)
+	{
+	}
+
+	void LogRecord::setMessage(const char* text, size_t length)
+	{
+		if (length <= inlineMessageSize)
+		{
+			memcpy(message, text, length);
+			longMessage.reset();
+		}
+		else
+		{
+			longMessage = std::make_unique<char[]>(length);
+			memcpy(longMessage.get(), text, length);
+		}
+		messageLength = uint32_t(length);
+	}
+
+	const char* LogRecord::getMessage() const noexcept
+	{
+		return longMessage ? longMessage.get() : message;
+	}
+
+	void writeLog(LogRecord&& record)
+	{
+		if (!AsyncLogging::write(std::move(record)))
+			writeLogRecord(record);
+	}
+
+	void writeLogRecord(const LogRecord& record)
+	{
+		std::string text;
+		if (record.file)
+		{
+			text += '[';
+			text += get_base_file_name(record.file);
+			text += ':';
+			text += std::to_string(record.line);
+			text += ' ';
+			text += record.function;
+			text += "] ";
+		}
+		text.append(record.getMessage(), record.messageLength);
+		if (record.numberOfFrames)
+		{
+			text += "\n*** Check failure stack trace: ***\n";
+			text += symbolizeStackTrace(record.frames.get(), record.numberOfFrames);
+		}
+		logger->log(record.level, text);
+	}
+
+	LogMessage::LogMessage(spdlog::level::level_enum level, const char* file, int line, const char* function)
+		: _enabled(logger->should_log(level))
+	{
+		_record.level = level;
+		_record.file = file;
+		_record.line = line;
+		_record.function = function;
+	}
+
+	LogMessage::~LogMessage()
+	{
+		if (!_enabled)
+			return;
+		try
+		{
+			writeLog(std::move(_record));
+		}
+		catch (...)
+		{
+			// Logging is not worth failing the caller for
+		}
+	}
+
+	LogMessage& LogMessage::stream() noexcept
+	{
+		return *this;
+	}
+
+	LogMessage& LogMessage::operator<<(const char* text)
+	{
+		if (!text)
+			text = "(null)";
+		append(text, strlen(text));
+		return *this;
+	}
+
+	LogMessage& LogMessage::operator<<(const std::string& text)
+	{
+		append(text.data(), text.size());
+		return *this;
+	}
+
+	LogMessage& LogMessage::operator<<(const wchar_t* text)
+	{
+		if (!text)
+			text = L"(null)";
+		appendWide(text, wcslen(text));
+		return *this;
+	}
+
+	LogMessage& LogMessage::operator<<(const std::wstring& text)
+	{
+		appendWide(text.data(), text.size());
+		return *this;
+	}
+
+	LogMessage& LogMessage::operator<<(char value)
+	{
+		append(&value, 1);
+		return *this;
+	}
+
+	LogMessage& LogMessage::operator<<(bool value)
+	{
+		// As std::ostream does
+		append(value ? "1" : "0", 1);
+		return *this;
+	}
+
+	LogMessage& LogMessage::operator<<(int value)
+	{
+		return *this << (long long)value;
+	}
+
+	LogMessage& LogMessage::operator<<(unsigned value)
+	{
+		return *this << (unsigned long long)value;
+	}
+
+	LogMessage& LogMessage::operator<<(long value)
+	{
+		return *this << (long long)value;
+	}
+
+	LogMessage& LogMessage::operator<<(unsigned long value)
+	{
+		return *this << (unsigned long long)value;
+	}
+
+	LogMessage& LogMessage::operator<<(long long value)
+	{
+		if (value < 0)
+			appendInteger(0ULL - (unsigned long long)value, true);
+		else
+			appendInteger((unsigned long long)value, false);
+		return *this;
+	}
+
+	LogMessage& LogMessage::operator<<(unsigned long long value)
+	{
+		appendInteger(value, false);
+		return *this;
+	}
+
+	LogMessage& LogMessage::operator<<(double value)
+	{
+		if (!_enabled)
+			return *this;
+		char buffer[32];
+		const int length = snprintf(buffer, sizeof(buffer), "%g", value);
+		if (length > 0)
+			append(buffer, std::min(size_t(length), sizeof(buffer) - 1));
+		return *this;
+	}
+
+	LogMessage& LogMessage::operator<<(const void* pointer)
+	{
+		if (!_enabled)
+			return *this;
+		char buffer[32];
+		const int length = snprintf(buffer, sizeof(buffer), "%p", pointer);
+		if (length > 0)
+			append(buffer, std::min(size_t(length), sizeof(buffer) - 1));
+		return *this;
+	}
+
+	void LogMessage::append(const char* text, size_t length)
+	{
+		if (!_enabled)
+			return;
+		length = std::min(length, LogRecord::inlineMessageSize - _record.messageLength);
+		memcpy(_record.message + _record.messageLength, text, length);
+		_record.messageLength += uint32_t(length);
+	}
+
+	void LogMessage::appendWide(const wchar_t* text, size_t length)
+	{
+		if (!_enabled)
+			return;
+		while (length)
+		{
+			// A UTF-16 unit takes at most 3 bytes in UTF-8, a surrogate pair 4
+			size_t numberOfUnits = std::min(length, (LogRecord::inlineMessageSize - _record.messageLength) / 3);
+			if (!numberOfUnits)
+				break;
+			// Not splitting a surrogate pair
+			if (numberOfUnits < length && IS_HIGH_SURROGATE(text[numberOfUnits - 1]))
+				--numberOfUnits;
+			if (!numberOfUnits)
+				break;
+			const int numberOfBytes = WideCharToMultiByte(CP_UTF8, 0, text, int(numberOfUnits), _record.message + _record.messageLength,
+				int(LogRecord::inlineMessageSize - _record.messageLength), nullptr, nullptr);
+			if (!numberOfBytes)
+				break;
+			_record.messageLength += uint32_t(numberOfBytes);
+			text += numberOfUnits;
+			length -= numberOfUnits;
+		}
+	}
+
+	void LogMessage::appendInteger(unsigned long long value, bool negative)
+	{
+		if (!_enabled)
+			return;
+		char buffer[24];
+		char *end = buffer + sizeof(buffer), *digit = end;
+		do
+		{
+			*--digit = char('0' + value % 10);
+			value /= 10;
+		} while (value);
+		if (negative)
+			*--digit = '-';
+		append(digit, size_t(end - digit));
+	}
+
 	HRESULT getHRESULTFromRuntimeException(const RuntimeException& exp)
 	{
 		if (exp.getErrorCodeType() == ErrorCodeType::HRESULT)
@@ -8,23 +8,49 @@
 
 namespace Base
 {
-	MemoryMappedIO::MemoryMappedIO(const wchar_t* filename)
-		: hFile(nullptr), hFileMapping(nullptr)
+	static const SYSTEM_INFO &getSystemInfo()
+	{
+		struct SystemInfo
+		{
+			SystemInfo()
+			{
+				GetSystemInfo(&info);
+			}
+			SYSTEM_INFO info;
+		};
+		static const SystemInfo systemInfo;
+		return systemInfo.info;
+	}
+
+	MemoryMappedIO::MemoryMappedIO(const wchar_t* filename, AccessHint hint)
+		: MemoryMappedIO(filename, 0, 0, hint)
+	{
+	}
+
+	MemoryMappedIO::MemoryMappedIO(const wchar_t* filename, uint64_t windowOffset, uint64_t windowSize, AccessHint hint)
+		: hFile(nullptr), hFileMapping(nullptr), view(nullptr), ptr(nullptr), offset(0), size(0), fileSize(0), locked(false)
 	{
 		try
 		{
-			hFile = CreateFile(filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+			DWORD flagsAndAttributes = FILE_ATTRIBUTE_NORMAL;
+			if (hint == AccessHint::sequential)
+				flagsAndAttributes |= FILE_FLAG_SEQUENTIAL_SCAN;
+			else if (hint == AccessHint::random)
+				flagsAndAttributes |= FILE_FLAG_RANDOM_ACCESS;
+			hFile = CreateFile(filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, flagsAndAttributes, NULL);
 			CHECK_NE_WIN32API(hFile, INVALID_HANDLE_VALUE);
+			LARGE_INTEGER large_integer;
+			CHECK_WIN32API(GetFileSizeEx(hFile, &large_integer));
+			fileSize = large_integer.QuadPart;
 			hFileMapping = CreateFileMapping(hFile, NULL, PAGE_READONLY, 0, 0, NULL);
 			CHECK_WIN32API(hFileMapping);
-			ptr = MapViewOfFileEx(hFileMapping, FILE_MAP_READ, 0, 0, 0, NULL);
-			CHECK_WIN32API(ptr);
+			map(windowOffset, windowSize);
 		}
 		catch (...)
 		{
 			if (hFileMapping)
 				CloseHandle(hFileMapping);
-			if (hFile)
+			if (hFile && hFile != INVALID_HANDLE_VALUE)
 				CloseHandle(hFile);
 			throw;
 		}
@@ -32,20 +58,101 @@ namespace Base
 
 	MemoryMappedIO::~MemoryMappedIO() noexcept(false)
 	{
-		LOG_IF_FAILED_WIN32API(UnmapViewOfFile(ptr));
+		unmap();
 		LOG_IF_FAILED_WIN32API(CloseHandle(hFileMapping));
 		LOG_IF_FAILED_WIN32API(CloseHandle(hFile));
 	}
 
+	void MemoryMappedIO::map(uint64_t windowOffset, uint64_t windowSize)
+	{
+		CHECK_LT(windowOffset, fileSize);
+		if (!windowSize || windowSize > fileSize - windowOffset)
+			windowSize = fileSize - windowOffset;
+		// Views start on the allocation granularity (64 KB)
+		const uint64_t viewOffset = windowOffset - windowOffset % getSystemInfo().dwAllocationGranularity;
+		const uint64_t viewSize = windowSize + (windowOffset - viewOffset);
+		CHECK_LE(viewSize, (uint64_t)SIZE_MAX);
+		view = MapViewOfFileEx(hFileMapping, FILE_MAP_READ, DWORD(viewOffset >> 32), DWORD(viewOffset), SIZE_T(viewSize), NULL);
+		CHECK_WIN32API(view);
+		ptr = (const unsigned char*)view + (windowOffset - viewOffset);
+		offset = windowOffset;
+		size = windowSize;
+	}
+
+	void MemoryMappedIO::unmap()
+	{
+		if (!view)
+			return;
+		unlock();
+		LOG_IF_FAILED_WIN32API(UnmapViewOfFile(view));
+		view = nullptr;
+		ptr = nullptr;
+		size = 0;
+	}
+
+	void MemoryMappedIO::remap(uint64_t windowOffset, uint64_t windowSize)
+	{
+		unmap();
+		map(windowOffset, windowSize);
+	}
+
 	const unsigned char* MemoryMappedIO::getPtr() const
 	{
-		return (const unsigned char *)ptr;
+		return ptr;
 	}
 
 	uint64_t MemoryMappedIO::getSize() const
 	{
-		LARGE_INTEGER large_integer;
-		CHECK_WIN32API(GetFileSizeEx(hFile, &large_integer));
-		return large_integer.QuadPart;
+		return size;
+	}
+
+	uint64_t MemoryMappedIO::getOffset() const
+	{
+		return offset;
+	}
+
+	uint64_t MemoryMappedIO::getFileSize() const
+	{
+		return fileSize;
+	}
+
+	void MemoryMappedIO::prefetch(uint64_t rangeOffset, uint64_t rangeSize)
+	{
+		CHECK_LE(rangeOffset, size);
+		if (!rangeSize || rangeSize > size - rangeOffset)
+			rangeSize = size - rangeOffset;
+		if (!rangeSize)
+			return;
+		WIN32_MEMORY_RANGE_ENTRY range;
+		range.VirtualAddress = (void*)(ptr + rangeOffset);
+		range.NumberOfBytes = SIZE_T(rangeSize);
+		// Only a hint, the pages are faulted in on access anyway
+		LOG_IF_FAILED_WIN32API(PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0));
+	}
+
+	void MemoryMappedIO::populate()
+	{
+		prefetch();
+		const uint64_t pageSize = getSystemInfo().dwPageSize;
+		// Volatile reads, so touching the pages is not optimized away
+		const volatile unsigned char *window = ptr;
+		for (uint64_t pageOffset = 0; pageOffset < size; pageOffset += pageSize)
+			(void)window[pageOffset];
+	}
+
+	void MemoryMappedIO::lock()
+	{
+		if (locked)
+			return;
+		CHECK_WIN32API(VirtualLock((void*)ptr, SIZE_T(size)));
+		locked = true;
+	}
+
+	void MemoryMappedIO::unlock()
+	{
+		if (!locked)
+			return;
+		LOG_IF_FAILED_WIN32API(VirtualUnlock((void*)ptr, SIZE_T(size)));
+		locked = false;
 	}
-}
\ No newline at end of file
+}
@@ -1,114 +1,173 @@
 #include <base/native_event_looper.h>
-#include <base/sync.h>
+
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
 
 #include <base/logging.h>
 
 namespace Base
 {
+	// Packets taken from the port at once
+	static const ULONG batchSize = 64;
+	// Completion key of the packet posted by cancel(), slots use their index + 1
+	static const ULONG_PTR cancelKey = 0;
+
+	// Read by the thread pool callback, written only while no wait is set on the slot
+	struct WaitContext
+	{
+		HANDLE completionPort;
+		uint32_t slotIndex;
+		// Bumped whenever the slot is released, packets of an earlier use are dropped
+		uint32_t generation;
+	};
+
+	struct NativeEventLooper::Slot
+	{
+		WaitContext context;
+		PTP_WAIT wait;
+		HANDLE handle;
+		// nullptr while the slot is free
+		NativeWaitableObject *object;
+		uint32_t index;
+	};
+
+	static void CALLBACK waitCallback(PTP_CALLBACK_INSTANCE, PVOID parameter, PTP_WAIT, TP_WAIT_RESULT)
+	{
+		const WaitContext *context = static_cast<const WaitContext*>(parameter);
+		LOG_IF_FAILED_WIN32API(PostQueuedCompletionStatus(context->completionPort, context->generation, ULONG_PTR(context->slotIndex) + 1, nullptr));
+	}
+
 	NativeEventLooper::NativeEventLooper()
+		: _completionPort(nullptr), _entries(std::make_unique<OVERLAPPED_ENTRY[]>(batchSize)), _numberOfEntries(0), _nextEntry(0)
 	{
-		_nativeWaitableHandles.push_back(_event.getHandle());
+		_completionPort = CreateIoCompletionPort(INVALID_HANDLE_VALUE, nullptr, 0, 1);
+		CHECK_WIN32API(_completionPort);
+	}
+
+	NativeEventLooper::~NativeEventLooper()
+	{
+		for (const std::unique_ptr<Slot> &slot : _slots)
+		{
+			SetThreadpoolWait(slot->wait, nullptr, nullptr);
+			WaitForThreadpoolWaitCallbacks(slot->wait, TRUE);
+			CloseThreadpoolWait(slot->wait);
+		}
+		LOG_IF_FAILED_WIN32API(CloseHandle(_completionPort));
 	}
 
 	void NativeEventLooper::registerWaitableObject(NativeWaitableObject* waitable_object)
 	{
-		uint32_t numberOfObjects;
-		waitable_object->getNumberOfWaitableObjects(&numberOfObjects);
-		const uint32_t originalSize = _nativeWaitableHandles.size();
-		_nativeWaitableHandles.resize(originalSize + numberOfObjects);
-		waitable_object->getWaitableObjects(_nativeWaitableHandles.data() + originalSize);
-		_objects.push_back(waitable_object);
-		const auto rc = _objectNativeHandleCountMapper.insert(std::make_pair(waitable_object, numberOfObjects));
+		const auto rc = _objectSlots.emplace(waitable_object, std::vector<uint32_t>());
 		CHECK(rc.second);
+		addSlots(waitable_object, rc.first->second);
 	}
 
 	void NativeEventLooper::updateWaitableObject(NativeWaitableObject* waitable_object)
 	{
-		uint32_t nativeObjectIndex = 1;
-		for (NativeWaitableObject *object : _objects)
+		std::vector<uint32_t> &slots = _objectSlots.at(waitable_object);
+		removeSlots(slots);
+		slots.clear();
+		addSlots(waitable_object, slots);
+	}
+
+	void NativeEventLooper::eraseWaitableObject(NativeWaitableObject* waitable_object)
+	{
+		const auto iterator = _objectSlots.find(waitable_object);
+		CHECK(iterator != _objectSlots.end());
+		removeSlots(iterator->second);
+		_objectSlots.erase(iterator);
+	}
+
+	void NativeEventLooper::runLooper()
+	{
+		while (true)
 		{
-			if (waitable_object == object)
-				break;
-			else
+			while (_nextEntry < _numberOfEntries)
 			{
-				const uint32_t index = _objectNativeHandleCountMapper.at(object);
-				nativeObjectIndex += index;
+				const OVERLAPPED_ENTRY &entry = _entries[_nextEntry++];
+				if (entry.lpCompletionKey == cancelKey)
+					return;
+				dispatch(entry.lpCompletionKey, entry.dwNumberOfBytesTransferred);
 			}
+			ULONG numberOfEntries;
+			CHECK_WIN32API(GetQueuedCompletionStatusEx(_completionPort, _entries.get(), batchSize, &numberOfEntries, INFINITE, FALSE));
+			_numberOfEntries = numberOfEntries;
+			_nextEntry = 0;
 		}
-		uint32_t numberOfWaitableObjects;
-		waitable_object->getNumberOfWaitableObjects(&numberOfWaitableObjects);
-		const uint32_t recordedNumberOfWaitableObjects = _objectNativeHandleCountMapper.at(waitable_object);
-		if (numberOfWaitableObjects != recordedNumberOfWaitableObjects)
+	}
+
+	void NativeEventLooper::cancel()
+	{
+		CHECK_WIN32API(PostQueuedCompletionStatus(_completionPort, 0, cancelKey, nullptr));
+	}
+
+	void NativeEventLooper::addSlots(NativeWaitableObject* waitable_object, std::vector<uint32_t>& slots)
+	{
+		uint32_t numberOfObjects;
+		waitable_object->getNumberOfWaitableObjects(&numberOfObjects);
+		std::vector<HANDLE> handles(numberOfObjects);
+		if (numberOfObjects)
+			waitable_object->getWaitableObjects(handles.data());
+		for (uint32_t index = 0; index < numberOfObjects; ++index)
 		{
-			if (numberOfWaitableObjects > recordedNumberOfWaitableObjects)
+			uint32_t slotIndex;
+			if (!_freeSlots.empty())
 			{
-				_nativeWaitableHandles.insert(
-					_nativeWaitableHandles.begin() + nativeObjectIndex,
-					numberOfWaitableObjects - recordedNumberOfWaitableObjects,
-					nullptr);
+				slotIndex = _freeSlots.back();
+				_freeSlots.pop_back();
 			}
 			else
 			{
-				_nativeWaitableHandles.erase(
-					_nativeWaitableHandles.begin() + nativeObjectIndex,
-					_nativeWaitableHandles.begin() + nativeObjectIndex + (recordedNumberOfWaitableObjects - numberOfWaitableObjects));
+				std::unique_ptr<Slot> slot = std::make_unique<Slot>();
+				slotIndex = uint32_t(_slots.size());
+				slot->context.completionPort = _completionPort;
+				slot->context.slotIndex = slotIndex;
+				slot->context.generation = 0;
+				slot->wait = CreateThreadpoolWait(waitCallback, &slot->context, nullptr);
+				CHECK_WIN32API(slot->wait);
+				_slots.push_back(std::move(slot));
 			}
-			_objectNativeHandleCountMapper.at(waitable_object) = numberOfWaitableObjects;
+			Slot &slot = *_slots[slotIndex];
+			slot.handle = handles[index];
+			slot.object = waitable_object;
+			slot.index = index;
+			slots.push_back(slotIndex);
+			SetThreadpoolWait(slot.wait, slot.handle, nullptr);
 		}
-		waitable_object->getWaitableObjects(_nativeWaitableHandles.data() + nativeObjectIndex);
 	}
 
-	void NativeEventLooper::eraseWaitableObject(NativeWaitableObject* waitable_object)
+	void NativeEventLooper::removeSlots(const std::vector<uint32_t>& slots)
 	{
-		uint32_t nativeObjectIndex = 1;
-		uint32_t objectIndex = 0;
-		for (NativeWaitableObject *object : _objects)
+		for (uint32_t slotIndex : slots)
 		{
-			if (waitable_object == object)
-				break;
-			else
-			{
-				const uint32_t index = _objectNativeHandleCountMapper.at(object);
-				nativeObjectIndex += index;
-				++objectIndex;
-			}
+			Slot &slot = *_slots[slotIndex];
+			// Cancels the wait and the callbacks not started yet, waits for a running one
+			SetThreadpoolWait(slot.wait, nullptr, nullptr);
+			WaitForThreadpoolWaitCallbacks(slot.wait, TRUE);
+			slot.object = nullptr;
+			++slot.context.generation;
+			_freeSlots.push_back(slotIndex);
 		}
-
-		const uint32_t numberOfObject = _objectNativeHandleCountMapper.at(waitable_object);
-		_nativeWaitableHandles.erase(_nativeWaitableHandles.begin() + nativeObjectIndex,
-			_nativeWaitableHandles.begin() + nativeObjectIndex + numberOfObject);
-		_objects.erase(_objects.begin() + objectIndex);
-		_objectNativeHandleCountMapper.erase(waitable_object);
 	}
 
-	void NativeEventLooper::runLooper()
+	void NativeEventLooper::dispatch(uintptr_t key, uint32_t generation)
 	{
-		while (true)
+		Slot *slot = _slots[key - 1].get();
+		if (slot->context.generation != generation || !slot->object)
+			return;
+		try
 		{
-			unsigned signaledObjectIndex;
-			waitForMultipleObjects(_nativeWaitableHandles.data(), _nativeWaitableHandles.size(), &signaledObjectIndex);
-			if (signaledObjectIndex == 0)
-				return;
-
-			signaledObjectIndex -= 1;
-			NativeWaitableObject *signaledObject = nullptr;
-			for (NativeWaitableObject *object : _objects)
-			{
-				const uint32_t numberOfNativeObjects = _objectNativeHandleCountMapper.at(object);
-
-				if (numberOfNativeObjects > signaledObjectIndex) {
-					signaledObject = object;
-					break;
-				}
-				else
-					signaledObjectIndex -= numberOfNativeObjects;
-			}
-			signaledObject->callback(signaledObjectIndex);
+			slot->object->callback(slot->index);
 		}
+		catch (...)
+		{
+			if (slot->context.generation == generation)
+				SetThreadpoolWait(slot->wait, slot->handle, nullptr);
+			throw;
+		}
+		// Unless the callback erased or updated its object
+		if (slot->context.generation == generation)
+			SetThreadpoolWait(slot->wait, slot->handle, nullptr);
 	}
-
-	void NativeEventLooper::cancel()
-	{
-		_event.set();
-	}
-}
\ No newline at end of file
+}
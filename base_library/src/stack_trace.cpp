@@ -12,7 +12,13 @@ namespace Base
 	std::mutex stack_trace_locker;
 	HANDLE hProcess = GetCurrentProcess();
 
-	std::string getStackTrace()
+	unsigned short captureStackTrace(void **frames, unsigned short maximumNumberOfFrames, unsigned long framesToSkip)
+	{
+		// Not counting this one
+		return CaptureStackBackTrace(framesToSkip + 1, maximumNumberOfFrames, frames, nullptr);
+	}
+
+	std::string symbolizeStackTrace(void *const *frames, unsigned short numberOfFrames)
 	{
 		std::string message;
 		SYMBOL_INFO *symbol = static_cast<SYMBOL_INFO*>(malloc(sizeof(SYMBOL_INFO) + (MAX_SYM_NAME - 1) * sizeof(char)));
@@ -20,8 +26,6 @@ namespace Base
 
 		symbol->MaxNameLen = MAX_SYM_NAME;
 		symbol->SizeOfStruct = sizeof(SYMBOL_INFO);
-		const unsigned short max_frames = std::numeric_limits<unsigned short>::max();
-		void **stacks = (void**)malloc(sizeof(void*) * max_frames);
 
 		stack_trace_locker.lock();
 		static bool stack_trace_initialized = false;
@@ -35,13 +39,12 @@ namespace Base
 			stack_trace_initialized = true;
 		}
 
-		unsigned short frames = CaptureStackBackTrace(1, max_frames, stacks, nullptr);
 		const unsigned address_buffer_length = sizeof(ptrdiff_t) * 2 + 1;
 		char buffer[address_buffer_length];
 
-		for (unsigned short i = 0; i < frames; ++i)
+		for (unsigned short i = 0; i < numberOfFrames; ++i)
 		{
-			if (!SymFromAddr(hProcess, (DWORD64)stacks[i], 0, symbol))
+			if (!SymFromAddr(hProcess, (DWORD64)frames[i], 0, symbol))
 			{
 				message += "Warning! SymFromAddr() failed.\n"
 					"Win32 Error Code: " + std::to_string(GetLastError()) + "\n";
@@ -52,8 +55,18 @@ namespace Base
 		stack_trace_locker.unlock();
 
 		free(symbol);
+
+		return message;
+	}
+
+	std::string getStackTrace()
+	{
+		const unsigned short max_frames = std::numeric_limits<unsigned short>::max();
+		void **stacks = (void**)malloc(sizeof(void*) * max_frames);
+		unsigned short frames = captureStackTrace(stacks, max_frames, 1);
+		std::string message = symbolizeStackTrace(stacks, frames);
 		free(stacks);
 
 		return message;
 	}
-}
\ No newline at end of file
+}
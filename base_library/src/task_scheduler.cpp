@@ -0,0 +1,337 @@
+#include <base/task_scheduler.h>
+
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+
+#include <base/logging.h>
+
+#include <algorithm>
+#include <typeinfo>
+
+namespace Base
+{
+	// Set on the worker threads, tasks submitted from them go to their own deque
+	static thread_local TaskScheduler *currentScheduler = nullptr;
+	static thread_local unsigned currentWorkerIndex = 0;
+
+	CancellationToken::CancellationToken()
+		: _canceled(std::make_shared<std::atomic<bool>>(false))
+	{
+	}
+
+	void CancellationToken::cancel() const noexcept
+	{
+		_canceled->store(true);
+	}
+
+	bool CancellationToken::isCanceled() const noexcept
+	{
+		return _canceled->load();
+	}
+
+	TaskScheduler::TaskScheduler(unsigned numberOfWorkers, uint64_t affinityMask)
+		: _numberOfQueued(0), _numberOfSleeping(0), _stopping(false)
+	{
+		if (!numberOfWorkers)
+			numberOfWorkers = std::max(std::thread::hardware_concurrency(), 1U);
+		std::vector<unsigned> processors;
+		for (unsigned processor = 0; processor < 64; ++processor)
+		{
+			if (affinityMask & (1ULL << processor))
+				processors.push_back(processor);
+		}
+		for (unsigned index = 0; index < numberOfWorkers; ++index)
+			_workers.push_back(std::make_unique<Worker>());
+		try
+		{
+			for (unsigned index = 0; index < numberOfWorkers; ++index)
+			{
+				std::thread &thread = _workers[index]->thread;
+				thread = std::thread(&TaskScheduler::workerEntry, this, index);
+				if (!processors.empty())
+					CHECK_WIN32API(SetThreadAffinityMask(thread.native_handle(), DWORD_PTR(1) << processors[index % processors.size()]));
+			}
+		}
+		catch (...)
+		{
+			{
+				std::lock_guard<std::mutex> lock_guard(_lock);
+				_stopping = true;
+			}
+			_wakeup.notify_all();
+			for (const std::unique_ptr<Worker> &worker : _workers)
+			{
+				if (worker->thread.joinable())
+					worker->thread.join();
+			}
+			throw;
+		}
+	}
+
+	TaskScheduler::~TaskScheduler()
+	{
+		{
+			std::lock_guard<std::mutex> lock_guard(_lock);
+			_stopping = true;
+		}
+		_wakeup.notify_all();
+		for (const std::unique_ptr<Worker> &worker : _workers)
+			worker->thread.join();
+	}
+
+	void TaskScheduler::submit(Task task)
+	{
+		// Counted before it is published, a worker taking it right away must not wrap the counter
+		++_numberOfQueued;
+		if (currentScheduler == this)
+		{
+			Worker &worker = *_workers[currentWorkerIndex];
+			std::lock_guard<std::mutex> lock_guard(worker.lock);
+			worker.tasks.push_back(std::move(task));
+		}
+		else
+		{
+			std::lock_guard<std::mutex> lock_guard(_lock);
+			_submittedTasks.push_back(std::move(task));
+		}
+		// A worker going to sleep counts itself before checking _numberOfQueued, one of the two sees the other.
+		// Taking the lock orders the notification after its wait.
+		if (_numberOfSleeping.load())
+		{
+			{
+				std::lock_guard<std::mutex> lock_guard(_lock);
+			}
+			_wakeup.notify_one();
+		}
+	}
+
+	bool TaskScheduler::runPendingTask()
+	{
+		Task task;
+		if (!tryTakeTask(task))
+			return false;
+		runTask(task);
+		return true;
+	}
+
+	unsigned TaskScheduler::getNumberOfWorkers() const noexcept
+	{
+		return unsigned(_workers.size());
+	}
+
+	bool TaskScheduler::tryTakeTask(Task& task)
+	{
+		const bool onWorker = currentScheduler == this;
+		bool taken = false;
+		if (onWorker)
+		{
+			Worker &worker = *_workers[currentWorkerIndex];
+			std::lock_guard<std::mutex> lock_guard(worker.lock);
+			if (!worker.tasks.empty())
+			{
+				task = std::move(worker.tasks.back());
+				worker.tasks.pop_back();
+				taken = true;
+			}
+		}
+		if (!taken)
+		{
+			std::lock_guard<std::mutex> lock_guard(_lock);
+			if (!_submittedTasks.empty())
+			{
+				task = std::move(_submittedTasks.front());
+				_submittedTasks.pop_front();
+				taken = true;
+			}
+		}
+		const size_t numberOfWorkers = _workers.size();
+		const size_t firstVictim = onWorker ? currentWorkerIndex + 1 : 0;
+		for (size_t offset = 0; !taken && offset < numberOfWorkers; ++offset)
+		{
+			Worker &victim = *_workers[(firstVictim + offset) % numberOfWorkers];
+			std::lock_guard<std::mutex> lock_guard(victim.lock);
+			if (!victim.tasks.empty())
+			{
+				task = std::move(victim.tasks.front());
+				victim.tasks.pop_front();
+				taken = true;
+			}
+		}
+		if (taken)
+			--_numberOfQueued;
+		return taken;
+	}
+
+	void TaskScheduler::runTask(Task& task)
+	{
+		try
+		{
+			task();
+		}
+		catch (const std::exception &exp)
+		{
+			EventLogging(__FILE__, __LINE__, __func__).stream() << "Unhandled exception in task, " << typeid(exp).name() << ": " << exp.what();
+		}
+		catch (...)
+		{
+			EventLogging(__FILE__, __LINE__, __func__).stream() << "Unhandled exception in task";
+		}
+		// Releases the captures now rather than with the next task
+		task = nullptr;
+	}
+
+	void TaskScheduler::workerEntry(unsigned index)
+	{
+		currentScheduler = this;
+		currentWorkerIndex = index;
+		Task task;
+		while (true)
+		{
+			if (tryTakeTask(task))
+			{
+				runTask(task);
+				continue;
+			}
+			std::unique_lock<std::mutex> lock(_lock);
+			if (_stopping && !_numberOfQueued.load())
+				return;
+			++_numberOfSleeping;
+			_wakeup.wait(lock, [this]() { return _numberOfQueued.load() || _stopping; });
+			--_numberOfSleeping;
+		}
+	}
+
+	TaskGroup::TaskGroup(TaskScheduler& scheduler, CancellationToken token)
+		: _scheduler(scheduler), _token(token), _state(std::make_shared<State>())
+	{
+		_state->numberOfUnfinished = 0;
+		_state->numberOfRuns = 0;
+		_state->numberOfWaiting = 0;
+	}
+
+	TaskGroup::~TaskGroup()
+	{
+		try
+		{
+			wait();
+		}
+		catch (...)
+		{
+		}
+	}
+
+	void TaskGroup::run(TaskScheduler::Task task)
+	{
+		++_state->numberOfUnfinished;
+		const std::shared_ptr<State> state = _state;
+		const CancellationToken token = _token;
+		_scheduler.submit([state, token, task]()
+		{
+			if (!token.isCanceled())
+			{
+				try
+				{
+					task();
+				}
+				catch (...)
+				{
+					std::lock_guard<std::mutex> lock_guard(state->lock);
+					if (!state->exception)
+						state->exception = std::current_exception();
+					token.cancel();
+				}
+			}
+			if (--state->numberOfUnfinished == 0)
+			{
+				std::lock_guard<std::mutex> lock_guard(state->lock);
+				state->finished.notify_all();
+			}
+		});
+		// Counted after it is published. Pairs with the fence in wait(): either the waiter sees the count change,
+		// or this sees the waiter and takes the lock, which it only gets once the waiter sleeps.
+		++_state->numberOfRuns;
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if (_state->numberOfWaiting.load(std::memory_order_relaxed))
+		{
+			std::lock_guard<std::mutex> lock_guard(_state->lock);
+			_state->finished.notify_all();
+		}
+	}
+
+	void TaskGroup::wait()
+	{
+		while (true)
+		{
+			// Read before looking for tasks, a task run after that changes it
+			const size_t numberOfRuns = _state->numberOfRuns.load();
+			if (!_state->numberOfUnfinished.load())
+				break;
+			if (_scheduler.runPendingTask())
+				continue;
+			// Tasks of the group still running may run more, those are worth waking up for
+			std::unique_lock<std::mutex> lock(_state->lock);
+			++_state->numberOfWaiting;
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			_state->finished.wait(lock, [this, numberOfRuns]()
+			{
+				return !_state->numberOfUnfinished.load() || _state->numberOfRuns.load() != numberOfRuns;
+			});
+			--_state->numberOfWaiting;
+		}
+		std::exception_ptr exception;
+		{
+			std::lock_guard<std::mutex> lock_guard(_state->lock);
+			exception.swap(_state->exception);
+		}
+		if (exception)
+			std::rethrow_exception(exception);
+	}
+
+	void TaskGroup::cancel() noexcept
+	{
+		_token.cancel();
+	}
+
+	bool TaskGroup::isCanceled() const noexcept
+	{
+		return _token.isCanceled();
+	}
+
+	const CancellationToken& TaskGroup::getCancellationToken() const noexcept
+	{
+		return _token;
+	}
+
+	void parallelFor(TaskScheduler& scheduler, size_t begin, size_t end, const std::function<void(size_t index)>& body, size_t grainSize)
+	{
+		if (!grainSize)
+			grainSize = 1;
+		// Declared before the group, whose destructor waits for the pieces still running it
+		std::function<void(size_t, size_t)> split;
+		TaskGroup group(scheduler);
+		split = [&](size_t first, size_t last)
+		{
+			while (last - first > grainSize)
+			{
+				const size_t middle = first + (last - first) / 2;
+				group.run([&split, middle, last]() { split(middle, last); });
+				last = middle;
+			}
+			for (size_t index = first; index < last && !group.isCanceled(); ++index)
+				body(index);
+		};
+		try
+		{
+			if (begin < end)
+				split(begin, end);
+		}
+		catch (...)
+		{
+			// The destructor waits for the pieces already handed out
+			group.cancel();
+			throw;
+		}
+		group.wait();
+	}
+}
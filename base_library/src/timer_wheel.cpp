@@ -0,0 +1,245 @@
+#include <base/timer_wheel.h>
+
+#include <base/logging.h>
+
+#include <algorithm>
+
+namespace Base
+{
+	TimerWheel::TimerWheel(uint32_t resolution_ms)
+		: _resolution_ms(resolution_ms), _startTime(std::chrono::steady_clock::now()), _currentTick(0), _numberOfTimers(0)
+	{
+		CHECK_GT(resolution_ms, 0U);
+		for (unsigned level = 0; level < numberOfLevels; ++level)
+		{
+			for (unsigned slot = 0; slot < slotsPerLevel; ++slot)
+				_slots[level][slot] = none;
+		}
+	}
+
+	TimerWheel::TimerId TimerWheel::schedule(uint32_t delay_ms, Callback callback, uint32_t period_ms)
+	{
+		std::lock_guard<std::mutex> lock_guard(_lock);
+		const uint64_t currentTick = getCurrentTick();
+		// Nothing is in the wheel, skip the ticks it was idle for
+		if (!_numberOfTimers)
+			_currentTick = currentTick;
+		uint32_t index;
+		if (!_freeEntries.empty())
+		{
+			index = _freeEntries.back();
+			_freeEntries.pop_back();
+		}
+		else
+		{
+			CHECK_LT(_entries.size(), size_t(none));
+			index = uint32_t(_entries.size());
+			_entries.emplace_back();
+			_entries.back().generation = 1;
+		}
+		Entry &entry = _entries[index];
+		entry.callback = std::move(callback);
+		entry.expiry = currentTick + std::max(toTicks(delay_ms), uint64_t(1));
+		entry.periodTicks = period_ms ? std::max(toTicks(period_ms), uint64_t(1)) : 0;
+		entry.slot = none;
+		entry.due = false;
+		entry.used = true;
+		insert(index);
+		++_numberOfTimers;
+		if (_timer.getTimerState() != Timer::TimerState::ACTIVE)
+			_timer.activate(_resolution_ms, uint64_t(_resolution_ms) * 10000ULL);
+		return (TimerId(entry.generation) << 32) | index;
+	}
+
+	bool TimerWheel::cancel(TimerId id)
+	{
+		std::lock_guard<std::mutex> lock_guard(_lock);
+		const uint32_t index = uint32_t(id);
+		if (index >= _entries.size())
+			return false;
+		Entry &entry = _entries[index];
+		if (!entry.used || entry.generation != uint32_t(id >> 32))
+			return false;
+		if (entry.slot != none)
+			unlink(index);
+		release(index);
+		return true;
+	}
+
+	size_t TimerWheel::getNumberOfTimers() const
+	{
+		std::lock_guard<std::mutex> lock_guard(_lock);
+		return _numberOfTimers;
+	}
+
+	uint32_t TimerWheel::getResolution() const noexcept
+	{
+		return _resolution_ms;
+	}
+
+	void TimerWheel::advance()
+	{
+		std::vector<TimerId> due;
+		{
+			std::lock_guard<std::mutex> lock_guard(_lock);
+			const uint64_t currentTick = getCurrentTick();
+			if (!_numberOfTimers)
+				_currentTick = std::max(_currentTick, currentTick);
+			while (_currentTick < currentTick)
+				tick();
+			due.swap(_due);
+		}
+		for (size_t i = 0; i < due.size(); ++i)
+		{
+			Callback callback;
+			{
+				std::lock_guard<std::mutex> lock_guard(_lock);
+				const uint32_t index = uint32_t(due[i]);
+				Entry &entry = _entries[index];
+				// Canceled after it expired
+				if (!entry.used || entry.generation != uint32_t(due[i] >> 32) || !entry.due)
+					continue;
+				entry.due = false;
+				if (entry.periodTicks)
+				{
+					callback = entry.callback;
+					// One catch up firing at most if the looper fell behind
+					entry.expiry = std::max(entry.expiry + entry.periodTicks, _currentTick + 1);
+					insert(index);
+				}
+				else
+				{
+					callback = std::move(entry.callback);
+					release(index);
+				}
+			}
+			try
+			{
+				callback();
+			}
+			catch (...)
+			{
+				// The rest still fire with the next advance()
+				std::lock_guard<std::mutex> lock_guard(_lock);
+				_due.insert(_due.begin(), due.begin() + i + 1, due.end());
+				throw;
+			}
+		}
+		std::lock_guard<std::mutex> lock_guard(_lock);
+		if (!_numberOfTimers && _timer.getTimerState() == Timer::TimerState::ACTIVE)
+			_timer.inactivate();
+	}
+
+	void TimerWheel::getNumberOfWaitableObjects(uint32_t* numberOfWaitableObject)
+	{
+		*numberOfWaitableObject = 1;
+	}
+
+	void TimerWheel::getWaitableObjects(HANDLE* nativeWaitableObjects)
+	{
+		nativeWaitableObjects[0] = _timer.getHandle();
+	}
+
+	void TimerWheel::callback(uint32_t index)
+	{
+		(index);
+		advance();
+	}
+
+	uint64_t TimerWheel::toTicks(uint32_t time_ms) const
+	{
+		return (uint64_t(time_ms) + _resolution_ms - 1) / _resolution_ms;
+	}
+
+	uint64_t TimerWheel::getCurrentTick() const
+	{
+		return uint64_t(std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - _startTime).count()) / _resolution_ms;
+	}
+
+	void TimerWheel::insert(uint32_t index)
+	{
+		Entry &entry = _entries[index];
+		// Only a cascade hands in entries due on the current tick, tick() drains their level 0 slot right after it
+		uint64_t expiry = std::max(entry.expiry, _currentTick);
+		const uint64_t range = 1ULL << (levelBits * numberOfLevels);
+		// Beyond the wheel, parked in the last slot reachable and inserted again from there
+		if (expiry - _currentTick >= range)
+			expiry = _currentTick + range - 1;
+		const uint64_t delta = expiry - _currentTick;
+		unsigned level = 0;
+		while (level + 1 < numberOfLevels && delta >= (1ULL << (levelBits * (level + 1))))
+			++level;
+		link(level * slotsPerLevel + uint32_t((expiry >> (levelBits * level)) & (slotsPerLevel - 1)), index);
+	}
+
+	void TimerWheel::link(uint32_t slot, uint32_t index)
+	{
+		uint32_t &head = _slots[slot / slotsPerLevel][slot % slotsPerLevel];
+		Entry &entry = _entries[index];
+		entry.slot = slot;
+		entry.previous = none;
+		entry.next = head;
+		if (head != none)
+			_entries[head].previous = index;
+		head = index;
+	}
+
+	void TimerWheel::unlink(uint32_t index)
+	{
+		Entry &entry = _entries[index];
+		if (entry.previous != none)
+			_entries[entry.previous].next = entry.next;
+		else
+			_slots[entry.slot / slotsPerLevel][entry.slot % slotsPerLevel] = entry.next;
+		if (entry.next != none)
+			_entries[entry.next].previous = entry.previous;
+		entry.slot = none;
+	}
+
+	void TimerWheel::release(uint32_t index)
+	{
+		Entry &entry = _entries[index];
+		entry.callback = nullptr;
+		entry.used = false;
+		entry.due = false;
+		++entry.generation;
+		_freeEntries.push_back(index);
+		--_numberOfTimers;
+	}
+
+	void TimerWheel::cascade(unsigned level)
+	{
+		uint32_t &head = _slots[level][(_currentTick >> (levelBits * level)) & (slotsPerLevel - 1)];
+		uint32_t index = head;
+		head = none;
+		while (index != none)
+		{
+			const uint32_t next = _entries[index].next;
+			insert(index);
+			index = next;
+		}
+	}
+
+	void TimerWheel::tick()
+	{
+		++_currentTick;
+		// Coarse slots coming up are spread over the finer levels, the coarsest first
+		for (unsigned level = numberOfLevels - 1; level > 0; --level)
+		{
+			if (!(_currentTick & ((1ULL << (levelBits * level)) - 1)))
+				cascade(level);
+		}
+		uint32_t &head = _slots[0][_currentTick & (slotsPerLevel - 1)];
+		uint32_t index = head;
+		head = none;
+		while (index != none)
+		{
+			Entry &entry = _entries[index];
+			const uint32_t next = entry.next;
+			entry.slot = none;
+			entry.due = true;
+			_due.push_back((TimerId(entry.generation) << 32) | index);
+			index = next;
+		}
+	}
+}
@@ -0,0 +1,8 @@
+#pragma once
+
+// Each subcommand receives the arguments following its name and returns the process exit code
+int dedupCommand(int argc, wchar_t *argv[]);
+int packCommand(int argc, wchar_t *argv[]);
+int patchesCommand(int argc, wchar_t *argv[]);
+int propagateCommand(int argc, wchar_t *argv[]);
+int transformCommand(int argc, wchar_t *argv[]);
@@ -0,0 +1,70 @@
+#include "commands.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <base/dataset_scanner.h>
+#include <base/file.h>
+#include <base/logging.h>
+#include <frame_hash.h>
+#include <header_scanner.h>
+
+// Lists the frames that duplicate an earlier one, within and across the given sequences, one per line:
+// exact|near <hash distance> <frame> <original>. Sequences are taken in argument order, frames in natural file name order.
+int dedupCommand(int argc, wchar_t *argv[])
+{
+	std::vector<std::wstring> directories;
+	unsigned maximumDistance = 3;
+	const std::wstring distanceOption = L"--distance=";
+	for (int i = 0; i < argc; ++i)
+	{
+		const std::wstring argument = argv[i];
+		if (argument.compare(0, distanceOption.size(), distanceOption) == 0)
+			maximumDistance = std::stoul(argument.substr(distanceOption.size()));
+		else
+			directories.push_back(argument);
+	}
+	if (directories.empty() || maximumDistance > 15)
+	{
+		std::wcerr << L"Usage: dataset_tool dedup <sequence directory> [sequence directory ...] [--distance=0..15]" << std::endl;
+		return 1;
+	}
+
+	std::vector<std::wstring> paths;
+	for (const std::wstring &directory : directories)
+	{
+		std::vector<std::wstring> fileNames;
+		std::vector<uint64_t> lastWriteTimes;
+		Base::getDirectoryFileLists(directory, fileNames, lastWriteTimes);
+		fileNames.erase(std::remove_if(fileNames.begin(), fileNames.end(),
+			[](const std::wstring &fileName) { return !isJPEGFileName(fileName); }), fileNames.end());
+		std::sort(fileNames.begin(), fileNames.end(), Base::naturalLess);
+		for (const std::wstring &fileName : fileNames)
+			paths.push_back(Base::appendPath(directory, fileName));
+	}
+
+	const auto begin = std::chrono::steady_clock::now();
+	const std::vector<FrameHash> hashes = hashFrameFiles(paths);
+	const std::vector<DuplicateFrame> duplicates = findDuplicateFrameFiles(paths, hashes, maximumDistance);
+	const double elapsed_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+
+	size_t numberOfExactDuplicates = 0;
+	for (const DuplicateFrame &duplicate : duplicates)
+	{
+		if (duplicate.kind == DuplicateKind::exact)
+		{
+			std::wcout << L"exact 0 ";
+			++numberOfExactDuplicates;
+		}
+		else
+			std::wcout << L"near " << duplicate.distance << L' ';
+		std::wcout << paths[duplicate.frame] << L' ' << paths[duplicate.original] << L'\n';
+	}
+	const size_t numberOfUndecodable = std::count_if(hashes.begin(), hashes.end(), [](const FrameHash &hash) { return !hash.decoded; });
+	std::wcerr << L"Hashed " << paths.size() << L" frames in " << elapsed_s << L" s: " << numberOfExactDuplicates << L" exact and "
+		<< duplicates.size() - numberOfExactDuplicates << L" near duplicates, " << numberOfUndecodable << L" frames not decodable" << std::endl;
+	return 0;
+}
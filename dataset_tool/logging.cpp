@@ -0,0 +1,3 @@
+#include <spdlog/spdlog.h>
+
+auto logger = spdlog::stdout_logger_mt("logger");
\ No newline at end of file
@@ -0,0 +1,55 @@
+#include <iostream>
+#include <string>
+
+#include <base/async_logging.h>
+
+#include "commands.h"
+
+struct Command
+{
+	const wchar_t *name;
+	int(*entry)(int argc, wchar_t *argv[]);
+	const wchar_t *usage;
+};
+
+static const Command commands[] = {
+	{ L"dedup", dedupCommand, L"dedup <sequence directory> [sequence directory ...] [--distance=0..15]" },
+	{ L"pack", packCommand, L"pack <sequence directory> <archive> [annotation .mat]" },
+	{ L"patches", patchesCommand, L"patches <sequence directory> <annotation .mat> <output> [template size] [search size]" },
+	{ L"propagate", propagateCommand, L"propagate <sequence directory> <annotation .mat> <record> [minimum confidence]" },
+	{ L"transform", transformCommand, L"transform <sequence directory> <annotation .mat> <output directory> <output annotation .mat> <operation> [crop x y w h]" },
+};
+
+static void printUsage()
+{
+	std::wcerr << L"Usage: dataset_tool <command> [arguments]" << std::endl;
+	for (const Command &command : commands)
+		std::wcerr << L"  " << command.usage << std::endl;
+}
+
+int wmain(int argc, wchar_t *argv[])
+{
+	// The commands log from their decode workers, the records left are written before returning
+	Base::AsyncLogging asyncLogging;
+	if (argc < 2)
+	{
+		printUsage();
+		return 1;
+	}
+	for (const Command &command : commands)
+	{
+		if (command.name == std::wstring(argv[1]))
+		{
+			try {
+				return command.entry(argc - 2, argv + 2);
+			}
+			catch (std::exception &exp)
+			{
+				std::cerr << exp.what() << std::endl;
+				return 1;
+			}
+		}
+	}
+	printUsage();
+	return 1;
+}
@@ -0,0 +1,75 @@
+#include "commands.h"
+
+#include <algorithm>
+#include <iostream>
+
+#include <base/dataset_scanner.h>
+#include <base/file.h>
+#include <base/logging.h>
+#include <header_scanner.h>
+#include <operation.h>
+#include <sequence_archive.h>
+
+static void packDirectory(const std::wstring &directory, SequenceArchiveWriter &writer)
+{
+	std::vector<std::wstring> fileNames;
+	std::vector<uint64_t> lastWriteTimes;
+	Base::getDirectoryFileLists(directory, fileNames, lastWriteTimes);
+	fileNames.erase(std::remove_if(fileNames.begin(), fileNames.end(),
+		[](const std::wstring &fileName) { return !isJPEGFileName(fileName); }), fileNames.end());
+	// Natural order (2.jpg before 10.jpg), the archive order is the playback order
+	std::sort(fileNames.begin(), fileNames.end(), Base::naturalLess);
+	for (const std::wstring &fileName : fileNames)
+		writer.addFrameFromFile(fileName, Base::appendPath(directory, fileName));
+}
+
+// Frames follow the record order, each record's path is relative to the sequence directory
+static void packAnnotatedDirectory(const std::wstring &directory, const std::wstring &matFilePath, SequenceArchiveWriter &writer)
+{
+	AnnotationOperator annotationOperator(matFilePath, AnnotationOperator::DesiredAccess::read, AnnotationOperator::CreationDisposition::open_always);
+	const size_t numberOfRecords = annotationOperator.getNumberOfRecords();
+	for (size_t i = 0; i < numberOfRecords; ++i)
+	{
+		int id, x, y, w, h;
+		bool labeled, occlusion, outOfView;
+		std::wstring path;
+		CHECK(annotationOperator.get(i, &id, &labeled, &x, &y, &w, &h, &occlusion, &outOfView, &path)) << "Record " << i;
+		SequenceArchiveRecord record = {};
+		record.id = id;
+		record.x = x;
+		record.y = y;
+		record.w = w;
+		record.h = h;
+		record.labeled = labeled;
+		record.occlusion = occlusion;
+		record.outOfView = outOfView;
+		writer.addFrameFromFile(path, Base::appendPath(directory, path), &record);
+	}
+}
+
+int packCommand(int argc, wchar_t *argv[])
+{
+	if (argc != 2 && argc != 3)
+	{
+		std::wcerr << L"Usage: dataset_tool pack <sequence directory> <archive> [annotation .mat]" << std::endl;
+		return 1;
+	}
+	const std::wstring directory = argv[0];
+	const std::wstring archivePath = argv[1];
+	if (argc == 3 && !Base::isPathExists(argv[2]))
+	{
+		std::wcerr << argv[2] << L" does not exist" << std::endl;
+		return 1;
+	}
+
+	SequenceArchiveWriter writer(archivePath, argc == 3);
+	if (argc == 3)
+		packAnnotatedDirectory(directory, argv[2], writer);
+	else
+		packDirectory(directory, writer);
+	writer.finish();
+
+	SequenceArchiveReader reader(archivePath);
+	std::wcout << L"Packed " << reader.getNumberOfFrames() << L" frames into " << archivePath << std::endl;
+	return 0;
+}
@@ -0,0 +1,168 @@
+#include "commands.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <ppl.h>
+#include <string>
+#include <vector>
+
+#include <base/file.h>
+#include <base/logging.h>
+#include <base/memory_mapped_io.h>
+#include <operation.h>
+#include <patch_extractor.h>
+
+// Output, little endian, laid out to be memory mapped as a numpy array:
+//   PatchArchiveHeader
+//   numberOfEntries entries of entrySize bytes, each holding the patches of one record back to back,
+//   every patch size x size x pixel size
+//   uint32_t recordIndices[numberOfEntries], the AnnotationOperator record of each entry
+struct PatchArchiveHeader
+{
+	char magic[8];
+	uint32_t version;
+	uint32_t numberOfEntries;
+	uint32_t numberOfPatches;
+	uint32_t pixelFormat;
+	uint32_t patchSizes[4];
+	float cropScales[4];
+	float contextAmount;
+	uint32_t entrySize;
+};
+static_assert(sizeof(PatchArchiveHeader) == 64, "On-disk layout");
+
+static const char PATCH_ARCHIVE_MAGIC[8] = { 'T', 'A', 'T', 'P', 'A', 'T', '\0', '\0' };
+static const uint32_t PATCH_ARCHIVE_VERSION = 1;
+// Records decoded in parallel before their patches are handed to the writer
+static const size_t RECORDS_PER_BATCH = 256;
+
+struct PatchRecord
+{
+	uint32_t index;
+	int x, y, w, h;
+	std::wstring path;
+};
+
+struct PatchBatch
+{
+	std::vector<unsigned char> patches;
+	// One byte per record, written concurrently
+	std::vector<char> succeeded;
+};
+
+static std::vector<PatchRecord> readRecords(const std::wstring &matFilePath)
+{
+	AnnotationOperator annotationOperator(matFilePath, AnnotationOperator::DesiredAccess::read, AnnotationOperator::CreationDisposition::open_always);
+	const size_t numberOfRecords = annotationOperator.getNumberOfRecords();
+	std::vector<PatchRecord> records;
+	for (size_t i = 0; i < numberOfRecords; ++i)
+	{
+		int id;
+		bool labeled, occlusion, outOfView;
+		PatchRecord record;
+		CHECK(annotationOperator.get(i, &id, &labeled, &record.x, &record.y, &record.w, &record.h, &occlusion, &outOfView, &record.path)) << "Record " << i;
+		// Nothing to crop around
+		if (!labeled || outOfView || record.w <= 0 || record.h <= 0)
+			continue;
+		record.index = (uint32_t)i;
+		records.push_back(std::move(record));
+	}
+	return records;
+}
+
+static void extractBatch(const std::wstring &directory, const std::vector<PatchRecord> &records, size_t begin, size_t end,
+	Concurrency::combinable<std::shared_ptr<PatchExtractor>> &extractors, PatchBatch &batch)
+{
+	const size_t entrySize = extractors.local()->getOutputSize();
+	batch.patches.resize((end - begin) * entrySize);
+	batch.succeeded.assign(end - begin, 0);
+	Concurrency::parallel_for(begin, end, [&](size_t i)
+	{
+		PatchExtractor *extractor = extractors.local().get();
+		const PatchRecord &record = records[i];
+		try {
+			Base::MemoryMappedIO file(Base::appendPath(directory, record.path).c_str());
+			extractor->extract(file.getPtr(), (unsigned long)file.getSize(), record.x, record.y, record.w, record.h,
+				batch.patches.data() + (i - begin) * entrySize);
+			batch.succeeded[i - begin] = 1;
+		}
+		catch (std::exception &)
+		{
+			// Already logged, the record is left out
+		}
+	});
+}
+
+int patchesCommand(int argc, wchar_t *argv[])
+{
+	if (argc != 3 && argc != 5)
+	{
+		std::wcerr << L"Usage: dataset_tool patches <sequence directory> <annotation .mat> <output> [template size] [search size]" << std::endl;
+		return 1;
+	}
+	const std::wstring directory = argv[0];
+	const std::wstring outputPath = argv[2];
+	unsigned templateSize = 127, searchSize = 255;
+	if (argc == 5)
+	{
+		templateSize = (unsigned)std::stoul(argv[3]);
+		searchSize = (unsigned)std::stoul(argv[4]);
+	}
+	const std::vector<PatchSpecification> patches = { { templateSize, 1. }, { searchSize, double(searchSize) / templateSize } };
+	const std::vector<PatchRecord> records = readRecords(argv[1]);
+
+	Concurrency::combinable<std::shared_ptr<PatchExtractor>> extractors([&patches]() { return std::make_shared<PatchExtractor>(patches); });
+	const size_t entrySize = extractors.local()->getOutputSize();
+	CHECK_LE(entrySize, (size_t)std::numeric_limits<uint32_t>::max());
+
+	PatchArchiveHeader header = {};
+	memcpy(header.magic, PATCH_ARCHIVE_MAGIC, sizeof(header.magic));
+	header.version = PATCH_ARCHIVE_VERSION;
+	header.numberOfPatches = (uint32_t)patches.size();
+	header.pixelFormat = (uint32_t)extractors.local()->getFormat();
+	for (size_t i = 0; i < patches.size(); ++i)
+	{
+		header.patchSizes[i] = patches[i].size;
+		header.cropScales[i] = (float)patches[i].cropScale;
+	}
+	header.contextAmount = (float)extractors.local()->getContextAmount();
+	header.entrySize = (uint32_t)entrySize;
+
+	Base::File file(outputPath, Base::File::Mode::write | Base::File::Mode::create_always);
+	uint64_t offset = sizeof(header);
+	std::vector<uint32_t> recordIndices;
+
+	// The previous batch is written while the next one is decoded
+	PatchBatch batches[2];
+	Concurrency::task_group writer;
+	for (size_t begin = 0, batchIndex = 0; begin < records.size(); begin += RECORDS_PER_BATCH, ++batchIndex)
+	{
+		const size_t end = std::min(begin + RECORDS_PER_BATCH, records.size());
+		PatchBatch *batch = &batches[batchIndex % 2];
+		extractBatch(directory, records, begin, end, extractors, *batch);
+		writer.wait();
+		writer.run([&, batch, begin]()
+		{
+			for (size_t i = 0; i < batch->succeeded.size(); ++i)
+			{
+				if (!batch->succeeded[i])
+					continue;
+				CHECK_EQ(file.write(batch->patches.data() + i * entrySize, offset, entrySize), entrySize);
+				offset += entrySize;
+				recordIndices.push_back(records[begin + i].index);
+			}
+		});
+	}
+	writer.wait();
+
+	const uint64_t recordIndicesSize = recordIndices.size() * sizeof(uint32_t);
+	CHECK_EQ(file.write((const unsigned char*)recordIndices.data(), offset, recordIndicesSize), recordIndicesSize);
+	header.numberOfEntries = (uint32_t)recordIndices.size();
+	CHECK_EQ(file.write((const unsigned char*)&header, 0, sizeof(header)), sizeof(header));
+
+	std::wcout << L"Extracted patches of " << recordIndices.size() << L" of " << records.size() << L" records into " << outputPath << std::endl;
+	return 0;
+}
@@ -0,0 +1,75 @@
+#include "commands.h"
+
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <memory>
+#include <string>
+
+#include <base/file.h>
+#include <base/logging.h>
+#include <base/memory_mapped_io.h>
+#include <box_propagator.h>
+#include <operation.h>
+
+// Carries the box of a labeled record forward over the unlabeled records following it, up to the
+// next labeled one. The proposals are written with labeled left false, the annotator confirms them.
+int propagateCommand(int argc, wchar_t *argv[])
+{
+	if (argc != 3 && argc != 4)
+	{
+		std::wcerr << L"Usage: dataset_tool propagate <sequence directory> <annotation .mat> <record> [minimum confidence]" << std::endl;
+		return 1;
+	}
+	const std::wstring directory = argv[0];
+	const size_t first = std::stoul(argv[2]);
+	const double minimumConfidence = argc == 4 ? std::stod(argv[3]) : 0.5;
+
+	AnnotationOperator annotationOperator(argv[1], AnnotationOperator::DesiredAccess::both, AnnotationOperator::CreationDisposition::open_always);
+	const size_t numberOfRecords = annotationOperator.getNumberOfRecords();
+	CHECK_LT(first, numberOfRecords);
+	int id, x, y, w, h;
+	bool labeled, occlusion, outOfView;
+	std::wstring path;
+	CHECK(annotationOperator.get(first, &id, &labeled, &x, &y, &w, &h, &occlusion, &outOfView, &path)) << "Record " << first;
+	CHECK(labeled && !outOfView) << "Record " << first << " has no box to start from";
+
+	BoxPropagator propagator;
+	std::unique_ptr<Base::MemoryMappedIO> frame(new Base::MemoryMappedIO(Base::appendPath(directory, path).c_str()));
+	size_t numberOfProposals = 0;
+	double elapsed_ms = 0;
+	for (size_t i = first + 1; i < numberOfRecords; ++i)
+	{
+		int nextId, nextX, nextY, nextW, nextH;
+		bool nextLabeled, nextOcclusion, nextOutOfView;
+		std::wstring nextPath;
+		CHECK(annotationOperator.get(i, &nextId, &nextLabeled, &nextX, &nextY, &nextW, &nextH, &nextOcclusion, &nextOutOfView, &nextPath)) << "Record " << i;
+		if (nextLabeled)
+			break;
+		std::unique_ptr<Base::MemoryMappedIO> nextFrame(new Base::MemoryMappedIO(Base::appendPath(directory, nextPath).c_str()));
+
+		const auto begin = std::chrono::steady_clock::now();
+		const PropagatedBox box = propagator.propagate(frame->getPtr(), (unsigned long)frame->getSize(),
+			nextFrame->getPtr(), (unsigned long)nextFrame->getSize(), x, y, w, h);
+		elapsed_ms += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+		// Lost, the annotator takes over from here
+		if (box.confidence < minimumConfidence)
+		{
+			std::wcout << L"Record " << i << L": confidence " << box.confidence << L" below " << minimumConfidence << L", stopped" << std::endl;
+			break;
+		}
+		x = (int)std::lround(box.x);
+		y = (int)std::lround(box.y);
+		w = (int)std::lround(box.w);
+		h = (int)std::lround(box.h);
+		annotationOperator.update(i, nextId, false, x, y, w, h, nextOcclusion, false, nextPath);
+		++numberOfProposals;
+		frame = std::move(nextFrame);
+	}
+
+	std::wcout << L"Proposed " << numberOfProposals << L" boxes";
+	if (numberOfProposals)
+		std::wcout << L", " << elapsed_ms / numberOfProposals << L" ms per frame";
+	std::wcout << std::endl;
+	return 0;
+}
@@ -0,0 +1,105 @@
+#include "commands.h"
+
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <base/file.h>
+#include <base/logging.h>
+#include <operation.h>
+#include <transformer.h>
+
+struct AnnotationRecord
+{
+	int id, x, y, w, h;
+	bool labeled, occlusion, outOfView;
+	std::wstring path;
+};
+
+static bool parseOperation(const std::wstring &name, JPEGTransformOperation *operation)
+{
+	static const wchar_t *names[] = { L"none", L"hflip", L"vflip", L"transpose", L"transverse", L"rot90", L"rot180", L"rot270" };
+	for (size_t i = 0; i < sizeof(names) / sizeof(*names); ++i)
+	{
+		if (name == names[i])
+		{
+			*operation = (JPEGTransformOperation)i;
+			return true;
+		}
+	}
+	return false;
+}
+
+// Rotates, flips and crops every frame of a sequence losslessly and writes an annotation file whose boxes
+// follow the frames. Boxes cut off entirely by trimming or cropping are marked out of view.
+int transformCommand(int argc, wchar_t *argv[])
+{
+	JPEGTransformOperation operation;
+	if ((argc != 5 && argc != 9) || !parseOperation(argv[4], &operation))
+	{
+		std::wcerr << L"Usage: dataset_tool transform <sequence directory> <annotation .mat> <output directory> <output annotation .mat> "
+			L"<none|hflip|vflip|transpose|transverse|rot90|rot180|rot270> [crop x y w h]" << std::endl;
+		return 1;
+	}
+	const std::wstring directory = argv[0];
+	const std::wstring outputDirectory = argv[2];
+	JPEGTransformer transformer(operation);
+	if (argc == 9)
+		transformer.setCrop(std::stoul(argv[5]), std::stoul(argv[6]), std::stoul(argv[7]), std::stoul(argv[8]));
+
+	std::vector<AnnotationRecord> records;
+	{
+		AnnotationOperator annotationOperator(argv[1], AnnotationOperator::DesiredAccess::read, AnnotationOperator::CreationDisposition::open_always);
+		records.resize(annotationOperator.getNumberOfRecords());
+		for (size_t i = 0; i < records.size(); ++i)
+		{
+			AnnotationRecord &record = records[i];
+			CHECK(annotationOperator.get(i, &record.id, &record.labeled, &record.x, &record.y, &record.w, &record.h,
+				&record.occlusion, &record.outOfView, &record.path)) << "Record " << i;
+		}
+	}
+
+	// Records may share a frame, each frame is transformed once
+	std::unordered_map<std::wstring, size_t> frameIndices;
+	std::vector<std::wstring> srcPaths, dstPaths;
+	for (const AnnotationRecord &record : records)
+	{
+		if (frameIndices.emplace(record.path, srcPaths.size()).second)
+		{
+			srcPaths.push_back(Base::appendPath(directory, record.path));
+			dstPaths.push_back(Base::appendPath(outputDirectory, record.path));
+		}
+	}
+	if (!Base::isPathExists(outputDirectory))
+		CHECK_WIN32API(CreateDirectory(outputDirectory.c_str(), nullptr));
+
+	const auto begin = std::chrono::steady_clock::now();
+	std::vector<JPEGTransformGeometry> geometries;
+	transformer.transformFiles(srcPaths, dstPaths, &geometries);
+	const double elapsed_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+
+	AnnotationOperator annotationOperator(argv[3], AnnotationOperator::DesiredAccess::write, AnnotationOperator::CreationDisposition::create_always);
+	annotationOperator.resize(records.size());
+	size_t numberOfLostBoxes = 0;
+	for (size_t i = 0; i < records.size(); ++i)
+	{
+		AnnotationRecord record = records[i];
+		// Unlabeled records may carry a proposal box from propagate, it moves with the frame as well
+		if (record.w > 0 && record.h > 0
+			&& !JPEGTransformer::transformBox(geometries[frameIndices[record.path]], &record.x, &record.y, &record.w, &record.h))
+		{
+			record.outOfView = true;
+			record.x = record.y = record.w = record.h = 0;
+			++numberOfLostBoxes;
+		}
+		annotationOperator.update(i, record.id, record.labeled, record.x, record.y, record.w, record.h, record.occlusion, record.outOfView, record.path);
+	}
+
+	std::wcout << L"Transformed " << srcPaths.size() << L" frames in " << elapsed_s << L" s";
+	if (numberOfLostBoxes)
+		std::wcout << L", " << numberOfLostBoxes << L" boxes left the frame";
+	std::wcout << std::endl;
+	return 0;
+}
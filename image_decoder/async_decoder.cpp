@@ -0,0 +1,232 @@
+#include "async_decoder.h"
+
+#include <algorithm>
+
+#include <base/logging.h>
+#include <base/memory_mapped_io.h>
+
+static AsyncDecodeStatus decodeRequest(std::unique_ptr<JPEGDecompressor> &decompressor, const AsyncDecodeRequest &request, unsigned *width, unsigned *height)
+{
+	std::unique_ptr<Base::MemoryMappedIO> file;
+	const unsigned char *src = request.src;
+	unsigned long size = request.srcSize;
+	if (!src)
+	{
+		try {
+			file.reset(new Base::MemoryMappedIO(request.path.c_str()));
+		}
+		catch (std::exception &)
+		{
+			LOG_WARN << "Async decode can not open " << request.path;
+			return AsyncDecodeStatus::fileOpenFailed;
+		}
+		src = file->getPtr();
+		size = (unsigned long)file->getSize();
+	}
+	try {
+		if (decompressor)
+			decompressor->reset(src, size);
+		else
+			decompressor.reset(new JPEGDecompressor(src, size));
+		decompressor->setFormat(request.format);
+		decompressor->setQuality(request.quality);
+		decompressor->setScalingFactor(1, request.scalingFactorDenominator);
+		*width = decompressor->getScaledWidth();
+		*height = decompressor->getScaledHeight();
+		if (decompressor->getSize() > request.dstCapacity)
+			return AsyncDecodeStatus::bufferTooSmall;
+		decompressor->process(request.dst);
+	}
+	catch (std::exception &)
+	{
+		// Already logged
+		return AsyncDecodeStatus::decodeFailed;
+	}
+	return AsyncDecodeStatus::ok;
+}
+
+AsyncDecoder::AsyncDecoder(unsigned numberOfThreads, unsigned maximumQueueDepth)
+	: _ownedScheduler(std::make_unique<Base::TaskScheduler>(numberOfThreads)), _scheduler(*_ownedScheduler),
+	_maximumQueueDepth(maximumQueueDepth), _nextTicket(1), _stopping(false), _jobs(_scheduler)
+{
+	CHECK_GT(maximumQueueDepth, 0U);
+}
+
+AsyncDecoder::AsyncDecoder(Base::TaskScheduler& scheduler, unsigned maximumQueueDepth)
+	: _scheduler(scheduler), _maximumQueueDepth(maximumQueueDepth), _nextTicket(1), _stopping(false), _jobs(_scheduler)
+{
+	CHECK_GT(maximumQueueDepth, 0U);
+}
+
+AsyncDecoder::~AsyncDecoder()
+{
+	// Jobs already decoding complete normally, _jobs waits for them
+	stop();
+}
+
+uint64_t AsyncDecoder::submit(const AsyncDecodeRequest& request)
+{
+	return enqueue(request, true);
+}
+
+uint64_t AsyncDecoder::trySubmit(const AsyncDecodeRequest& request)
+{
+	return enqueue(request, false);
+}
+
+uint64_t AsyncDecoder::enqueue(const AsyncDecodeRequest& request, bool block)
+{
+	CHECK(request.dst);
+	CHECK(request.src || !request.path.empty());
+	getPixelSize(request.format);
+	CHECK(JPEGDecompressor::isScalingFactorSupported(1, request.scalingFactorDenominator)) << "Scaling factor: 1/" << request.scalingFactorDenominator;
+
+	uint64_t ticket;
+	{
+		std::unique_lock<std::mutex> lock(_lock);
+		if (block)
+			_notFull.wait(lock, [this]() { return _queue.size() < _maximumQueueDepth || _stopping; });
+		else if (_queue.size() >= _maximumQueueDepth)
+			return 0;
+		CHECK(!_stopping);
+		ticket = _nextTicket++;
+		_queue.push_back(Job{ ticket, request });
+		if (!request.callback)
+			_results[ticket] = Result{ AsyncDecodeStatus::pending, 0, 0 };
+	}
+	_jobs.run([this]() { runJob(); });
+	return ticket;
+}
+
+void AsyncDecoder::runJob()
+{
+	Job job;
+	if (!tryDequeue(&job))
+		return;
+	std::unique_ptr<JPEGDecompressor> decompressor;
+	{
+		std::lock_guard<std::mutex> lock_guard(_lock);
+		if (!_decompressors.empty())
+		{
+			decompressor = std::move(_decompressors.back());
+			_decompressors.pop_back();
+		}
+	}
+	unsigned width = 0, height = 0;
+	const AsyncDecodeStatus status = decodeRequest(decompressor, job.request, &width, &height);
+	if (decompressor)
+	{
+		std::lock_guard<std::mutex> lock_guard(_lock);
+		_decompressors.push_back(std::move(decompressor));
+	}
+	complete(job, status, width, height);
+}
+
+bool AsyncDecoder::tryDequeue(Job* job)
+{
+	{
+		std::lock_guard<std::mutex> lock_guard(_lock);
+		if (_stopping || _queue.empty())
+			return false;
+		*job = std::move(_queue.front());
+		_queue.pop_front();
+	}
+	_notFull.notify_one();
+	return true;
+}
+
+void AsyncDecoder::complete(const Job& job, AsyncDecodeStatus status, unsigned width, unsigned height)
+{
+	if (job.request.callback)
+	{
+		try {
+			job.request.callback(job.ticket, status, width, height);
+		}
+		catch (std::exception &exp)
+		{
+			LOG_ERROR << "Async decode callback of ticket " << job.ticket << " threw: " << exp.what();
+		}
+		return;
+	}
+	{
+		std::lock_guard<std::mutex> lock_guard(_lock);
+		_results[job.ticket] = Result{ status, width, height };
+	}
+	_completed.notify_all();
+}
+
+AsyncDecodeStatus AsyncDecoder::poll(uint64_t ticket, unsigned* width, unsigned* height)
+{
+	std::lock_guard<std::mutex> lock_guard(_lock);
+	auto iterator = _results.find(ticket);
+	CHECK(iterator != _results.end()) << "Unknown ticket " << ticket;
+	const Result result = iterator->second;
+	if (result.status == AsyncDecodeStatus::pending)
+		return result.status;
+	_results.erase(iterator);
+	*width = result.width;
+	*height = result.height;
+	return result.status;
+}
+
+AsyncDecodeStatus AsyncDecoder::wait(uint64_t ticket, uint32_t timeout_ms, unsigned* width, unsigned* height)
+{
+	std::unique_lock<std::mutex> lock(_lock);
+	auto iterator = _results.find(ticket);
+	CHECK(iterator != _results.end()) << "Unknown ticket " << ticket;
+	// Rehashing invalidates iterators, the entry is looked up again after every wakeup
+	_completed.wait_for(lock, std::chrono::milliseconds(timeout_ms), [&]()
+	{
+		iterator = _results.find(ticket);
+		return iterator == _results.end() || iterator->second.status != AsyncDecodeStatus::pending;
+	});
+	CHECK(iterator != _results.end()) << "Ticket " << ticket << " was handed out to another thread";
+	const Result result = iterator->second;
+	if (result.status == AsyncDecodeStatus::pending)
+		return result.status;
+	_results.erase(iterator);
+	*width = result.width;
+	*height = result.height;
+	return result.status;
+}
+
+bool AsyncDecoder::cancel(uint64_t ticket)
+{
+	Job job;
+	{
+		std::lock_guard<std::mutex> lock_guard(_lock);
+		auto iterator = std::find_if(_queue.begin(), _queue.end(), [ticket](const Job &queued) { return queued.ticket == ticket; });
+		if (iterator == _queue.end())
+			return false;
+		job = std::move(*iterator);
+		_queue.erase(iterator);
+	}
+	_notFull.notify_one();
+	complete(job, AsyncDecodeStatus::canceled, 0, 0);
+	return true;
+}
+
+unsigned AsyncDecoder::getNumberOfThreads() const noexcept
+{
+	return _scheduler.getNumberOfWorkers();
+}
+
+unsigned AsyncDecoder::getMaximumQueueDepth() const noexcept
+{
+	return _maximumQueueDepth;
+}
+
+void AsyncDecoder::stop()
+{
+	std::deque<Job> canceled;
+	{
+		std::lock_guard<std::mutex> lock_guard(_lock);
+		if (_stopping)
+			return;
+		_stopping = true;
+		canceled.swap(_queue);
+	}
+	_notFull.notify_all();
+	for (const Job &job : canceled)
+		complete(job, AsyncDecodeStatus::canceled, 0, 0);
+}
@@ -0,0 +1,116 @@
+#include "batch_decoder.h"
+
+#include <atomic>
+#include <cstring>
+#include <limits>
+#include <ppl.h>
+
+#include <base/logging.h>
+#include <base/memory_mapped_io.h>
+
+// combinable copies its elements, hence shared_ptr
+struct BatchDecoder::WorkerContext
+{
+	std::shared_ptr<JPEGDecompressor> decompressor;
+};
+
+struct BatchDecoder::WorkerContexts
+{
+	Concurrency::combinable<WorkerContext> contexts;
+};
+
+BatchDecoder::BatchDecoder(unsigned width, unsigned height, PixelFormat format)
+	: _width(width), _height(height), _format(format), _quality(DecodeQuality::full),
+	_scalingFactorNumerator(1), _scalingFactorDenominator(1), _workerContexts(std::make_unique<WorkerContexts>())
+{
+	CHECK_GT(width, 0U);
+	CHECK_GT(height, 0U);
+	_slotSize = size_t(width) * height * getPixelSize(format);
+}
+
+BatchDecoder::~BatchDecoder() = default;
+
+void BatchDecoder::setQuality(DecodeQuality quality) noexcept
+{
+	_quality = quality;
+}
+
+void BatchDecoder::setScalingFactor(unsigned numerator, unsigned denominator)
+{
+	CHECK(JPEGDecompressor::isScalingFactorSupported(numerator, denominator)) << "Unsupported scaling factor: " << numerator << '/' << denominator;
+	_scalingFactorNumerator = numerator;
+	_scalingFactorDenominator = denominator;
+}
+
+size_t BatchDecoder::getSlotSize() const noexcept
+{
+	return _slotSize;
+}
+
+unsigned BatchDecoder::decode(const unsigned char * const *srcs, const unsigned long *sizes, unsigned n, unsigned char *dst, BatchSlotStatus *statuses)
+{
+	std::atomic<unsigned> numberOfFailedSlots(0);
+	Concurrency::parallel_for(0U, n, [&](unsigned i)
+	{
+		const BatchSlotStatus status = decodeSlot(_workerContexts->contexts.local(), srcs[i], sizes[i], dst + i * _slotSize);
+		if (statuses)
+			statuses[i] = status;
+		if (status != BatchSlotStatus::ok)
+			++numberOfFailedSlots;
+	});
+	return numberOfFailedSlots;
+}
+
+unsigned BatchDecoder::decode(const wchar_t * const *paths, unsigned n, unsigned char *dst, BatchSlotStatus *statuses)
+{
+	std::atomic<unsigned> numberOfFailedSlots(0);
+	Concurrency::parallel_for(0U, n, [&](unsigned i)
+	{
+		unsigned char *slot = dst + i * _slotSize;
+		BatchSlotStatus status;
+		try {
+			Base::MemoryMappedIO file(paths[i]);
+			const uint64_t size = file.getSize();
+			CHECK_LE(size, (uint64_t)std::numeric_limits<unsigned long>::max());
+			status = decodeSlot(_workerContexts->contexts.local(), file.getPtr(), (unsigned long)size, slot);
+		}
+		catch (std::exception &)
+		{
+			memset(slot, 0, _slotSize);
+			status = BatchSlotStatus::fileOpenFailed;
+		}
+		if (status != BatchSlotStatus::ok)
+			LOG_WARN << "Batch slot " << i << " of " << paths[i] << " failed with status " << int(status);
+		if (statuses)
+			statuses[i] = status;
+		if (status != BatchSlotStatus::ok)
+			++numberOfFailedSlots;
+	});
+	return numberOfFailedSlots;
+}
+
+BatchSlotStatus BatchDecoder::decodeSlot(WorkerContext &context, const unsigned char *src, unsigned long size, unsigned char *dst)
+{
+	try {
+		if (context.decompressor)
+			context.decompressor->reset(src, size);
+		else
+			context.decompressor = std::make_shared<JPEGDecompressor>(src, size);
+		JPEGDecompressor &decompressor = *context.decompressor;
+		decompressor.setFormat(_format);
+		decompressor.setQuality(_quality);
+		decompressor.setScalingFactor(_scalingFactorNumerator, _scalingFactorDenominator);
+		if (decompressor.getScaledWidth() != _width || decompressor.getScaledHeight() != _height)
+		{
+			memset(dst, 0, _slotSize);
+			return BatchSlotStatus::sizeMismatch;
+		}
+		decompressor.process(dst);
+		return BatchSlotStatus::ok;
+	}
+	catch (std::exception &)
+	{
+		memset(dst, 0, _slotSize);
+		return BatchSlotStatus::decodeFailed;
+	}
+}
@@ -0,0 +1,258 @@
+#include "box_propagator.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include <base/logging.h>
+
+#include <emmintrin.h>
+#include <immintrin.h>
+
+#include "resampler.h"
+
+// The object may shrink or grow by this much between two frames
+static const double SCALES[] = { 1 / 1.05, 1., 1.05 };
+// Matches at another scale have to beat the unscaled one by this factor, keeps the size from drifting on flat scores
+static const double SCALE_CHANGE_PENALTY = 0.99;
+
+// Sum of a[i] * b[i], exact in 32 bit as long as size is below 2^15
+static uint32_t dotProductScalar(const unsigned char *a, const unsigned char *b, unsigned begin, unsigned size)
+{
+	uint32_t sum = 0;
+	for (unsigned i = begin; i < size; ++i)
+		sum += uint32_t(a[i]) * b[i];
+	return sum;
+}
+
+static uint32_t dotProductSSE2(const unsigned char *a, const unsigned char *b, unsigned size)
+{
+	const __m128i zero = _mm_setzero_si128();
+	__m128i sum = _mm_setzero_si128();
+	unsigned i = 0;
+	for (; i + 16 <= size; i += 16)
+	{
+		const __m128i va = _mm_loadu_si128((const __m128i*)(a + i));
+		const __m128i vb = _mm_loadu_si128((const __m128i*)(b + i));
+		sum = _mm_add_epi32(sum, _mm_madd_epi16(_mm_unpacklo_epi8(va, zero), _mm_unpacklo_epi8(vb, zero)));
+		sum = _mm_add_epi32(sum, _mm_madd_epi16(_mm_unpackhi_epi8(va, zero), _mm_unpackhi_epi8(vb, zero)));
+	}
+	sum = _mm_add_epi32(sum, _mm_srli_si128(sum, 8));
+	sum = _mm_add_epi32(sum, _mm_srli_si128(sum, 4));
+	return (uint32_t)_mm_cvtsi128_si32(sum) + dotProductScalar(a, b, i, size);
+}
+
+static uint32_t dotProductAVX2(const unsigned char *a, const unsigned char *b, unsigned size)
+{
+	__m256i sum = _mm256_setzero_si256();
+	unsigned i = 0;
+	for (; i + 16 <= size; i += 16)
+	{
+		const __m256i va = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*)(a + i)));
+		const __m256i vb = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*)(b + i)));
+		sum = _mm256_add_epi32(sum, _mm256_madd_epi16(va, vb));
+	}
+	__m128i sum128 = _mm_add_epi32(_mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1));
+	sum128 = _mm_add_epi32(sum128, _mm_srli_si128(sum128, 8));
+	sum128 = _mm_add_epi32(sum128, _mm_srli_si128(sum128, 4));
+	return (uint32_t)_mm_cvtsi128_si32(sum128) + dotProductScalar(a, b, i, size);
+}
+
+static uint32_t dotProductNone(const unsigned char *a, const unsigned char *b, unsigned size)
+{
+	return dotProductScalar(a, b, 0, size);
+}
+
+typedef uint32_t(*DotProductKernel)(const unsigned char *, const unsigned char *, unsigned);
+
+static DotProductKernel selectDotProductKernel(SIMDInstructionSet instructionSet)
+{
+	switch (instructionSet)
+	{
+	case SIMDInstructionSet::none:
+		return dotProductNone;
+	case SIMDInstructionSet::sse2:
+		return dotProductSSE2;
+	case SIMDInstructionSet::avx2:
+		return dotProductAVX2;
+	default:
+		UNREACHABLE_ERROR;
+	}
+}
+
+// Offset of the peak of the parabola through (-1, left), (0, center), (1, right)
+static double refinePeak(double left, double center, double right)
+{
+	const double curvature = left - 2 * center + right;
+	if (curvature >= 0)
+		return 0;
+	return std::min(std::max((left - right) / (2 * curvature), -0.5), 0.5);
+}
+
+BoxPropagator::BoxPropagator(double searchAreaFactor, unsigned templateSize, SIMDInstructionSet instructionSet)
+	: _searchAreaFactor(searchAreaFactor), _templateSize(templateSize), _instructionSet(instructionSet),
+	_denominator(1), _regionX(0), _regionY(0), _regionWidth(0), _regionHeight(0)
+{
+	CHECK_GE(searchAreaFactor, 1.);
+	// Keeps the correlation sums of a template within 32 bit
+	CHECK(templateSize && templateSize <= 128) << "Template size: " << templateSize;
+	_decompressor.setFormat(PixelFormat::GRAY);
+}
+
+void BoxPropagator::decode(unsigned denominator, double x0, double y0, double x1, double y1)
+{
+	_decompressor.setScalingFactor(1, denominator);
+	const unsigned scaledWidth = _decompressor.getScaledWidth();
+	const unsigned scaledHeight = _decompressor.getScaledHeight();
+	// One more pixel on each side for the bilinear taps
+	_regionX = (unsigned)std::min(std::max(std::floor(x0 / denominator) - 1, 0.), double(scaledWidth - 1));
+	_regionY = (unsigned)std::min(std::max(std::floor(y0 / denominator) - 1, 0.), double(scaledHeight - 1));
+	_regionWidth = (unsigned)std::min(std::max(std::ceil(x1 / denominator) + 1, double(_regionX + 1)), double(scaledWidth)) - _regionX;
+	_regionHeight = (unsigned)std::min(std::max(std::ceil(y1 / denominator) + 1, double(_regionY + 1)), double(scaledHeight)) - _regionY;
+	_denominator = denominator;
+	_region.resize(size_t(_regionWidth) * _regionHeight);
+	_decompressor.process(_regionX, _regionY, _regionWidth, _regionHeight, _region.data());
+}
+
+void BoxPropagator::sample(double x, double y, double w, double h, unsigned width, unsigned height, std::vector<unsigned char>& dst)
+{
+	dst.resize(size_t(width) * height);
+	resizeBilinear(_region.data(), _regionWidth, _regionHeight, 0, 1,
+		x / _denominator - _regionX, y / _denominator - _regionY, w / _denominator, h / _denominator,
+		dst.data(), width, height, 0, _instructionSet);
+}
+
+PropagatedBox BoxPropagator::propagate(const unsigned char* frame, unsigned long frameSize, const unsigned char* nextFrame, unsigned long nextFrameSize,
+	double x, double y, double w, double h)
+{
+	CHECK(w > 0 && h > 0) << "Box: " << x << ',' << y << ',' << w << ',' << h;
+	_decompressor.reset(frame, frameSize);
+	const unsigned width = _decompressor.getWidth();
+	const unsigned height = _decompressor.getHeight();
+
+	// The part of the box within the frame is the template
+	const double boxX0 = std::max(x, 0.), boxY0 = std::max(y, 0.);
+	const double boxX1 = std::min(x + w, double(width)), boxY1 = std::min(y + h, double(height));
+	CHECK(boxX1 > boxX0 && boxY1 > boxY0) << "Box out of frame: " << x << ',' << y << ',' << w << ',' << h;
+	const double boxWidth = boxX1 - boxX0, boxHeight = boxY1 - boxY0;
+	const double ratio = std::min(_templateSize / std::sqrt(boxWidth * boxHeight), 1.);
+	const unsigned templateWidth = std::max((unsigned)std::lround(boxWidth * ratio), 1u);
+	const unsigned templateHeight = std::max((unsigned)std::lround(boxHeight * ratio), 1u);
+	// Template pixels per frame pixel
+	const double ratioX = templateWidth / boxWidth, ratioY = templateHeight / boxHeight;
+	unsigned denominator = 8;
+	while (denominator > 1 && denominator * std::max(ratioX, ratioY) > 1)
+		denominator /= 2;
+
+	decode(denominator, boxX0, boxY0, boxX1, boxY1);
+	sample(boxX0, boxY0, boxWidth, boxHeight, templateWidth, templateHeight, _template);
+
+	const PropagatedBox unchanged = { x, y, w, h, 0 };
+	const unsigned numberOfPixels = templateWidth * templateHeight;
+	uint64_t templateSum = 0, templateSquaredSum = 0;
+	for (unsigned char value : _template)
+	{
+		templateSum += value;
+		templateSquaredSum += uint32_t(value) * value;
+	}
+	const double templateMean = double(templateSum) / numberOfPixels;
+	const double templateVariance = templateSquaredSum - double(templateSum) * templateSum / numberOfPixels;
+	// Nothing to match on a flat template
+	if (templateVariance < 1.)
+		return unchanged;
+
+	_decompressor.reset(nextFrame, nextFrameSize);
+	CHECK(_decompressor.getWidth() == width && _decompressor.getHeight() == height)
+		<< "Frame sizes differ: " << width << 'x' << height << ", " << _decompressor.getWidth() << 'x' << _decompressor.getHeight();
+	const double centerX = (boxX0 + boxX1) / 2, centerY = (boxY0 + boxY1) / 2;
+	auto getSearchWindow = [&](double scale, double *x0, double *y0, double *x1, double *y1)
+	{
+		const double halfWidth = boxWidth * _searchAreaFactor * scale / 2, halfHeight = boxHeight * _searchAreaFactor * scale / 2;
+		*x0 = std::max(centerX - halfWidth, 0.);
+		*y0 = std::max(centerY - halfHeight, 0.);
+		*x1 = std::min(centerX + halfWidth, double(width));
+		*y1 = std::min(centerY + halfHeight, double(height));
+	};
+	{
+		double x0, y0, x1, y1;
+		getSearchWindow(SCALES[sizeof(SCALES) / sizeof(SCALES[0]) - 1], &x0, &y0, &x1, &y1);
+		decode(denominator, x0, y0, x1, y1);
+	}
+
+	const DotProductKernel dotProduct = selectDotProductKernel(_instructionSet);
+	PropagatedBox best = unchanged;
+	double bestScore = -HUGE_VAL;
+	for (double scale : SCALES)
+	{
+		double x0, y0, x1, y1;
+		getSearchWindow(scale, &x0, &y0, &x1, &y1);
+		// The box appears template sized when the next frame is sampled at ratio / scale
+		const unsigned searchWidth = (unsigned)std::lround((x1 - x0) * ratioX / scale);
+		const unsigned searchHeight = (unsigned)std::lround((y1 - y0) * ratioY / scale);
+		if (searchWidth < templateWidth || searchHeight < templateHeight)
+			continue;
+		sample(x0, y0, x1 - x0, y1 - y0, searchWidth, searchHeight, _search);
+
+		// Integral images of the search window and its square for the window means and variances
+		const unsigned integralStride = searchWidth + 1;
+		_integral.assign(size_t(integralStride) * (searchHeight + 1), 0);
+		_squaredIntegral.assign(_integral.size(), 0);
+		for (unsigned row = 0; row < searchHeight; ++row)
+		{
+			uint32_t rowSum = 0;
+			uint64_t rowSquaredSum = 0;
+			for (unsigned column = 0; column < searchWidth; ++column)
+			{
+				const uint32_t value = _search[row * searchWidth + column];
+				rowSum += value;
+				rowSquaredSum += value * value;
+				const size_t index = (row + 1) * integralStride + column + 1;
+				_integral[index] = _integral[index - integralStride] + rowSum;
+				_squaredIntegral[index] = _squaredIntegral[index - integralStride] + rowSquaredSum;
+			}
+		}
+
+		const unsigned numberOfColumns = searchWidth - templateWidth + 1, numberOfRows = searchHeight - templateHeight + 1;
+		_scores.resize(size_t(numberOfColumns) * numberOfRows);
+		unsigned bestColumn = 0, bestRow = 0;
+		for (unsigned row = 0; row < numberOfRows; ++row)
+		{
+			for (unsigned column = 0; column < numberOfColumns; ++column)
+			{
+				uint32_t correlation = 0;
+				for (unsigned i = 0; i < templateHeight; ++i)
+					correlation += dotProduct(_template.data() + i * templateWidth, _search.data() + (row + i) * searchWidth + column, templateWidth);
+				const size_t topLeft = row * integralStride + column, bottomLeft = (row + templateHeight) * integralStride + column;
+				const double sum = double(_integral[bottomLeft + templateWidth] - _integral[bottomLeft] - _integral[topLeft + templateWidth] + _integral[topLeft]);
+				const double squaredSum = double(_squaredIntegral[bottomLeft + templateWidth] - _squaredIntegral[bottomLeft] - _squaredIntegral[topLeft + templateWidth] + _squaredIntegral[topLeft]);
+				const double variance = squaredSum - sum * sum / numberOfPixels;
+				float &score = _scores[row * numberOfColumns + column];
+				score = variance < 1. ? 0.f : float((correlation - templateMean * sum) / std::sqrt(templateVariance * variance));
+				if (score > _scores[bestRow * numberOfColumns + bestColumn])
+				{
+					bestColumn = column;
+					bestRow = row;
+				}
+			}
+		}
+
+		const double score = _scores[bestRow * numberOfColumns + bestColumn];
+		if ((scale == 1. ? score : score * SCALE_CHANGE_PENALTY) <= bestScore)
+			continue;
+		bestScore = scale == 1. ? score : score * SCALE_CHANGE_PENALTY;
+
+		double column = bestColumn, row = bestRow;
+		if (bestColumn > 0 && bestColumn + 1 < numberOfColumns)
+			column += refinePeak(_scores[bestRow * numberOfColumns + bestColumn - 1], score, _scores[bestRow * numberOfColumns + bestColumn + 1]);
+		if (bestRow > 0 && bestRow + 1 < numberOfRows)
+			row += refinePeak(_scores[(bestRow - 1) * numberOfColumns + bestColumn], score, _scores[(bestRow + 1) * numberOfColumns + bestColumn]);
+		// Back to frame pixels, the part of the box outside of the frame moves and scales along
+		const double matchCenterX = x0 + (column + templateWidth / 2.) * (x1 - x0) / searchWidth;
+		const double matchCenterY = y0 + (row + templateHeight / 2.) * (y1 - y0) / searchHeight;
+		best.w = w * scale;
+		best.h = h * scale;
+		best.x = matchCenterX + (x + w / 2 - centerX) * scale - best.w / 2;
+		best.y = matchCenterY + (y + h / 2 - centerY) * scale - best.h / 2;
+		best.confidence = score;
+	}
+	return best;
+}
@@ -0,0 +1,63 @@
+#include "cpu_features.h"
+
+#include <intrin.h>
+
+struct CPUFeatureFlags
+{
+	CPUFeatureFlags()
+		: sse2(false), sse42(false), avx2(false)
+	{
+		int info[4];
+		__cpuid(info, 0);
+		const int maxLeaf = info[0];
+
+		__cpuid(info, 1);
+		sse2 = (info[3] & (1 << 26)) != 0;
+		sse42 = (info[2] & (1 << 20)) != 0;
+		const bool osxsave = (info[2] & (1 << 27)) != 0;
+		const bool avx = (info[2] & (1 << 28)) != 0;
+
+		if (maxLeaf >= 7 && osxsave && avx)
+		{
+			// XMM and YMM state must be enabled by the OS
+			if ((_xgetbv(0) & 0x6) == 0x6)
+			{
+				__cpuidex(info, 7, 0);
+				avx2 = (info[1] & (1 << 5)) != 0;
+			}
+		}
+	}
+	bool sse2;
+	bool sse42;
+	bool avx2;
+};
+
+static const CPUFeatureFlags &getCPUFeatureFlags()
+{
+	static const CPUFeatureFlags flags;
+	return flags;
+}
+
+bool isSSE2Supported()
+{
+	return getCPUFeatureFlags().sse2;
+}
+
+bool isSSE42Supported()
+{
+	return getCPUFeatureFlags().sse42;
+}
+
+bool isAVX2Supported()
+{
+	return getCPUFeatureFlags().avx2;
+}
+
+SIMDInstructionSet getBestSupportedInstructionSet()
+{
+	if (isAVX2Supported())
+		return SIMDInstructionSet::avx2;
+	if (isSSE2Supported())
+		return SIMDInstructionSet::sse2;
+	return SIMDInstructionSet::none;
+}
@@ -13,20 +13,35 @@ Base::RuntimeExceptionLogging(Base::ErrorCodeType::USERDEFINED, GetLastError(),
 
 #define CHECK_EQ_TURBOJPEG(exp1, exp2) \
 	CHECK_OP_TURBOJPEG(exp1, exp2, ==, std::equal_to<>())
+#define CHECK_GT_TURBOJPEG(exp1, exp2) \
+	CHECK_OP_TURBOJPEG(exp1, exp2, >, std::greater<>())
+
+unsigned getPixelSize(PixelFormat format)
+{
+	switch (format)
+	{
+	case PixelFormat::RGB:
+	case PixelFormat::BGR:
+		return 3;
+	case PixelFormat::RGBA:
+	case PixelFormat::BGRA:
+	case PixelFormat::ABGR:
+	case PixelFormat::ARGB:
+		return 4;
+	case PixelFormat::GRAY:
+		return 1;
+	default:
+		UNREACHABLE_ERROR;
+	}
+}
 
 JPEGDecompressor::JPEGDecompressor(const unsigned char *src, unsigned long srcSize)
-	: _src(src), _srcSize(srcSize), _format(TJPF_RGB)
+	: _src(src), _srcSize(srcSize), _format(TJPF_RGB), _flags(TJFLAG_NOREALLOC), _scalingFactor{ 1, 1 }
 {
 	_tjhandle = tjInitDecompress();
 	CHECK_TURBOJPEG(_tjhandle);
-	int width, height;
 	try {
-		int subsample, colorspace;
-		CHECK_EQ_TURBOJPEG(tjDecompressHeader3(_tjhandle, _src, _srcSize, &width, &height, &subsample, &colorspace), 0);
-		CHECK_GT(width, 0);
-		_width = width;
-		CHECK_GT(height, 0);
-		_height = height;
+		parseHeader();
 	} catch (std::exception &)
 	{
 		tjDestroy(_tjhandle);
@@ -39,14 +54,38 @@ JPEGDecompressor::~JPEGDecompressor()
 	tjDestroy(_tjhandle);
 }
 
+void JPEGDecompressor::reset(const unsigned char* src, unsigned long size)
+{
+	_src = src;
+	_srcSize = size;
+	parseHeader();
+}
+
+void JPEGDecompressor::parseHeader()
+{
+	int width, height;
+	CHECK_EQ_TURBOJPEG(tjDecompressHeader3(_tjhandle, _src, _srcSize, &width, &height, &_subsampling, &_colorspace), 0);
+	CHECK_GT(width, 0);
+	_width = width;
+	CHECK_GT(height, 0);
+	_height = height;
+}
+
 void JPEGDecompressor::process(unsigned char* dst)
 {
-	CHECK_EQ_TURBOJPEG(tjDecompress2(_tjhandle, _src, _srcSize, dst, 0, 0, 0, _format, TJFLAG_NOREALLOC), 0);
+	CHECK_EQ_TURBOJPEG(tjDecompress2(_tjhandle, _src, _srcSize, dst, getScaledWidth(), 0, getScaledHeight(), _format, _flags), 0);
+}
+
+Base::BufferLease JPEGDecompressor::process(Base::BufferPool& pool)
+{
+	Base::BufferLease image = pool.acquire(getSize());
+	process(image.get());
+	return image;
 }
 
 unsigned JPEGDecompressor::getSize() const noexcept
 {
-	return _width * _height * tjPixelSize[_format];
+	return getScaledWidth() * getScaledHeight() * tjPixelSize[_format];
 }
 
 unsigned JPEGDecompressor::getWidth() const noexcept
@@ -118,3 +157,107 @@ PixelFormat JPEGDecompressor::getFormat() const
 		UNREACHABLE_ERROR;
 	}
 }
+
+Subsampling JPEGDecompressor::getSubsampling() const noexcept
+{
+	return Subsampling(_subsampling);
+}
+
+unsigned JPEGDecompressor::getNumberOfPlanes() const noexcept
+{
+	return _subsampling == TJSAMP_GRAY ? 1 : 3;
+}
+
+unsigned JPEGDecompressor::getPlaneWidth(unsigned component) const
+{
+	CHECK_LT(component, getNumberOfPlanes());
+	const int width = tjPlaneWidth(component, getScaledWidth(), _subsampling);
+	CHECK_GT_TURBOJPEG(width, 0);
+	return width;
+}
+
+unsigned JPEGDecompressor::getPlaneHeight(unsigned component) const
+{
+	CHECK_LT(component, getNumberOfPlanes());
+	const int height = tjPlaneHeight(component, getScaledHeight(), _subsampling);
+	CHECK_GT_TURBOJPEG(height, 0);
+	return height;
+}
+
+unsigned JPEGDecompressor::getPlaneSize(unsigned component) const
+{
+	return getPlaneWidth(component) * getPlaneHeight(component);
+}
+
+bool JPEGDecompressor::isYUVDecodingSupported() const noexcept
+{
+	// YUV output only makes sense for YCbCr and grayscale JPEGs, RGB/CMYK/YCCK images can not be represented
+	return _colorspace == TJCS_YCbCr || _colorspace == TJCS_GRAY;
+}
+
+void JPEGDecompressor::processYUVPlanes(unsigned char** planes, const int* strides)
+{
+	CHECK(isYUVDecodingSupported()) << "JPEG colorspace: " << _colorspace;
+	int strides_[3] = { 0, 0, 0 };
+	if (strides)
+	{
+		for (unsigned i = 0; i < getNumberOfPlanes(); ++i)
+			strides_[i] = strides[i];
+	}
+	CHECK_EQ_TURBOJPEG(tjDecompressToYUVPlanes(_tjhandle, _src, _srcSize, planes, getScaledWidth(), strides_, getScaledHeight(), _flags), 0);
+}
+
+void JPEGDecompressor::processLuma(unsigned char* dst)
+{
+	// For YCbCr sources libjpeg-turbo copies the Y component straight through
+	// and does not run the IDCT for the chroma components at all.
+	CHECK(isYUVDecodingSupported()) << "JPEG colorspace: " << _colorspace;
+	CHECK_EQ_TURBOJPEG(tjDecompress2(_tjhandle, _src, _srcSize, dst, getScaledWidth(), 0, getScaledHeight(), TJPF_GRAY, _flags), 0);
+}
+
+void JPEGDecompressor::setQuality(DecodeQuality quality) noexcept
+{
+	if (quality == DecodeQuality::preview)
+		_flags = TJFLAG_NOREALLOC | TJFLAG_FASTDCT | TJFLAG_FASTUPSAMPLE;
+	else
+		_flags = TJFLAG_NOREALLOC;
+}
+
+DecodeQuality JPEGDecompressor::getQuality() const noexcept
+{
+	return (_flags & TJFLAG_FASTDCT) ? DecodeQuality::preview : DecodeQuality::full;
+}
+
+void JPEGDecompressor::setScalingFactor(unsigned numerator, unsigned denominator)
+{
+	CHECK(isScalingFactorSupported(numerator, denominator)) << "Unsupported scaling factor: " << numerator << '/' << denominator;
+	_scalingFactor.num = numerator;
+	_scalingFactor.denom = denominator;
+}
+
+bool JPEGDecompressor::isScalingFactorSupported(unsigned numerator, unsigned denominator)
+{
+	// 0/0 would match every entry of the cross multiplied check below
+	if (!numerator || !denominator)
+		return false;
+	int numberOfScalingFactors;
+	const tjscalingfactor *scalingFactors = tjGetScalingFactors(&numberOfScalingFactors);
+	CHECK_TURBOJPEG(scalingFactors);
+	for (int i = 0; i < numberOfScalingFactors; ++i)
+	{
+		// The list is not reduced, 2/4 is not there while 1/2 is
+		if ((unsigned)scalingFactors[i].num * denominator == numerator * (unsigned)scalingFactors[i].denom)
+			return true;
+	}
+	return false;
+}
+
+unsigned JPEGDecompressor::getScaledWidth() const noexcept
+{
+	return TJSCALED(_width, _scalingFactor);
+}
+
+unsigned JPEGDecompressor::getScaledHeight() const noexcept
+{
+	return TJSCALED(_height, _scalingFactor);
+}
@@ -0,0 +1,127 @@
+#include "file_decoder.h"
+
+#include <algorithm>
+#include <climits>
+
+#include <base/file.h>
+#include <base/logging.h>
+#include <base/utils.h>
+
+JPEGFileDecoder::JPEGFileDecoder(unsigned maximumPrefetchedFrames)
+	: _maximumPrefetchedFrames(maximumPrefetchedFrames), _current(std::make_shared<std::vector<unsigned char>>())
+{
+}
+
+JPEGFileDecoder::~JPEGFileDecoder()
+{
+	_prefetchTasks.wait();
+}
+
+JPEGDecompressor& JPEGFileDecoder::open(const std::wstring& path)
+{
+	auto iterator = std::find_if(_prefetched.begin(), _prefetched.end(), [&path](const PrefetchedFrame &frame) { return frame.path == path; });
+	if (iterator != _prefetched.end())
+	{
+		PrefetchedFrame frame = std::move(*iterator);
+		_prefetched.erase(iterator);
+		bool succeeded = true;
+		try {
+			frame.read.get();
+		}
+		catch (std::exception &)
+		{
+			// Read again below to report the error to the caller
+			LOG_DEBUG << "Prefetch of " << path << " failed";
+			succeeded = false;
+		}
+		if (succeeded)
+		{
+			recycleBuffer(std::move(_current));
+			_current = std::move(frame.buffer);
+		}
+		else
+		{
+			recycleBuffer(std::move(frame.buffer));
+			readFile(path, *_current);
+		}
+	}
+	else
+		readFile(path, *_current);
+
+	const unsigned char *src = _current->data();
+	const unsigned long size = (unsigned long)_current->size();
+	if (_decompressor)
+		_decompressor->reset(src, size);
+	else
+		_decompressor.reset(new JPEGDecompressor(src, size));
+	return *_decompressor;
+}
+
+void JPEGFileDecoder::prefetch(const std::wstring& path)
+{
+	if (!_maximumPrefetchedFrames)
+		return;
+	for (const PrefetchedFrame &frame : _prefetched)
+	{
+		if (frame.path == path)
+			return;
+	}
+	// A frame pushed out while it is still being read keeps its buffer alive through the task
+	if (_prefetched.size() >= _maximumPrefetchedFrames)
+		_prefetched.pop_front();
+
+	Buffer buffer = acquireBuffer();
+	std::shared_ptr<std::promise<void>> promise = std::make_shared<std::promise<void>>();
+	_prefetched.push_back(PrefetchedFrame{ path, buffer, promise->get_future().share() });
+	_prefetchTasks.run([path, buffer, promise]()
+	{
+		try {
+			readFile(path, *buffer);
+			promise->set_value();
+		}
+		catch (...)
+		{
+			promise->set_exception(std::current_exception());
+		}
+	});
+}
+
+void JPEGFileDecoder::clearPrefetched()
+{
+	_prefetched.clear();
+}
+
+size_t JPEGFileDecoder::getNumberOfPrefetchedFrames() const noexcept
+{
+	return _prefetched.size();
+}
+
+void JPEGFileDecoder::readFile(const std::wstring& path, std::vector<unsigned char>& buffer)
+{
+	Base::File file(path, Base::File::Mode::read | Base::File::Mode::sequential_scan);
+	const uint64_t size = file.getSize();
+	CHECK_LE(size, (uint64_t)ULONG_MAX) << Base::UTF16ToUTF8(path);
+	// Shrinking keeps the capacity, a buffer only grows to the largest frame it has held
+	buffer.resize((size_t)size);
+	// A single ReadFile for the whole file
+	if (size)
+		CHECK_EQ(file.read(buffer.data(), 0, size), size) << "Short read of " << Base::UTF16ToUTF8(path);
+}
+
+JPEGFileDecoder::Buffer JPEGFileDecoder::acquireBuffer()
+{
+	if (_freeBuffers.empty())
+		return std::make_shared<std::vector<unsigned char>>();
+	Buffer buffer = std::move(_freeBuffers.back());
+	_freeBuffers.pop_back();
+	return buffer;
+}
+
+void JPEGFileDecoder::recycleBuffer(Buffer buffer)
+{
+	// Still referenced by a prefetch that was pushed out or cleared while reading into it
+	if (buffer.use_count() != 1)
+		return;
+	if (_freeBuffers.size() < _maximumPrefetchedFrames)
+		_freeBuffers.push_back(std::move(buffer));
+}
@@ -0,0 +1,282 @@
+#include "frame_hash.h"
+
+#include <algorithm>
+#include <bitset>
+#include <cstring>
+#include <numeric>
+
+#include <nmmintrin.h>
+#include <ppl.h>
+
+#include <base/logging.h>
+#include <base/memory_mapped_io.h>
+
+#include "decoder.h"
+#include "resampler.h"
+
+struct CRC32CTable
+{
+	CRC32CTable()
+	{
+		// Reflected Castagnoli polynomial
+		for (uint32_t i = 0; i < 256; ++i)
+		{
+			uint32_t crc = i;
+			for (unsigned bit = 0; bit < 8; ++bit)
+				crc = (crc >> 1) ^ (0x82F63B78U & (0U - (crc & 1)));
+			values[i] = crc;
+		}
+	}
+	uint32_t values[256];
+};
+
+static uint32_t computeCRC32CScalar(const unsigned char *data, size_t size, uint32_t crc)
+{
+	static const CRC32CTable table;
+	for (size_t i = 0; i < size; ++i)
+		crc = table.values[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+	return crc;
+}
+
+static uint32_t computeCRC32CSSE42(const unsigned char *data, size_t size, uint32_t crc)
+{
+	uint64_t crc64 = crc;
+	for (; size >= 8; data += 8, size -= 8)
+	{
+		uint64_t value;
+		memcpy(&value, data, 8);
+		crc64 = _mm_crc32_u64(crc64, value);
+	}
+	crc = (uint32_t)crc64;
+	for (; size; ++data, --size)
+		crc = _mm_crc32_u8(crc, *data);
+	return crc;
+}
+
+uint32_t computeCRC32C(const unsigned char* data, size_t size, uint32_t crc, bool useSSE42)
+{
+	crc = ~crc;
+	crc = useSSE42 ? computeCRC32CSSE42(data, size, crc) : computeCRC32CScalar(data, size, crc);
+	return ~crc;
+}
+
+uint64_t computeDifferenceHash(const unsigned char* luma, unsigned width, unsigned height, unsigned stride)
+{
+	CHECK(width && height);
+	unsigned char thumbnail[9 * 8];
+	// Area averaging when shrinking, which is the common case, keeps the hash stable under noise
+	const ResamplingFilter filter = width >= 9 && height >= 8 ? ResamplingFilter::area : ResamplingFilter::bilinear;
+	resizeImage(luma, width, height, stride, thumbnail, 9, 8, 9, PixelFormat::GRAY, filter);
+	uint64_t hash = 0;
+	for (unsigned y = 0; y < 8; ++y)
+		for (unsigned x = 0; x < 8; ++x)
+		{
+			if (thumbnail[y * 9 + x] > thumbnail[y * 9 + x + 1])
+				hash |= uint64_t(1) << (y * 8 + x);
+		}
+	return hash;
+}
+
+unsigned getHashDistance(uint64_t hash1, uint64_t hash2)
+{
+	return (unsigned)std::bitset<64>(hash1 ^ hash2).count();
+}
+
+FrameHash hashFrame(const unsigned char* data, size_t size)
+{
+	FrameHash hash = {};
+	hash.size = size;
+	hash.crc32c = computeCRC32C(data, size);
+	try {
+		JPEGDecompressor decompressor(data, (unsigned long)size);
+		for (unsigned denominator = 8; ; denominator /= 2)
+		{
+			decompressor.setScalingFactor(1, denominator);
+			if (denominator == 1 || (decompressor.getScaledWidth() >= 9 && decompressor.getScaledHeight() >= 8))
+				break;
+		}
+		decompressor.setFormat(PixelFormat::GRAY);
+		decompressor.setQuality(DecodeQuality::preview);
+		std::vector<unsigned char> luma(decompressor.getSize());
+		decompressor.process(luma.data());
+		hash.differenceHash = computeDifferenceHash(luma.data(), decompressor.getScaledWidth(), decompressor.getScaledHeight(), 0);
+		hash.decoded = true;
+	}
+	catch (std::exception &)
+	{
+		// Already logged, the frame can still be an exact duplicate
+	}
+	return hash;
+}
+
+std::vector<FrameHash> hashFrameFiles(const std::vector<std::wstring>& paths)
+{
+	std::vector<FrameHash> hashes(paths.size());
+	Concurrency::parallel_for(size_t(0), paths.size(), [&](size_t i)
+	{
+		try {
+			Base::MemoryMappedIO file(paths[i].c_str());
+			hashes[i] = hashFrame(file.getPtr(), (size_t)file.getSize());
+		}
+		catch (std::exception &)
+		{
+			LOG_WARN << "Can not hash " << paths[i];
+			hashes[i] = FrameHash{};
+		}
+	});
+	return hashes;
+}
+
+// Union-find whose roots are the smallest index of their set
+class FrameGroups
+{
+public:
+	FrameGroups(size_t numberOfFrames)
+		: _parents(numberOfFrames)
+	{
+		std::iota(_parents.begin(), _parents.end(), size_t(0));
+	}
+	size_t find(size_t frame)
+	{
+		while (_parents[frame] != frame)
+		{
+			_parents[frame] = _parents[_parents[frame]];
+			frame = _parents[frame];
+		}
+		return frame;
+	}
+	void unite(size_t frame1, size_t frame2)
+	{
+		const size_t root1 = find(frame1), root2 = find(frame2);
+		if (root1 < root2)
+			_parents[root2] = root1;
+		else if (root2 < root1)
+			_parents[root1] = root2;
+	}
+private:
+	std::vector<size_t> _parents;
+};
+
+// Sorts frames by key and calls function for every run of frames with equal keys
+template <typename Key, typename Function>
+static void forEachRun(std::vector<size_t> &frames, Key key, Function function)
+{
+	std::sort(frames.begin(), frames.end(), [&key](size_t frame1, size_t frame2) { return key(frame1) < key(frame2); });
+	for (size_t begin = 0; begin < frames.size(); )
+	{
+		size_t end = begin + 1;
+		while (end < frames.size() && key(frames[end]) == key(frames[begin]))
+			++end;
+		if (end - begin > 1)
+			function(frames.data() + begin, end - begin);
+		begin = end;
+	}
+}
+
+static bool isFileContentEqual(const std::wstring &path1, const std::wstring &path2)
+{
+	try {
+		Base::MemoryMappedIO file1(path1.c_str(), Base::MemoryMappedIO::AccessHint::sequential);
+		Base::MemoryMappedIO file2(path2.c_str(), Base::MemoryMappedIO::AccessHint::sequential);
+		return file1.getSize() == file2.getSize() && memcmp(file1.getPtr(), file2.getPtr(), size_t(file1.getSize())) == 0;
+	}
+	catch (std::exception &)
+	{
+		// Already logged, a file that can not be read is no proof of anything
+		return false;
+	}
+}
+
+// paths may be null, equal size and CRC-32C then count as byte identical
+static std::vector<DuplicateFrame> findDuplicates(const std::vector<FrameHash> &hashes, unsigned maximumDistance, const std::vector<std::wstring> *paths)
+{
+	CHECK_LE(maximumDistance, 15U);
+	CHECK(!paths || paths->size() == hashes.size());
+	FrameGroups groups(hashes.size());
+	// One frame standing for all frames of the same bytes, for telling exact from near duplicates within a group
+	std::vector<size_t> sameBytes(hashes.size());
+	std::iota(sameBytes.begin(), sameBytes.end(), size_t(0));
+
+	std::vector<size_t> frames;
+	for (size_t i = 0; i < hashes.size(); ++i)
+	{
+		if (hashes[i].size)
+			frames.push_back(i);
+	}
+	forEachRun(frames, [&hashes](size_t frame) { return std::make_pair(hashes[frame].size, hashes[frame].crc32c); },
+		[&groups, &sameBytes, paths](const size_t *run, size_t length)
+	{
+		// One frame per distinct content, a collision leaves more than one
+		std::vector<size_t> distinctFrames;
+		for (size_t i = 0; i < length; ++i)
+		{
+			auto match = std::find_if(distinctFrames.begin(), distinctFrames.end(),
+				[&](size_t frame) { return !paths || isFileContentEqual((*paths)[frame], (*paths)[run[i]]); });
+			if (match == distinctFrames.end())
+			{
+				distinctFrames.push_back(run[i]);
+				continue;
+			}
+			sameBytes[run[i]] = *match;
+			groups.unite(*match, run[i]);
+		}
+	});
+
+	// Identical difference hashes are grouped right away, the bands only see one frame per hash value
+	frames.erase(std::remove_if(frames.begin(), frames.end(), [&hashes](size_t frame) { return !hashes[frame].decoded; }), frames.end());
+	std::vector<size_t> distinctHashFrames;
+	forEachRun(frames, [&hashes](size_t frame) { return hashes[frame].differenceHash; },
+		[&groups](const size_t *run, size_t length)
+	{
+		for (size_t i = 1; i < length; ++i)
+			groups.unite(run[0], run[i]);
+	});
+	for (size_t i = 0; i < frames.size(); ++i)
+	{
+		if (i == 0 || hashes[frames[i]].differenceHash != hashes[frames[i - 1]].differenceHash)
+			distinctHashFrames.push_back(frames[i]);
+	}
+
+	const unsigned numberOfBands = maximumDistance + 1;
+	for (unsigned band = 0; maximumDistance && band < numberOfBands; ++band)
+	{
+		const unsigned firstBit = 64 * band / numberOfBands, lastBit = 64 * (band + 1) / numberOfBands;
+		const uint64_t mask = (lastBit - firstBit == 64 ? ~uint64_t(0) : (uint64_t(1) << (lastBit - firstBit)) - 1) << firstBit;
+		forEachRun(distinctHashFrames, [&hashes, mask](size_t frame) { return hashes[frame].differenceHash & mask; },
+			[&hashes, &groups, maximumDistance](const size_t *run, size_t length)
+		{
+			for (size_t i = 0; i < length; ++i)
+				for (size_t j = i + 1; j < length; ++j)
+				{
+					if (groups.find(run[i]) != groups.find(run[j])
+						&& getHashDistance(hashes[run[i]].differenceHash, hashes[run[j]].differenceHash) <= maximumDistance)
+						groups.unite(run[i], run[j]);
+				}
+		});
+	}
+
+	std::vector<DuplicateFrame> duplicates;
+	for (size_t i = 0; i < hashes.size(); ++i)
+	{
+		const size_t original = groups.find(i);
+		if (original == i)
+			continue;
+		DuplicateFrame duplicate;
+		duplicate.frame = i;
+		duplicate.original = original;
+		duplicate.kind = sameBytes[i] == sameBytes[original] ? DuplicateKind::exact : DuplicateKind::near;
+		duplicate.distance = getHashDistance(hashes[i].differenceHash, hashes[original].differenceHash);
+		duplicates.push_back(duplicate);
+	}
+	return duplicates;
+}
+
+std::vector<DuplicateFrame> findDuplicateFrames(const std::vector<FrameHash>& hashes, unsigned maximumDistance)
+{
+	return findDuplicates(hashes, maximumDistance, nullptr);
+}
+
+std::vector<DuplicateFrame> findDuplicateFrameFiles(const std::vector<std::wstring>& paths, const std::vector<FrameHash>& hashes, unsigned maximumDistance)
+{
+	return findDuplicates(hashes, maximumDistance, &paths);
+}
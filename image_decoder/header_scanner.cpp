@@ -0,0 +1,217 @@
+#include "header_scanner.h"
+
+#include <algorithm>
+#include <cwctype>
+#include <ppl.h>
+
+#include <base/dataset_scanner.h>
+#include <base/file.h>
+#include <base/logging.h>
+
+class MemoryReader
+{
+public:
+	MemoryReader(const unsigned char *data, size_t size)
+		: _data(data), _size(size)
+	{
+	}
+	const unsigned char *get(uint64_t offset, size_t length)
+	{
+		if (offset + length > _size)
+			return nullptr;
+		return _data + offset;
+	}
+private:
+	const unsigned char *_data;
+	size_t _size;
+};
+
+// Keeps one chunk of the file buffered, a request outside of it reads a new chunk starting at the requested offset
+class ChunkedFileReader
+{
+public:
+	ChunkedFileReader(const std::wstring &path)
+		: _file(path), _buffer(4096), _bufferOffset(0), _bufferSize(0)
+	{
+	}
+	const unsigned char *get(uint64_t offset, size_t length)
+	{
+		if (offset < _bufferOffset || offset + length > _bufferOffset + _bufferSize)
+		{
+			if (length > _buffer.size())
+				_buffer.resize(length);
+			_bufferOffset = offset;
+			_bufferSize = (size_t)_file.read(_buffer.data(), offset, _buffer.size());
+			if (length > _bufferSize)
+				return nullptr;
+		}
+		return _buffer.data() + (offset - _bufferOffset);
+	}
+private:
+	Base::File _file;
+	std::vector<unsigned char> _buffer;
+	uint64_t _bufferOffset;
+	size_t _bufferSize;
+};
+
+static unsigned readUInt16BE(const unsigned char *data)
+{
+	return (unsigned(data[0]) << 8) | data[1];
+}
+
+static bool isSOFMarker(unsigned char marker)
+{
+	// SOF0-SOF15 except DHT (C4), JPG (C8) and DAC (CC)
+	return marker >= 0xC0 && marker <= 0xCF && marker != 0xC4 && marker != 0xC8 && marker != 0xCC;
+}
+
+static bool isDecodableSOFMarker(unsigned char marker)
+{
+	// Huffman baseline, extended and progressive (C0-C2), and their arithmetic counterparts (C9, CA) since
+	// libjpeg-turbo is built with D_ARITH_CODING_SUPPORTED. Lossless and hierarchical frames are not decodable.
+	return marker == 0xC0 || marker == 0xC1 || marker == 0xC2 || marker == 0xC9 || marker == 0xCA;
+}
+
+static bool parseSOFSegment(const unsigned char *segment, unsigned length, JPEGImageInfo *info)
+{
+	// P(1) Y(2) X(2) Nf(1), then Nf * { C(1) HV(1) Tq(1) }
+	if (length < 6)
+		return false;
+	const unsigned height = readUInt16BE(segment + 1);
+	const unsigned width = readUInt16BE(segment + 3);
+	const unsigned numberOfComponents = segment[5];
+	// A height of 0 is defined by a later DNL marker, libjpeg-turbo does not support it either
+	if (!width || !height || !numberOfComponents || length < 6 + numberOfComponents * 3)
+		return false;
+
+	const unsigned char *components = segment + 6;
+	Subsampling subsampling;
+	if (numberOfComponents == 1)
+		subsampling = Subsampling::GRAY;
+	else
+	{
+		if (numberOfComponents != 3 && numberOfComponents != 4)
+			return false;
+		// The chroma components must not be subsampled themselves
+		if (components[3 + 1] != 0x11 || components[6 + 1] != 0x11)
+			return false;
+		switch (components[1])
+		{
+		case 0x11:
+			subsampling = Subsampling::YUV444;
+			break;
+		case 0x21:
+			subsampling = Subsampling::YUV422;
+			break;
+		case 0x22:
+			subsampling = Subsampling::YUV420;
+			break;
+		case 0x12:
+			subsampling = Subsampling::YUV440;
+			break;
+		case 0x41:
+			subsampling = Subsampling::YUV411;
+			break;
+		default:
+			return false;
+		}
+	}
+	info->width = width;
+	info->height = height;
+	info->subsampling = subsampling;
+	info->numberOfComponents = numberOfComponents;
+	return true;
+}
+
+template <typename Reader>
+static bool parseJPEGHeader(Reader &reader, JPEGImageInfo *info)
+{
+	const unsigned char *data = reader.get(0, 2);
+	if (!data || data[0] != 0xFF || data[1] != 0xD8)
+		return false;
+	uint64_t offset = 2;
+	while (true)
+	{
+		data = reader.get(offset, 2);
+		if (!data || data[0] != 0xFF)
+			return false;
+		const unsigned char marker = data[1];
+		if (marker == 0xFF)
+		{
+			// Fill byte
+			++offset;
+			continue;
+		}
+		// Standalone markers without a length field
+		if (marker == 0x01 || (marker >= 0xD0 && marker <= 0xD7))
+		{
+			offset += 2;
+			continue;
+		}
+		// SOS or EOI before any SOF
+		if (marker == 0xDA || marker == 0xD9 || marker == 0xD8)
+			return false;
+
+		data = reader.get(offset + 2, 2);
+		if (!data)
+			return false;
+		const unsigned length = readUInt16BE(data);
+		if (length < 2)
+			return false;
+		if (isSOFMarker(marker))
+		{
+			if (!isDecodableSOFMarker(marker))
+				return false;
+			data = reader.get(offset + 4, length - 2);
+			if (!data)
+				return false;
+			return parseSOFSegment(data, length - 2, info);
+		}
+		offset += 2 + length;
+	}
+}
+
+bool parseJPEGHeader(const unsigned char* data, size_t size, JPEGImageInfo* info)
+{
+	MemoryReader reader(data, size);
+	return parseJPEGHeader(reader, info);
+}
+
+bool readJPEGHeader(const std::wstring& path, JPEGImageInfo* info)
+{
+	ChunkedFileReader reader(path);
+	return parseJPEGHeader(reader, info);
+}
+
+bool isJPEGFileName(const std::wstring& fileName)
+{
+	std::wstring extension = Base::getFileExtension(fileName);
+	std::transform(extension.begin(), extension.end(), extension.begin(), towlower);
+	return extension == L"jpg" || extension == L"jpeg";
+}
+
+std::vector<JPEGHeaderScanResult> scanJPEGHeaders(const std::wstring& directory)
+{
+	std::vector<std::wstring> fileNames;
+	std::vector<uint64_t> lastWriteTimes;
+	Base::getDirectoryFileLists(directory, fileNames, lastWriteTimes);
+	fileNames.erase(std::remove_if(fileNames.begin(), fileNames.end(),
+		[](const std::wstring &fileName) { return !isJPEGFileName(fileName); }), fileNames.end());
+	std::sort(fileNames.begin(), fileNames.end(), Base::naturalLess);
+
+	std::vector<JPEGHeaderScanResult> results(fileNames.size());
+	Concurrency::parallel_for(size_t(0), fileNames.size(), [&](size_t i)
+	{
+		JPEGHeaderScanResult &result = results[i];
+		result.fileName = std::move(fileNames[i]);
+		try {
+			result.valid = readJPEGHeader(Base::appendPath(directory, result.fileName), &result.info);
+		}
+		catch (std::exception &)
+		{
+			LOG_WARN << "Can not read the header of " << result.fileName << " in " << directory;
+			result.valid = false;
+		}
+	});
+	return results;
+}
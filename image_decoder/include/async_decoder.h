@@ -0,0 +1,103 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <base/task_scheduler.h>
+
+#include "decoder.h"
+
+enum class AsyncDecodeStatus : int32_t
+{
+	pending = 0, ok, decodeFailed, fileOpenFailed, bufferTooSmall, canceled
+};
+
+// Runs on a worker thread (on the cancelling thread for canceled requests), must not block for long.
+// width and height are those of the decoded image, also set for bufferTooSmall.
+typedef std::function<void(uint64_t ticket, AsyncDecodeStatus status, unsigned width, unsigned height)> AsyncDecodeCallback;
+
+struct AsyncDecodeRequest
+{
+	// Either a JPEG in memory, which must stay valid until the request completes, or a path
+	const unsigned char *src;
+	unsigned long srcSize;
+	std::wstring path;
+	// Receives the image, tightly packed, must stay valid until the request completes
+	unsigned char *dst;
+	size_t dstCapacity;
+	PixelFormat format;
+	DecodeQuality quality;
+	unsigned scalingFactorDenominator;
+	// Optional. Without one, the result is kept until poll() or wait() hands it out.
+	AsyncDecodeCallback callback;
+};
+
+// Decodes on the workers of a task scheduler, its own or one shared with other decode paths, reusing
+// decompressors between requests. Requests wait in a queue of bounded depth, submit() blocks while it is full
+// (trySubmit() fails instead), so a fast producer is slowed down to the decode rate rather than queueing
+// without limit. Tickets are never 0. Destroying the decoder cancels everything still queued.
+// Request callbacks run on the scheduler's workers and must not wait for work of the same scheduler.
+class AsyncDecoder
+{
+public:
+	// Starts its own scheduler, numberOfThreads of 0 means one per core
+	AsyncDecoder(unsigned numberOfThreads = 0, unsigned maximumQueueDepth = 64);
+	// The scheduler must outlive the decoder
+	AsyncDecoder(Base::TaskScheduler &scheduler, unsigned maximumQueueDepth = 64);
+	AsyncDecoder(const AsyncDecoder &) = delete;
+	~AsyncDecoder();
+	uint64_t submit(const AsyncDecodeRequest &request);
+	// 0 if the queue is full
+	uint64_t trySubmit(const AsyncDecodeRequest &request);
+	// pending while queued or decoding. Once a result has been returned, the ticket is forgotten.
+	AsyncDecodeStatus poll(uint64_t ticket, unsigned *width, unsigned *height);
+	// pending if timeout_ms elapsed first
+	AsyncDecodeStatus wait(uint64_t ticket, uint32_t timeout_ms, unsigned *width, unsigned *height);
+	// Only succeeds while the request is still queued, its callback then runs on the calling thread
+	bool cancel(uint64_t ticket);
+	unsigned getNumberOfThreads() const noexcept;
+	unsigned getMaximumQueueDepth() const noexcept;
+private:
+	struct Job
+	{
+		uint64_t ticket;
+		AsyncDecodeRequest request;
+	};
+	struct Result
+	{
+		AsyncDecodeStatus status;
+		unsigned width;
+		unsigned height;
+	};
+	uint64_t enqueue(const AsyncDecodeRequest &request, bool block);
+	// One task per request, it takes whichever job is queued first. Nothing is left if the job was canceled.
+	void runJob();
+	// false if the queue is empty or the decoder shuts down
+	bool tryDequeue(Job *job);
+	void complete(const Job &job, AsyncDecodeStatus status, unsigned width, unsigned height);
+	void stop();
+
+	// Null when a shared scheduler is used
+	std::unique_ptr<Base::TaskScheduler> _ownedScheduler;
+	Base::TaskScheduler &_scheduler;
+	unsigned _maximumQueueDepth;
+	std::mutex _lock;
+	std::condition_variable _notFull;
+	std::condition_variable _completed;
+	std::deque<Job> _queue;
+	// Requests without a callback, from submission until their result is handed out
+	std::unordered_map<uint64_t, Result> _results;
+	// Idle decompressors, taken by the running jobs
+	std::vector<std::unique_ptr<JPEGDecompressor>> _decompressors;
+	uint64_t _nextTicket;
+	bool _stopping;
+	// Declared last, it waits for the running jobs before anything they use is destroyed
+	Base::TaskGroup _jobs;
+};
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+#include "decoder.h"
+
+enum class BatchSlotStatus : int32_t
+{
+	ok = 0, decodeFailed, sizeMismatch, fileOpenFailed
+};
+
+// Decodes a batch of JPEGs in parallel into one contiguous N x H x W x C buffer.
+// Every image must decode (after scaling) to exactly width x height, slots that fail are zero filled.
+// Each worker thread keeps its own tjhandle for the lifetime of the BatchDecoder.
+class BatchDecoder
+{
+public:
+	BatchDecoder(unsigned width, unsigned height, PixelFormat format);
+	BatchDecoder(const BatchDecoder &) = delete;
+	~BatchDecoder();
+	void setQuality(DecodeQuality quality) noexcept;
+	void setScalingFactor(unsigned numerator, unsigned denominator);
+	// width * height * bytes per pixel
+	size_t getSlotSize() const noexcept;
+	// dst must hold n * getSlotSize() bytes, statuses (optional) n entries.
+	// Returns the number of slots that failed.
+	unsigned decode(const unsigned char * const *srcs, const unsigned long *sizes, unsigned n, unsigned char *dst, BatchSlotStatus *statuses = nullptr);
+	unsigned decode(const wchar_t * const *paths, unsigned n, unsigned char *dst, BatchSlotStatus *statuses = nullptr);
+private:
+	struct WorkerContext;
+	struct WorkerContexts;
+	BatchSlotStatus decodeSlot(WorkerContext &context, const unsigned char *src, unsigned long size, unsigned char *dst);
+	unsigned _width;
+	unsigned _height;
+	PixelFormat _format;
+	DecodeQuality _quality;
+	unsigned _scalingFactorNumerator;
+	unsigned _scalingFactorDenominator;
+	size_t _slotSize;
+	std::unique_ptr<WorkerContexts> _workerContexts;
+};
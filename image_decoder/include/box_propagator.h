@@ -0,0 +1,50 @@
+#pragma once
+
+#include <vector>
+
+#include "cpu_features.h"
+#include "region_decoder.h"
+
+struct PropagatedBox
+{
+	double x, y, w, h;
+	// Normalized cross-correlation of the best match, in [-1, 1], 0 if the template has no texture
+	double confidence;
+};
+
+// Proposes the box of the next frame from the box of the current one by template matching on luma.
+// The box is resampled to about templateSize x templateSize pixels (never enlarged), only the box
+// in the current frame and the search window around it in the next frame are decoded, at the
+// smallest DCT scaling factor that keeps that resolution. The template is matched by exhaustive
+// normalized cross-correlation at a few scales, the peak is refined to subpixel precision.
+// Not thread safe, one propagator per thread.
+class BoxPropagator
+{
+public:
+	// searchAreaFactor: size of the search window relative to the box, per axis
+	BoxPropagator(double searchAreaFactor = 2., unsigned templateSize = 32, SIMDInstructionSet instructionSet = getBestSupportedInstructionSet());
+	BoxPropagator(const BoxPropagator &) = delete;
+	// x, y is the top left corner of the box in frame, both frames must have the same size
+	PropagatedBox propagate(const unsigned char *frame, unsigned long frameSize, const unsigned char *nextFrame, unsigned long nextFrameSize,
+		double x, double y, double w, double h);
+private:
+	// Decodes the luma of [x0, x1) x [y0, y1) of the image _decompressor points to, in frame pixels, at 1 / denominator
+	void decode(unsigned denominator, double x0, double y0, double x1, double y1);
+	// Resamples the frame rectangle (x, y, w, h) from the decoded region
+	void sample(double x, double y, double w, double h, unsigned width, unsigned height, std::vector<unsigned char> &dst);
+	double _searchAreaFactor;
+	unsigned _templateSize;
+	SIMDInstructionSet _instructionSet;
+	JPEGRegionDecompressor _decompressor;
+	std::vector<unsigned char> _region;
+	unsigned _denominator;
+	unsigned _regionX;
+	unsigned _regionY;
+	unsigned _regionWidth;
+	unsigned _regionHeight;
+	std::vector<unsigned char> _template;
+	std::vector<unsigned char> _search;
+	std::vector<float> _scores;
+	std::vector<uint32_t> _integral;
+	std::vector<uint64_t> _squaredIntegral;
+};
@@ -0,0 +1,14 @@
+#pragma once
+
+#include <stdint.h>
+
+enum class SIMDInstructionSet : uint32_t
+{
+	none = 0, sse2, avx2
+};
+
+bool isSSE2Supported();
+bool isSSE42Supported();
+bool isAVX2Supported();
+// The widest instruction set both the CPU and the OS (saved YMM state) support
+SIMDInstructionSet getBestSupportedInstructionSet();
@@ -1,6 +1,8 @@
 #pragma once
 #include <turbojpeg.h>
 
+#include <base/buffer_pool.h>
+
 #include <stdint.h>
 
 enum class PixelFormat : uint32_t
@@ -8,22 +10,68 @@ enum class PixelFormat : uint32_t
 	RGB = 0, BGR, RGBA, BGRA, ABGR, ARGB, GRAY
 };
 
+// Bytes per pixel, packed formats only
+unsigned getPixelSize(PixelFormat format);
+
+// preview trades accuracy for speed (fast integer IDCT, nearest chroma upsampling),
+// meant for interactive scrubbing where the frame is replaced a moment later
+enum class DecodeQuality : uint32_t
+{
+	full = 0, preview
+};
+
+// Values match TJSAMP
+enum class Subsampling : uint32_t
+{
+	YUV444 = 0, YUV422, YUV420, GRAY, YUV440, YUV411
+};
+
 class DLLEXPORT JPEGDecompressor
 {
 public:
 	JPEGDecompressor(const unsigned char *src, unsigned long size);
 	~JPEGDecompressor() noexcept;
+	// Points the decompressor to another image, keeping the tjhandle, format, quality and scaling factor
+	void reset(const unsigned char *src, unsigned long size);
 	void process(unsigned char *dst);
+	// Decodes into a buffer of getSize() bytes leased from pool
+	Base::BufferLease process(Base::BufferPool &pool = Base::BufferPool::getDefault());
 	unsigned getSize() const noexcept;
 	unsigned getWidth() const noexcept;
 	unsigned getHeight() const noexcept;
 	void setFormat(PixelFormat format);
 	PixelFormat getFormat() const;
+	void setQuality(DecodeQuality quality) noexcept;
+	DecodeQuality getQuality() const noexcept;
+	// DCT domain scaling, must be one of tjGetScalingFactors(), e.g. 1/2, 1/4, 1/8
+	void setScalingFactor(unsigned numerator, unsigned denominator);
+	static bool isScalingFactorSupported(unsigned numerator, unsigned denominator);
+	// Size of the decoded image, getWidth()/getHeight() scaled by the scaling factor.
+	// getSize(), the plane geometry and all process* functions refer to the scaled size.
+	unsigned getScaledWidth() const noexcept;
+	unsigned getScaledHeight() const noexcept;
+	Subsampling getSubsampling() const noexcept;
+	// False for RGB/CMYK/YCCK JPEGs, processYUVPlanes() and processLuma() require YCbCr or grayscale
+	bool isYUVDecodingSupported() const noexcept;
+	// YUV planar output, 1 plane for grayscale images, otherwise Y, Cb, Cr
+	unsigned getNumberOfPlanes() const noexcept;
+	unsigned getPlaneWidth(unsigned component) const;
+	unsigned getPlaneHeight(unsigned component) const;
+	unsigned getPlaneSize(unsigned component) const;
+	// strides can be nullptr, which means each plane is tightly packed (getPlaneWidth())
+	void processYUVPlanes(unsigned char **planes, const int *strides = nullptr);
+	// Decodes the Y component only (getScaledWidth() * getScaledHeight() bytes), skipping chroma decoding and color conversion
+	void processLuma(unsigned char *dst);
 private:
+	void parseHeader();
 	tjhandle _tjhandle;
 	const unsigned char *_src;
-	const unsigned long _srcSize;
+	unsigned long _srcSize;
 	unsigned _width;
 	unsigned _height;
+	int _subsampling;
+	int _colorspace;
 	TJPF _format;
+	int _flags;
+	tjscalingfactor _scalingFactor;
 };
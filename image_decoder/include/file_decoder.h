@@ -0,0 +1,52 @@
+#pragma once
+
+#include <deque>
+#include <future>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <ppl.h>
+
+#include "decoder.h"
+
+// Decodes JPEG files by path. A file is read with one ReadFile into a scratch buffer that is reused from
+// frame to frame, opened for sequential scan so the cache manager reads ahead, instead of mapping it and
+// faulting it in page by page. prefetch() reads upcoming frames in the background, open() of a prefetched
+// frame then only waits for the read still outstanding, which hides the latency of cold disks and network shares.
+// Not thread safe, one decoder per thread.
+class JPEGFileDecoder
+{
+public:
+	// Frames prefetched beyond maximumPrefetchedFrames push out the oldest ones not opened yet
+	JPEGFileDecoder(unsigned maximumPrefetchedFrames = 8);
+	JPEGFileDecoder(const JPEGFileDecoder &) = delete;
+	// Waits for the outstanding prefetches
+	~JPEGFileDecoder();
+	// Reads the file, or takes it over from the prefetched frames, and points the decompressor to it.
+	// The decompressor keeps format, quality and scaling factor across calls and is valid until the next open().
+	JPEGDecompressor &open(const std::wstring &path);
+	void prefetch(const std::wstring &path);
+	// Drops the frames prefetched but not opened, e.g. after seeking
+	void clearPrefetched();
+	size_t getNumberOfPrefetchedFrames() const noexcept;
+private:
+	typedef std::shared_ptr<std::vector<unsigned char>> Buffer;
+	struct PrefetchedFrame
+	{
+		std::wstring path;
+		Buffer buffer;
+		std::shared_future<void> read;
+	};
+	static void readFile(const std::wstring &path, std::vector<unsigned char> &buffer);
+	Buffer acquireBuffer();
+	void recycleBuffer(Buffer buffer);
+
+	unsigned _maximumPrefetchedFrames;
+	Buffer _current;
+	std::deque<PrefetchedFrame> _prefetched;
+	std::vector<Buffer> _freeBuffers;
+	std::unique_ptr<JPEGDecompressor> _decompressor;
+	// Declared last, waited for before the buffers go away
+	Concurrency::task_group _prefetchTasks;
+};
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "cpu_features.h"
+
+// CRC-32C (Castagnoli), chainable: pass the previous result as crc to continue over more data.
+// useSSE42 selects the crc32 instruction, both paths give the same result.
+uint32_t computeCRC32C(const unsigned char *data, size_t size, uint32_t crc = 0, bool useSSE42 = isSSE42Supported());
+
+// 64 bit difference hash of a luma image: the image is area resampled to 9x8, bit 8 * y + x is set
+// where pixel x of row y is brighter than pixel x + 1. Insensitive to re-encoding, scaling and
+// small global brightness changes, unlike a hash of the bytes.
+uint64_t computeDifferenceHash(const unsigned char *luma, unsigned width, unsigned height, unsigned stride);
+unsigned getHashDistance(uint64_t hash1, uint64_t hash2);
+
+struct FrameHash
+{
+	uint64_t size;
+	uint32_t crc32c;
+	// False if the frame could not be decoded, differenceHash is 0 then
+	bool decoded;
+	uint64_t differenceHash;
+};
+
+// The difference hash comes from a grayscale decode at the smallest DCT scaling factor that keeps 9x8 pixels
+FrameHash hashFrame(const unsigned char *data, size_t size);
+// Hashes files in parallel. Unreadable files get a FrameHash of size 0 that matches nothing.
+std::vector<FrameHash> hashFrameFiles(const std::vector<std::wstring> &paths);
+
+enum class DuplicateKind : uint32_t
+{
+	// Byte identical. findDuplicateFrames() only sees the size and CRC-32C, findDuplicateFrameFiles() compares the bytes.
+	exact = 0,
+	// Difference hashes at most maximumDistance bits apart
+	near
+};
+
+struct DuplicateFrame
+{
+	size_t frame;
+	// The first frame of its group, frame > original
+	size_t original;
+	DuplicateKind kind;
+	// Between the difference hashes of frame and original, can exceed maximumDistance since groups are transitive
+	unsigned distance;
+};
+
+// Groups frames that are exact or near duplicates of each other, transitively, and reports every frame of
+// a group but the first, in frame order. Near duplicates are found through the hash bands: hashes within
+// maximumDistance bits agree on at least one of maximumDistance + 1 bands, only frames sharing a band
+// are compared. maximumDistance is at most 15, 0 still finds identical hashes of differing bytes.
+std::vector<DuplicateFrame> findDuplicateFrames(const std::vector<FrameHash> &hashes, unsigned maximumDistance = 3);
+// Same as above for the files the hashes came from, frames of equal size and CRC-32C are compared byte by byte
+// before they count as exact duplicates, so a CRC-32C collision is never reported as one
+std::vector<DuplicateFrame> findDuplicateFrameFiles(const std::vector<std::wstring> &paths, const std::vector<FrameHash> &hashes,
+	unsigned maximumDistance = 3);
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "decoder.h"
+
+struct JPEGImageInfo
+{
+	unsigned width;
+	unsigned height;
+	Subsampling subsampling;
+	unsigned numberOfComponents;
+};
+
+// Walks the marker segments up to SOF without touching the entropy coded data and without a tjhandle.
+// Returns false if the data is not a baseline/extended/progressive JPEG with a subsampling libjpeg-turbo can decode,
+// or if the SOF segment lies beyond size.
+bool parseJPEGHeader(const unsigned char *data, size_t size, JPEGImageInfo *info);
+// Same as above, reading the file in 4 KB chunks instead of mapping it.
+// Marker segments before SOF (Exif, ICC profiles) are skipped by offset, not read.
+bool readJPEGHeader(const std::wstring &path, JPEGImageInfo *info);
+
+// .jpg or .jpeg, case insensitive
+bool isJPEGFileName(const std::wstring &fileName);
+
+struct JPEGHeaderScanResult
+{
+	std::wstring fileName;
+	bool valid;
+	JPEGImageInfo info;
+};
+
+// Probes every .jpg/.jpeg file of a directory in parallel, in natural file name order (2.jpg before 10.jpg)
+std::vector<JPEGHeaderScanResult> scanJPEGHeaders(const std::wstring &directory);
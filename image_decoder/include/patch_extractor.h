@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include "region_decoder.h"
+
+// One square patch around a box, as cropped for Siamese tracker training (SiamFC):
+// the box is padded by contextAmount * (w + h) in both directions, the crop is the square of the
+// same area, scaled by cropScale and centered on the box, resized to size x size.
+// Template and search patches of SiamFC are { 127, 1 } and { 255, 255 / 127. }.
+struct PatchSpecification
+{
+	unsigned size;
+	double cropScale;
+};
+
+// Decodes only the part of the frame the patches cover, at the smallest DCT scaling factor that
+// still has at least one pixel per patch pixel, and resizes it bilinearly. Patch pixels outside of
+// the frame are filled with the mean of the decoded part. Not thread safe, one extractor per thread.
+class PatchExtractor
+{
+public:
+	PatchExtractor(const std::vector<PatchSpecification> &patches, double contextAmount = 0.5, PixelFormat format = PixelFormat::RGB);
+	PatchExtractor(const PatchExtractor &) = delete;
+	const std::vector<PatchSpecification> &getPatches() const noexcept;
+	double getContextAmount() const noexcept;
+	PixelFormat getFormat() const noexcept;
+	// Size of all patches of one box, extract() writes them back to back in specification order
+	size_t getOutputSize() const noexcept;
+	// x, y is the top left corner of the box, in pixels of the frame
+	void extract(const unsigned char *jpeg, unsigned long size, double x, double y, double w, double h, unsigned char *dst);
+private:
+	std::vector<PatchSpecification> _patches;
+	double _contextAmount;
+	JPEGRegionDecompressor _decompressor;
+	std::vector<unsigned char> _region;
+};
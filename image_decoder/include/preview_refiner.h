@@ -0,0 +1,39 @@
+#pragma once
+
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <mutex>
+
+#include <base/native_event_looper.h>
+#include <base/timer.h>
+
+#include "decoder.h"
+
+// Scrubbing helper: seek() decodes the frame in DecodeQuality::preview right away and arms a timer,
+// once no further seek() happened for settleTime_ms the last frame is decoded again in full quality.
+// Register it to a Base::NativeEventLooper, the full quality decode runs on the looper thread.
+class PreviewRefiner : public Base::NativeWaitableObject
+{
+public:
+	// image is only valid during the call
+	typedef std::function<void(const unsigned char *image, unsigned width, unsigned height, DecodeQuality quality)> FrameCallback;
+	// previewScalingFactorDenominator of 1 keeps the full resolution for the preview frames
+	PreviewRefiner(PixelFormat format, FrameCallback callback, uint32_t settleTime_ms = 150, unsigned previewScalingFactorDenominator = 1);
+	// src must stay valid until the next seek() or until the full quality frame has been delivered.
+	// Must not be called from inside the FrameCallback.
+	void seek(const unsigned char *src, unsigned long size);
+	void getNumberOfWaitableObjects(uint32_t *numberOfWaitableObject) override;
+	void getWaitableObjects(HANDLE *nativeWaitableObjects) override;
+	void callback(uint32_t index) override;
+private:
+	void decode();
+	PixelFormat _format;
+	FrameCallback _callback;
+	uint32_t _settleTime_ms;
+	unsigned _previewScalingFactorDenominator;
+	Base::Timer _timer;
+	std::chrono::steady_clock::time_point _lastSeekTime;
+	std::unique_ptr<JPEGDecompressor> _decompressor;
+	std::mutex _lock;
+};
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <memory>
+
+#include "decoder.h"
+
+// Decodes a rectangle of a JPEG through libjpeg's partial decompression: rows above the rectangle
+// are only entropy decoded (jpeg_skip_scanlines), rows below are not read at all, and columns
+// outside of it skip IDCT, upsampling and color conversion, up to iMCU alignment (jpeg_crop_scanline).
+// Worth it when the rectangle is a small part of the image, e.g. the context around an annotated box.
+class JPEGRegionDecompressor
+{
+public:
+	JPEGRegionDecompressor();
+	JPEGRegionDecompressor(const JPEGRegionDecompressor &) = delete;
+	~JPEGRegionDecompressor() noexcept;
+	// Reads the header, format and scaling factor are kept
+	void reset(const unsigned char *src, unsigned long size);
+	unsigned getWidth() const noexcept;
+	unsigned getHeight() const noexcept;
+	void setFormat(PixelFormat format);
+	PixelFormat getFormat() const noexcept;
+	unsigned getPixelSize() const noexcept;
+	// Same scaling factors as JPEGDecompressor::setScalingFactor()
+	void setScalingFactor(unsigned numerator, unsigned denominator);
+	unsigned getScaledWidth() const noexcept;
+	unsigned getScaledHeight() const noexcept;
+	// The rectangle is in scaled pixels and must lie within the scaled image.
+	// dst receives width x height pixels, dstStride of 0 means width * getPixelSize().
+	void process(unsigned x, unsigned y, unsigned width, unsigned height, unsigned char *dst, unsigned dstStride = 0);
+private:
+	struct Context;
+	std::unique_ptr<Context> _context;
+	const unsigned char *_src;
+	unsigned long _srcSize;
+	unsigned _width;
+	unsigned _height;
+	PixelFormat _format;
+	unsigned _scalingNumerator;
+	unsigned _scalingDenominator;
+};
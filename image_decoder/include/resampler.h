@@ -0,0 +1,39 @@
+#pragma once
+
+#include "cpu_features.h"
+#include "decoder.h"
+
+enum class ResamplingFilter : uint32_t
+{
+	// Source pixel under each destination pixel center
+	nearest = 0,
+	// 2x2 taps in 7 bit fixed point per axis, aliases when shrinking by more than 2
+	bilinear,
+	// Source pixels weighted by how much of the destination pixel they cover, the filter for shrinking
+	area
+};
+
+// Resizes a packed image of one of the PixelFormat layouts. Large images are split into tiles of
+// destination rows that are resized in parallel. Strides of 0 mean tightly packed rows.
+void resizeImage(const unsigned char *src, unsigned srcWidth, unsigned srcHeight, unsigned srcStride,
+	unsigned char *dst, unsigned dstWidth, unsigned dstHeight, unsigned dstStride,
+	PixelFormat format, ResamplingFilter filter);
+
+// Same as above with an explicit kernel, SIMDInstructionSet::none is the scalar reference.
+// All kernels of a filter produce identical output.
+void resizeImage(const unsigned char *src, unsigned srcWidth, unsigned srcHeight, unsigned srcStride,
+	unsigned char *dst, unsigned dstWidth, unsigned dstHeight, unsigned dstStride,
+	PixelFormat format, ResamplingFilter filter, SIMDInstructionSet instructionSet, bool parallel);
+
+// Bilinear resampling of 8 bit images with 1 to 4 interleaved channels, in 7 bit fixed point per axis.
+// The rectangle (regionX, regionY, regionWidth, regionHeight) of src, in pixels with pixel i covering [i, i + 1),
+// is stretched over the whole of dst. Samples beyond the edges of src repeat the edge pixels.
+// Strides of 0 mean tightly packed rows.
+void resizeBilinear(const unsigned char *src, unsigned srcWidth, unsigned srcHeight, unsigned srcStride, unsigned channels,
+	double regionX, double regionY, double regionWidth, double regionHeight,
+	unsigned char *dst, unsigned dstWidth, unsigned dstHeight, unsigned dstStride);
+
+// Same as above with an explicit kernel, SIMDInstructionSet::none is the scalar reference
+void resizeBilinear(const unsigned char *src, unsigned srcWidth, unsigned srcHeight, unsigned srcStride, unsigned channels,
+	double regionX, double regionY, double regionWidth, double regionHeight,
+	unsigned char *dst, unsigned dstWidth, unsigned dstHeight, unsigned dstStride, SIMDInstructionSet instructionSet);
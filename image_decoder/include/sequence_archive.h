@@ -0,0 +1,94 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <base/file.h>
+#include <base/memory_mapped_io.h>
+
+// A whole sequence in one file, little endian:
+//   SequenceArchiveHeader
+//   JPEG payloads, back to back in frame order
+//   SequenceArchiveFrameEntry[numberOfFrames]
+//   SequenceArchiveRecord[numberOfFrames], only with SequenceArchiveHeader::hasRecords
+//   Frame names, UTF-16 without terminators, referenced by the frame entries
+struct SequenceArchiveHeader
+{
+	char magic[8];
+	uint32_t version;
+	uint32_t numberOfFrames;
+	uint32_t hasRecords;
+	uint32_t reserved;
+	uint64_t indexOffset;
+	uint64_t recordsOffset;
+	uint64_t namesOffset;
+	uint64_t namesLength;
+};
+static_assert(sizeof(SequenceArchiveHeader) == 56, "On-disk layout");
+
+struct SequenceArchiveFrameEntry
+{
+	uint64_t offset;
+	uint32_t size;
+	uint32_t nameOffset;
+	uint32_t nameLength;
+	uint32_t reserved;
+};
+static_assert(sizeof(SequenceArchiveFrameEntry) == 24, "On-disk layout");
+
+// Mirrors one AnnotationOperator record, the path is the frame name
+struct SequenceArchiveRecord
+{
+	int32_t id;
+	int32_t x;
+	int32_t y;
+	int32_t w;
+	int32_t h;
+	uint8_t labeled;
+	uint8_t occlusion;
+	uint8_t outOfView;
+	uint8_t reserved;
+};
+static_assert(sizeof(SequenceArchiveRecord) == 24, "On-disk layout");
+
+// Streams the payloads out sequentially, the index is written by finish()
+class SequenceArchiveWriter
+{
+public:
+	SequenceArchiveWriter(const std::wstring &path, bool hasRecords);
+	SequenceArchiveWriter(const SequenceArchiveWriter &) = delete;
+	// record is required if the archive has records, ignored otherwise
+	void addFrame(const std::wstring &name, const unsigned char *jpeg, uint32_t size, const SequenceArchiveRecord *record = nullptr);
+	void addFrameFromFile(const std::wstring &name, const std::wstring &path, const SequenceArchiveRecord *record = nullptr);
+	// The archive is not readable before finish() returns
+	void finish();
+private:
+	Base::File _file;
+	uint64_t _offset;
+	bool _hasRecords;
+	bool _finished;
+	std::vector<SequenceArchiveFrameEntry> _entries;
+	std::vector<SequenceArchiveRecord> _records;
+	std::wstring _names;
+};
+
+// Maps the archive once, frames are handed out as pointers into the mapping and can be passed
+// to JPEGDecompressor directly. The layout is validated on open.
+class SequenceArchiveReader
+{
+public:
+	SequenceArchiveReader(const std::wstring &path);
+	SequenceArchiveReader(const SequenceArchiveReader &) = delete;
+	uint32_t getNumberOfFrames() const noexcept;
+	const unsigned char *getFrame(uint32_t index, uint32_t *size) const;
+	std::wstring getFrameName(uint32_t index) const;
+	bool hasRecords() const noexcept;
+	const SequenceArchiveRecord &getRecord(uint32_t index) const;
+private:
+	Base::MemoryMappedIO _file;
+	const SequenceArchiveHeader *_header;
+	const SequenceArchiveFrameEntry *_entries;
+	const SequenceArchiveRecord *_records;
+	const wchar_t *_names;
+};
@@ -0,0 +1,115 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <base/thread.h>
+
+#include "turbojpeg_handle_pool.h"
+
+// The store file, little endian:
+//   ThumbnailStoreHeader
+//   uint32_t scalingFactorDenominators[numberOfLevels]
+//   ThumbnailStoreFrameEntry[numberOfFrames]
+//   ThumbnailStoreThumbnailEntry[numberOfFrames * numberOfLevels], frame major
+//   Frame names, UTF-16 without terminators, referenced by the frame entries
+//   JPEG payloads
+struct ThumbnailStoreHeader
+{
+	char magic[8];
+	uint32_t version;
+	uint32_t numberOfFrames;
+	uint32_t numberOfLevels;
+	uint32_t reserved;
+	uint64_t namesLength;
+};
+static_assert(sizeof(ThumbnailStoreHeader) == 32, "On-disk layout");
+
+struct ThumbnailStoreFrameEntry
+{
+	uint64_t lastWriteTime;
+	uint32_t nameOffset;
+	uint32_t nameLength;
+};
+static_assert(sizeof(ThumbnailStoreFrameEntry) == 16, "On-disk layout");
+
+struct ThumbnailStoreThumbnailEntry
+{
+	uint64_t offset;
+	uint32_t size;
+	uint16_t width;
+	uint16_t height;
+};
+static_assert(sizeof(ThumbnailStoreThumbnailEntry) == 16, "On-disk layout");
+
+// Thumbnails of every JPEG frame of a sequence directory, one JPEG per frame and level,
+// each level is the frame decoded with a DCT scaling factor of 1/denominator.
+// The constructor only loads the store file, so the whole timeline is available right away,
+// update() then brings it in line with the directory on a background thread.
+// A frame is rebuilt when its last write time differs from the one it was built from,
+// until then the outdated thumbnail is still handed out.
+class ThumbnailStore
+{
+public:
+	ThumbnailStore(const std::wstring &sequenceDirectory, const std::wstring &storePath,
+		const std::vector<unsigned> &scalingFactorDenominators = { 8, 4 }, int jpegQuality = 75);
+	ThumbnailStore(const ThumbnailStore &) = delete;
+	// Cancels a running update, the store file is not written in that case
+	~ThumbnailStore();
+	// Rescans the directory, rebuilds missing and outdated thumbnails and rewrites the store file.
+	// Does nothing if an update is still running.
+	void update();
+	bool isUpdating() const;
+	void waitForUpdate() const;
+	// Empty if the last update failed
+	std::string getUpdateErrorMessage() const;
+	unsigned getNumberOfFrames() const;
+	unsigned getNumberOfLevels() const noexcept;
+	unsigned getScalingFactorDenominator(unsigned level) const;
+	std::wstring getFrameName(unsigned frame) const;
+	// false if the thumbnail is not built yet
+	bool getThumbnail(unsigned frame, unsigned level, std::vector<unsigned char> *jpeg, unsigned *width, unsigned *height) const;
+private:
+	struct Thumbnail
+	{
+		std::shared_ptr<const std::vector<unsigned char>> jpeg;
+		unsigned width;
+		unsigned height;
+	};
+	struct Frame
+	{
+		std::wstring name;
+		// Of the file the thumbnails were built from
+		uint64_t lastWriteTime;
+		// Empty if not built yet or if the file can not be decoded
+		std::vector<Thumbnail> thumbnails;
+	};
+	class Updater : public Base::Runnable
+	{
+	public:
+		Updater(ThumbnailStore *store);
+		int job_entry() override;
+		bool job_cancel() override;
+	private:
+		ThumbnailStore *_store;
+		std::atomic<bool> _cancelled;
+	};
+	void load();
+	void save(const std::vector<Frame> &frames) const;
+	void runUpdate(const std::atomic<bool> &cancelled);
+	std::vector<Thumbnail> build(const std::wstring &fileName);
+
+	std::wstring _sequenceDirectory;
+	std::wstring _storePath;
+	std::vector<unsigned> _scalingFactorDenominators;
+	int _jpegQuality;
+	TurboJPEGHandlePool _compressors;
+	mutable std::mutex _lock;
+	std::vector<Frame> _frames;
+	std::unique_ptr<Updater> _updater;
+	std::unique_ptr<Base::Thread> _updaterThread;
+};
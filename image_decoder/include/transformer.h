@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "turbojpeg_handle_pool.h"
+
+// Values match TJXOP. rotate90 is clockwise.
+enum class JPEGTransformOperation : uint32_t
+{
+	none = 0, horizontalFlip, verticalFlip, transpose, transverse, rotate90, rotate180, rotate270
+};
+
+// Where the pixels of a source image end up. sourceWidth/sourceHeight are the part of the source that is kept
+// once the partial iMCUs are trimmed, the transformed image is that part transformed, then cropped to
+// cropX, cropY, width, height.
+struct JPEGTransformGeometry
+{
+	JPEGTransformOperation operation;
+	unsigned sourceWidth;
+	unsigned sourceHeight;
+	unsigned cropX;
+	unsigned cropY;
+	unsigned width;
+	unsigned height;
+};
+
+// Lossless rotation, flipping and cropping on the DCT coefficients (tjTransform), without decoding or re-encoding.
+// Thread safe once configured, transform handles are pooled.
+class JPEGTransformer
+{
+public:
+	JPEGTransformer(JPEGTransformOperation operation = JPEGTransformOperation::none);
+	JPEGTransformer(const JPEGTransformer &) = delete;
+	void setOperation(JPEGTransformOperation operation) noexcept;
+	JPEGTransformOperation getOperation() const noexcept;
+	// The region refers to the transformed image, w or h of 0 extend it to the edge. The top left corner is
+	// moved up and left to the iMCU grid, w and h grow accordingly, and the region is clipped to the image.
+	void setCrop(unsigned x, unsigned y, unsigned w, unsigned h) noexcept;
+	void clearCrop() noexcept;
+	// Flips and rotations can only move whole iMCUs. With trimming (the default) the partial iMCUs on the
+	// affected edges are dropped, up to 15 pixels, otherwise such images fail to transform.
+	void setTrim(bool trim) noexcept;
+	JPEGTransformGeometry getGeometry(const unsigned char *src, unsigned long size);
+	JPEGTransformGeometry transform(const unsigned char *src, unsigned long size, std::vector<unsigned char> &dst);
+	// Transforms file by file in parallel. The output directories must exist.
+	// geometries (may be nullptr) receives the geometry of each file.
+	void transformFiles(const std::vector<std::wstring> &srcPaths, const std::vector<std::wstring> &dstPaths, std::vector<JPEGTransformGeometry> *geometries = nullptr);
+	// Maps a box given in source pixels into the transformed image, clipped to it.
+	// False if nothing of the box is left, x, y, w, h are then unchanged.
+	static bool transformBox(const JPEGTransformGeometry &geometry, int *x, int *y, int *w, int *h);
+private:
+	JPEGTransformGeometry getGeometry(tjhandle handle, const unsigned char *src, unsigned long size) const;
+	JPEGTransformOperation _operation;
+	bool _crop;
+	unsigned _cropX, _cropY, _cropW, _cropH;
+	bool _trim;
+	TurboJPEGHandlePool _handles;
+};
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <mutex>
+#include <vector>
+
+#include <turbojpeg.h>
+
+enum class TurboJPEGHandleType
+{
+	compress, decompress, transform
+};
+
+// Keeps idle tjhandles around so concurrent workers do not pay tjInit*() / tjDestroy() per image
+class TurboJPEGHandlePool
+{
+public:
+	class Lease
+	{
+	public:
+		Lease(const Lease &) = delete;
+		Lease(Lease &&other) noexcept;
+		~Lease();
+		tjhandle get() const noexcept;
+	private:
+		friend class TurboJPEGHandlePool;
+		Lease(TurboJPEGHandlePool *pool, tjhandle handle) noexcept;
+		TurboJPEGHandlePool *_pool;
+		tjhandle _handle;
+	};
+	explicit TurboJPEGHandlePool(TurboJPEGHandleType type);
+	TurboJPEGHandlePool(const TurboJPEGHandlePool &) = delete;
+	~TurboJPEGHandlePool();
+	Lease acquire();
+private:
+	void release(tjhandle handle) noexcept;
+	TurboJPEGHandleType _type;
+	std::mutex _lock;
+	std::vector<tjhandle> _handles;
+};
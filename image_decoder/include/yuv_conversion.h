@@ -0,0 +1,16 @@
+#pragma once
+
+#include "cpu_features.h"
+#include "decoder.h"
+
+// Converts full-range (JFIF) YCbCr planes, as produced by JPEGDecompressor::processYUVPlanes(),
+// into packed BGRA with opaque alpha. For Subsampling::GRAY only planes[0] is read.
+// dstStride of 0 means width * 4.
+void convertYUVPlanesToBGRA(const unsigned char * const *planes, const int *strides,
+	unsigned width, unsigned height, Subsampling subsampling,
+	unsigned char *dst, unsigned dstStride = 0);
+
+// Same as above with an explicit kernel, SIMDInstructionSet::none is the scalar reference.
+void convertYUVPlanesToBGRA(const unsigned char * const *planes, const int *strides,
+	unsigned width, unsigned height, Subsampling subsampling,
+	unsigned char *dst, unsigned dstStride, SIMDInstructionSet instructionSet);
@@ -0,0 +1,144 @@
+#include "patch_extractor.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include <base/logging.h>
+
+#include "resampler.h"
+
+static void fillPixels(unsigned char *dst, unsigned count, const unsigned char *pixel, unsigned pixelSize)
+{
+	for (unsigned i = 0; i < count; ++i)
+		memcpy(dst + i * pixelSize, pixel, pixelSize);
+}
+
+// First destination pixel whose center lies at or beyond edge, the crop starting at cropBegin
+static unsigned getFirstPixelAtOrBeyond(double edge, double cropBegin, double pixelsPerUnit, unsigned size)
+{
+	const double position = std::ceil((edge - cropBegin) * pixelsPerUnit - 0.5);
+	return (unsigned)std::min(std::max(position, 0.), double(size));
+}
+
+PatchExtractor::PatchExtractor(const std::vector<PatchSpecification>& patches, double contextAmount, PixelFormat format)
+	: _patches(patches), _contextAmount(contextAmount)
+{
+	CHECK(!_patches.empty());
+	for (const PatchSpecification &patch : _patches)
+		CHECK(patch.size && patch.cropScale > 0) << "Patch size: " << patch.size << ", crop scale: " << patch.cropScale;
+	CHECK_GE(contextAmount, 0.);
+	_decompressor.setFormat(format);
+}
+
+const std::vector<PatchSpecification>& PatchExtractor::getPatches() const noexcept
+{
+	return _patches;
+}
+
+double PatchExtractor::getContextAmount() const noexcept
+{
+	return _contextAmount;
+}
+
+PixelFormat PatchExtractor::getFormat() const noexcept
+{
+	return _decompressor.getFormat();
+}
+
+size_t PatchExtractor::getOutputSize() const noexcept
+{
+	size_t size = 0;
+	for (const PatchSpecification &patch : _patches)
+		size += size_t(patch.size) * patch.size * _decompressor.getPixelSize();
+	return size;
+}
+
+void PatchExtractor::extract(const unsigned char* jpeg, unsigned long size, double x, double y, double w, double h, unsigned char* dst)
+{
+	CHECK(w > 0 && h > 0) << "Box: " << x << ',' << y << ',' << w << ',' << h;
+	_decompressor.reset(jpeg, size);
+	const unsigned width = _decompressor.getWidth();
+	const unsigned height = _decompressor.getHeight();
+	const unsigned pixelSize = _decompressor.getPixelSize();
+
+	const double context = _contextAmount * (w + h);
+	const double cropSize = std::sqrt((w + context) * (h + context));
+	const double centerX = x + w / 2;
+	const double centerY = y + h / 2;
+
+	// Union of all crops, and the DCT scaling factor that keeps every crop at or above its patch resolution
+	double unionSize = 0;
+	double minimumPixelsPerPatchPixel = HUGE_VAL;
+	for (const PatchSpecification &patch : _patches)
+	{
+		unionSize = std::max(unionSize, cropSize * patch.cropScale);
+		minimumPixelsPerPatchPixel = std::min(minimumPixelsPerPatchPixel, cropSize * patch.cropScale / patch.size);
+	}
+	unsigned denominator = 8;
+	while (denominator > 1 && denominator > minimumPixelsPerPatchPixel)
+		denominator /= 2;
+
+	// In frame pixels, one more pixel on each side for the bilinear taps. A union entirely outside
+	// of the frame is moved onto its nearest edge, so there is still something to take the mean of.
+	unsigned left = (unsigned)std::min(std::max(std::floor(centerX - unionSize / 2) - 1, 0.), double(width - 1));
+	unsigned top = (unsigned)std::min(std::max(std::floor(centerY - unionSize / 2) - 1, 0.), double(height - 1));
+	unsigned right = (unsigned)std::min(std::max(std::ceil(centerX + unionSize / 2) + 1, double(left + 1)), double(width));
+	unsigned bottom = (unsigned)std::min(std::max(std::ceil(centerY + unionSize / 2) + 1, double(top + 1)), double(height));
+
+	_decompressor.setScalingFactor(1, denominator);
+	const unsigned regionX = left / denominator;
+	const unsigned regionY = top / denominator;
+	const unsigned regionWidth = std::min((right + denominator - 1) / denominator, _decompressor.getScaledWidth()) - regionX;
+	const unsigned regionHeight = std::min((bottom + denominator - 1) / denominator, _decompressor.getScaledHeight()) - regionY;
+	_region.resize(size_t(regionWidth) * regionHeight * pixelSize);
+	_decompressor.process(regionX, regionY, regionWidth, regionHeight, _region.data());
+
+	uint64_t sums[4] = { 0, 0, 0, 0 };
+	const size_t numberOfPixels = size_t(regionWidth) * regionHeight;
+	for (size_t i = 0; i < numberOfPixels; ++i)
+	{
+		for (unsigned c = 0; c < pixelSize; ++c)
+			sums[c] += _region[i * pixelSize + c];
+	}
+	unsigned char mean[4];
+	for (unsigned c = 0; c < pixelSize; ++c)
+		mean[c] = (unsigned char)((sums[c] + numberOfPixels / 2) / numberOfPixels);
+
+	for (const PatchSpecification &patch : _patches)
+	{
+		const unsigned patchSize = patch.size;
+		const size_t patchStride = size_t(patchSize) * pixelSize;
+		const double crop = cropSize * patch.cropScale;
+		const double cropX = centerX - crop / 2;
+		const double cropY = centerY - crop / 2;
+		const double pixelsPerUnit = patchSize / crop;
+		// Patch pixels whose centers lie within the frame, everything else is mean
+		const unsigned x0 = getFirstPixelAtOrBeyond(0, cropX, pixelsPerUnit, patchSize);
+		const unsigned x1 = std::max(getFirstPixelAtOrBeyond(width, cropX, pixelsPerUnit, patchSize), x0);
+		const unsigned y0 = getFirstPixelAtOrBeyond(0, cropY, pixelsPerUnit, patchSize);
+		const unsigned y1 = std::max(getFirstPixelAtOrBeyond(height, cropY, pixelsPerUnit, patchSize), y0);
+
+		for (unsigned row = 0; row < patchSize; ++row)
+		{
+			unsigned char *dstRow = dst + row * patchStride;
+			if (row < y0 || row >= y1 || x0 == x1)
+			{
+				fillPixels(dstRow, patchSize, mean, pixelSize);
+				continue;
+			}
+			fillPixels(dstRow, x0, mean, pixelSize);
+			fillPixels(dstRow + x1 * pixelSize, patchSize - x1, mean, pixelSize);
+		}
+		if (x0 < x1 && y0 < y1)
+		{
+			// Frame pixel p maps to p / denominator - region offset in the decoded region
+			const double unitsPerPixel = crop / patchSize;
+			resizeBilinear(_region.data(), regionWidth, regionHeight, 0, pixelSize,
+				(cropX + x0 * unitsPerPixel) / denominator - regionX, (cropY + y0 * unitsPerPixel) / denominator - regionY,
+				(x1 - x0) * unitsPerPixel / denominator, (y1 - y0) * unitsPerPixel / denominator,
+				dst + y0 * patchStride + x0 * pixelSize, x1 - x0, y1 - y0, (unsigned)patchStride);
+		}
+		dst += patchSize * patchStride;
+	}
+}
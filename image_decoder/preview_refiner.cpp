@@ -0,0 +1,61 @@
+#include "preview_refiner.h"
+
+#include <base/logging.h>
+
+PreviewRefiner::PreviewRefiner(PixelFormat format, FrameCallback callback, uint32_t settleTime_ms, unsigned previewScalingFactorDenominator)
+	: _format(format), _callback(callback), _settleTime_ms(settleTime_ms), _previewScalingFactorDenominator(previewScalingFactorDenominator)
+{
+	CHECK(JPEGDecompressor::isScalingFactorSupported(1, previewScalingFactorDenominator)) << "Unsupported scaling factor: 1/" << previewScalingFactorDenominator;
+}
+
+void PreviewRefiner::seek(const unsigned char* src, unsigned long size)
+{
+	std::lock_guard<std::mutex> lock_guard(_lock);
+	_decompressor.reset();
+	_timer.inactivate();
+
+	_decompressor = std::make_unique<JPEGDecompressor>(src, size);
+	_decompressor->setFormat(_format);
+	_decompressor->setQuality(DecodeQuality::preview);
+	_decompressor->setScalingFactor(1, _previewScalingFactorDenominator);
+	decode();
+
+	_lastSeekTime = std::chrono::steady_clock::now();
+	_timer.activate(0, _settleTime_ms * 10000ULL);
+}
+
+void PreviewRefiner::getNumberOfWaitableObjects(uint32_t* numberOfWaitableObject)
+{
+	*numberOfWaitableObject = 1;
+}
+
+void PreviewRefiner::getWaitableObjects(HANDLE* nativeWaitableObjects)
+{
+	nativeWaitableObjects[0] = _timer.getHandle();
+}
+
+void PreviewRefiner::callback(uint32_t index)
+{
+	(index);
+	std::lock_guard<std::mutex> lock_guard(_lock);
+	if (!_decompressor || _decompressor->getQuality() == DecodeQuality::full)
+		return;
+	// A seek() may have raced the expiry, wait out the rest of its settle time
+	const auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - _lastSeekTime).count();
+	if (elapsed < (long long)_settleTime_ms)
+	{
+		_timer.activate(0, uint64_t(_settleTime_ms - elapsed) * 10000ULL);
+		return;
+	}
+	_timer.inactivate();
+
+	_decompressor->setQuality(DecodeQuality::full);
+	_decompressor->setScalingFactor(1, 1);
+	decode();
+}
+
+void PreviewRefiner::decode()
+{
+	Base::BufferLease image = _decompressor->process();
+	_callback(image.get(), _decompressor->getScaledWidth(), _decompressor->getScaledHeight(), _decompressor->getQuality());
+}
@@ -0,0 +1,195 @@
+#include "region_decoder.h"
+
+#include <csetjmp>
+#include <cstdio>
+#include <cstring>
+
+#include <base/logging.h>
+
+#include <jpeglib.h>
+
+// libjpeg reports errors through error_exit(), which must not return. It jumps back to the
+// setjmp() of the running call, so no object with a destructor may live in those functions.
+struct RegionDecoderErrorManager
+{
+	jpeg_error_mgr pub;
+	jmp_buf jump;
+	char message[JMSG_LENGTH_MAX];
+};
+
+struct JPEGRegionDecompressor::Context
+{
+	jpeg_decompress_struct cinfo;
+	RegionDecoderErrorManager error;
+};
+
+static void errorExit(j_common_ptr cinfo)
+{
+	RegionDecoderErrorManager *error = (RegionDecoderErrorManager*)cinfo->err;
+	(*cinfo->err->format_message)(cinfo, error->message);
+	longjmp(error->jump, 1);
+}
+
+static void outputMessage(j_common_ptr)
+{
+	// Warnings (corrupt data that could be recovered from) are not printed to stderr
+}
+
+static J_COLOR_SPACE getColorSpace(PixelFormat format)
+{
+	switch (format)
+	{
+	case PixelFormat::RGB:
+		return JCS_EXT_RGB;
+	case PixelFormat::BGR:
+		return JCS_EXT_BGR;
+	case PixelFormat::RGBA:
+		return JCS_EXT_RGBA;
+	case PixelFormat::BGRA:
+		return JCS_EXT_BGRA;
+	case PixelFormat::ABGR:
+		return JCS_EXT_ABGR;
+	case PixelFormat::ARGB:
+		return JCS_EXT_ARGB;
+	case PixelFormat::GRAY:
+		return JCS_GRAYSCALE;
+	default:
+		UNREACHABLE_ERROR;
+	}
+}
+
+static bool createDecompressor(jpeg_decompress_struct *cinfo, RegionDecoderErrorManager *error)
+{
+	cinfo->err = jpeg_std_error(&error->pub);
+	error->pub.error_exit = errorExit;
+	error->pub.output_message = outputMessage;
+	if (setjmp(error->jump))
+		return false;
+	jpeg_create_decompress(cinfo);
+	return true;
+}
+
+static bool readHeader(jpeg_decompress_struct *cinfo, RegionDecoderErrorManager *error, const unsigned char *src, unsigned long size)
+{
+	if (setjmp(error->jump))
+	{
+		jpeg_abort_decompress(cinfo);
+		return false;
+	}
+	jpeg_mem_src(cinfo, src, size);
+	jpeg_read_header(cinfo, TRUE);
+	return true;
+}
+
+static bool decodeRegion(jpeg_decompress_struct *cinfo, RegionDecoderErrorManager *error, J_COLOR_SPACE colorSpace,
+	unsigned scaleNumerator, unsigned scaleDenominator, unsigned x, unsigned y, unsigned width, unsigned height,
+	unsigned pixelSize, unsigned char *dst, size_t dstStride)
+{
+	if (setjmp(error->jump))
+	{
+		jpeg_abort_decompress(cinfo);
+		return false;
+	}
+	cinfo->out_color_space = colorSpace;
+	cinfo->scale_num = scaleNumerator;
+	cinfo->scale_denom = scaleDenominator;
+	jpeg_start_decompress(cinfo);
+
+	// Widened to iMCU boundaries by libjpeg, the requested columns start at x - xOffset.
+	// Fancy upsampling treats the cropped edges like image edges, one more column on each
+	// side keeps the requested ones identical to a full decode.
+	JDIMENSION xOffset = x ? x - 1 : 0;
+	JDIMENSION croppedWidth = (x + width < cinfo->output_width ? x + width + 1 : cinfo->output_width) - xOffset;
+	if (croppedWidth != cinfo->output_width)
+		jpeg_crop_scanline(cinfo, &xOffset, &croppedWidth);
+	JSAMPARRAY row = (*cinfo->mem->alloc_sarray)((j_common_ptr)cinfo, JPOOL_IMAGE, croppedWidth * pixelSize, 1);
+	if (y)
+		jpeg_skip_scanlines(cinfo, y);
+	for (unsigned i = 0; i < height; ++i)
+	{
+		jpeg_read_scanlines(cinfo, row, 1);
+		memcpy(dst + i * dstStride, row[0] + (x - xOffset) * pixelSize, size_t(width) * pixelSize);
+	}
+	// The remaining rows are never decoded
+	jpeg_abort_decompress(cinfo);
+	return true;
+}
+
+JPEGRegionDecompressor::JPEGRegionDecompressor()
+	: _context(new Context), _src(nullptr), _srcSize(0), _width(0), _height(0), _format(PixelFormat::RGB), _scalingNumerator(1), _scalingDenominator(1)
+{
+	CHECK(createDecompressor(&_context->cinfo, &_context->error)) << _context->error.message;
+}
+
+JPEGRegionDecompressor::~JPEGRegionDecompressor() noexcept
+{
+	jpeg_destroy_decompress(&_context->cinfo);
+}
+
+void JPEGRegionDecompressor::reset(const unsigned char* src, unsigned long size)
+{
+	_src = src;
+	_srcSize = size;
+	CHECK(readHeader(&_context->cinfo, &_context->error, src, size)) << _context->error.message;
+	_width = _context->cinfo.image_width;
+	_height = _context->cinfo.image_height;
+	jpeg_abort_decompress(&_context->cinfo);
+}
+
+unsigned JPEGRegionDecompressor::getWidth() const noexcept
+{
+	return _width;
+}
+
+unsigned JPEGRegionDecompressor::getHeight() const noexcept
+{
+	return _height;
+}
+
+void JPEGRegionDecompressor::setFormat(PixelFormat format)
+{
+	getColorSpace(format);
+	_format = format;
+}
+
+PixelFormat JPEGRegionDecompressor::getFormat() const noexcept
+{
+	return _format;
+}
+
+unsigned JPEGRegionDecompressor::getPixelSize() const noexcept
+{
+	return ::getPixelSize(_format);
+}
+
+void JPEGRegionDecompressor::setScalingFactor(unsigned numerator, unsigned denominator)
+{
+	CHECK(JPEGDecompressor::isScalingFactorSupported(numerator, denominator)) << "Scaling factor: " << numerator << '/' << denominator;
+	_scalingNumerator = numerator;
+	_scalingDenominator = denominator;
+}
+
+unsigned JPEGRegionDecompressor::getScaledWidth() const noexcept
+{
+	return (_width * _scalingNumerator + _scalingDenominator - 1) / _scalingDenominator;
+}
+
+unsigned JPEGRegionDecompressor::getScaledHeight() const noexcept
+{
+	return (_height * _scalingNumerator + _scalingDenominator - 1) / _scalingDenominator;
+}
+
+void JPEGRegionDecompressor::process(unsigned x, unsigned y, unsigned width, unsigned height, unsigned char* dst, unsigned dstStride)
+{
+	CHECK(_src);
+	CHECK(width && height);
+	CHECK_LE(uint64_t(x) + width, getScaledWidth());
+	CHECK_LE(uint64_t(y) + height, getScaledHeight());
+	const unsigned pixelSize = getPixelSize();
+	if (!dstStride)
+		dstStride = width * pixelSize;
+	// The header is read again, a decompression can not be restarted once it went past jpeg_start_decompress()
+	CHECK(readHeader(&_context->cinfo, &_context->error, _src, _srcSize)) << _context->error.message;
+	CHECK(decodeRegion(&_context->cinfo, &_context->error, getColorSpace(_format), _scalingNumerator, _scalingDenominator,
+		x, y, width, height, pixelSize, dst, dstStride)) << _context->error.message;
+}
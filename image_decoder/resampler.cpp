@@ -0,0 +1,563 @@
+#include "resampler.h"
+
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstring>
+#include <vector>
+#include <ppl.h>
+
+#include <base/logging.h>
+
+#include <emmintrin.h>
+#include <immintrin.h>
+
+// Destination rows per tile, and the destination size below which tiling is not worth the scheduling
+static const unsigned ROWS_PER_TILE = 32;
+static const size_t MINIMUM_PIXELS_FOR_TILING = 256 * 256;
+
+struct ResamplingJob
+{
+	const unsigned char *src;
+	unsigned srcWidth;
+	unsigned srcHeight;
+	size_t srcStride;
+	unsigned char *dst;
+	unsigned dstWidth;
+	unsigned dstHeight;
+	size_t dstStride;
+	unsigned channels;
+	SIMDInstructionSet instructionSet;
+};
+
+// Bilinear is separable: each source row that is needed gets resampled horizontally into 16 bit
+// intermediates (value * 128), two of them are kept and blended vertically into each destination row.
+// The SIMD kernels use the identical integer arithmetic, so all kernels are bit exact.
+static const int WEIGHT_BITS = 7;
+static const int WEIGHT_ONE = 1 << WEIGHT_BITS;
+static const int ROUNDING = 1 << (2 * WEIGHT_BITS - 1);
+
+struct BilinearTaps
+{
+	std::vector<unsigned> xIndices;
+	std::vector<int16_t> xWeights;
+	std::vector<unsigned> yIndices;
+	std::vector<int16_t> yWeights;
+};
+
+// For each destination pixel: the left (top) source pixel and the weight of the one after it.
+// A tap never points at the last source pixel unless the source has a single pixel,
+// so the SIMD kernels can always load a pair of adjacent pixels.
+static void computeBilinearTaps(double regionOffset, double regionSize, unsigned srcSize, unsigned dstSize,
+	std::vector<unsigned> &indices, std::vector<int16_t> &weights)
+{
+	indices.resize(dstSize);
+	weights.resize(dstSize);
+	const double scale = regionSize / dstSize;
+	for (unsigned i = 0; i < dstSize; ++i)
+	{
+		double position = regionOffset + (i + 0.5) * scale - 0.5;
+		position = std::min(std::max(position, 0.), double(srcSize - 1));
+		unsigned index = (unsigned)position;
+		int weight = (int)std::lround((position - index) * WEIGHT_ONE);
+		if (weight == WEIGHT_ONE)
+		{
+			++index;
+			weight = 0;
+		}
+		if (srcSize > 1 && index == srcSize - 1)
+		{
+			--index;
+			weight = WEIGHT_ONE;
+		}
+		indices[i] = index;
+		weights[i] = (int16_t)weight;
+	}
+}
+
+static void resizeRowBilinearScalar(const unsigned char *src, unsigned srcWidth, unsigned channels,
+	const unsigned *xIndices, const int16_t *xWeights, unsigned begin, unsigned dstWidth, int16_t *dst)
+{
+	for (unsigned x = begin; x < dstWidth; ++x)
+	{
+		const unsigned char *pixel0 = src + xIndices[x] * channels;
+		const unsigned char *pixel1 = src + std::min(xIndices[x] + 1, srcWidth - 1) * channels;
+		const int weight = xWeights[x];
+		for (unsigned c = 0; c < channels; ++c)
+			dst[x * channels + c] = (int16_t)(pixel0[c] * (WEIGHT_ONE - weight) + pixel1[c] * weight);
+	}
+}
+
+// One destination pixel per iteration: both source pixels are loaded with a single 8 byte load and
+// interleaved channel by channel, so one madd against (1 - w, w) yields every channel.
+// Stores 4 intermediates per pixel, dst needs 4 - channels elements of padding.
+template <unsigned channels>
+static unsigned resizeRowBilinearSSE2(const unsigned char *src, unsigned srcWidth,
+	const unsigned *xIndices, const int16_t *xWeights, unsigned dstWidth, int16_t *dst)
+{
+	const __m128i zero = _mm_setzero_si128();
+	const unsigned rowSize = srcWidth * channels;
+	unsigned x = 0;
+	// The indices never decrease, the remaining pixels are left to the scalar kernel
+	for (; x < dstWidth && xIndices[x] * channels + 8 <= rowSize; ++x)
+	{
+		const __m128i pixels = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(src + xIndices[x] * channels)), zero);
+		const __m128i pairs = _mm_unpacklo_epi16(pixels, _mm_srli_si128(pixels, channels * 2));
+		const int weight = xWeights[x];
+		const __m128i weights = _mm_set1_epi32((weight << 16) | (WEIGHT_ONE - weight));
+		const __m128i sum = _mm_madd_epi16(pairs, weights);
+		_mm_storel_epi64((__m128i*)(dst + x * channels), _mm_packs_epi32(sum, sum));
+	}
+	return x;
+}
+
+static void blendRowsScalar(const int16_t *row0, const int16_t *row1, int weight, unsigned begin, unsigned size, unsigned char *dst)
+{
+	for (unsigned x = begin; x < size; ++x)
+		dst[x] = (unsigned char)((row0[x] * (WEIGHT_ONE - weight) + row1[x] * weight + ROUNDING) >> (2 * WEIGHT_BITS));
+}
+
+static inline __m128i blend8SSE2(__m128i row0, __m128i row1, __m128i weights, __m128i rounding)
+{
+	__m128i lo = _mm_madd_epi16(_mm_unpacklo_epi16(row0, row1), weights);
+	__m128i hi = _mm_madd_epi16(_mm_unpackhi_epi16(row0, row1), weights);
+	lo = _mm_srai_epi32(_mm_add_epi32(lo, rounding), 2 * WEIGHT_BITS);
+	hi = _mm_srai_epi32(_mm_add_epi32(hi, rounding), 2 * WEIGHT_BITS);
+	return _mm_packs_epi32(lo, hi);
+}
+
+static unsigned blendRowsSSE2(const int16_t *row0, const int16_t *row1, int weight, unsigned begin, unsigned size, unsigned char *dst)
+{
+	const __m128i weights = _mm_set1_epi32((weight << 16) | (WEIGHT_ONE - weight));
+	const __m128i rounding = _mm_set1_epi32(ROUNDING);
+	unsigned x = begin;
+	for (; x + 16 <= size; x += 16)
+	{
+		const __m128i lo = blend8SSE2(_mm_loadu_si128((const __m128i*)(row0 + x)), _mm_loadu_si128((const __m128i*)(row1 + x)), weights, rounding);
+		const __m128i hi = blend8SSE2(_mm_loadu_si128((const __m128i*)(row0 + x + 8)), _mm_loadu_si128((const __m128i*)(row1 + x + 8)), weights, rounding);
+		_mm_storeu_si128((__m128i*)(dst + x), _mm_packus_epi16(lo, hi));
+	}
+	return x;
+}
+
+// unpack and packs both work within 128 bit lanes, the 16 results come out in order
+static inline __m256i blend16AVX2(__m256i row0, __m256i row1, __m256i weights, __m256i rounding)
+{
+	__m256i lo = _mm256_madd_epi16(_mm256_unpacklo_epi16(row0, row1), weights);
+	__m256i hi = _mm256_madd_epi16(_mm256_unpackhi_epi16(row0, row1), weights);
+	lo = _mm256_srai_epi32(_mm256_add_epi32(lo, rounding), 2 * WEIGHT_BITS);
+	hi = _mm256_srai_epi32(_mm256_add_epi32(hi, rounding), 2 * WEIGHT_BITS);
+	return _mm256_packs_epi32(lo, hi);
+}
+
+static unsigned blendRowsAVX2(const int16_t *row0, const int16_t *row1, int weight, unsigned size, unsigned char *dst)
+{
+	const __m256i weights = _mm256_set1_epi32((weight << 16) | (WEIGHT_ONE - weight));
+	const __m256i rounding = _mm256_set1_epi32(ROUNDING);
+	unsigned x = 0;
+	for (; x + 32 <= size; x += 32)
+	{
+		const __m256i lo = blend16AVX2(_mm256_loadu_si256((const __m256i*)(row0 + x)), _mm256_loadu_si256((const __m256i*)(row1 + x)), weights, rounding);
+		const __m256i hi = blend16AVX2(_mm256_loadu_si256((const __m256i*)(row0 + x + 16)), _mm256_loadu_si256((const __m256i*)(row1 + x + 16)), weights, rounding);
+		// packus interleaves the lanes of lo and hi
+		_mm256_storeu_si256((__m256i*)(dst + x), _mm256_permute4x64_epi64(_mm256_packus_epi16(lo, hi), 0xD8));
+	}
+	return x;
+}
+
+typedef unsigned(*BilinearRowKernel)(const unsigned char *, unsigned, const unsigned *, const int16_t *, unsigned, int16_t *);
+
+static BilinearRowKernel selectBilinearRowKernel(unsigned channels, SIMDInstructionSet instructionSet)
+{
+	if (instructionSet == SIMDInstructionSet::none)
+		return nullptr;
+	// Gather bound, AVX2 has nothing over SSE2 here
+	switch (channels)
+	{
+	case 1:
+		return resizeRowBilinearSSE2<1>;
+	case 2:
+		return resizeRowBilinearSSE2<2>;
+	case 3:
+		return resizeRowBilinearSSE2<3>;
+	case 4:
+		return resizeRowBilinearSSE2<4>;
+	default:
+		UNREACHABLE_ERROR;
+	}
+}
+
+static void resizeRowsBilinear(const ResamplingJob &job, const BilinearTaps &taps, unsigned yBegin, unsigned yEnd)
+{
+	const unsigned rowSize = job.dstWidth * job.channels;
+	// Padding for the 4 intermediates the SIMD row kernels store per pixel
+	const unsigned rowCapacity = rowSize + 4;
+	std::vector<int16_t> rowBuffer(2 * rowCapacity);
+	int16_t *rows[2] = { rowBuffer.data(), rowBuffer.data() + rowCapacity };
+	unsigned rowSources[2] = { UINT_MAX, UINT_MAX };
+	const BilinearRowKernel rowKernel = job.srcWidth > 1 ? selectBilinearRowKernel(job.channels, job.instructionSet) : nullptr;
+
+	// Returns the horizontally resampled source row, keeping the slot that holds the other row of the pair
+	auto fetchRow = [&](unsigned index, unsigned keep) -> const int16_t*
+	{
+		for (unsigned slot = 0; slot < 2; ++slot)
+		{
+			if (rowSources[slot] == index)
+				return rows[slot];
+		}
+		const unsigned slot = rowSources[0] == keep ? 1 : 0;
+		const unsigned char *srcRow = job.src + index * job.srcStride;
+		unsigned x = 0;
+		if (rowKernel)
+			x = rowKernel(srcRow, job.srcWidth, taps.xIndices.data(), taps.xWeights.data(), job.dstWidth, rows[slot]);
+		resizeRowBilinearScalar(srcRow, job.srcWidth, job.channels, taps.xIndices.data(), taps.xWeights.data(), x, job.dstWidth, rows[slot]);
+		rowSources[slot] = index;
+		return rows[slot];
+	};
+
+	for (unsigned y = yBegin; y < yEnd; ++y)
+	{
+		const unsigned index0 = taps.yIndices[y];
+		const unsigned index1 = std::min(index0 + 1, job.srcHeight - 1);
+		const int16_t *row0 = fetchRow(index0, index1);
+		const int16_t *row1 = fetchRow(index1, index0);
+		unsigned char *dstRow = job.dst + y * job.dstStride;
+		unsigned x = 0;
+		if (job.instructionSet == SIMDInstructionSet::avx2)
+			x = blendRowsAVX2(row0, row1, taps.yWeights[y], rowSize, dstRow);
+		if (job.instructionSet != SIMDInstructionSet::none)
+			x = blendRowsSSE2(row0, row1, taps.yWeights[y], x, rowSize, dstRow);
+		blendRowsScalar(row0, row1, taps.yWeights[y], x, rowSize, dstRow);
+	}
+}
+
+// Nearest: a copy of the source pixel under each destination pixel center, rows that map to the
+// same source row as the previous one are copied from it
+struct NearestTaps
+{
+	// Byte offsets within a source row
+	std::vector<uint32_t> xOffsets;
+	std::vector<unsigned> yIndices;
+};
+
+static void computeNearestTaps(unsigned srcSize, unsigned dstSize, unsigned step, std::vector<uint32_t> &taps)
+{
+	taps.resize(dstSize);
+	// Divided last, so centers that land exactly on a pixel edge are not rounded below it
+	for (unsigned i = 0; i < dstSize; ++i)
+		taps[i] = std::min((unsigned)((i + 0.5) * srcSize / dstSize), srcSize - 1) * step;
+}
+
+template <unsigned channels>
+static void resizeRowNearestScalar(const unsigned char *src, const uint32_t *xOffsets, unsigned begin, unsigned dstWidth, unsigned char *dst)
+{
+	for (unsigned x = begin; x < dstWidth; ++x)
+		memcpy(dst + x * channels, src + xOffsets[x], channels);
+}
+
+// 8 pixels per gather, 4 channel formats only
+static unsigned resizeRowNearestAVX2(const unsigned char *src, const uint32_t *xOffsets, unsigned dstWidth, unsigned char *dst)
+{
+	unsigned x = 0;
+	for (; x + 8 <= dstWidth; x += 8)
+	{
+		const __m256i offsets = _mm256_loadu_si256((const __m256i*)(xOffsets + x));
+		_mm256_storeu_si256((__m256i*)(dst + x * 4), _mm256_i32gather_epi32((const int*)src, offsets, 1));
+	}
+	return x;
+}
+
+typedef void(*NearestRowKernel)(const unsigned char *, const uint32_t *, unsigned, unsigned, unsigned char *);
+
+static NearestRowKernel selectNearestRowKernel(unsigned channels)
+{
+	switch (channels)
+	{
+	case 1:
+		return resizeRowNearestScalar<1>;
+	case 2:
+		return resizeRowNearestScalar<2>;
+	case 3:
+		return resizeRowNearestScalar<3>;
+	case 4:
+		return resizeRowNearestScalar<4>;
+	default:
+		UNREACHABLE_ERROR;
+	}
+}
+
+static void resizeRowsNearest(const ResamplingJob &job, const NearestTaps &taps, unsigned yBegin, unsigned yEnd)
+{
+	const NearestRowKernel rowKernel = selectNearestRowKernel(job.channels);
+	const size_t rowSize = size_t(job.dstWidth) * job.channels;
+	for (unsigned y = yBegin; y < yEnd; ++y)
+	{
+		unsigned char *dstRow = job.dst + y * job.dstStride;
+		if (y > yBegin && taps.yIndices[y] == taps.yIndices[y - 1])
+		{
+			memcpy(dstRow, dstRow - job.dstStride, rowSize);
+			continue;
+		}
+		const unsigned char *srcRow = job.src + taps.yIndices[y] * job.srcStride;
+		unsigned x = 0;
+		if (job.instructionSet == SIMDInstructionSet::avx2 && job.channels == 4)
+			x = resizeRowNearestAVX2(srcRow, taps.xOffsets.data(), job.dstWidth, dstRow);
+		rowKernel(srcRow, taps.xOffsets.data(), x, job.dstWidth, dstRow);
+	}
+}
+
+// Area: every source pixel weighted by the fraction of the destination pixel it covers, separable
+// in float. Horizontally resampled source rows are kept in a ring large enough for one destination row,
+// then accumulated vertically. Every kernel adds the same products in the same order, so the
+// SIMD kernels are bit exact as well.
+struct AreaAxisTaps
+{
+	std::vector<unsigned> begins;
+	std::vector<unsigned> counts;
+	std::vector<unsigned> offsets;
+	std::vector<float> weights;
+	unsigned maximumCount;
+};
+
+struct AreaTaps
+{
+	AreaAxisTaps x;
+	AreaAxisTaps y;
+};
+
+static void computeAreaTaps(unsigned srcSize, unsigned dstSize, AreaAxisTaps &taps)
+{
+	taps.begins.resize(dstSize);
+	taps.counts.resize(dstSize);
+	taps.offsets.resize(dstSize);
+	taps.weights.clear();
+	taps.maximumCount = 0;
+	const double scale = double(srcSize) / dstSize;
+	// Overlaps below this are rounding errors of the footprint edges
+	const double epsilon = 1e-9;
+	for (unsigned i = 0; i < dstSize; ++i)
+	{
+		const double footprintBegin = i * scale;
+		const double footprintEnd = std::min((i + 1) * scale, double(srcSize));
+		const unsigned begin = (unsigned)std::floor(footprintBegin + epsilon);
+		const unsigned end = std::max(std::min((unsigned)std::ceil(footprintEnd - epsilon), srcSize), begin + 1);
+		taps.begins[i] = begin;
+		taps.counts[i] = end - begin;
+		taps.offsets[i] = (unsigned)taps.weights.size();
+		for (unsigned j = begin; j < end; ++j)
+		{
+			const double overlap = std::min(double(j + 1), footprintEnd) - std::max(double(j), footprintBegin);
+			taps.weights.push_back(float(std::max(overlap, 0.) / scale));
+		}
+		taps.maximumCount = std::max(taps.maximumCount, end - begin);
+	}
+}
+
+template <unsigned channels>
+static void resizeRowArea(const unsigned char *src, const AreaAxisTaps &taps, unsigned dstWidth, float *dst)
+{
+	for (unsigned x = 0; x < dstWidth; ++x)
+	{
+		const unsigned char *pixels = src + taps.begins[x] * channels;
+		const float *weights = taps.weights.data() + taps.offsets[x];
+		const unsigned count = taps.counts[x];
+		for (unsigned c = 0; c < channels; ++c)
+		{
+			float sum = 0;
+			for (unsigned k = 0; k < count; ++k)
+				sum += pixels[k * channels + c] * weights[k];
+			dst[x * channels + c] = sum;
+		}
+	}
+}
+
+typedef void(*AreaRowKernel)(const unsigned char *, const AreaAxisTaps &, unsigned, float *);
+
+static AreaRowKernel selectAreaRowKernel(unsigned channels)
+{
+	switch (channels)
+	{
+	case 1:
+		return resizeRowArea<1>;
+	case 2:
+		return resizeRowArea<2>;
+	case 3:
+		return resizeRowArea<3>;
+	case 4:
+		return resizeRowArea<4>;
+	default:
+		UNREACHABLE_ERROR;
+	}
+}
+
+static void accumulateRowScalar(const float *row, float weight, unsigned begin, unsigned size, float *sum)
+{
+	for (unsigned x = begin; x < size; ++x)
+		sum[x] = sum[x] + row[x] * weight;
+}
+
+static unsigned accumulateRowSSE2(const float *row, float weight, unsigned begin, unsigned size, float *sum)
+{
+	const __m128 weights = _mm_set1_ps(weight);
+	unsigned x = begin;
+	for (; x + 4 <= size; x += 4)
+		_mm_storeu_ps(sum + x, _mm_add_ps(_mm_loadu_ps(sum + x), _mm_mul_ps(_mm_loadu_ps(row + x), weights)));
+	return x;
+}
+
+static unsigned accumulateRowAVX2(const float *row, float weight, unsigned size, float *sum)
+{
+	const __m256 weights = _mm256_set1_ps(weight);
+	unsigned x = 0;
+	for (; x + 8 <= size; x += 8)
+		_mm256_storeu_ps(sum + x, _mm256_add_ps(_mm256_loadu_ps(sum + x), _mm256_mul_ps(_mm256_loadu_ps(row + x), weights)));
+	return x;
+}
+
+static void storeRowScalar(const float *sum, unsigned begin, unsigned size, unsigned char *dst)
+{
+	for (unsigned x = begin; x < size; ++x)
+		dst[x] = (unsigned char)std::min((int)(sum[x] + 0.5f), 255);
+}
+
+static unsigned storeRowSSE2(const float *sum, unsigned size, unsigned char *dst)
+{
+	const __m128 half = _mm_set1_ps(0.5f);
+	unsigned x = 0;
+	for (; x + 16 <= size; x += 16)
+	{
+		const __m128i a = _mm_cvttps_epi32(_mm_add_ps(_mm_loadu_ps(sum + x), half));
+		const __m128i b = _mm_cvttps_epi32(_mm_add_ps(_mm_loadu_ps(sum + x + 4), half));
+		const __m128i c = _mm_cvttps_epi32(_mm_add_ps(_mm_loadu_ps(sum + x + 8), half));
+		const __m128i d = _mm_cvttps_epi32(_mm_add_ps(_mm_loadu_ps(sum + x + 12), half));
+		_mm_storeu_si128((__m128i*)(dst + x), _mm_packus_epi16(_mm_packs_epi32(a, b), _mm_packs_epi32(c, d)));
+	}
+	return x;
+}
+
+static void resizeRowsArea(const ResamplingJob &job, const AreaTaps &taps, unsigned yBegin, unsigned yEnd)
+{
+	const AreaRowKernel rowKernel = selectAreaRowKernel(job.channels);
+	const unsigned rowSize = job.dstWidth * job.channels;
+	// The source rows of one destination row never span more than maximumCount consecutive rows
+	const unsigned numberOfSlots = taps.y.maximumCount + 1;
+	std::vector<float> rowBuffer(size_t(numberOfSlots + 1) * rowSize);
+	std::vector<unsigned> rowSources(numberOfSlots, UINT_MAX);
+	float *sum = rowBuffer.data() + size_t(numberOfSlots) * rowSize;
+
+	for (unsigned y = yBegin; y < yEnd; ++y)
+	{
+		std::fill(sum, sum + rowSize, 0.f);
+		const float *weights = taps.y.weights.data() + taps.y.offsets[y];
+		for (unsigned k = 0; k < taps.y.counts[y]; ++k)
+		{
+			const unsigned index = taps.y.begins[y] + k;
+			const unsigned slot = index % numberOfSlots;
+			float *row = rowBuffer.data() + size_t(slot) * rowSize;
+			if (rowSources[slot] != index)
+			{
+				rowKernel(job.src + index * job.srcStride, taps.x, job.dstWidth, row);
+				rowSources[slot] = index;
+			}
+			unsigned x = 0;
+			if (job.instructionSet == SIMDInstructionSet::avx2)
+				x = accumulateRowAVX2(row, weights[k], rowSize, sum);
+			if (job.instructionSet != SIMDInstructionSet::none)
+				x = accumulateRowSSE2(row, weights[k], x, rowSize, sum);
+			accumulateRowScalar(row, weights[k], x, rowSize, sum);
+		}
+		unsigned char *dstRow = job.dst + y * job.dstStride;
+		unsigned x = 0;
+		if (job.instructionSet != SIMDInstructionSet::none)
+			x = storeRowSSE2(sum, rowSize, dstRow);
+		storeRowScalar(sum, x, rowSize, dstRow);
+	}
+}
+
+template <typename Function>
+static void forEachTile(unsigned dstWidth, unsigned dstHeight, bool parallel, const Function &function)
+{
+	if (!parallel || size_t(dstWidth) * dstHeight < MINIMUM_PIXELS_FOR_TILING)
+	{
+		function(0, dstHeight);
+		return;
+	}
+	const unsigned numberOfTiles = (dstHeight + ROWS_PER_TILE - 1) / ROWS_PER_TILE;
+	Concurrency::parallel_for(0u, numberOfTiles, [&](unsigned tile)
+	{
+		function(tile * ROWS_PER_TILE, std::min((tile + 1) * ROWS_PER_TILE, dstHeight));
+	});
+}
+
+void resizeImage(const unsigned char* src, unsigned srcWidth, unsigned srcHeight, unsigned srcStride,
+	unsigned char* dst, unsigned dstWidth, unsigned dstHeight, unsigned dstStride,
+	PixelFormat format, ResamplingFilter filter)
+{
+	resizeImage(src, srcWidth, srcHeight, srcStride, dst, dstWidth, dstHeight, dstStride,
+		format, filter, getBestSupportedInstructionSet(), true);
+}
+
+void resizeImage(const unsigned char* src, unsigned srcWidth, unsigned srcHeight, unsigned srcStride,
+	unsigned char* dst, unsigned dstWidth, unsigned dstHeight, unsigned dstStride,
+	PixelFormat format, ResamplingFilter filter, SIMDInstructionSet instructionSet, bool parallel)
+{
+	CHECK(srcWidth && srcHeight && dstWidth && dstHeight);
+	const unsigned channels = getPixelSize(format);
+	ResamplingJob job = { src, srcWidth, srcHeight, srcStride ? srcStride : srcWidth * channels,
+		dst, dstWidth, dstHeight, dstStride ? dstStride : dstWidth * channels, channels, instructionSet };
+
+	switch (filter)
+	{
+	case ResamplingFilter::nearest:
+	{
+		NearestTaps taps;
+		computeNearestTaps(srcWidth, dstWidth, channels, taps.xOffsets);
+		std::vector<uint32_t> yIndices;
+		computeNearestTaps(srcHeight, dstHeight, 1, yIndices);
+		taps.yIndices.assign(yIndices.begin(), yIndices.end());
+		forEachTile(dstWidth, dstHeight, parallel, [&](unsigned yBegin, unsigned yEnd) { resizeRowsNearest(job, taps, yBegin, yEnd); });
+		break;
+	}
+	case ResamplingFilter::bilinear:
+	{
+		BilinearTaps taps;
+		computeBilinearTaps(0, srcWidth, srcWidth, dstWidth, taps.xIndices, taps.xWeights);
+		computeBilinearTaps(0, srcHeight, srcHeight, dstHeight, taps.yIndices, taps.yWeights);
+		forEachTile(dstWidth, dstHeight, parallel, [&](unsigned yBegin, unsigned yEnd) { resizeRowsBilinear(job, taps, yBegin, yEnd); });
+		break;
+	}
+	case ResamplingFilter::area:
+	{
+		AreaTaps taps;
+		computeAreaTaps(srcWidth, dstWidth, taps.x);
+		computeAreaTaps(srcHeight, dstHeight, taps.y);
+		forEachTile(dstWidth, dstHeight, parallel, [&](unsigned yBegin, unsigned yEnd) { resizeRowsArea(job, taps, yBegin, yEnd); });
+		break;
+	}
+	default:
+		UNREACHABLE_ERROR;
+	}
+}
+
+void resizeBilinear(const unsigned char* src, unsigned srcWidth, unsigned srcHeight, unsigned srcStride, unsigned channels,
+	double regionX, double regionY, double regionWidth, double regionHeight,
+	unsigned char* dst, unsigned dstWidth, unsigned dstHeight, unsigned dstStride)
+{
+	resizeBilinear(src, srcWidth, srcHeight, srcStride, channels, regionX, regionY, regionWidth, regionHeight,
+		dst, dstWidth, dstHeight, dstStride, getBestSupportedInstructionSet());
+}
+
+void resizeBilinear(const unsigned char* src, unsigned srcWidth, unsigned srcHeight, unsigned srcStride, unsigned channels,
+	double regionX, double regionY, double regionWidth, double regionHeight,
+	unsigned char* dst, unsigned dstWidth, unsigned dstHeight, unsigned dstStride, SIMDInstructionSet instructionSet)
+{
+	CHECK(channels >= 1 && channels <= 4) << "Channels: " << channels;
+	CHECK(srcWidth && srcHeight && dstWidth && dstHeight);
+	CHECK(regionWidth > 0 && regionHeight > 0);
+	ResamplingJob job = { src, srcWidth, srcHeight, srcStride ? srcStride : srcWidth * channels,
+		dst, dstWidth, dstHeight, dstStride ? dstStride : dstWidth * channels, channels, instructionSet };
+	BilinearTaps taps;
+	computeBilinearTaps(regionX, regionWidth, srcWidth, dstWidth, taps.xIndices, taps.xWeights);
+	computeBilinearTaps(regionY, regionHeight, srcHeight, dstHeight, taps.yIndices, taps.yWeights);
+	resizeRowsBilinear(job, taps, 0, dstHeight);
+}
@@ -0,0 +1,142 @@
+#include "sequence_archive.h"
+
+#include <cstring>
+#include <limits>
+
+#include <base/logging.h>
+
+static const char SEQUENCE_ARCHIVE_MAGIC[8] = { 'T', 'A', 'T', 'S', 'E', 'Q', '\0', '\0' };
+static const uint32_t SEQUENCE_ARCHIVE_VERSION = 1;
+
+SequenceArchiveWriter::SequenceArchiveWriter(const std::wstring& path, bool hasRecords)
+	: _file(path, Base::File::Mode::write | Base::File::Mode::create_always), _offset(sizeof(SequenceArchiveHeader)), _hasRecords(hasRecords), _finished(false)
+{
+	// Placeholder, rewritten by finish()
+	SequenceArchiveHeader header = {};
+	CHECK_EQ(_file.write((const unsigned char*)&header, 0, sizeof(header)), sizeof(header));
+}
+
+void SequenceArchiveWriter::addFrame(const std::wstring& name, const unsigned char* jpeg, uint32_t size, const SequenceArchiveRecord* record)
+{
+	CHECK(!_finished);
+	CHECK(!_hasRecords || record);
+	CHECK_LT(_entries.size(), (size_t)std::numeric_limits<uint32_t>::max());
+	CHECK_LE(_names.size() + name.size(), (size_t)std::numeric_limits<uint32_t>::max());
+	CHECK_EQ(_file.write(jpeg, _offset, size), size);
+
+	SequenceArchiveFrameEntry entry = {};
+	entry.offset = _offset;
+	entry.size = size;
+	entry.nameOffset = (uint32_t)_names.size();
+	entry.nameLength = (uint32_t)name.size();
+	_entries.push_back(entry);
+	_names += name;
+	if (_hasRecords)
+		_records.push_back(*record);
+	_offset += size;
+}
+
+void SequenceArchiveWriter::addFrameFromFile(const std::wstring& name, const std::wstring& path, const SequenceArchiveRecord* record)
+{
+	// Read front to back once
+	Base::MemoryMappedIO file(path.c_str(), Base::MemoryMappedIO::AccessHint::sequential);
+	const uint64_t size = file.getSize();
+	CHECK_LE(size, (uint64_t)std::numeric_limits<uint32_t>::max());
+	addFrame(name, file.getPtr(), (uint32_t)size, record);
+}
+
+void SequenceArchiveWriter::finish()
+{
+	CHECK(!_finished);
+	SequenceArchiveHeader header = {};
+	memcpy(header.magic, SEQUENCE_ARCHIVE_MAGIC, sizeof(header.magic));
+	header.version = SEQUENCE_ARCHIVE_VERSION;
+	header.numberOfFrames = (uint32_t)_entries.size();
+	header.hasRecords = _hasRecords;
+
+	uint64_t offset = _offset;
+	header.indexOffset = offset;
+	const uint64_t indexSize = _entries.size() * sizeof(SequenceArchiveFrameEntry);
+	CHECK_EQ(_file.write((const unsigned char*)_entries.data(), offset, indexSize), indexSize);
+	offset += indexSize;
+
+	if (_hasRecords)
+	{
+		header.recordsOffset = offset;
+		const uint64_t recordsSize = _records.size() * sizeof(SequenceArchiveRecord);
+		CHECK_EQ(_file.write((const unsigned char*)_records.data(), offset, recordsSize), recordsSize);
+		offset += recordsSize;
+	}
+
+	header.namesOffset = offset;
+	header.namesLength = _names.size();
+	const uint64_t namesSize = _names.size() * sizeof(wchar_t);
+	CHECK_EQ(_file.write((const unsigned char*)_names.data(), offset, namesSize), namesSize);
+
+	CHECK_EQ(_file.write((const unsigned char*)&header, 0, sizeof(header)), sizeof(header));
+	_finished = true;
+}
+
+SequenceArchiveReader::SequenceArchiveReader(const std::wstring& path)
+	: _file(path.c_str()), _records(nullptr)
+{
+	const uint64_t fileSize = _file.getSize();
+	const unsigned char *base = _file.getPtr();
+	CHECK_GE(fileSize, sizeof(SequenceArchiveHeader));
+	_header = (const SequenceArchiveHeader*)base;
+	CHECK(memcmp(_header->magic, SEQUENCE_ARCHIVE_MAGIC, sizeof(_header->magic)) == 0) << "Not a sequence archive";
+	CHECK_EQ(_header->version, SEQUENCE_ARCHIVE_VERSION);
+
+	const uint64_t numberOfFrames = _header->numberOfFrames;
+	CHECK_LE(_header->indexOffset, fileSize);
+	CHECK_LE(numberOfFrames * sizeof(SequenceArchiveFrameEntry), fileSize - _header->indexOffset);
+	_entries = (const SequenceArchiveFrameEntry*)(base + _header->indexOffset);
+	if (_header->hasRecords)
+	{
+		CHECK_LE(_header->recordsOffset, fileSize);
+		CHECK_LE(numberOfFrames * sizeof(SequenceArchiveRecord), fileSize - _header->recordsOffset);
+		_records = (const SequenceArchiveRecord*)(base + _header->recordsOffset);
+	}
+	CHECK_LE(_header->namesOffset, fileSize);
+	// Divided rather than multiplied, a crafted length could wrap around
+	CHECK_LE(_header->namesLength, (fileSize - _header->namesOffset) / sizeof(wchar_t));
+	_names = (const wchar_t*)(base + _header->namesOffset);
+
+	for (uint32_t i = 0; i < _header->numberOfFrames; ++i)
+	{
+		const SequenceArchiveFrameEntry &entry = _entries[i];
+		CHECK_LE(entry.offset, fileSize);
+		CHECK_LE(entry.size, fileSize - entry.offset);
+		CHECK_LE(uint64_t(entry.nameOffset) + entry.nameLength, _header->namesLength);
+	}
+}
+
+uint32_t SequenceArchiveReader::getNumberOfFrames() const noexcept
+{
+	return _header->numberOfFrames;
+}
+
+const unsigned char* SequenceArchiveReader::getFrame(uint32_t index, uint32_t* size) const
+{
+	CHECK_LT(index, _header->numberOfFrames);
+	*size = _entries[index].size;
+	return _file.getPtr() + _entries[index].offset;
+}
+
+std::wstring SequenceArchiveReader::getFrameName(uint32_t index) const
+{
+	CHECK_LT(index, _header->numberOfFrames);
+	return std::wstring(_names + _entries[index].nameOffset, _entries[index].nameLength);
+}
+
+bool SequenceArchiveReader::hasRecords() const noexcept
+{
+	return _records != nullptr;
+}
+
+const SequenceArchiveRecord& SequenceArchiveReader::getRecord(uint32_t index) const
+{
+	CHECK(_records);
+	CHECK_LT(index, _header->numberOfFrames);
+	return _records[index];
+}
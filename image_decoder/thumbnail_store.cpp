@@ -0,0 +1,393 @@
+#include "thumbnail_store.h"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <map>
+#include <ppl.h>
+
+#include <base/dataset_scanner.h>
+#include <base/file.h>
+#include <base/logging.h>
+#include <base/memory_mapped_io.h>
+
+#include "decoder.h"
+#include "header_scanner.h"
+
+static const char THUMBNAIL_STORE_MAGIC[8] = { 'T', 'A', 'T', 'T', 'H', 'B', '\0', '\0' };
+static const uint32_t THUMBNAIL_STORE_VERSION = 1;
+
+ThumbnailStore::Updater::Updater(ThumbnailStore* store)
+	: _store(store), _cancelled(false)
+{
+}
+
+int ThumbnailStore::Updater::job_entry()
+{
+	_store->runUpdate(_cancelled);
+	return 0;
+}
+
+bool ThumbnailStore::Updater::job_cancel()
+{
+	_cancelled = true;
+	return true;
+}
+
+ThumbnailStore::ThumbnailStore(const std::wstring& sequenceDirectory, const std::wstring& storePath,
+	const std::vector<unsigned>& scalingFactorDenominators, int jpegQuality)
+	: _sequenceDirectory(sequenceDirectory), _storePath(storePath), _scalingFactorDenominators(scalingFactorDenominators),
+	_jpegQuality(jpegQuality), _compressors(TurboJPEGHandleType::compress)
+{
+	CHECK(!_scalingFactorDenominators.empty());
+	for (unsigned denominator : _scalingFactorDenominators)
+		CHECK(JPEGDecompressor::isScalingFactorSupported(1, denominator)) << "Scaling factor: 1/" << denominator;
+	CHECK(jpegQuality >= 1 && jpegQuality <= 100) << "JPEG quality: " << jpegQuality;
+	if (Base::isPathExists(_storePath))
+	{
+		try {
+			load();
+		}
+		catch (std::exception &)
+		{
+			// Already logged, the store is rebuilt by the next update()
+			_frames.clear();
+		}
+	}
+}
+
+ThumbnailStore::~ThumbnailStore()
+{
+	_updaterThread.reset();
+}
+
+void ThumbnailStore::update()
+{
+	if (_updaterThread && _updaterThread->isRunning())
+		return;
+	_updaterThread.reset();
+	_updater = std::make_unique<Updater>(this);
+	_updaterThread = std::make_unique<Base::Thread>();
+	_updaterThread->initialize(_updater.get());
+}
+
+bool ThumbnailStore::isUpdating() const
+{
+	return _updaterThread && _updaterThread->isRunning();
+}
+
+void ThumbnailStore::waitForUpdate() const
+{
+	if (_updaterThread)
+		_updaterThread->join();
+}
+
+std::string ThumbnailStore::getUpdateErrorMessage() const
+{
+	if (_updaterThread && !_updaterThread->isRunning() && _updaterThread->isExceptionThrown())
+		return _updaterThread->getExceptionMessage();
+	return std::string();
+}
+
+unsigned ThumbnailStore::getNumberOfFrames() const
+{
+	std::lock_guard<std::mutex> lock_guard(_lock);
+	return (unsigned)_frames.size();
+}
+
+unsigned ThumbnailStore::getNumberOfLevels() const noexcept
+{
+	return (unsigned)_scalingFactorDenominators.size();
+}
+
+unsigned ThumbnailStore::getScalingFactorDenominator(unsigned level) const
+{
+	CHECK_LT(level, _scalingFactorDenominators.size());
+	return _scalingFactorDenominators[level];
+}
+
+std::wstring ThumbnailStore::getFrameName(unsigned frame) const
+{
+	std::lock_guard<std::mutex> lock_guard(_lock);
+	CHECK_LT(frame, _frames.size());
+	return _frames[frame].name;
+}
+
+bool ThumbnailStore::getThumbnail(unsigned frame, unsigned level, std::vector<unsigned char>* jpeg, unsigned* width, unsigned* height) const
+{
+	CHECK_LT(level, _scalingFactorDenominators.size());
+	std::shared_ptr<const std::vector<unsigned char>> data;
+	{
+		std::lock_guard<std::mutex> lock_guard(_lock);
+		CHECK_LT(frame, _frames.size());
+		const Frame &entry = _frames[frame];
+		if (entry.thumbnails.empty())
+			return false;
+		const Thumbnail &thumbnail = entry.thumbnails[level];
+		data = thumbnail.jpeg;
+		*width = thumbnail.width;
+		*height = thumbnail.height;
+	}
+	// Copied outside of the lock, the payload itself is never modified
+	jpeg->assign(data->begin(), data->end());
+	return true;
+}
+
+void ThumbnailStore::load()
+{
+	Base::MemoryMappedIO file(_storePath.c_str());
+	const uint64_t fileSize = file.getSize();
+	const unsigned char *base = file.getPtr();
+	CHECK_GE(fileSize, sizeof(ThumbnailStoreHeader));
+	const ThumbnailStoreHeader *header = (const ThumbnailStoreHeader*)base;
+	CHECK(memcmp(header->magic, THUMBNAIL_STORE_MAGIC, sizeof(header->magic)) == 0) << "Not a thumbnail store";
+	CHECK_EQ(header->version, THUMBNAIL_STORE_VERSION);
+
+	const uint64_t numberOfFrames = header->numberOfFrames;
+	const uint64_t numberOfLevels = header->numberOfLevels;
+	uint64_t offset = sizeof(ThumbnailStoreHeader);
+	CHECK_LE(numberOfLevels * sizeof(uint32_t), fileSize - offset);
+	const uint32_t *denominators = (const uint32_t*)(base + offset);
+	// Built with other scaling factors, nothing can be reused
+	if (numberOfLevels != _scalingFactorDenominators.size() ||
+		!std::equal(_scalingFactorDenominators.begin(), _scalingFactorDenominators.end(), denominators))
+		return;
+	offset += numberOfLevels * sizeof(uint32_t);
+
+	CHECK_LE(numberOfFrames * sizeof(ThumbnailStoreFrameEntry), fileSize - offset);
+	const ThumbnailStoreFrameEntry *frameEntries = (const ThumbnailStoreFrameEntry*)(base + offset);
+	offset += numberOfFrames * sizeof(ThumbnailStoreFrameEntry);
+	CHECK_LE(numberOfFrames * numberOfLevels * sizeof(ThumbnailStoreThumbnailEntry), fileSize - offset);
+	const ThumbnailStoreThumbnailEntry *thumbnailEntries = (const ThumbnailStoreThumbnailEntry*)(base + offset);
+	offset += numberOfFrames * numberOfLevels * sizeof(ThumbnailStoreThumbnailEntry);
+	CHECK_LE(header->namesLength * sizeof(wchar_t), fileSize - offset);
+	const wchar_t *names = (const wchar_t*)(base + offset);
+
+	std::vector<Frame> frames(header->numberOfFrames);
+	for (uint32_t i = 0; i < header->numberOfFrames; ++i)
+	{
+		const ThumbnailStoreFrameEntry &frameEntry = frameEntries[i];
+		CHECK_LE(uint64_t(frameEntry.nameOffset) + frameEntry.nameLength, header->namesLength);
+		Frame &frame = frames[i];
+		frame.name.assign(names + frameEntry.nameOffset, frameEntry.nameLength);
+		frame.lastWriteTime = frameEntry.lastWriteTime;
+		const ThumbnailStoreThumbnailEntry *entries = thumbnailEntries + i * numberOfLevels;
+		// A frame that failed to decode has no payloads at all
+		if (!entries[0].size)
+			continue;
+		frame.thumbnails.resize(numberOfLevels);
+		for (uint32_t level = 0; level < numberOfLevels; ++level)
+		{
+			const ThumbnailStoreThumbnailEntry &entry = entries[level];
+			CHECK_LE(entry.offset, fileSize);
+			CHECK_LE(entry.size, fileSize - entry.offset);
+			Thumbnail &thumbnail = frame.thumbnails[level];
+			thumbnail.jpeg = std::make_shared<const std::vector<unsigned char>>(base + entry.offset, base + entry.offset + entry.size);
+			thumbnail.width = entry.width;
+			thumbnail.height = entry.height;
+		}
+	}
+	std::lock_guard<std::mutex> lock_guard(_lock);
+	_frames = std::move(frames);
+}
+
+void ThumbnailStore::save(const std::vector<Frame>& frames) const
+{
+	const uint64_t numberOfLevels = _scalingFactorDenominators.size();
+	std::vector<ThumbnailStoreFrameEntry> frameEntries(frames.size());
+	std::vector<ThumbnailStoreThumbnailEntry> thumbnailEntries(frames.size() * numberOfLevels);
+	std::wstring names;
+	for (size_t i = 0; i < frames.size(); ++i)
+	{
+		CHECK_LE(names.size() + frames[i].name.size(), (size_t)std::numeric_limits<uint32_t>::max());
+		frameEntries[i].lastWriteTime = frames[i].lastWriteTime;
+		frameEntries[i].nameOffset = (uint32_t)names.size();
+		frameEntries[i].nameLength = (uint32_t)frames[i].name.size();
+		names += frames[i].name;
+	}
+
+	ThumbnailStoreHeader header = {};
+	memcpy(header.magic, THUMBNAIL_STORE_MAGIC, sizeof(header.magic));
+	header.version = THUMBNAIL_STORE_VERSION;
+	header.numberOfFrames = (uint32_t)frames.size();
+	header.numberOfLevels = (uint32_t)numberOfLevels;
+	header.namesLength = names.size();
+
+	uint64_t offset = sizeof(header) + numberOfLevels * sizeof(uint32_t) +
+		frameEntries.size() * sizeof(ThumbnailStoreFrameEntry) +
+		thumbnailEntries.size() * sizeof(ThumbnailStoreThumbnailEntry) +
+		names.size() * sizeof(wchar_t);
+
+	// Written next to the store and swapped in at the end, a crash never leaves a truncated store behind
+	const std::wstring temporaryPath = _storePath + L".tmp";
+	{
+		Base::File file(temporaryPath, Base::File::Mode::write | Base::File::Mode::create_always);
+		for (size_t i = 0; i < frames.size(); ++i)
+		{
+			for (size_t level = 0; level < frames[i].thumbnails.size(); ++level)
+			{
+				const Thumbnail &thumbnail = frames[i].thumbnails[level];
+				ThumbnailStoreThumbnailEntry &entry = thumbnailEntries[i * numberOfLevels + level];
+				entry.offset = offset;
+				entry.size = (uint32_t)thumbnail.jpeg->size();
+				entry.width = (uint16_t)thumbnail.width;
+				entry.height = (uint16_t)thumbnail.height;
+				CHECK_EQ(file.write(thumbnail.jpeg->data(), offset, entry.size), entry.size);
+				offset += entry.size;
+			}
+		}
+
+		offset = 0;
+		CHECK_EQ(file.write((const unsigned char*)&header, offset, sizeof(header)), sizeof(header));
+		offset += sizeof(header);
+		const uint64_t denominatorsSize = numberOfLevels * sizeof(uint32_t);
+		CHECK_EQ(file.write((const unsigned char*)_scalingFactorDenominators.data(), offset, denominatorsSize), denominatorsSize);
+		offset += denominatorsSize;
+		const uint64_t frameEntriesSize = frameEntries.size() * sizeof(ThumbnailStoreFrameEntry);
+		CHECK_EQ(file.write((const unsigned char*)frameEntries.data(), offset, frameEntriesSize), frameEntriesSize);
+		offset += frameEntriesSize;
+		const uint64_t thumbnailEntriesSize = thumbnailEntries.size() * sizeof(ThumbnailStoreThumbnailEntry);
+		CHECK_EQ(file.write((const unsigned char*)thumbnailEntries.data(), offset, thumbnailEntriesSize), thumbnailEntriesSize);
+		offset += thumbnailEntriesSize;
+		const uint64_t namesSize = names.size() * sizeof(wchar_t);
+		CHECK_EQ(file.write((const unsigned char*)names.data(), offset, namesSize), namesSize);
+	}
+	CHECK_WIN32API(MoveFileExW(temporaryPath.c_str(), _storePath.c_str(), MOVEFILE_REPLACE_EXISTING));
+}
+
+void ThumbnailStore::runUpdate(const std::atomic<bool>& cancelled)
+{
+	std::vector<Frame> frames;
+	{
+		Base::DirectoryIterator iterator(_sequenceDirectory);
+		std::wstring fileName;
+		bool isDirectory;
+		uint64_t lastWriteTime;
+		while (iterator.next(fileName, isDirectory, lastWriteTime))
+		{
+			if (isDirectory || !isJPEGFileName(fileName))
+				continue;
+			Frame frame;
+			frame.name = std::move(fileName);
+			frame.lastWriteTime = lastWriteTime;
+			frames.push_back(std::move(frame));
+		}
+	}
+	std::sort(frames.begin(), frames.end(), [](const Frame &left, const Frame &right) { return Base::naturalLess(left.name, right.name); });
+
+	// Thumbnails are carried over by name, outdated ones are still shown until their rebuild is done
+	struct OutdatedFrame
+	{
+		size_t index;
+		uint64_t lastWriteTime;
+	};
+	std::vector<OutdatedFrame> outdatedFrames;
+	{
+		std::lock_guard<std::mutex> lock_guard(_lock);
+		std::map<std::wstring, const Frame*> previousFrames;
+		for (const Frame &frame : _frames)
+			previousFrames.emplace(frame.name, &frame);
+		for (size_t i = 0; i < frames.size(); ++i)
+		{
+			Frame &frame = frames[i];
+			auto iterator = previousFrames.find(frame.name);
+			if (iterator != previousFrames.end() && iterator->second->lastWriteTime == frame.lastWriteTime)
+			{
+				frame.thumbnails = iterator->second->thumbnails;
+				continue;
+			}
+			outdatedFrames.push_back({ i, frame.lastWriteTime });
+			// Until rebuilt the frame describes the file its current thumbnails were built from
+			if (iterator != previousFrames.end())
+			{
+				frame.lastWriteTime = iterator->second->lastWriteTime;
+				frame.thumbnails = iterator->second->thumbnails;
+			}
+			else
+				frame.lastWriteTime = 0;
+		}
+		_frames.swap(frames);
+	}
+	frames.clear();
+
+	Concurrency::parallel_for(size_t(0), outdatedFrames.size(), [&](size_t i)
+	{
+		if (cancelled)
+			return;
+		const OutdatedFrame &outdatedFrame = outdatedFrames[i];
+		std::wstring fileName;
+		{
+			std::lock_guard<std::mutex> lock_guard(_lock);
+			fileName = _frames[outdatedFrame.index].name;
+		}
+		std::vector<Thumbnail> thumbnails;
+		try {
+			thumbnails = build(fileName);
+		}
+		catch (std::exception &)
+		{
+			// The frame stays without thumbnails until the file changes
+			LOG_WARN << "Can not build the thumbnails of " << fileName;
+		}
+		std::lock_guard<std::mutex> lock_guard(_lock);
+		Frame &frame = _frames[outdatedFrame.index];
+		frame.lastWriteTime = outdatedFrame.lastWriteTime;
+		frame.thumbnails = std::move(thumbnails);
+	});
+	if (cancelled)
+		return;
+	LOG_DEBUG << "Rebuilt the thumbnails of " << outdatedFrames.size() << " frames of " << _sequenceDirectory;
+
+	{
+		std::lock_guard<std::mutex> lock_guard(_lock);
+		frames = _frames;
+	}
+	save(frames);
+}
+
+std::vector<ThumbnailStore::Thumbnail> ThumbnailStore::build(const std::wstring& fileName)
+{
+	Base::MemoryMappedIO file(Base::appendPath(_sequenceDirectory, fileName).c_str());
+	JPEGDecompressor decompressor(file.getPtr(), (unsigned long)file.getSize());
+	TurboJPEGHandlePool::Lease compressor = _compressors.acquire();
+	std::vector<unsigned char> image;
+	std::vector<Thumbnail> thumbnails(_scalingFactorDenominators.size());
+	for (size_t level = 0; level < _scalingFactorDenominators.size(); ++level)
+	{
+		decompressor.setScalingFactor(1, _scalingFactorDenominators[level]);
+		const int width = (int)decompressor.getScaledWidth();
+		const int height = (int)decompressor.getScaledHeight();
+		unsigned char *jpeg = nullptr;
+		unsigned long jpegSize = 0;
+		int rc;
+		if (decompressor.isYUVDecodingSupported())
+		{
+			// Planes go straight back into the encoder, no color conversion in either direction
+			unsigned char *planes[3] = { nullptr, nullptr, nullptr };
+			size_t imageSize = 0;
+			for (unsigned plane = 0; plane < decompressor.getNumberOfPlanes(); ++plane)
+				imageSize += decompressor.getPlaneSize(plane);
+			image.resize(imageSize);
+			planes[0] = image.data();
+			for (unsigned plane = 1; plane < decompressor.getNumberOfPlanes(); ++plane)
+				planes[plane] = planes[plane - 1] + decompressor.getPlaneSize(plane - 1);
+			decompressor.processYUVPlanes(planes);
+			rc = tjCompressFromYUVPlanes(compressor.get(), (const unsigned char**)planes, width, nullptr, height,
+				(int)decompressor.getSubsampling(), &jpeg, &jpegSize, _jpegQuality, 0);
+		}
+		else
+		{
+			decompressor.setFormat(PixelFormat::RGB);
+			image.resize(decompressor.getSize());
+			decompressor.process(image.data());
+			rc = tjCompress2(compressor.get(), image.data(), width, 0, height, TJPF_RGB, &jpeg, &jpegSize, TJSAMP_420, _jpegQuality, 0);
+		}
+		std::shared_ptr<const std::vector<unsigned char>> data;
+		if (rc == 0)
+			data = std::make_shared<const std::vector<unsigned char>>(jpeg, jpeg + jpegSize);
+		tjFree(jpeg);
+		CHECK_EQ(rc, 0) << tjGetErrorStr();
+		thumbnails[level] = { std::move(data), (unsigned)width, (unsigned)height };
+	}
+	return thumbnails;
+}
@@ -0,0 +1,225 @@
+#include "transformer.h"
+
+#include <algorithm>
+
+#include <ppl.h>
+
+#include <base/file.h>
+#include <base/logging.h>
+#include <base/memory_mapped_io.h>
+
+static bool isTransposing(JPEGTransformOperation operation)
+{
+	return operation == JPEGTransformOperation::transpose || operation == JPEGTransformOperation::transverse
+		|| operation == JPEGTransformOperation::rotate90 || operation == JPEGTransformOperation::rotate270;
+}
+
+// The partial iMCUs that can not be moved are those on the right (bottom) edge of the source
+// when it ends up anywhere but on the right (bottom) edge of the transformed image
+static bool isRightEdgeTrimmed(JPEGTransformOperation operation)
+{
+	return operation == JPEGTransformOperation::horizontalFlip || operation == JPEGTransformOperation::transverse
+		|| operation == JPEGTransformOperation::rotate180 || operation == JPEGTransformOperation::rotate270;
+}
+
+static bool isBottomEdgeTrimmed(JPEGTransformOperation operation)
+{
+	return operation == JPEGTransformOperation::verticalFlip || operation == JPEGTransformOperation::transverse
+		|| operation == JPEGTransformOperation::rotate90 || operation == JPEGTransformOperation::rotate180;
+}
+
+JPEGTransformer::JPEGTransformer(JPEGTransformOperation operation)
+	: _operation(operation), _crop(false), _cropX(0), _cropY(0), _cropW(0), _cropH(0), _trim(true), _handles(TurboJPEGHandleType::transform)
+{
+}
+
+void JPEGTransformer::setOperation(JPEGTransformOperation operation) noexcept
+{
+	_operation = operation;
+}
+
+JPEGTransformOperation JPEGTransformer::getOperation() const noexcept
+{
+	return _operation;
+}
+
+void JPEGTransformer::setCrop(unsigned x, unsigned y, unsigned w, unsigned h) noexcept
+{
+	_crop = true;
+	_cropX = x;
+	_cropY = y;
+	_cropW = w;
+	_cropH = h;
+}
+
+void JPEGTransformer::clearCrop() noexcept
+{
+	_crop = false;
+}
+
+void JPEGTransformer::setTrim(bool trim) noexcept
+{
+	_trim = trim;
+}
+
+JPEGTransformGeometry JPEGTransformer::getGeometry(const unsigned char* src, unsigned long size)
+{
+	TurboJPEGHandlePool::Lease handle = _handles.acquire();
+	return getGeometry(handle.get(), src, size);
+}
+
+JPEGTransformGeometry JPEGTransformer::getGeometry(tjhandle handle, const unsigned char* src, unsigned long size) const
+{
+	int width, height, subsampling, colorspace;
+	CHECK_EQ(tjDecompressHeader3(handle, src, size, &width, &height, &subsampling, &colorspace), 0) << tjGetErrorStr();
+	CHECK(subsampling >= 0 && subsampling < TJ_NUMSAMP) << "Subsampling: " << subsampling;
+	const unsigned mcuWidth = tjMCUWidth[subsampling], mcuHeight = tjMCUHeight[subsampling];
+
+	JPEGTransformGeometry geometry;
+	geometry.operation = _operation;
+	geometry.sourceWidth = width;
+	geometry.sourceHeight = height;
+	if (_trim)
+	{
+		if (isRightEdgeTrimmed(_operation))
+			geometry.sourceWidth -= geometry.sourceWidth % mcuWidth;
+		if (isBottomEdgeTrimmed(_operation))
+			geometry.sourceHeight -= geometry.sourceHeight % mcuHeight;
+		CHECK(geometry.sourceWidth && geometry.sourceHeight) << "Image of " << width << "x" << height << " is smaller than an iMCU";
+	}
+	const bool transposing = isTransposing(_operation);
+	const unsigned transformedWidth = transposing ? geometry.sourceHeight : geometry.sourceWidth;
+	const unsigned transformedHeight = transposing ? geometry.sourceWidth : geometry.sourceHeight;
+	geometry.cropX = 0;
+	geometry.cropY = 0;
+	geometry.width = transformedWidth;
+	geometry.height = transformedHeight;
+	if (_crop)
+	{
+		CHECK_LT(_cropX, transformedWidth);
+		CHECK_LT(_cropY, transformedHeight);
+		// The grid of the transformed image, iMCUs are transposed along with the image
+		const unsigned alignmentX = transposing ? mcuHeight : mcuWidth, alignmentY = transposing ? mcuWidth : mcuHeight;
+		geometry.cropX = _cropX - _cropX % alignmentX;
+		geometry.cropY = _cropY - _cropY % alignmentY;
+		geometry.width = transformedWidth - geometry.cropX;
+		if (_cropW)
+			geometry.width = std::min(geometry.width, _cropW + (_cropX - geometry.cropX));
+		geometry.height = transformedHeight - geometry.cropY;
+		if (_cropH)
+			geometry.height = std::min(geometry.height, _cropH + (_cropY - geometry.cropY));
+	}
+	return geometry;
+}
+
+JPEGTransformGeometry JPEGTransformer::transform(const unsigned char* src, unsigned long size, std::vector<unsigned char>& dst)
+{
+	TurboJPEGHandlePool::Lease handle = _handles.acquire();
+	const JPEGTransformGeometry geometry = getGeometry(handle.get(), src, size);
+
+	tjtransform transform = {};
+	transform.op = (int)_operation;
+	// Without trimming, fail instead of leaving the edge iMCUs where they were
+	transform.options = _trim ? TJXOPT_TRIM : TJXOPT_PERFECT;
+	if (_crop)
+	{
+		transform.options |= TJXOPT_CROP;
+		transform.r.x = geometry.cropX;
+		transform.r.y = geometry.cropY;
+		transform.r.w = geometry.width;
+		transform.r.h = geometry.height;
+	}
+	unsigned char *buffer = nullptr;
+	unsigned long bufferSize = 0;
+	const int rc = tjTransform(handle.get(), src, size, 1, &buffer, &bufferSize, &transform, 0);
+	if (rc == 0)
+		dst.assign(buffer, buffer + bufferSize);
+	tjFree(buffer);
+	CHECK_EQ(rc, 0) << tjGetErrorStr();
+	return geometry;
+}
+
+void JPEGTransformer::transformFiles(const std::vector<std::wstring>& srcPaths, const std::vector<std::wstring>& dstPaths, std::vector<JPEGTransformGeometry>* geometries)
+{
+	CHECK_EQ(srcPaths.size(), dstPaths.size());
+	if (geometries)
+		geometries->resize(srcPaths.size());
+	Concurrency::parallel_for(size_t(0), srcPaths.size(), [&](size_t i)
+	{
+		std::vector<unsigned char> transformed;
+		JPEGTransformGeometry geometry;
+		{
+			Base::MemoryMappedIO file(srcPaths[i].c_str());
+			geometry = transform(file.getPtr(), (unsigned long)file.getSize(), transformed);
+		}
+		Base::File output(dstPaths[i], Base::File::Mode::write | Base::File::Mode::create_always);
+		CHECK_EQ(output.write(transformed.data(), 0, transformed.size()), transformed.size());
+		if (geometries)
+			(*geometries)[i] = geometry;
+	});
+}
+
+bool JPEGTransformer::transformBox(const JPEGTransformGeometry& geometry, int* x, int* y, int* w, int* h)
+{
+	const int sourceWidth = (int)geometry.sourceWidth, sourceHeight = (int)geometry.sourceHeight;
+	// Clipped to the part of the source that is kept
+	const int left = std::max(*x, 0), top = std::max(*y, 0);
+	const int right = std::min(*x + *w, sourceWidth), bottom = std::min(*y + *h, sourceHeight);
+	if (right <= left || bottom <= top)
+		return false;
+
+	int transformedX = 0, transformedY = 0, transformedW = right - left, transformedH = bottom - top;
+	switch (geometry.operation)
+	{
+	case JPEGTransformOperation::none:
+		transformedX = left;
+		transformedY = top;
+		break;
+	case JPEGTransformOperation::horizontalFlip:
+		transformedX = sourceWidth - right;
+		transformedY = top;
+		break;
+	case JPEGTransformOperation::verticalFlip:
+		transformedX = left;
+		transformedY = sourceHeight - bottom;
+		break;
+	case JPEGTransformOperation::transpose:
+		transformedX = top;
+		transformedY = left;
+		std::swap(transformedW, transformedH);
+		break;
+	case JPEGTransformOperation::transverse:
+		transformedX = sourceHeight - bottom;
+		transformedY = sourceWidth - right;
+		std::swap(transformedW, transformedH);
+		break;
+	case JPEGTransformOperation::rotate90:
+		transformedX = sourceHeight - bottom;
+		transformedY = left;
+		std::swap(transformedW, transformedH);
+		break;
+	case JPEGTransformOperation::rotate180:
+		transformedX = sourceWidth - right;
+		transformedY = sourceHeight - bottom;
+		break;
+	case JPEGTransformOperation::rotate270:
+		transformedX = top;
+		transformedY = sourceWidth - right;
+		std::swap(transformedW, transformedH);
+		break;
+	default:
+		UNREACHABLE_ERROR;
+	}
+
+	const int croppedLeft = std::max(transformedX - (int)geometry.cropX, 0);
+	const int croppedTop = std::max(transformedY - (int)geometry.cropY, 0);
+	const int croppedRight = std::min(transformedX + transformedW - (int)geometry.cropX, (int)geometry.width);
+	const int croppedBottom = std::min(transformedY + transformedH - (int)geometry.cropY, (int)geometry.height);
+	if (croppedRight <= croppedLeft || croppedBottom <= croppedTop)
+		return false;
+	*x = croppedLeft;
+	*y = croppedTop;
+	*w = croppedRight - croppedLeft;
+	*h = croppedBottom - croppedTop;
+	return true;
+}
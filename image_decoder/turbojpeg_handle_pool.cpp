@@ -0,0 +1,78 @@
+#include "turbojpeg_handle_pool.h"
+
+#include <base/logging.h>
+
+TurboJPEGHandlePool::Lease::Lease(TurboJPEGHandlePool* pool, tjhandle handle) noexcept
+	: _pool(pool), _handle(handle)
+{
+}
+
+TurboJPEGHandlePool::Lease::Lease(Lease&& other) noexcept
+	: _pool(other._pool), _handle(other._handle)
+{
+	other._handle = nullptr;
+}
+
+TurboJPEGHandlePool::Lease::~Lease()
+{
+	if (_handle)
+		_pool->release(_handle);
+}
+
+tjhandle TurboJPEGHandlePool::Lease::get() const noexcept
+{
+	return _handle;
+}
+
+TurboJPEGHandlePool::TurboJPEGHandlePool(TurboJPEGHandleType type)
+	: _type(type)
+{
+}
+
+TurboJPEGHandlePool::~TurboJPEGHandlePool()
+{
+	for (tjhandle handle : _handles)
+		tjDestroy(handle);
+}
+
+TurboJPEGHandlePool::Lease TurboJPEGHandlePool::acquire()
+{
+	{
+		std::lock_guard<std::mutex> lock_guard(_lock);
+		if (!_handles.empty())
+		{
+			tjhandle handle = _handles.back();
+			_handles.pop_back();
+			return Lease(this, handle);
+		}
+	}
+	tjhandle handle;
+	switch (_type)
+	{
+	case TurboJPEGHandleType::compress:
+		handle = tjInitCompress();
+		break;
+	case TurboJPEGHandleType::decompress:
+		handle = tjInitDecompress();
+		break;
+	case TurboJPEGHandleType::transform:
+		handle = tjInitTransform();
+		break;
+	default:
+		UNREACHABLE_ERROR;
+	}
+	CHECK(handle) << tjGetErrorStr();
+	return Lease(this, handle);
+}
+
+void TurboJPEGHandlePool::release(tjhandle handle) noexcept
+{
+	std::lock_guard<std::mutex> lock_guard(_lock);
+	try {
+		_handles.push_back(handle);
+	}
+	catch (std::bad_alloc &)
+	{
+		tjDestroy(handle);
+	}
+}
@@ -0,0 +1,275 @@
+#include "yuv_conversion.h"
+
+#include <base/logging.h>
+
+#include <emmintrin.h>
+#include <immintrin.h>
+
+// JFIF YCbCr -> RGB in fixed point. The chroma terms keep 2 fractional bits, which lets the
+// SIMD kernels evaluate each of them with a single mulhi on (chroma - 128) << 7.
+// The scalar path uses the identical arithmetic, so all kernels are bit exact.
+static const int16_t CR_TO_R = 2871; // 1.402 * 2048
+static const int16_t CB_TO_G = 705; // 0.344136 * 2048
+static const int16_t CR_TO_G = 1463; // 0.714136 * 2048
+static const int16_t CB_TO_B = 3629; // 1.772 * 2048
+
+static inline unsigned char clampToByte(int value)
+{
+	return value < 0 ? 0 : (value > 255 ? 255 : (unsigned char)value);
+}
+
+static void convertRowScalar(const unsigned char *y, const unsigned char *cb, const unsigned char *cr,
+	unsigned hshift, unsigned begin, unsigned width, unsigned char *dst)
+{
+	for (unsigned x = begin; x < width; ++x)
+	{
+		const int y4 = y[x] * 4 + 2;
+		const int cb_ = cb[x >> hshift] - 128;
+		const int cr_ = cr[x >> hshift] - 128;
+		unsigned char *pixel = dst + x * 4;
+		pixel[0] = clampToByte((y4 + ((cb_ * CB_TO_B) >> 9)) >> 2);
+		pixel[1] = clampToByte((y4 - ((cb_ * CB_TO_G) >> 9) - ((cr_ * CR_TO_G) >> 9)) >> 2);
+		pixel[2] = clampToByte((y4 + ((cr_ * CR_TO_R) >> 9)) >> 2);
+		pixel[3] = 0xFF;
+	}
+}
+
+static void convertGrayRowScalar(const unsigned char *y, unsigned begin, unsigned width, unsigned char *dst)
+{
+	for (unsigned x = begin; x < width; ++x)
+	{
+		unsigned char *pixel = dst + x * 4;
+		pixel[0] = pixel[1] = pixel[2] = y[x];
+		pixel[3] = 0xFF;
+	}
+}
+
+// Loads the chroma samples covering 16 (or 32) luma pixels starting at x, one byte per pixel
+template <unsigned hshift>
+struct ChromaLoader;
+
+template <>
+struct ChromaLoader<0>
+{
+	static __m128i load16(const unsigned char *c, unsigned x)
+	{
+		return _mm_loadu_si128((const __m128i*)(c + x));
+	}
+	static void load32(const unsigned char *c, unsigned x, __m128i &lo, __m128i &hi)
+	{
+		lo = _mm_loadu_si128((const __m128i*)(c + x));
+		hi = _mm_loadu_si128((const __m128i*)(c + x + 16));
+	}
+};
+
+template <>
+struct ChromaLoader<1>
+{
+	static __m128i load16(const unsigned char *c, unsigned x)
+	{
+		const __m128i v = _mm_loadl_epi64((const __m128i*)(c + x / 2));
+		return _mm_unpacklo_epi8(v, v);
+	}
+	static void load32(const unsigned char *c, unsigned x, __m128i &lo, __m128i &hi)
+	{
+		const __m128i v = _mm_loadu_si128((const __m128i*)(c + x / 2));
+		lo = _mm_unpacklo_epi8(v, v);
+		hi = _mm_unpackhi_epi8(v, v);
+	}
+};
+
+static inline void convert8SSE2(__m128i y, __m128i cb, __m128i cr, __m128i &b, __m128i &g, __m128i &r)
+{
+	const __m128i bias = _mm_set1_epi16(128);
+	cb = _mm_slli_epi16(_mm_sub_epi16(cb, bias), 7);
+	cr = _mm_slli_epi16(_mm_sub_epi16(cr, bias), 7);
+	y = _mm_add_epi16(_mm_slli_epi16(y, 2), _mm_set1_epi16(2));
+	b = _mm_srai_epi16(_mm_add_epi16(y, _mm_mulhi_epi16(cb, _mm_set1_epi16(CB_TO_B))), 2);
+	g = _mm_srai_epi16(_mm_sub_epi16(_mm_sub_epi16(y, _mm_mulhi_epi16(cb, _mm_set1_epi16(CB_TO_G))),
+		_mm_mulhi_epi16(cr, _mm_set1_epi16(CR_TO_G))), 2);
+	r = _mm_srai_epi16(_mm_add_epi16(y, _mm_mulhi_epi16(cr, _mm_set1_epi16(CR_TO_R))), 2);
+}
+
+static inline void storeBGRA16SSE2(__m128i b, __m128i g, __m128i r, unsigned char *dst)
+{
+	const __m128i a = _mm_set1_epi8(-1);
+	const __m128i bgLo = _mm_unpacklo_epi8(b, g), bgHi = _mm_unpackhi_epi8(b, g);
+	const __m128i raLo = _mm_unpacklo_epi8(r, a), raHi = _mm_unpackhi_epi8(r, a);
+	_mm_storeu_si128((__m128i*)dst, _mm_unpacklo_epi16(bgLo, raLo));
+	_mm_storeu_si128((__m128i*)(dst + 16), _mm_unpackhi_epi16(bgLo, raLo));
+	_mm_storeu_si128((__m128i*)(dst + 32), _mm_unpacklo_epi16(bgHi, raHi));
+	_mm_storeu_si128((__m128i*)(dst + 48), _mm_unpackhi_epi16(bgHi, raHi));
+}
+
+template <unsigned hshift>
+static unsigned convertRowSSE2(const unsigned char *y, const unsigned char *cb, const unsigned char *cr,
+	unsigned begin, unsigned width, unsigned char *dst)
+{
+	const __m128i zero = _mm_setzero_si128();
+	unsigned x = begin;
+	for (; x + 16 <= width; x += 16)
+	{
+		const __m128i yv = _mm_loadu_si128((const __m128i*)(y + x));
+		const __m128i cbv = ChromaLoader<hshift>::load16(cb, x);
+		const __m128i crv = ChromaLoader<hshift>::load16(cr, x);
+		__m128i bLo, gLo, rLo, bHi, gHi, rHi;
+		convert8SSE2(_mm_unpacklo_epi8(yv, zero), _mm_unpacklo_epi8(cbv, zero), _mm_unpacklo_epi8(crv, zero), bLo, gLo, rLo);
+		convert8SSE2(_mm_unpackhi_epi8(yv, zero), _mm_unpackhi_epi8(cbv, zero), _mm_unpackhi_epi8(crv, zero), bHi, gHi, rHi);
+		storeBGRA16SSE2(_mm_packus_epi16(bLo, bHi), _mm_packus_epi16(gLo, gHi), _mm_packus_epi16(rLo, rHi), dst + x * 4);
+	}
+	return x;
+}
+
+static unsigned convertGrayRowSSE2(const unsigned char *y, unsigned begin, unsigned width, unsigned char *dst)
+{
+	unsigned x = begin;
+	for (; x + 16 <= width; x += 16)
+	{
+		const __m128i yv = _mm_loadu_si128((const __m128i*)(y + x));
+		storeBGRA16SSE2(yv, yv, yv, dst + x * 4);
+	}
+	return x;
+}
+
+static inline void convert16AVX2(__m256i y, __m256i cb, __m256i cr, __m256i &b, __m256i &g, __m256i &r)
+{
+	const __m256i bias = _mm256_set1_epi16(128);
+	cb = _mm256_slli_epi16(_mm256_sub_epi16(cb, bias), 7);
+	cr = _mm256_slli_epi16(_mm256_sub_epi16(cr, bias), 7);
+	y = _mm256_add_epi16(_mm256_slli_epi16(y, 2), _mm256_set1_epi16(2));
+	b = _mm256_srai_epi16(_mm256_add_epi16(y, _mm256_mulhi_epi16(cb, _mm256_set1_epi16(CB_TO_B))), 2);
+	g = _mm256_srai_epi16(_mm256_sub_epi16(_mm256_sub_epi16(y, _mm256_mulhi_epi16(cb, _mm256_set1_epi16(CB_TO_G))),
+		_mm256_mulhi_epi16(cr, _mm256_set1_epi16(CR_TO_G))), 2);
+	r = _mm256_srai_epi16(_mm256_add_epi16(y, _mm256_mulhi_epi16(cr, _mm256_set1_epi16(CR_TO_R))), 2);
+}
+
+// Packs two vectors of 16 words (pixels 0-15 and 16-31) into 32 bytes in pixel order
+static inline __m256i packOrderedAVX2(__m256i lo, __m256i hi)
+{
+	return _mm256_permute4x64_epi64(_mm256_packus_epi16(lo, hi), 0xD8);
+}
+
+static inline void storeBGRA32AVX2(__m256i b, __m256i g, __m256i r, unsigned char *dst)
+{
+	const __m256i a = _mm256_set1_epi8(-1);
+	// unpack works within 128-bit lanes: lane 0 holds pixels 0-15, lane 1 holds 16-31
+	const __m256i bgLo = _mm256_unpacklo_epi8(b, g), bgHi = _mm256_unpackhi_epi8(b, g);
+	const __m256i raLo = _mm256_unpacklo_epi8(r, a), raHi = _mm256_unpackhi_epi8(r, a);
+	const __m256i q0 = _mm256_unpacklo_epi16(bgLo, raLo); // 0-3 | 16-19
+	const __m256i q1 = _mm256_unpackhi_epi16(bgLo, raLo); // 4-7 | 20-23
+	const __m256i q2 = _mm256_unpacklo_epi16(bgHi, raHi); // 8-11 | 24-27
+	const __m256i q3 = _mm256_unpackhi_epi16(bgHi, raHi); // 12-15 | 28-31
+	_mm256_storeu_si256((__m256i*)dst, _mm256_permute2x128_si256(q0, q1, 0x20));
+	_mm256_storeu_si256((__m256i*)(dst + 32), _mm256_permute2x128_si256(q2, q3, 0x20));
+	_mm256_storeu_si256((__m256i*)(dst + 64), _mm256_permute2x128_si256(q0, q1, 0x31));
+	_mm256_storeu_si256((__m256i*)(dst + 96), _mm256_permute2x128_si256(q2, q3, 0x31));
+}
+
+template <unsigned hshift>
+static unsigned convertRowAVX2(const unsigned char *y, const unsigned char *cb, const unsigned char *cr,
+	unsigned begin, unsigned width, unsigned char *dst)
+{
+	unsigned x = begin;
+	for (; x + 32 <= width; x += 32)
+	{
+		const __m128i yLo = _mm_loadu_si128((const __m128i*)(y + x));
+		const __m128i yHi = _mm_loadu_si128((const __m128i*)(y + x + 16));
+		__m128i cbLo, cbHi, crLo, crHi;
+		ChromaLoader<hshift>::load32(cb, x, cbLo, cbHi);
+		ChromaLoader<hshift>::load32(cr, x, crLo, crHi);
+		__m256i b0, g0, r0, b1, g1, r1;
+		convert16AVX2(_mm256_cvtepu8_epi16(yLo), _mm256_cvtepu8_epi16(cbLo), _mm256_cvtepu8_epi16(crLo), b0, g0, r0);
+		convert16AVX2(_mm256_cvtepu8_epi16(yHi), _mm256_cvtepu8_epi16(cbHi), _mm256_cvtepu8_epi16(crHi), b1, g1, r1);
+		storeBGRA32AVX2(packOrderedAVX2(b0, b1), packOrderedAVX2(g0, g1), packOrderedAVX2(r0, r1), dst + x * 4);
+	}
+	return convertRowSSE2<hshift>(y, cb, cr, x, width, dst);
+}
+
+typedef unsigned(*ConvertRowKernel)(const unsigned char *, const unsigned char *, const unsigned char *, unsigned, unsigned, unsigned char *);
+
+static ConvertRowKernel selectRowKernel(unsigned hshift, SIMDInstructionSet instructionSet)
+{
+	if (hshift > 1)
+		return nullptr;
+	switch (instructionSet)
+	{
+	case SIMDInstructionSet::avx2:
+		return hshift ? convertRowAVX2<1> : convertRowAVX2<0>;
+	case SIMDInstructionSet::sse2:
+		return hshift ? convertRowSSE2<1> : convertRowSSE2<0>;
+	default:
+		return nullptr;
+	}
+}
+
+void convertYUVPlanesToBGRA(const unsigned char * const *planes, const int *strides,
+	unsigned width, unsigned height, Subsampling subsampling,
+	unsigned char *dst, unsigned dstStride)
+{
+	convertYUVPlanesToBGRA(planes, strides, width, height, subsampling, dst, dstStride, getBestSupportedInstructionSet());
+}
+
+void convertYUVPlanesToBGRA(const unsigned char * const *planes, const int *strides,
+	unsigned width, unsigned height, Subsampling subsampling,
+	unsigned char *dst, unsigned dstStride, SIMDInstructionSet instructionSet)
+{
+	if (!dstStride)
+		dstStride = width * 4;
+	CHECK_GE(dstStride, width * 4);
+
+	unsigned hshift = 0, vshift = 0;
+	switch (subsampling)
+	{
+	case Subsampling::YUV444:
+	case Subsampling::GRAY:
+		break;
+	case Subsampling::YUV422:
+		hshift = 1;
+		break;
+	case Subsampling::YUV420:
+		hshift = 1;
+		vshift = 1;
+		break;
+	case Subsampling::YUV440:
+		vshift = 1;
+		break;
+	case Subsampling::YUV411:
+		hshift = 2;
+		break;
+	default:
+		UNREACHABLE_ERROR;
+	}
+
+	const int tjSubsampling = int(subsampling);
+	const size_t yStride = strides && strides[0] ? strides[0] : tjPlaneWidth(0, width, tjSubsampling);
+
+	if (subsampling == Subsampling::GRAY)
+	{
+		for (unsigned row = 0; row < height; ++row)
+		{
+			const unsigned char *yRow = planes[0] + row * yStride;
+			unsigned char *dstRow = dst + size_t(row) * dstStride;
+			unsigned x = 0;
+			if (instructionSet != SIMDInstructionSet::none)
+				x = convertGrayRowSSE2(yRow, 0, width, dstRow);
+			convertGrayRowScalar(yRow, x, width, dstRow);
+		}
+		return;
+	}
+
+	const size_t cbStride = strides && strides[1] ? strides[1] : tjPlaneWidth(1, width, tjSubsampling);
+	const size_t crStride = strides && strides[2] ? strides[2] : tjPlaneWidth(2, width, tjSubsampling);
+	const ConvertRowKernel rowKernel = selectRowKernel(hshift, instructionSet);
+
+	for (unsigned row = 0; row < height; ++row)
+	{
+		const unsigned char *yRow = planes[0] + row * yStride;
+		const unsigned char *cbRow = planes[1] + (row >> vshift) * cbStride;
+		const unsigned char *crRow = planes[2] + (row >> vshift) * crStride;
+		unsigned char *dstRow = dst + size_t(row) * dstStride;
+		unsigned x = 0;
+		if (rowKernel)
+			x = rowKernel(yRow, cbRow, crRow, 0, width, dstRow);
+		convertRowScalar(yRow, cbRow, crRow, hshift, x, width, dstRow);
+	}
+}
@@ -0,0 +1,4 @@
+#include <spdlog/spdlog.h>
+
+// stdout carries the results
+auto logger = spdlog::stderr_logger_mt("logger");
\ No newline at end of file
@@ -0,0 +1,328 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <base/file.h>
+#include <base/logging.h>
+#include <base/memory_mapped_io.h>
+#include <base/utils.h>
+#include <decoder.h>
+#include <header_scanner.h>
+#include <resampler.h>
+
+// Decodes every JPEG of a directory, held in memory, under each combination of pixel format, DCT
+// scaling factor, quality and thread count, and times the resampling kernels against the scalar
+// reference. One JSON object per line on stdout, one per configuration:
+//   {"benchmark":"decode","format":"BGRA","scale":"1/2","quality":"full","threads":4,"frames":1200,
+//    "seconds":..,"frames_per_second":..,"input_mb_per_second":..,"output_megapixels_per_second":..,
+//    "latency_ms":{"p50":..,"p90":..,"p99":..,"max":..}}
+//   {"benchmark":"resample","filter":"area","format":"RGB","instruction_set":"avx2","src":"1920x1080",
+//    "dst":"640x360","milliseconds":..,"megapixels_per_second":..,"speedup":..}
+// Log output goes to stderr.
+
+typedef std::chrono::steady_clock Clock;
+
+struct BenchmarkOptions
+{
+	std::vector<PixelFormat> formats;
+	std::vector<unsigned> scalingFactorDenominators;
+	std::vector<DecodeQuality> qualities;
+	std::vector<unsigned> threadCounts;
+	unsigned iterations;
+	bool resample;
+};
+
+static const char *PIXEL_FORMAT_NAMES[] = { "RGB", "BGR", "RGBA", "BGRA", "ABGR", "ARGB", "GRAY" };
+static const char *RESAMPLING_FILTER_NAMES[] = { "nearest", "bilinear", "area" };
+static const char *INSTRUCTION_SET_NAMES[] = { "none", "sse2", "avx2" };
+
+static std::vector<std::wstring> splitList(const std::wstring &list)
+{
+	std::vector<std::wstring> items;
+	size_t begin = 0;
+	while (begin <= list.size())
+	{
+		size_t end = list.find(L',', begin);
+		if (end == std::wstring::npos)
+			end = list.size();
+		if (end > begin)
+			items.push_back(list.substr(begin, end - begin));
+		begin = end + 1;
+	}
+	return items;
+}
+
+static PixelFormat parsePixelFormat(const std::wstring &name)
+{
+	for (size_t i = 0; i < sizeof(PIXEL_FORMAT_NAMES) / sizeof(PIXEL_FORMAT_NAMES[0]); ++i)
+	{
+		if (Base::UTF16ToUTF8(name) == PIXEL_FORMAT_NAMES[i])
+			return (PixelFormat)i;
+	}
+	CHECK(false) << "Unknown pixel format: " << Base::UTF16ToUTF8(name);
+	return PixelFormat::RGB;
+}
+
+static std::vector<std::vector<unsigned char>> loadCorpus(const std::wstring &directory)
+{
+	std::vector<std::wstring> fileNames;
+	std::vector<uint64_t> lastWriteTimes;
+	CHECK(Base::getDirectoryFileLists(directory, fileNames, lastWriteTimes)) << "Can not list " << Base::UTF16ToUTF8(directory);
+	std::sort(fileNames.begin(), fileNames.end());
+	std::vector<std::vector<unsigned char>> corpus;
+	for (const std::wstring &fileName : fileNames)
+	{
+		if (!isJPEGFileName(fileName))
+			continue;
+		Base::MemoryMappedIO file(Base::appendPath(directory, fileName).c_str());
+		const unsigned char *data = file.getPtr();
+		corpus.emplace_back(data, data + file.getSize());
+	}
+	return corpus;
+}
+
+// Nearest rank
+static double getPercentile(const std::vector<double> &sorted, double percentile)
+{
+	const size_t rank = (size_t)std::ceil(percentile / 100 * sorted.size());
+	return sorted[std::min(std::max(rank, (size_t)1), sorted.size()) - 1];
+}
+
+struct DecodeConfiguration
+{
+	PixelFormat format;
+	unsigned scalingFactorDenominator;
+	DecodeQuality quality;
+	unsigned numberOfThreads;
+};
+
+static void runDecodeBenchmark(const std::vector<std::vector<unsigned char>> &corpus, const DecodeConfiguration &configuration, unsigned iterations)
+{
+	const size_t numberOfFrames = corpus.size() * iterations;
+	std::atomic<size_t> next(0);
+	std::vector<std::vector<double>> latencies(configuration.numberOfThreads);
+	std::vector<uint64_t> pixels(configuration.numberOfThreads, 0);
+	std::vector<size_t> failures(configuration.numberOfThreads, 0);
+
+	auto worker = [&](unsigned threadIndex)
+	{
+		std::unique_ptr<JPEGDecompressor> decompressor;
+		std::vector<unsigned char> image;
+		latencies[threadIndex].reserve(numberOfFrames / configuration.numberOfThreads + 1);
+		for (size_t i = next++; i < numberOfFrames; i = next++)
+		{
+			const std::vector<unsigned char> &jpeg = corpus[i % corpus.size()];
+			const Clock::time_point begin = Clock::now();
+			try {
+				if (!decompressor)
+				{
+					decompressor.reset(new JPEGDecompressor(jpeg.data(), (unsigned long)jpeg.size()));
+					decompressor->setFormat(configuration.format);
+					decompressor->setQuality(configuration.quality);
+					decompressor->setScalingFactor(1, configuration.scalingFactorDenominator);
+				}
+				else
+					decompressor->reset(jpeg.data(), (unsigned long)jpeg.size());
+				// Grows to the largest frame once, not timed again after that
+				if (image.size() < decompressor->getSize())
+					image.resize(decompressor->getSize());
+				decompressor->process(image.data());
+				pixels[threadIndex] += uint64_t(decompressor->getScaledWidth()) * decompressor->getScaledHeight();
+			}
+			catch (std::exception &)
+			{
+				++failures[threadIndex];
+				continue;
+			}
+			latencies[threadIndex].push_back(std::chrono::duration<double, std::milli>(Clock::now() - begin).count());
+		}
+	};
+
+	const Clock::time_point begin = Clock::now();
+	std::vector<std::thread> threads;
+	for (unsigned i = 1; i < configuration.numberOfThreads; ++i)
+		threads.emplace_back(worker, i);
+	worker(0);
+	for (std::thread &thread : threads)
+		thread.join();
+	const double seconds = std::chrono::duration<double>(Clock::now() - begin).count();
+
+	std::vector<double> sortedLatencies;
+	uint64_t totalPixels = 0;
+	size_t totalFailures = 0;
+	for (unsigned i = 0; i < configuration.numberOfThreads; ++i)
+	{
+		sortedLatencies.insert(sortedLatencies.end(), latencies[i].begin(), latencies[i].end());
+		totalPixels += pixels[i];
+		totalFailures += failures[i];
+	}
+	std::sort(sortedLatencies.begin(), sortedLatencies.end());
+	uint64_t inputBytes = 0;
+	for (const std::vector<unsigned char> &jpeg : corpus)
+		inputBytes += jpeg.size();
+	inputBytes *= iterations;
+
+	std::cout << "{\"benchmark\":\"decode\",\"format\":\"" << PIXEL_FORMAT_NAMES[(uint32_t)configuration.format]
+		<< "\",\"scale\":\"1/" << configuration.scalingFactorDenominator
+		<< "\",\"quality\":\"" << (configuration.quality == DecodeQuality::full ? "full" : "preview")
+		<< "\",\"threads\":" << configuration.numberOfThreads
+		<< ",\"frames\":" << sortedLatencies.size()
+		<< ",\"failures\":" << totalFailures
+		<< ",\"seconds\":" << seconds
+		<< ",\"frames_per_second\":" << sortedLatencies.size() / seconds
+		<< ",\"input_mb_per_second\":" << inputBytes / seconds / 1e6
+		<< ",\"output_megapixels_per_second\":" << totalPixels / seconds / 1e6;
+	if (!sortedLatencies.empty())
+	{
+		std::cout << ",\"latency_ms\":{\"p50\":" << getPercentile(sortedLatencies, 50)
+			<< ",\"p90\":" << getPercentile(sortedLatencies, 90)
+			<< ",\"p99\":" << getPercentile(sortedLatencies, 99)
+			<< ",\"max\":" << sortedLatencies.back() << '}';
+	}
+	std::cout << '}' << std::endl;
+}
+
+// Single threaded, so the speedup is that of the kernels alone
+static void runResampleBenchmarks(unsigned iterations)
+{
+	const unsigned sizes[][4] = { { 1920, 1080, 640, 360 }, { 1920, 1080, 2560, 1440 }, { 640, 480, 127, 127 } };
+	const PixelFormat formats[] = { PixelFormat::GRAY, PixelFormat::RGB, PixelFormat::BGRA };
+	std::vector<SIMDInstructionSet> instructionSets = { SIMDInstructionSet::none };
+	if (isSSE2Supported())
+		instructionSets.push_back(SIMDInstructionSet::sse2);
+	if (getBestSupportedInstructionSet() == SIMDInstructionSet::avx2)
+		instructionSets.push_back(SIMDInstructionSet::avx2);
+
+	for (const auto &size : sizes)
+	{
+		for (PixelFormat format : formats)
+		{
+			const unsigned pixelSize = getPixelSize(format);
+			std::vector<unsigned char> src(size_t(size[0]) * size[1] * pixelSize);
+			for (size_t i = 0; i < src.size(); ++i)
+				src[i] = (unsigned char)(i * 2654435761u >> 24);
+			std::vector<unsigned char> dst(size_t(size[2]) * size[3] * pixelSize);
+			for (uint32_t filter = 0; filter < 3; ++filter)
+			{
+				double scalarTime = 0;
+				for (SIMDInstructionSet instructionSet : instructionSets)
+				{
+					// Warm up
+					resizeImage(src.data(), size[0], size[1], 0, dst.data(), size[2], size[3], 0, format, (ResamplingFilter)filter, instructionSet, false);
+					const Clock::time_point begin = Clock::now();
+					for (unsigned i = 0; i < iterations; ++i)
+						resizeImage(src.data(), size[0], size[1], 0, dst.data(), size[2], size[3], 0, format, (ResamplingFilter)filter, instructionSet, false);
+					const double milliseconds = std::chrono::duration<double, std::milli>(Clock::now() - begin).count() / iterations;
+					if (instructionSet == SIMDInstructionSet::none)
+						scalarTime = milliseconds;
+					std::cout << "{\"benchmark\":\"resample\",\"filter\":\"" << RESAMPLING_FILTER_NAMES[filter]
+						<< "\",\"format\":\"" << PIXEL_FORMAT_NAMES[(uint32_t)format]
+						<< "\",\"instruction_set\":\"" << INSTRUCTION_SET_NAMES[(uint32_t)instructionSet]
+						<< "\",\"src\":\"" << size[0] << 'x' << size[1]
+						<< "\",\"dst\":\"" << size[2] << 'x' << size[3]
+						<< "\",\"milliseconds\":" << milliseconds
+						<< ",\"megapixels_per_second\":" << double(size[2]) * size[3] / milliseconds / 1e3
+						<< ",\"speedup\":" << scalarTime / milliseconds << '}' << std::endl;
+				}
+			}
+		}
+	}
+}
+
+static void printUsage()
+{
+	std::wcerr << L"Usage: image_decoder_benchmark <corpus directory> [--formats=RGB,BGRA,...] [--scales=1,2,4,8] "
+		L"[--qualities=full,preview] [--threads=1,2,4,...] [--iterations=N] [--no-resample]" << std::endl;
+}
+
+int wmain(int argc, wchar_t *argv[])
+{
+	if (argc < 2)
+	{
+		printUsage();
+		return 1;
+	}
+	BenchmarkOptions options;
+	for (size_t i = 0; i < sizeof(PIXEL_FORMAT_NAMES) / sizeof(PIXEL_FORMAT_NAMES[0]); ++i)
+		options.formats.push_back((PixelFormat)i);
+	options.scalingFactorDenominators = { 1, 2, 4, 8 };
+	options.qualities = { DecodeQuality::full, DecodeQuality::preview };
+	const unsigned numberOfCores = std::max(std::thread::hardware_concurrency(), 1u);
+	for (unsigned threads = 1; threads < numberOfCores; threads *= 2)
+		options.threadCounts.push_back(threads);
+	options.threadCounts.push_back(numberOfCores);
+	options.iterations = 3;
+	options.resample = true;
+
+	try {
+		for (int i = 2; i < argc; ++i)
+		{
+			const std::wstring argument = argv[i];
+			const size_t separator = argument.find(L'=');
+			const std::wstring name = argument.substr(0, separator);
+			const std::wstring value = separator == std::wstring::npos ? std::wstring() : argument.substr(separator + 1);
+			if (name == L"--formats")
+			{
+				options.formats.clear();
+				for (const std::wstring &item : splitList(value))
+					options.formats.push_back(parsePixelFormat(item));
+			}
+			else if (name == L"--scales")
+			{
+				options.scalingFactorDenominators.clear();
+				for (const std::wstring &item : splitList(value))
+					options.scalingFactorDenominators.push_back((unsigned)std::stoul(item));
+			}
+			else if (name == L"--qualities")
+			{
+				options.qualities.clear();
+				for (const std::wstring &item : splitList(value))
+					options.qualities.push_back(item == L"preview" ? DecodeQuality::preview : DecodeQuality::full);
+			}
+			else if (name == L"--threads")
+			{
+				options.threadCounts.clear();
+				for (const std::wstring &item : splitList(value))
+					options.threadCounts.push_back(std::max((unsigned)std::stoul(item), 1u));
+			}
+			else if (name == L"--iterations")
+				options.iterations = std::max((unsigned)std::stoul(value), 1u);
+			else if (name == L"--no-resample")
+				options.resample = false;
+			else
+			{
+				printUsage();
+				return 1;
+			}
+		}
+		for (unsigned denominator : options.scalingFactorDenominators)
+			CHECK(JPEGDecompressor::isScalingFactorSupported(1, denominator)) << "Unsupported scaling factor: 1/" << denominator;
+
+		const std::vector<std::vector<unsigned char>> corpus = loadCorpus(argv[1]);
+		CHECK(!corpus.empty()) << "No JPEG files in " << Base::UTF16ToUTF8(argv[1]);
+		std::cerr << corpus.size() << " JPEG files loaded" << std::endl;
+
+		for (PixelFormat format : options.formats)
+			for (unsigned denominator : options.scalingFactorDenominators)
+				for (DecodeQuality quality : options.qualities)
+					for (unsigned threads : options.threadCounts)
+					{
+						const DecodeConfiguration configuration = { format, denominator, quality, threads };
+						runDecodeBenchmark(corpus, configuration, options.iterations);
+					}
+		if (options.resample)
+			runResampleBenchmarks(options.iterations * 10);
+	}
+	catch (std::exception &exp)
+	{
+		std::cerr << exp.what() << std::endl;
+		return 1;
+	}
+	return 0;
+}
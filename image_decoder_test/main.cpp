@@ -1,8 +1,9 @@
 #include <base/d2d_window.h>
-#include <base/memory_mapped_io.h>
 
+#include <base/async_logging.h>
 #include <base/logging.h>
 #include <decoder.h>
+#include <file_decoder.h>
 
 #include <dshow.h>
 
@@ -14,20 +15,20 @@ int __stdcall wWinMain(HINSTANCE hInstance,
 	(hInstance);
 	(hPrevInstance);
 	(nShowCmd);
+	Base::AsyncLogging asyncLogging;
 	ENSURE_HR(CoInitialize(nullptr));
 	{
-		Base::MemoryMappedIO file(lpCmdLine);
-		JPEGDecompressor decompressor(file.getPtr(), (uint32_t)file.getSize());
+		JPEGFileDecoder fileDecoder;
+		JPEGDecompressor &decompressor = fileDecoder.open(lpCmdLine);
 		uint32_t width = decompressor.getWidth(), height = decompressor.getHeight();
 		decompressor.setFormat(PixelFormat::BGRA);
 		double dpix = 96, dpiy = 96;
 		//decoder.getResolution(&width, &height);
-		std::vector<unsigned char> image(decompressor.getSize());
-		decompressor.process(image.data());
+		Base::BufferLease image = decompressor.process();
 
 		Base::D2DWindow window;
 		window.Initialize();
-		window.setImage(image.data(), width, height, dpix, dpiy);
+		window.setImage(image.get(), width, height, dpix, dpiy);
 		window.RunMessageLoop();
 	}
 	CoUninitialize();
@@ -0,0 +1,1342 @@
+#define CATCH_CONFIG_MAIN
+#include <catch.hpp>
+
+#include <async_decoder.h>
+#include <batch_decoder.h>
+#include <box_propagator.h>
+#include <file_decoder.h>
+#include <frame_hash.h>
+#include <header_scanner.h>
+#include <preview_refiner.h>
+#include <region_decoder.h>
+#include <resampler.h>
+#include <sequence_archive.h>
+#include <thumbnail_store.h>
+#include <transformer.h>
+#include <yuv_conversion.h>
+
+#include <turbojpeg.h>
+
+#include <spdlog/logger.h>
+#include <spdlog/sinks/base_sink.h>
+
+#include <base/async_io.h>
+#include <base/async_logging.h>
+#include <base/buffer_pool.h>
+#include <base/dataset_scanner.h>
+#include <base/directory_watcher.h>
+#include <base/event.h>
+#include <base/file.h>
+// Only CHECK collides, Catch's is kept
+#pragma push_macro("CHECK")
+#undef CHECK
+#include <base/logging.h>
+#undef CHECK
+#pragma pop_macro("CHECK")
+#include <base/memory_mapped_io.h>
+#include <base/message_notifier.h>
+#include <base/task_scheduler.h>
+#include <base/timer_wheel.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+static std::vector<unsigned char> compressTestImage(unsigned width, unsigned height)
+{
+	std::vector<unsigned char> image(width * height * 3);
+	for (unsigned y = 0; y < height; ++y)
+		for (unsigned x = 0; x < width; ++x)
+		{
+			unsigned char *pixel = image.data() + (y * width + x) * 3;
+			pixel[0] = (unsigned char)(x * 255 / width);
+			pixel[1] = (unsigned char)(y * 255 / height);
+			pixel[2] = 128;
+		}
+	tjhandle handle = tjInitCompress();
+	REQUIRE(handle);
+	unsigned char *jpeg = nullptr;
+	unsigned long jpegSize = 0;
+	REQUIRE(tjCompress2(handle, image.data(), width, 0, height, TJPF_RGB, &jpeg, &jpegSize, TJSAMP_420, 90, 0) == 0);
+	std::vector<unsigned char> result(jpeg, jpeg + jpegSize);
+	tjFree(jpeg);
+	tjDestroy(handle);
+	return result;
+}
+
+static void fillRandom(std::vector<unsigned char> &buffer, std::mt19937 &engine)
+{
+	std::uniform_int_distribution<int> distribution(0, 255);
+	for (unsigned char &value : buffer)
+		value = (unsigned char)distribution(engine);
+}
+
+TEST_CASE("yuv to bgra simd kernels match scalar")
+{
+	std::mt19937 engine(1);
+	const Subsampling subsamplings[] = { Subsampling::YUV444, Subsampling::YUV422, Subsampling::YUV420, Subsampling::GRAY, Subsampling::YUV440, Subsampling::YUV411 };
+	const unsigned widths[] = { 1, 15, 17, 33, 64, 101 };
+	const unsigned height = 7;
+
+	for (Subsampling subsampling : subsamplings)
+	{
+		for (unsigned width : widths)
+		{
+			std::vector<unsigned char> planeBuffers[3];
+			const unsigned char *planes[3];
+			int strides[3];
+			const int numberOfPlanes = subsampling == Subsampling::GRAY ? 1 : 3;
+			for (int i = 0; i < numberOfPlanes; ++i)
+			{
+				strides[i] = tjPlaneWidth(i, width, (int)subsampling);
+				planeBuffers[i].resize(strides[i] * tjPlaneHeight(i, height, (int)subsampling));
+				fillRandom(planeBuffers[i], engine);
+				planes[i] = planeBuffers[i].data();
+			}
+
+			std::vector<unsigned char> reference(width * height * 4);
+			convertYUVPlanesToBGRA(planes, strides, width, height, subsampling, reference.data(), 0, SIMDInstructionSet::none);
+
+			std::vector<unsigned char> result(width * height * 4);
+			if (isSSE2Supported())
+			{
+				convertYUVPlanesToBGRA(planes, strides, width, height, subsampling, result.data(), 0, SIMDInstructionSet::sse2);
+				CHECK(result == reference);
+			}
+			if (isAVX2Supported())
+			{
+				convertYUVPlanesToBGRA(planes, strides, width, height, subsampling, result.data(), 0, SIMDInstructionSet::avx2);
+				CHECK(result == reference);
+			}
+		}
+	}
+}
+
+TEST_CASE("resampling simd kernels match scalar")
+{
+	std::mt19937 engine(2);
+	const PixelFormat formats[] = { PixelFormat::GRAY, PixelFormat::RGB, PixelFormat::BGRA };
+	const ResamplingFilter filters[] = { ResamplingFilter::nearest, ResamplingFilter::bilinear, ResamplingFilter::area };
+	// Shrinking, enlarging and mixed, the last one large enough to be tiled
+	const unsigned sizes[][4] = { { 101, 37, 33, 12 }, { 17, 9, 70, 41 }, { 64, 64, 100, 23 }, { 1, 5, 3, 3 }, { 900, 700, 333, 301 } };
+
+	for (PixelFormat format : formats)
+	{
+		const unsigned pixelSize = getPixelSize(format);
+		for (const auto &size : sizes)
+		{
+			std::vector<unsigned char> src(size[0] * size[1] * pixelSize);
+			fillRandom(src, engine);
+			for (ResamplingFilter filter : filters)
+			{
+				std::vector<unsigned char> reference(size[2] * size[3] * pixelSize);
+				resizeImage(src.data(), size[0], size[1], 0, reference.data(), size[2], size[3], 0, format, filter, SIMDInstructionSet::none, false);
+
+				std::vector<unsigned char> result(reference.size());
+				resizeImage(src.data(), size[0], size[1], 0, result.data(), size[2], size[3], 0, format, filter, SIMDInstructionSet::none, true);
+				CHECK(result == reference);
+				if (isSSE2Supported())
+				{
+					resizeImage(src.data(), size[0], size[1], 0, result.data(), size[2], size[3], 0, format, filter, SIMDInstructionSet::sse2, true);
+					CHECK(result == reference);
+				}
+				if (isAVX2Supported())
+				{
+					resizeImage(src.data(), size[0], size[1], 0, result.data(), size[2], size[3], 0, format, filter, SIMDInstructionSet::avx2, true);
+					CHECK(result == reference);
+				}
+			}
+		}
+	}
+}
+
+TEST_CASE("scaling factors")
+{
+	CHECK(JPEGDecompressor::isScalingFactorSupported(1, 1));
+	CHECK(JPEGDecompressor::isScalingFactorSupported(1, 2));
+	CHECK(JPEGDecompressor::isScalingFactorSupported(2, 4));
+	CHECK(JPEGDecompressor::isScalingFactorSupported(1, 8));
+	CHECK_FALSE(JPEGDecompressor::isScalingFactorSupported(1, 3));
+	CHECK_FALSE(JPEGDecompressor::isScalingFactorSupported(1, 16));
+	CHECK_FALSE(JPEGDecompressor::isScalingFactorSupported(0, 0));
+	CHECK_FALSE(JPEGDecompressor::isScalingFactorSupported(0, 1));
+	CHECK_FALSE(JPEGDecompressor::isScalingFactorSupported(1, 0));
+}
+
+TEST_CASE("batch decode")
+{
+	const std::vector<unsigned char> frame = compressTestImage(64, 48);
+	const std::vector<unsigned char> otherSize = compressTestImage(32, 48);
+	const std::vector<unsigned char> garbage(100, 0xAB);
+	const unsigned char *srcs[] = { frame.data(), otherSize.data(), garbage.data(), frame.data() };
+	const unsigned long sizes[] = { (unsigned long)frame.size(), (unsigned long)otherSize.size(), (unsigned long)garbage.size(), (unsigned long)frame.size() };
+
+	BatchDecoder decoder(64, 48, PixelFormat::BGRA);
+	REQUIRE(decoder.getSlotSize() == 64 * 48 * 4);
+	std::vector<unsigned char> batch(decoder.getSlotSize() * 4, 0xFF);
+	BatchSlotStatus statuses[4];
+	CHECK(decoder.decode(srcs, sizes, 4, batch.data(), statuses) == 2);
+	CHECK(statuses[0] == BatchSlotStatus::ok);
+	CHECK(statuses[1] == BatchSlotStatus::sizeMismatch);
+	CHECK(statuses[2] == BatchSlotStatus::decodeFailed);
+	CHECK(statuses[3] == BatchSlotStatus::ok);
+
+	JPEGDecompressor decompressor(frame.data(), (unsigned long)frame.size());
+	decompressor.setFormat(PixelFormat::BGRA);
+	std::vector<unsigned char> expected(decompressor.getSize());
+	decompressor.process(expected.data());
+	const size_t slotSize = decoder.getSlotSize();
+	CHECK(std::equal(expected.begin(), expected.end(), batch.begin()));
+	CHECK(std::equal(expected.begin(), expected.end(), batch.begin() + slotSize * 3));
+	CHECK(std::all_of(batch.begin() + slotSize, batch.begin() + slotSize * 3, [](unsigned char value) { return value == 0; }));
+}
+
+TEST_CASE("header scan matches the decompressor")
+{
+	const std::vector<unsigned char> jpeg = compressTestImage(70, 33);
+	JPEGImageInfo info;
+	REQUIRE(parseJPEGHeader(jpeg.data(), jpeg.size(), &info));
+	JPEGDecompressor decompressor(jpeg.data(), (unsigned long)jpeg.size());
+	CHECK(info.width == decompressor.getWidth());
+	CHECK(info.height == decompressor.getHeight());
+	CHECK(info.subsampling == decompressor.getSubsampling());
+	CHECK(info.numberOfComponents == 3);
+
+	CHECK_FALSE(parseJPEGHeader(jpeg.data(), 20, &info));
+	const unsigned char notJPEG[] = { 0x89, 'P', 'N', 'G' };
+	CHECK_FALSE(parseJPEGHeader(notJPEG, sizeof(notJPEG), &info));
+
+	// Same frame declared as extended sequential, then as lossless, which libjpeg-turbo can not decode
+	const unsigned char sof0[] = { 0xFF, 0xC0, 0x00, 0x11 };
+	std::vector<unsigned char> patched = jpeg;
+	const auto sof = std::search(patched.begin(), patched.end(), std::begin(sof0), std::end(sof0));
+	REQUIRE(sof != patched.end());
+	sof[1] = 0xC1;
+	CHECK(parseJPEGHeader(patched.data(), patched.size(), &info));
+	sof[1] = 0xC3;
+	CHECK_FALSE(parseJPEGHeader(patched.data(), patched.size(), &info));
+}
+
+TEST_CASE("region decode matches a full decode")
+{
+	const std::vector<unsigned char> jpeg = compressTestImage(100, 70);
+	JPEGDecompressor decompressor(jpeg.data(), (unsigned long)jpeg.size());
+	JPEGRegionDecompressor regionDecompressor;
+	regionDecompressor.reset(jpeg.data(), (unsigned long)jpeg.size());
+	REQUIRE(regionDecompressor.getWidth() == 100);
+	REQUIRE(regionDecompressor.getHeight() == 70);
+
+	for (unsigned denominator : { 1u, 2u })
+	{
+		decompressor.setScalingFactor(1, denominator);
+		regionDecompressor.setScalingFactor(1, denominator);
+		const unsigned width = decompressor.getScaledWidth();
+		REQUIRE(regionDecompressor.getScaledWidth() == width);
+		std::vector<unsigned char> full(decompressor.getSize());
+		decompressor.process(full.data());
+
+		const unsigned regions[][4] = { { 0, 0, 1, 1 }, { 17, 9, 21, 13 }, { 32, 16, 16, 16 }, { width / 2, 5, width - width / 2, 20 } };
+		for (const auto &region : regions)
+		{
+			std::vector<unsigned char> part(region[2] * region[3] * 3);
+			regionDecompressor.process(region[0], region[1], region[2], region[3], part.data());
+			for (unsigned row = 0; row < region[3]; ++row)
+				CHECK(std::equal(part.begin() + row * region[2] * 3, part.begin() + (row + 1) * region[2] * 3,
+					full.begin() + ((region[1] + row) * width + region[0]) * 3));
+		}
+	}
+}
+
+TEST_CASE("box propagation follows a shifted texture")
+{
+	const unsigned width = 320, height = 240;
+	const int shiftX = 9, shiftY = -5;
+	std::mt19937 engine(3);
+	std::vector<unsigned char> texture((width + 32) * (height + 32));
+	fillRandom(texture, engine);
+	// Low-pass, neither JPEG nor the template resampling keep much of white noise
+	for (int pass = 0; pass < 4; ++pass)
+		for (size_t i = 0; i + width + 33 < texture.size(); ++i)
+			texture[i] = (unsigned char)((texture[i] + texture[i + 1] + texture[i + width + 32] + texture[i + width + 33]) / 4);
+
+	tjhandle handle = tjInitCompress();
+	REQUIRE(handle);
+	std::vector<unsigned char> jpegs[2];
+	for (int frame = 0; frame < 2; ++frame)
+	{
+		std::vector<unsigned char> image(width * height);
+		for (unsigned y = 0; y < height; ++y)
+			for (unsigned x = 0; x < width; ++x)
+				image[y * width + x] = texture[(y + 16 - frame * shiftY) * (width + 32) + x + 16 - frame * shiftX];
+		unsigned char *jpeg = nullptr;
+		unsigned long jpegSize = 0;
+		REQUIRE(tjCompress2(handle, image.data(), width, 0, height, TJPF_GRAY, &jpeg, &jpegSize, TJSAMP_GRAY, 95, 0) == 0);
+		jpegs[frame].assign(jpeg, jpeg + jpegSize);
+		tjFree(jpeg);
+	}
+	tjDestroy(handle);
+
+	for (SIMDInstructionSet instructionSet : { SIMDInstructionSet::none, getBestSupportedInstructionSet() })
+	{
+		BoxPropagator propagator(2., 32, instructionSet);
+		const PropagatedBox box = propagator.propagate(jpegs[0].data(), (unsigned long)jpegs[0].size(), jpegs[1].data(), (unsigned long)jpegs[1].size(), 120, 90, 60, 50);
+		CHECK(std::abs(box.x - (120 + shiftX)) < 1);
+		CHECK(std::abs(box.y - (90 + shiftY)) < 1);
+		CHECK(std::abs(box.w - 60) < 1);
+		CHECK(std::abs(box.h - 50) < 1);
+		CHECK(box.confidence > 0.8);
+	}
+}
+
+TEST_CASE("async decode matches a synchronous decode")
+{
+	const std::vector<unsigned char> jpeg = compressTestImage(64, 48);
+	JPEGDecompressor decompressor(jpeg.data(), (unsigned long)jpeg.size());
+	std::vector<unsigned char> reference(decompressor.getSize());
+	decompressor.process(reference.data());
+
+	const unsigned numberOfRequests = 32;
+	std::vector<std::vector<unsigned char>> images(numberOfRequests, std::vector<unsigned char>(reference.size()));
+	std::atomic<unsigned> numberOfCallbacks(0);
+	{
+		AsyncDecoder decoder(2, 4);
+		std::vector<uint64_t> tickets;
+		for (unsigned i = 0; i < numberOfRequests; ++i)
+		{
+			AsyncDecodeRequest request = {};
+			request.src = jpeg.data();
+			request.srcSize = (unsigned long)jpeg.size();
+			request.dst = images[i].data();
+			request.dstCapacity = images[i].size();
+			request.format = PixelFormat::RGB;
+			request.scalingFactorDenominator = 1;
+			if (i % 2)
+				request.callback = [&numberOfCallbacks](uint64_t, AsyncDecodeStatus status, unsigned, unsigned) { if (status == AsyncDecodeStatus::ok) ++numberOfCallbacks; };
+			// More requests than the queue holds, submit() has to wait for the workers
+			const uint64_t ticket = decoder.submit(request);
+			REQUIRE(ticket);
+			if (!request.callback)
+				tickets.push_back(ticket);
+		}
+		for (uint64_t ticket : tickets)
+		{
+			unsigned width = 0, height = 0;
+			CHECK(decoder.wait(ticket, 10000, &width, &height) == AsyncDecodeStatus::ok);
+			CHECK(width == 64);
+			CHECK(height == 48);
+		}
+
+		AsyncDecodeRequest request = {};
+		request.src = jpeg.data();
+		request.srcSize = (unsigned long)jpeg.size();
+		request.dst = images[0].data();
+		request.dstCapacity = images[0].size() - 1;
+		request.format = PixelFormat::RGB;
+		request.scalingFactorDenominator = 1;
+		unsigned width, height;
+		CHECK(decoder.wait(decoder.submit(request), 10000, &width, &height) == AsyncDecodeStatus::bufferTooSmall);
+	}
+	// All requests left the queue before the last one completed, destruction waits for those still decoding
+	CHECK(numberOfCallbacks == numberOfRequests / 2);
+	for (const std::vector<unsigned char> &image : images)
+		CHECK(image == reference);
+}
+
+TEST_CASE("async decoders share the workers of one scheduler")
+{
+	const std::vector<unsigned char> jpeg = compressTestImage(64, 48);
+	Base::TaskScheduler scheduler(2);
+	std::vector<unsigned char> first(64 * 48 * 3), second(first.size());
+	{
+		AsyncDecoder decoder1(scheduler, 1), decoder2(scheduler, 1);
+		CHECK(decoder1.getNumberOfThreads() == 2);
+		AsyncDecodeRequest request = {};
+		request.src = jpeg.data();
+		request.srcSize = (unsigned long)jpeg.size();
+		request.format = PixelFormat::RGB;
+		request.scalingFactorDenominator = 1;
+		request.dst = first.data();
+		request.dstCapacity = first.size();
+		const uint64_t ticket1 = decoder1.submit(request);
+		request.dst = second.data();
+		const uint64_t ticket2 = decoder2.submit(request);
+		unsigned width, height;
+		CHECK(decoder1.wait(ticket1, 10000, &width, &height) == AsyncDecodeStatus::ok);
+		CHECK(decoder2.wait(ticket2, 10000, &width, &height) == AsyncDecodeStatus::ok);
+	}
+	CHECK(first == second);
+	// The scheduler keeps running after its decoders are gone
+	std::atomic<bool> ran(false);
+	{
+		Base::TaskGroup group(scheduler);
+		group.run([&ran]() { ran = true; });
+	}
+	CHECK(ran);
+}
+
+TEST_CASE("file decode reads prefetched and unprefetched frames")
+{
+	std::vector<std::vector<unsigned char>> jpegs = { compressTestImage(64, 48), compressTestImage(32, 16), compressTestImage(96, 64) };
+	std::vector<std::wstring> paths;
+	for (size_t i = 0; i < jpegs.size(); ++i)
+	{
+		paths.push_back(Base::appendPath(Base::getTempPath(), L"image_decoder_unit_test_" + std::to_wstring(i) + L".jpg"));
+		Base::File file(paths.back(), Base::File::Mode::write | Base::File::Mode::create_always);
+		file.write(jpegs[i].data(), 0, jpegs[i].size());
+	}
+	{
+		// Room for one prefetched frame, the second prefetch pushes the first out
+		JPEGFileDecoder decoder(1);
+		decoder.prefetch(paths[1]);
+		decoder.prefetch(paths[2]);
+		CHECK(decoder.getNumberOfPrefetchedFrames() == 1);
+		for (size_t i = 0; i < jpegs.size(); ++i)
+		{
+			JPEGDecompressor &decompressor = decoder.open(paths[i]);
+			std::vector<unsigned char> image(decompressor.getSize());
+			decompressor.process(image.data());
+
+			JPEGDecompressor reference(jpegs[i].data(), (unsigned long)jpegs[i].size());
+			std::vector<unsigned char> referenceImage(reference.getSize());
+			reference.process(referenceImage.data());
+			CHECK(decompressor.getWidth() == reference.getWidth());
+			CHECK(image == referenceImage);
+		}
+		CHECK(decoder.getNumberOfPrefetchedFrames() == 0);
+		CHECK_THROWS(decoder.open(paths[0] + L".missing"));
+	}
+	for (const std::wstring &path : paths)
+		DeleteFileW(path.c_str());
+}
+
+TEST_CASE("preview refiner follows a scaled preview with a full resolution frame")
+{
+	const std::vector<unsigned char> first = compressTestImage(64, 48), second = compressTestImage(32, 16);
+	struct Frame
+	{
+		unsigned width;
+		unsigned height;
+		DecodeQuality quality;
+		long long elapsed_ms;
+	};
+	const uint32_t settleTime_ms = 200;
+	const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	auto getElapsed = [start]()
+	{
+		return (long long)std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+	};
+	std::mutex lock;
+	std::vector<Frame> frames;
+	Base::NativeEventLooper looper;
+	PreviewRefiner refiner(PixelFormat::RGB, [&](const unsigned char *, unsigned width, unsigned height, DecodeQuality quality)
+	{
+		std::lock_guard<std::mutex> lock_guard(lock);
+		frames.push_back(Frame{ width, height, quality, getElapsed() });
+		if (quality == DecodeQuality::full)
+			looper.cancel();
+	}, settleTime_ms, 2);
+	looper.registerWaitableObject(&refiner);
+	std::thread looperThread([&looper]() { looper.runLooper(); });
+	refiner.seek(first.data(), (unsigned long)first.size());
+	// Seeking again before the first frame settled cancels its refinement
+	std::this_thread::sleep_for(std::chrono::milliseconds(settleTime_ms / 2));
+	const long long secondSeek_ms = getElapsed();
+	refiner.seek(second.data(), (unsigned long)second.size());
+	looperThread.join();
+	looper.eraseWaitableObject(&refiner);
+
+	REQUIRE(frames.size() == 3);
+	CHECK(frames[0].quality == DecodeQuality::preview);
+	CHECK((frames[0].width == 32 && frames[0].height == 24));
+	CHECK(frames[1].quality == DecodeQuality::preview);
+	CHECK((frames[1].width == 16 && frames[1].height == 8));
+	CHECK(frames[2].quality == DecodeQuality::full);
+	CHECK((frames[2].width == 32 && frames[2].height == 16));
+	CHECK(frames[2].elapsed_ms >= secondSeek_ms + settleTime_ms);
+}
+
+TEST_CASE("lossless transform round trips and maps boxes")
+{
+	const std::vector<unsigned char> jpeg = compressTestImage(64, 48);
+	JPEGTransformer transformer(JPEGTransformOperation::rotate90);
+	std::vector<unsigned char> rotated = jpeg, next;
+	for (unsigned i = 0; i < 4; ++i)
+	{
+		const JPEGTransformGeometry geometry = transformer.transform(rotated.data(), (unsigned long)rotated.size(), next);
+		CHECK(geometry.width == (i % 2 ? 64U : 48U));
+		rotated.swap(next);
+	}
+	// Four quarter turns give back the coefficients of the original
+	JPEGDecompressor original(jpeg.data(), (unsigned long)jpeg.size()), roundTrip(rotated.data(), (unsigned long)rotated.size());
+	std::vector<unsigned char> originalImage(original.getSize()), roundTripImage(roundTrip.getSize());
+	original.process(originalImage.data());
+	roundTrip.process(roundTripImage.data());
+	CHECK(originalImage == roundTripImage);
+
+	JPEGTransformGeometry geometry = transformer.getGeometry(jpeg.data(), (unsigned long)jpeg.size());
+	int x = 0, y = 0, w = 10, h = 5;
+	REQUIRE(JPEGTransformer::transformBox(geometry, &x, &y, &w, &h));
+	CHECK((x == 43 && y == 0 && w == 5 && h == 10));
+
+	// 4:2:0, the corner moves to the 16 x 16 grid
+	transformer.setOperation(JPEGTransformOperation::none);
+	transformer.setCrop(20, 10, 16, 16);
+	geometry = transformer.transform(jpeg.data(), (unsigned long)jpeg.size(), next);
+	CHECK((geometry.cropX == 16 && geometry.cropY == 0 && geometry.width == 20 && geometry.height == 26));
+	JPEGDecompressor cropped(next.data(), (unsigned long)next.size());
+	CHECK(cropped.getWidth() == 20);
+	CHECK(cropped.getHeight() == 26);
+	x = 0, y = 30, w = 8, h = 8;
+	CHECK_FALSE(JPEGTransformer::transformBox(geometry, &x, &y, &w, &h));
+}
+
+TEST_CASE("frame hashes find exact and near duplicates")
+{
+	const unsigned char check[] = "123456789";
+	CHECK(computeCRC32C(check, 9, 0, false) == 0xE3069283U);
+	if (isSSE42Supported())
+		CHECK(computeCRC32C(check, 9, 0, true) == 0xE3069283U);
+
+	const std::vector<unsigned char> jpeg = compressTestImage(64, 48);
+	const FrameHash hash = hashFrame(jpeg.data(), jpeg.size());
+	CHECK(hash.decoded);
+	CHECK(hash.crc32c == computeCRC32C(jpeg.data(), jpeg.size()));
+
+	std::vector<FrameHash> hashes(5, hash);
+	// Re-encoded: other bytes, nearly the same picture
+	hashes[1].crc32c ^= 1;
+	hashes[1].differenceHash ^= 0x8000000000000001ULL;
+	// Another picture
+	hashes[3].crc32c ^= 2;
+	hashes[3].differenceHash = ~hash.differenceHash;
+	// Unreadable
+	hashes[4] = FrameHash{};
+	const std::vector<DuplicateFrame> duplicates = findDuplicateFrames(hashes, 3);
+	REQUIRE(duplicates.size() == 2);
+	CHECK((duplicates[0].frame == 1 && duplicates[0].original == 0 && duplicates[0].kind == DuplicateKind::near && duplicates[0].distance == 2));
+	CHECK((duplicates[1].frame == 2 && duplicates[1].original == 0 && duplicates[1].kind == DuplicateKind::exact));
+	CHECK(findDuplicateFrames(hashes, 1).size() == 1);
+
+	// Same size and CRC-32C, only the files tell a collision from a copy
+	const std::vector<unsigned char> contents[3] = { { 1, 2, 3, 4 }, { 4, 3, 2, 1 }, { 1, 2, 3, 4 } };
+	std::vector<std::wstring> paths;
+	for (size_t i = 0; i < 3; ++i)
+	{
+		paths.push_back(Base::appendPath(Base::getTempPath(), L"image_decoder_unit_test_frame_" + std::to_wstring(i) + L".bin"));
+		Base::File(paths.back(), Base::File::Mode::write | Base::File::Mode::create_always).write(contents[i].data(), 0, contents[i].size());
+	}
+	const FrameHash colliding = { 4, 0x12345678U, false, 0 };
+	const std::vector<FrameHash> collidingHashes(3, colliding);
+	CHECK(findDuplicateFrames(collidingHashes, 0).size() == 2);
+	const std::vector<DuplicateFrame> fileDuplicates = findDuplicateFrameFiles(paths, collidingHashes, 0);
+	REQUIRE(fileDuplicates.size() == 1);
+	CHECK((fileDuplicates[0].frame == 2 && fileDuplicates[0].original == 0 && fileDuplicates[0].kind == DuplicateKind::exact));
+	for (const std::wstring &path : paths)
+		DeleteFileW(path.c_str());
+}
+
+TEST_CASE("scatter reads merge nearby ranges")
+{
+	std::vector<unsigned char> data(300000);
+	for (size_t i = 0; i < data.size(); ++i)
+		data[i] = (unsigned char)(i * 7 + i / 251);
+	const std::wstring path = Base::appendPath(Base::getTempPath(), L"image_decoder_unit_test_ranges.bin");
+	{
+		Base::File file(path, Base::File::Mode::write | Base::File::Mode::create_always);
+		REQUIRE(file.write(data.data(), 0, data.size()) == data.size());
+	}
+	{
+		Base::File file(path, Base::File::Mode::read | Base::File::Mode::overlapped);
+		// Out of order, two close enough to be merged, one far away, one past the end of the file
+		const uint64_t offsets[] = { 1000, 10, 250000, 299990 };
+		const uint64_t sizes[] = { 500, 100, 4096, 100 };
+		std::vector<std::vector<unsigned char>> buffers;
+		std::vector<Base::FileRange> ranges;
+		for (size_t i = 0; i < 4; ++i)
+			buffers.emplace_back(size_t(sizes[i]));
+		for (size_t i = 0; i < 4; ++i)
+			ranges.push_back(Base::FileRange{ offsets[i], sizes[i], buffers[i].data() });
+		CHECK(file.readRanges(ranges.data(), ranges.size()) == 500 + 100 + 4096 + 10);
+		for (size_t i = 0; i < 4; ++i)
+		{
+			const size_t size = std::min(size_t(sizes[i]), data.size() - size_t(offsets[i]));
+			CHECK(std::equal(buffers[i].begin(), buffers[i].begin() + size, data.begin() + size_t(offsets[i])));
+		}
+		unsigned char tail[16];
+		CHECK(file.read(tail, data.size() - 4, sizeof(tail)) == 4);
+	}
+	DeleteFileW(path.c_str());
+}
+
+TEST_CASE("memory mapped windows slide over the file")
+{
+	std::vector<unsigned char> data(300000);
+	for (size_t i = 0; i < data.size(); ++i)
+		data[i] = (unsigned char)(i * 11 + i / 257);
+	const std::wstring path = Base::appendPath(Base::getTempPath(), L"image_decoder_unit_test_mapped.bin");
+	{
+		Base::File file(path, Base::File::Mode::write | Base::File::Mode::create_always);
+		REQUIRE(file.write(data.data(), 0, data.size()) == data.size());
+	}
+	{
+		Base::MemoryMappedIO whole(path.c_str(), Base::MemoryMappedIO::AccessHint::sequential);
+		REQUIRE(whole.getSize() == data.size());
+		CHECK(std::equal(data.begin(), data.end(), whole.getPtr()));
+	}
+	{
+		// Not aligned to the allocation granularity
+		Base::MemoryMappedIO window(path.c_str(), 70001, 100000, Base::MemoryMappedIO::AccessHint::random);
+		REQUIRE(window.getOffset() == 70001);
+		REQUIRE(window.getSize() == 100000);
+		CHECK(window.getFileSize() == data.size());
+		window.prefetch(10, 5000);
+		window.lock();
+		CHECK(std::equal(data.begin() + 70001, data.begin() + 170001, window.getPtr()));
+		window.unlock();
+
+		// Up to the end of the file
+		window.remap(250003);
+		REQUIRE(window.getOffset() == 250003);
+		REQUIRE(window.getSize() == data.size() - 250003);
+		window.populate();
+		CHECK(std::equal(data.begin() + 250003, data.end(), window.getPtr()));
+
+		window.remap(65536, 4096);
+		REQUIRE(window.getSize() == 4096);
+		CHECK(std::equal(data.begin() + 65536, data.begin() + 65536 + 4096, window.getPtr()));
+	}
+	DeleteFileW(path.c_str());
+}
+
+TEST_CASE("sequence archive round trips frames, names and records")
+{
+	std::vector<std::vector<unsigned char>> jpegs = { compressTestImage(64, 48), compressTestImage(32, 16), compressTestImage(96, 64) };
+	const std::wstring path = Base::appendPath(Base::getTempPath(), L"image_decoder_unit_test.seq");
+	{
+		SequenceArchiveWriter writer(path, true);
+		for (unsigned i = 0; i < jpegs.size(); ++i)
+		{
+			SequenceArchiveRecord record = {};
+			record.id = int32_t(i);
+			record.x = int32_t(i * 10);
+			record.w = 5;
+			record.labeled = 1;
+			writer.addFrame(L"frame" + std::to_wstring(i) + L".jpg", jpegs[i].data(), uint32_t(jpegs[i].size()), &record);
+		}
+		writer.finish();
+	}
+	{
+		SequenceArchiveReader reader(path);
+		REQUIRE(reader.getNumberOfFrames() == jpegs.size());
+		REQUIRE(reader.hasRecords());
+		for (uint32_t i = 0; i < jpegs.size(); ++i)
+		{
+			uint32_t size;
+			const unsigned char *frame = reader.getFrame(i, &size);
+			REQUIRE(size == jpegs[i].size());
+			CHECK(std::equal(jpegs[i].begin(), jpegs[i].end(), frame));
+			CHECK(reader.getFrameName(i) == L"frame" + std::to_wstring(i) + L".jpg");
+			CHECK(reader.getRecord(i).id == int32_t(i));
+			CHECK(reader.getRecord(i).x == int32_t(i * 10));
+			CHECK(reader.getRecord(i).labeled == 1);
+		}
+		CHECK_THROWS(reader.getFrameName(uint32_t(jpegs.size())));
+	}
+	{
+		// A names length that wraps around when multiplied by sizeof(wchar_t)
+		Base::File file(path, Base::File::Mode::write | Base::File::Mode::open_always);
+		const uint64_t namesLength = 0x8000000000000001ULL;
+		REQUIRE(file.write((const unsigned char*)&namesLength, offsetof(SequenceArchiveHeader, namesLength), sizeof(namesLength)) == sizeof(namesLength));
+	}
+	CHECK_THROWS(SequenceArchiveReader(path));
+	DeleteFileW(path.c_str());
+}
+
+TEST_CASE("thumbnail store rebuilds only new and changed frames")
+{
+	const std::wstring directory = Base::appendPath(Base::getTempPath(), L"image_decoder_unit_test_thumbnails");
+	const std::wstring storePath = Base::appendPath(Base::getTempPath(), L"image_decoder_unit_test.thumbs");
+	CreateDirectoryW(directory.c_str(), nullptr);
+	DeleteFileW(storePath.c_str());
+	auto writeFrame = [&](const wchar_t *name, const std::vector<unsigned char> &jpeg)
+	{
+		Base::File(Base::appendPath(directory, name), Base::File::Mode::write | Base::File::Mode::create_always).write(jpeg.data(), 0, jpeg.size());
+	};
+	auto getLastWriteTime = [&](const wchar_t *name)
+	{
+		HANDLE file = CreateFileW(Base::appendPath(directory, name).c_str(), FILE_READ_ATTRIBUTES, FILE_SHARE_READ, nullptr, OPEN_EXISTING, 0, nullptr);
+		ULARGE_INTEGER time = {};
+		FILETIME fileTime;
+		if (GetFileTime(file, nullptr, nullptr, &fileTime))
+		{
+			time.LowPart = fileTime.dwLowDateTime;
+			time.HighPart = fileTime.dwHighDateTime;
+		}
+		CloseHandle(file);
+		return time.QuadPart;
+	};
+	auto setLastWriteTime = [&](const wchar_t *name, uint64_t time)
+	{
+		HANDLE file = CreateFileW(Base::appendPath(directory, name).c_str(), FILE_WRITE_ATTRIBUTES, FILE_SHARE_READ, nullptr, OPEN_EXISTING, 0, nullptr);
+		FILETIME fileTime;
+		fileTime.dwLowDateTime = DWORD(time);
+		fileTime.dwHighDateTime = DWORD(time >> 32);
+		SetFileTime(file, nullptr, nullptr, &fileTime);
+		CloseHandle(file);
+	};
+	writeFrame(L"10.jpg", compressTestImage(64, 48));
+	writeFrame(L"9.jpg", compressTestImage(32, 16));
+	writeFrame(L"2.JPG", compressTestImage(96, 64));
+	writeFrame(L"notes.txt", { 'n', 'o' });
+
+	std::vector<unsigned char> jpeg;
+	unsigned width, height;
+	{
+		ThumbnailStore store(directory, storePath);
+		CHECK(store.getNumberOfFrames() == 0);
+		store.update();
+		store.waitForUpdate();
+		CHECK(store.getUpdateErrorMessage().empty());
+		REQUIRE(store.getNumberOfFrames() == 3);
+		CHECK(store.getFrameName(0) == L"2.JPG");
+		CHECK(store.getFrameName(1) == L"9.jpg");
+		CHECK(store.getFrameName(2) == L"10.jpg");
+		REQUIRE(store.getThumbnail(0, 0, &jpeg, &width, &height));
+		CHECK(width == 12);
+		CHECK(height == 8);
+		REQUIRE(store.getThumbnail(0, 1, &jpeg, &width, &height));
+		JPEGDecompressor thumbnail(jpeg.data(), (unsigned long)jpeg.size());
+		CHECK(thumbnail.getWidth() == 24);
+		CHECK(thumbnail.getHeight() == 16);
+	}
+	{
+		Base::MemoryMappedIO file(storePath.c_str());
+		REQUIRE(file.getSize() >= sizeof(ThumbnailStoreHeader));
+		const ThumbnailStoreHeader *header = (const ThumbnailStoreHeader*)file.getPtr();
+		CHECK(memcmp(header->magic, "TATTHB", 6) == 0);
+		CHECK(header->numberOfFrames == 3);
+		CHECK(header->numberOfLevels == 2);
+		CHECK(header->namesLength == 16);
+	}
+
+	// Other content under the same last write time, only a carried over thumbnail survives that
+	const uint64_t unchangedTime = getLastWriteTime(L"2.JPG");
+	writeFrame(L"2.JPG", { 0xFF, 0xD8, 0xFF, 0xD9 });
+	setLastWriteTime(L"2.JPG", unchangedTime);
+	// One second later, whatever the file system resolution
+	const uint64_t changedTime = getLastWriteTime(L"9.jpg") + 10000000;
+	writeFrame(L"9.jpg", compressTestImage(64, 48));
+	setLastWriteTime(L"9.jpg", changedTime);
+	DeleteFileW(Base::appendPath(directory, L"10.jpg").c_str());
+	writeFrame(L"1.jpg", compressTestImage(32, 16));
+	{
+		ThumbnailStore store(directory, storePath);
+		// Loaded from the store file, the outdated thumbnail is still there
+		REQUIRE(store.getNumberOfFrames() == 3);
+		REQUIRE(store.getThumbnail(1, 0, &jpeg, &width, &height));
+		CHECK(width == 4);
+		store.update();
+		store.waitForUpdate();
+		CHECK(store.getUpdateErrorMessage().empty());
+		REQUIRE(store.getNumberOfFrames() == 3);
+		CHECK(store.getFrameName(0) == L"1.jpg");
+		CHECK(store.getFrameName(1) == L"2.JPG");
+		CHECK(store.getFrameName(2) == L"9.jpg");
+		REQUIRE(store.getThumbnail(0, 0, &jpeg, &width, &height));
+		CHECK(width == 4);
+		CHECK(height == 2);
+		REQUIRE(store.getThumbnail(1, 0, &jpeg, &width, &height));
+		CHECK(width == 12);
+		REQUIRE(store.getThumbnail(2, 0, &jpeg, &width, &height));
+		CHECK(width == 8);
+		CHECK(height == 6);
+	}
+
+	for (const wchar_t *name : { L"1.jpg", L"2.JPG", L"9.jpg", L"notes.txt" })
+		DeleteFileW(Base::appendPath(directory, name).c_str());
+	RemoveDirectoryW(directory.c_str());
+	DeleteFileW(storePath.c_str());
+}
+
+TEST_CASE("buffer pool rounds sizes up and reuses released buffers")
+{
+	CHECK(Base::BufferPool::getCapacityOfSizeClass(0) == 65536);
+	CHECK(Base::BufferPool::getCapacityOfSizeClass(1) == 81920);
+	CHECK(Base::BufferPool::getCapacityOfSizeClass(16) == 1048576);
+
+	Base::BufferPool pool(false, 1);
+	for (size_t size = 1; size < 4 * 1048576; size = size * 3 + 7)
+	{
+		Base::BufferLease lease = pool.acquire(size);
+		REQUIRE(lease);
+		CHECK(lease.getSize() == size);
+		CHECK(lease.getCapacity() >= size);
+		// At most a quarter of slack above the smallest class
+		if (size > 65536)
+			CHECK((lease.getCapacity() - size) * 4 <= size);
+		CHECK(reinterpret_cast<uintptr_t>(lease.get()) % 64 == 0);
+	}
+	{
+		Base::BufferLease lease = pool.acquire(65537);
+		CHECK(lease.getCapacity() == 81920);
+		lease = pool.acquire(1048576);
+		CHECK(lease.getCapacity() == 1048576);
+	}
+
+	unsigned char *first;
+	{
+		Base::BufferLease lease = pool.acquire(100000);
+		first = lease.get();
+		CHECK(lease.getCapacity() == 114688);
+		lease.get()[99999] = 1;
+	}
+	// Same size class, handed back from the cache
+	Base::BufferLease reused = pool.acquire(110000);
+	CHECK(reused.get() == first);
+	Base::BufferLease other = pool.acquire(110000);
+	CHECK(other.get() != first);
+
+	Base::BufferLease moved(std::move(reused));
+	CHECK_FALSE(reused);
+	CHECK(reused.getCapacity() == 0);
+	CHECK(moved.get() == first);
+	CHECK(moved.getSize() == 110000);
+	// Assigning over a lease releases its buffer first
+	moved = std::move(other);
+	CHECK_FALSE(other);
+	CHECK(moved.get() != first);
+	CHECK(pool.acquire(100000).get() == first);
+	moved.release();
+	CHECK_FALSE(moved);
+	CHECK(moved.getSize() == 0);
+	pool.trim();
+
+	CHECK(&Base::BufferPool::getDefault() == &Base::BufferPool::getDefault());
+}
+
+TEST_CASE("async engine completes batched reads")
+{
+	std::vector<unsigned char> data(1 << 20);
+	for (size_t i = 0; i < data.size(); ++i)
+		data[i] = (unsigned char)(i * 13 + i / 4093);
+	const std::wstring path = Base::appendPath(Base::getTempPath(), L"image_decoder_unit_test_async_io.bin");
+	{
+		Base::File file(path, Base::File::Mode::write | Base::File::Mode::create_always);
+		REQUIRE(file.write(data.data(), 0, data.size()) == data.size());
+	}
+	{
+		Base::File file(path, Base::File::Mode::read | Base::File::Mode::overlapped);
+		Base::AsyncIOEngine engine(8);
+		engine.registerFile(file);
+		// More requests than may be in flight, the last one starts past the end of the file
+		const size_t numberOfRequests = 33;
+		const uint32_t blockSize = 32768;
+		std::vector<std::vector<unsigned char>> buffers(numberOfRequests, std::vector<unsigned char>(blockSize));
+		std::vector<Base::AsyncIORequest> requests;
+		for (size_t i = 0; i < numberOfRequests; ++i)
+			requests.push_back(Base::AsyncIORequest{ &file, i * blockSize, buffers[i].data(), blockSize, false, i });
+		std::vector<Base::AsyncIOCompletion> completions(numberOfRequests);
+		size_t numberOfSubmitted = 0, numberOfCompleted = 0;
+		while (numberOfCompleted < numberOfRequests)
+		{
+			numberOfSubmitted += engine.submit(requests.data() + numberOfSubmitted, numberOfRequests - numberOfSubmitted);
+			CHECK(engine.getNumberOfInFlight() <= engine.getMaximumInFlight());
+			const size_t n = engine.getCompletions(completions.data() + numberOfCompleted, numberOfRequests - numberOfCompleted, 5000);
+			REQUIRE(n > 0);
+			numberOfCompleted += n;
+		}
+		CHECK(engine.getNumberOfInFlight() == 0);
+		std::vector<bool> seen(numberOfRequests);
+		for (const Base::AsyncIOCompletion &completion : completions)
+		{
+			const size_t i = size_t(completion.userData);
+			REQUIRE(i < numberOfRequests);
+			CHECK_FALSE(seen[i]);
+			seen[i] = true;
+			if (i * blockSize >= data.size())
+			{
+				CHECK(completion.error == ERROR_HANDLE_EOF);
+				continue;
+			}
+			CHECK(completion.error == 0);
+			CHECK(completion.bytesTransferred == blockSize);
+			CHECK(std::equal(buffers[i].begin(), buffers[i].end(), data.begin() + i * blockSize));
+		}
+
+		// A synchronous read on the registered file leaves nothing for the engine to collect
+		std::vector<unsigned char> buffer(blockSize);
+		REQUIRE(file.read(buffer.data(), blockSize, blockSize) == blockSize);
+		CHECK(std::equal(buffer.begin(), buffer.end(), data.begin() + blockSize));
+		CHECK(engine.getCompletions(completions.data(), 1, 50) == 0);
+		CHECK(engine.getNumberOfInFlight() == 0);
+	}
+	DeleteFileW(path.c_str());
+}
+
+TEST_CASE("dataset scanner lists naturally and rescans changed directories")
+{
+	const std::wstring root = Base::appendPath(Base::getTempPath(), L"image_decoder_unit_test_dataset");
+	const std::wstring sequence = Base::appendPath(root, L"class\\seq2");
+	CreateDirectoryW(root.c_str(), nullptr);
+	CreateDirectoryW(Base::appendPath(root, L"class").c_str(), nullptr);
+	CreateDirectoryW(Base::appendPath(root, L"class\\seq10").c_str(), nullptr);
+	CreateDirectoryW(sequence.c_str(), nullptr);
+	const wchar_t *frames[] = { L"10.jpg", L"9.jpg", L"100.jpg" };
+	const unsigned char content[4] = { 0xFF, 0xD8, 0xFF, 0xD9 };
+	for (const wchar_t *frame : frames)
+		Base::File(Base::appendPath(sequence, frame), Base::File::Mode::write | Base::File::Mode::create_always).write(content, 0, 4);
+
+	Base::DatasetScanner scanner(root);
+	CHECK(scanner.scan() == 4);
+	REQUIRE(scanner.getNumberOfDirectories() == 4);
+	CHECK(scanner.getDirectoryPath(2) == L"class\\seq2");
+	CHECK(scanner.getDirectoryPath(3) == L"class\\seq10");
+	const size_t directory = scanner.findDirectory(L"class\\seq2");
+	REQUIRE(directory == 2);
+	REQUIRE(scanner.getNumberOfFiles(directory) == 3);
+	CHECK(scanner.getFileName(directory, 0) == L"9.jpg");
+	CHECK(scanner.getFileName(directory, 2) == L"100.jpg");
+	CHECK(scanner.getFileSize(directory, 1) == 4);
+	CHECK(scanner.scan() == 0);
+
+	// Only the sequence the frame is added to is listed again
+	Base::File(Base::appendPath(sequence, L"1.jpg"), Base::File::Mode::write | Base::File::Mode::create_always).write(content, 0, 1);
+	CHECK(scanner.scan() == 1);
+	REQUIRE(scanner.getNumberOfFiles(scanner.findDirectory(L"class\\seq2")) == 4);
+	CHECK(scanner.getFileName(scanner.findDirectory(L"class\\seq2"), 0) == L"1.jpg");
+
+	DeleteFileW(Base::appendPath(sequence, L"1.jpg").c_str());
+	for (const wchar_t *frame : frames)
+		DeleteFileW(Base::appendPath(sequence, frame).c_str());
+	RemoveDirectoryW(sequence.c_str());
+	RemoveDirectoryW(Base::appendPath(root, L"class\\seq10").c_str());
+	RemoveDirectoryW(Base::appendPath(root, L"class").c_str());
+	RemoveDirectoryW(root.c_str());
+}
+
+TEST_CASE("directory watcher coalesces changes for the dataset scanner")
+{
+	const std::wstring root = Base::appendPath(Base::getTempPath(), L"image_decoder_unit_test_watched");
+	const std::wstring sequence = Base::appendPath(root, L"seq");
+	CreateDirectoryW(root.c_str(), nullptr);
+	CreateDirectoryW(sequence.c_str(), nullptr);
+	Base::DatasetScanner scanner(root);
+	scanner.scan();
+	{
+		Base::DirectoryWatcher watcher(root, 50);
+		std::promise<std::vector<std::wstring>> changes;
+		std::atomic<unsigned> numberOfNotifications(0);
+		watcher.addListener([&](const std::vector<std::wstring> &paths, bool overflowed)
+		{
+			if (numberOfNotifications++ == 0)
+				changes.set_value(overflowed ? std::vector<std::wstring>() : paths);
+		});
+		Base::NativeEventLooper looper;
+		looper.registerWaitableObject(&watcher);
+		std::thread looperThread([&looper]() { looper.runLooper(); });
+
+		const unsigned char content[4] = { 0xFF, 0xD8, 0xFF, 0xD9 };
+		for (const wchar_t *frame : { L"1.jpg", L"2.jpg", L"3.jpg" })
+			Base::File(Base::appendPath(sequence, frame), Base::File::Mode::write | Base::File::Mode::create_always).write(content, 0, 4);
+		std::future<std::vector<std::wstring>> future = changes.get_future();
+		const bool notified = future.wait_for(std::chrono::seconds(5)) == std::future_status::ready;
+		looper.cancel();
+		looperThread.join();
+		REQUIRE(notified);
+		const std::vector<std::wstring> paths = future.get();
+		CHECK(std::find(paths.begin(), paths.end(), L"seq\\1.jpg") != paths.end());
+		CHECK(scanner.scan(paths) >= 1);
+		CHECK(scanner.getNumberOfFiles(scanner.findDirectory(L"seq")) >= 1);
+	}
+	for (const wchar_t *frame : { L"1.jpg", L"2.jpg", L"3.jpg" })
+		DeleteFileW(Base::appendPath(sequence, frame).c_str());
+	RemoveDirectoryW(sequence.c_str());
+	RemoveDirectoryW(root.c_str());
+}
+
+TEST_CASE("task scheduler runs nested groups and propagates failures")
+{
+	Base::TaskScheduler scheduler(4);
+	std::atomic<size_t> sum(0);
+	Base::parallelFor(scheduler, 0, 100000, [&sum](size_t index) { sum += index; }, 64);
+	CHECK(sum == size_t(100000) * 99999 / 2);
+
+	// Groups waited for inside tasks, the waiting workers keep running queued tasks
+	std::atomic<unsigned> numberOfInnerTasks(0);
+	Base::TaskGroup outer(scheduler);
+	for (unsigned i = 0; i < 50; ++i)
+		outer.run([&scheduler, &numberOfInnerTasks]()
+		{
+			Base::TaskGroup inner(scheduler);
+			for (unsigned j = 0; j < 20; ++j)
+				inner.run([&numberOfInnerTasks]() { ++numberOfInnerTasks; });
+			inner.wait();
+		});
+	outer.wait();
+	CHECK(numberOfInnerTasks == 1000);
+
+	CHECK_THROWS_AS(Base::parallelFor(scheduler, 0, 1000, [](size_t index) { if (index == 500) throw std::runtime_error("failed"); }), std::runtime_error);
+	// Thrown on the calling thread while the pieces handed out are still running
+	std::atomic<unsigned> numberOfPieces(0);
+	CHECK_THROWS_AS(Base::parallelFor(scheduler, 0, 64, [&numberOfPieces](size_t index)
+	{
+		if (index == 0)
+			throw std::runtime_error("failed");
+		std::this_thread::sleep_for(std::chrono::milliseconds(5));
+		++numberOfPieces;
+	}), std::runtime_error);
+	CHECK(numberOfPieces < 63);
+
+	Base::CancellationToken token;
+	token.cancel();
+	std::atomic<unsigned> numberOfRun(0);
+	Base::TaskGroup canceled(scheduler, token);
+	for (unsigned i = 0; i < 10; ++i)
+		canceled.run([&numberOfRun]() { ++numberOfRun; });
+	canceled.wait();
+	CHECK(numberOfRun == 0);
+}
+
+TEST_CASE("event looper waits on more than MAXIMUM_WAIT_OBJECTS handles")
+{
+	class EventSource : public Base::NativeWaitableObject
+	{
+	public:
+		EventSource(Base::NativeEventLooper &looper, unsigned numberOfEvents, unsigned &numberOfCallbacks)
+			: _looper(looper), _events(numberOfEvents), _signaled(numberOfEvents), _numberOfCallbacks(numberOfCallbacks)
+		{
+		}
+		void getNumberOfWaitableObjects(uint32_t *numberOfWaitableObject) override
+		{
+			*numberOfWaitableObject = uint32_t(_events.size());
+		}
+		void getWaitableObjects(HANDLE *nativeWaitableObjects) override
+		{
+			for (size_t i = 0; i < _events.size(); ++i)
+				nativeWaitableObjects[i] = _events[i].getHandle();
+		}
+		void callback(uint32_t index) override
+		{
+			++_signaled[index];
+			if (++_numberOfCallbacks == _events.size())
+				_looper.cancel();
+		}
+		std::vector<Base::Event> &getEvents() { return _events; }
+		const std::vector<unsigned> &getSignaled() const { return _signaled; }
+	private:
+		Base::NativeEventLooper &_looper;
+		std::vector<Base::Event> _events;
+		std::vector<unsigned> _signaled;
+		unsigned &_numberOfCallbacks;
+	};
+
+	Base::NativeEventLooper looper;
+	unsigned numberOfCallbacks = 0;
+	EventSource source(looper, 300, numberOfCallbacks);
+	looper.registerWaitableObject(&source);
+	for (Base::Event &event : source.getEvents())
+		event.set();
+	looper.runLooper();
+	CHECK(numberOfCallbacks == 300);
+	CHECK(std::all_of(source.getSignaled().begin(), source.getSignaled().end(), [](unsigned n) { return n == 1; }));
+
+	// Auto reset events are waited for again after their callback
+	numberOfCallbacks = 0;
+	for (Base::Event &event : source.getEvents())
+		event.set();
+	looper.runLooper();
+	CHECK(std::all_of(source.getSignaled().begin(), source.getSignaled().end(), [](unsigned n) { return n == 2; }));
+	looper.eraseWaitableObject(&source);
+}
+
+TEST_CASE("message notifier passes move only messages from many producers")
+{
+	Base::MessageNotifier<std::unique_ptr<unsigned>> notifier(64);
+	const unsigned numberOfProducers = 4, numberOfMessages = 20000;
+	std::vector<std::thread> producers;
+	for (unsigned producer = 0; producer < numberOfProducers; ++producer)
+		producers.emplace_back([&notifier, producer, numberOfMessages]()
+		{
+			for (unsigned i = 0; i < numberOfMessages; i += 4)
+			{
+				std::unique_ptr<unsigned> batch[4];
+				for (unsigned j = 0; j < 4; ++j)
+					batch[j] = std::make_unique<unsigned>(producer * numberOfMessages + i + j);
+				notifier.send(batch, 4);
+			}
+		});
+	std::vector<unsigned char> received(numberOfProducers * numberOfMessages);
+	for (size_t i = 0; i < received.size(); ++i)
+	{
+		std::unique_ptr<unsigned> message;
+		notifier.get(&message);
+		REQUIRE(*message < received.size());
+		++received[*message];
+	}
+	for (std::thread &producer : producers)
+		producer.join();
+	CHECK(std::all_of(received.begin(), received.end(), [](unsigned char n) { return n == 1; }));
+	std::unique_ptr<unsigned> message;
+	CHECK_FALSE(notifier.try_get(&message));
+
+	// A consumer waiting on the event before it ever called try_get(), then again once drained
+	Base::MessageNotifier<unsigned> waited;
+	std::thread sender([&waited]()
+	{
+		for (unsigned i = 0; i < 2; ++i)
+		{
+			std::this_thread::sleep_for(std::chrono::milliseconds(20));
+			waited.send(i);
+		}
+	});
+	for (unsigned i = 0; i < 2; ++i)
+	{
+		REQUIRE(WaitForSingleObject(waited.getEventHandle(), 5000) == WAIT_OBJECT_0);
+		unsigned value;
+		REQUIRE(waited.try_get(&value));
+		CHECK(value == i);
+		CHECK_FALSE(waited.try_get(&value));
+	}
+	sender.join();
+
+	Base::BoundedQueue<std::unique_ptr<unsigned>> queue(3);
+	REQUIRE(queue.getCapacity() == 4);
+	for (unsigned i = 0; i < 4; ++i)
+		CHECK(queue.tryPush(std::make_unique<unsigned>(i)));
+	std::unique_ptr<unsigned> rejected = std::make_unique<unsigned>(4);
+	CHECK_FALSE(queue.tryPush(std::move(rejected)));
+	CHECK(rejected);
+}
+
+TEST_CASE("timer wheel fires, repeats and cancels timers")
+{
+	Base::NativeEventLooper looper;
+	Base::TimerWheel wheel(1);
+	looper.registerWaitableObject(&wheel);
+	std::vector<unsigned> fired;
+	// Milliseconds from scheduling to firing, the last one goes through a cascade from the second level
+	std::vector<long long> elapsed(6, -1);
+	const unsigned delays[6] = { 5, 25, 45, 65, 85, 200 };
+	const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	auto getElapsed = [start]()
+	{
+		return (long long)std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+	};
+	unsigned numberOfRepeats = 0;
+	for (unsigned i = 0; i < 5; ++i)
+		wheel.schedule(delays[i], [&, i]() { fired.push_back(i); elapsed[i] = getElapsed(); });
+	const Base::TimerWheel::TimerId canceled = wheel.schedule(30, [&fired]() { fired.push_back(100); });
+	CHECK(wheel.cancel(canceled));
+	CHECK_FALSE(wheel.cancel(canceled));
+	Base::TimerWheel::TimerId periodic = 0;
+	periodic = wheel.schedule(1, [&]()
+	{
+		if (++numberOfRepeats == 10)
+			CHECK(wheel.cancel(periodic));
+	}, 10);
+	// Beyond the first level of the wheel
+	wheel.schedule(delays[5], [&]() { elapsed[5] = getElapsed(); looper.cancel(); });
+	looper.runLooper();
+	CHECK(fired == std::vector<unsigned>({ 0, 1, 2, 3, 4 }));
+	for (unsigned i = 0; i < 6; ++i)
+	{
+		// Ticks are counted from the wheel creation, the first one may be partly gone already
+		CHECK(elapsed[i] >= (long long)delays[i] - 1);
+		// Generous, the waitable timer is subject to the system timer resolution
+		CHECK(elapsed[i] < (long long)delays[i] + 100);
+	}
+	CHECK(numberOfRepeats == 10);
+	CHECK(wheel.getNumberOfTimers() == 0);
+	looper.eraseWaitableObject(&wheel);
+}
+
+// Defined in logging.cpp, swapped for a counting one while the writer runs
+extern std::shared_ptr<spdlog::logger> logger;
+
+class CountingSink : public spdlog::sinks::base_sink<std::mutex>
+{
+public:
+	CountingSink()
+		: numberOfRecords(0)
+	{
+	}
+	std::atomic<uint64_t> numberOfRecords;
+protected:
+	void _sink_it(const spdlog::details::log_msg &) override
+	{
+		++numberOfRecords;
+	}
+	void _flush() override
+	{
+	}
+};
+
+static void logFromManyThreads(spdlog::level::level_enum level, unsigned numberOfThreads, unsigned numberOfRecords)
+{
+	std::vector<std::thread> threads;
+	for (unsigned thread = 0; thread < numberOfThreads; ++thread)
+		threads.emplace_back([=]()
+		{
+			for (unsigned i = 0; i < numberOfRecords; ++i)
+			{
+				const std::string text = "thread " + std::to_string(thread) + " record " + std::to_string(i);
+				Base::LogRecord record;
+				record.level = level;
+				record.file = __FILE__;
+				record.function = __func__;
+				record.line = __LINE__;
+				record.setMessage(text.data(), text.size());
+				Base::writeLog(std::move(record));
+			}
+		});
+	for (std::thread &thread : threads)
+		thread.join();
+}
+
+TEST_CASE("async logging queues records from many threads")
+{
+	const std::shared_ptr<spdlog::logger> previousLogger = logger;
+	const std::shared_ptr<CountingSink> sink = std::make_shared<CountingSink>();
+	logger = std::make_shared<spdlog::logger>("counting", sink);
+	logger->set_level(spdlog::level::trace);
+	CHECK_FALSE(Base::AsyncLogging::isRunning());
+	{
+		Base::AsyncLogging async(64);
+		REQUIRE(Base::AsyncLogging::isRunning());
+		// Records below error are dropped while the ring is full, every other one is written
+		logFromManyThreads(spdlog::level::debug, 4, 1000);
+		async.flush();
+		CHECK(sink->numberOfRecords.load() + async.getNumberOfDropped() == 4000);
+
+		// Errors wait for room instead
+		const uint64_t numberOfDropped = async.getNumberOfDropped();
+		const uint64_t numberOfWritten = sink->numberOfRecords.load();
+		logFromManyThreads(spdlog::level::err, 4, 1000);
+		async.flush();
+		CHECK(async.getNumberOfDropped() == numberOfDropped);
+		CHECK(sink->numberOfRecords.load() == numberOfWritten + 4000);
+
+		const std::string longText(Base::LogRecord::inlineMessageSize * 2, 'x');
+		Base::LogRecord record;
+		record.level = spdlog::level::err;
+		record.setMessage(longText.data(), longText.size());
+		CHECK(std::string(record.getMessage(), record.messageLength) == longText);
+		Base::writeLog(std::move(record));
+		async.flush();
+		CHECK(async.getNumberOfDropped() == numberOfDropped);
+		CHECK(sink->numberOfRecords.load() == numberOfWritten + 4001);
+	}
+	CHECK_FALSE(Base::AsyncLogging::isRunning());
+	logger = previousLogger;
+}
+
+class RecordingSink : public spdlog::sinks::base_sink<std::mutex>
+{
+public:
+	std::vector<std::pair<spdlog::level::level_enum, std::string>> records;
+protected:
+	void _sink_it(const spdlog::details::log_msg &msg) override
+	{
+		records.emplace_back(msg.level, msg.raw.str());
+	}
+	void _flush() override
+	{
+	}
+};
+
+// The text after the "[file:line function] " prefix
+static std::string withoutLocation(const std::string &text)
+{
+	return text.substr(text.find("] ") + 2);
+}
+
+TEST_CASE("leveled logging cuts texts at the inline buffer and converts UTF-16")
+{
+	const std::shared_ptr<spdlog::logger> previousLogger = logger;
+	const std::shared_ptr<RecordingSink> sink = std::make_shared<RecordingSink>();
+	logger = std::make_shared<spdlog::logger>("recording", sink);
+	logger->set_level(spdlog::level::trace);
+	const size_t size = Base::LogRecord::inlineMessageSize;
+
+	LOG_ERROR << std::string(size, 'a');
+	LOG_ERROR << std::string(size - 1, 'a') << "bc" << 123;
+	LOG_ERROR << L"caf\u00e9 \U0001F600";
+	// A surrogate pair is written whole or not at all
+	LOG_ERROR << std::string(size - 4, 'a') << L"\U0001F600";
+	LOG_ERROR << std::string(size - 6, 'a') << L"\U0001F600";
+	REQUIRE(sink->records.size() == 5);
+	CHECK(sink->records[0].first == spdlog::level::err);
+	CHECK(withoutLocation(sink->records[0].second) == std::string(size, 'a'));
+	CHECK(withoutLocation(sink->records[1].second) == std::string(size - 1, 'a') + "b");
+	CHECK(withoutLocation(sink->records[2].second) == "caf\xc3\xa9 \xf0\x9f\x98\x80");
+	CHECK(withoutLocation(sink->records[3].second) == std::string(size - 4, 'a'));
+	CHECK(withoutLocation(sink->records[4].second) == std::string(size - 6, 'a') + "\xf0\x9f\x98\x80");
+	logger = previousLogger;
+}
+
+TEST_CASE("stream logging keeps texts longer than the inline buffer")
+{
+	const std::shared_ptr<spdlog::logger> previousLogger = logger;
+	const std::shared_ptr<RecordingSink> sink = std::make_shared<RecordingSink>();
+	logger = std::make_shared<spdlog::logger>("recording", sink);
+	const std::string longText(Base::LogRecord::inlineMessageSize * 3, 'x');
+	for (bool async : { false, true })
+	{
+		std::unique_ptr<Base::AsyncLogging> asyncLogging;
+		if (async)
+			asyncLogging = std::make_unique<Base::AsyncLogging>();
+		sink->records.clear();
+		const int expected = 1, actual = 2;
+		CHECK_THROWS_AS([&]() { CHECK_EQ(actual, expected) << longText; }(), Base::RuntimeException);
+		if (asyncLogging)
+			asyncLogging->flush();
+		REQUIRE(sink->records.size() == 1);
+		const std::string &text = sink->records[0].second;
+		CHECK(sink->records[0].first == spdlog::level::warn);
+		CHECK(text.find("(2 vs. 1) ") != std::string::npos);
+		REQUIRE(text.size() > longText.size());
+		CHECK(text.compare(text.size() - longText.size(), longText.size(), longText) == 0);
+	}
+	logger = previousLogger;
+}
+
+TEST_CASE("async logging writes fatal errors with their stack trace before throwing")
+{
+	const std::shared_ptr<spdlog::logger> previousLogger = logger;
+	const std::shared_ptr<RecordingSink> sink = std::make_shared<RecordingSink>();
+	logger = std::make_shared<spdlog::logger>("recording", sink);
+	{
+		Base::AsyncLogging asyncLogging;
+		const bool ready = false;
+		std::string what;
+		try {
+			ENSURE(ready) << "fatal test error";
+		}
+		catch (Base::FatalError &exp)
+		{
+			what = exp.what();
+		}
+		// No flush() here, the record has to be written already
+		REQUIRE(sink->records.size() == 1);
+		const std::string &text = sink->records[0].second;
+		CHECK(sink->records[0].first == spdlog::level::critical);
+		CHECK(text.find("fatal test error") != std::string::npos);
+		// The writer symbolized the frames, the exception only carries the message
+		CHECK(text.find("*** Check failure stack trace: ***\n0\t0x") != std::string::npos);
+		CHECK(what.find("fatal test error") != std::string::npos);
+		CHECK(what.find("stack trace") == std::string::npos);
+	}
+	logger = previousLogger;
+}
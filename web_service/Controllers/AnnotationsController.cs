@@ -14,11 +14,11 @@ namespace web_service.Controllers
     [Route("api/annotations")]
     public class AnnotationsController : Controller
     {
-        private IConfiguration _configuration;
+        private SequenceCache _sequenceCache;
 
-        public AnnotationsController(IConfiguration Configuration)
+        public AnnotationsController(SequenceCache sequenceCache)
         {
-            _configuration = Configuration;
+            _sequenceCache = sequenceCache;
         }
         public struct Record
         {
@@ -31,30 +31,11 @@ namespace web_service.Controllers
             public bool outOfView;
         }
 
-        private string[] GetSequences()
-        {
-            string datasetPath = _configuration["DataSet:Path"];
-            DirectoryInfo datasetDirectoryInfo = new DirectoryInfo(datasetPath);
-            var dirs = datasetDirectoryInfo.EnumerateDirectories();
-            IList<string> sequences = new List<string>();
-            foreach (var dir in dirs)
-            {
-                DirectoryInfo subDirectoryInfo = new DirectoryInfo(dir.FullName);
-                var subDirs = subDirectoryInfo.EnumerateDirectories();
-                foreach (var subdir in subDirs)
-                {
-                    sequences.Add(dir.Name + '/' + subdir.Name);
-                }
-            }
-
-            return sequences.ToArray();
-        }
-
         // GET api/values
         [HttpGet]
         public IEnumerable<string> Get()
         {
-            return GetSequences();
+            return _sequenceCache.GetSequences();
         }
 
         [HttpGet]
@@ -0,0 +1,74 @@
+﻿using System;
+using System.Collections.Generic;
+
+namespace web_service
+{
+    // Same order as Base::compareNatural: digit runs compare by value ("seq2" < "seq10"), other characters
+    // case insensitive, path separators before anything else so the sequence list matches the frame tools
+    public class NaturalStringComparer : IComparer<string>
+    {
+        public static readonly NaturalStringComparer Instance = new NaturalStringComparer();
+
+        private static bool IsDigit(char character)
+        {
+            return character >= '0' && character <= '9';
+        }
+
+        private static bool IsSeparator(char character)
+        {
+            return character == '/' || character == '\\';
+        }
+
+        public int Compare(string left, string right)
+        {
+            if (ReferenceEquals(left, right))
+                return 0;
+            if (left == null)
+                return -1;
+            if (right == null)
+                return 1;
+            int i = 0, j = 0;
+            while (i < left.Length && j < right.Length)
+            {
+                if (IsDigit(left[i]) && IsDigit(right[j]))
+                {
+                    while (i < left.Length && left[i] == '0')
+                        ++i;
+                    while (j < right.Length && right[j] == '0')
+                        ++j;
+                    int leftEnd = i, rightEnd = j;
+                    while (leftEnd < left.Length && IsDigit(left[leftEnd]))
+                        ++leftEnd;
+                    while (rightEnd < right.Length && IsDigit(right[rightEnd]))
+                        ++rightEnd;
+                    // Without leading zeros the longer run is the larger number
+                    if (leftEnd - i != rightEnd - j)
+                        return leftEnd - i < rightEnd - j ? -1 : 1;
+                    for (; i < leftEnd; ++i, ++j)
+                    {
+                        if (left[i] != right[j])
+                            return left[i] < right[j] ? -1 : 1;
+                    }
+                    continue;
+                }
+                char leftCharacter = char.ToLowerInvariant(left[i]), rightCharacter = char.ToLowerInvariant(right[j]);
+                if (leftCharacter != rightCharacter)
+                {
+                    if (IsSeparator(leftCharacter))
+                        return -1;
+                    if (IsSeparator(rightCharacter))
+                        return 1;
+                    return leftCharacter < rightCharacter ? -1 : 1;
+                }
+                ++i;
+                ++j;
+            }
+            if (i < left.Length)
+                return 1;
+            if (j < right.Length)
+                return -1;
+            // Equal apart from case or leading zeros, ordinal order keeps the order strict
+            return Math.Sign(string.CompareOrdinal(left, right));
+        }
+    }
+}
@@ -0,0 +1,89 @@
+﻿using System;
+using System.Collections.Generic;
+using System.IO;
+using System.Linq;
+using System.Threading.Tasks;
+using Microsoft.Extensions.Configuration;
+
+namespace web_service
+{
+    // Sequences of the dataset (<class>/<sequence> directories), kept between requests. A class directory
+    // is only enumerated again when its last write time changed, which is when sequences are added,
+    // removed or renamed in it.
+    public class SequenceCache
+    {
+        private struct ClassEntry
+        {
+            public DateTime lastWriteTime;
+            public string[] sequences;
+        }
+
+        private readonly string _datasetPath;
+        private readonly object _lock = new object();
+        private DateTime _lastWriteTime;
+        private Dictionary<string, ClassEntry> _classes = new Dictionary<string, ClassEntry>();
+        private string[] _sequences = new string[0];
+
+        public SequenceCache(IConfiguration configuration)
+        {
+            _datasetPath = configuration["DataSet:Path"];
+        }
+
+        public string[] GetSequences()
+        {
+            lock (_lock)
+            {
+                DirectoryInfo datasetDirectoryInfo = new DirectoryInfo(_datasetPath);
+                bool changed = false;
+                if (datasetDirectoryInfo.LastWriteTimeUtc != _lastWriteTime)
+                {
+                    _lastWriteTime = datasetDirectoryInfo.LastWriteTimeUtc;
+                    var classes = new Dictionary<string, ClassEntry>();
+                    foreach (var dir in datasetDirectoryInfo.EnumerateDirectories())
+                    {
+                        ClassEntry entry;
+                        if (!_classes.TryGetValue(dir.Name, out entry))
+                            entry.lastWriteTime = DateTime.MinValue;
+                        classes.Add(dir.Name, entry);
+                    }
+                    _classes = classes;
+                    changed = true;
+                }
+
+                // The class directories are checked, and enumerated if needed, in parallel
+                string[] names = _classes.Keys.ToArray();
+                ClassEntry[] entries = new ClassEntry[names.Length];
+                bool[] updated = new bool[names.Length];
+                Parallel.For(0, names.Length, i =>
+                {
+                    ClassEntry entry = _classes[names[i]];
+                    DirectoryInfo classDirectoryInfo = new DirectoryInfo(Path.Combine(_datasetPath, names[i]));
+                    DateTime lastWriteTime = classDirectoryInfo.Exists ? classDirectoryInfo.LastWriteTimeUtc : DateTime.MinValue;
+                    if (entry.sequences == null || lastWriteTime != entry.lastWriteTime)
+                    {
+                        entry.lastWriteTime = lastWriteTime;
+                        entry.sequences = classDirectoryInfo.Exists ?
+                            classDirectoryInfo.EnumerateDirectories().Select(subdir => names[i] + '/' + subdir.Name).ToArray() : new string[0];
+                        updated[i] = true;
+                    }
+                    entries[i] = entry;
+                });
+                for (int i = 0; i < names.Length; ++i)
+                {
+                    if (!updated[i])
+                        continue;
+                    _classes[names[i]] = entries[i];
+                    changed = true;
+                }
+
+                if (changed)
+                {
+                    var sequences = _classes.Values.SelectMany(entry => entry.sequences).ToArray();
+                    Array.Sort(sequences, NaturalStringComparer.Instance);
+                    _sequences = sequences;
+                }
+                return _sequences;
+            }
+        }
+    }
+}
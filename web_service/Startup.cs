@@ -23,6 +23,7 @@ namespace web_service
         // This method gets called by the runtime. Use this method to add services to the container.
         public void ConfigureServices(IServiceCollection services)
         {
+            services.AddSingleton<SequenceCache>();
             services.AddMvc();
         }
 